@@ -117,6 +117,9 @@ BEGIN
     -- enterprise catalog tables
     CREATE TABLE public.pg_dist_authinfo AS SELECT * FROM pg_catalog.pg_dist_authinfo;
     CREATE TABLE public.pg_dist_poolinfo AS SELECT * FROM pg_catalog.pg_dist_poolinfo;
+    -- zone map catalog tables
+    CREATE TABLE public.pg_dist_zone_map_column AS SELECT * FROM citus.pg_dist_zone_map_column;
+    CREATE TABLE public.pg_dist_shard_zone_map AS SELECT * FROM citus.pg_dist_shard_zone_map;
 
     -- store upgrade stable identifiers on pg_dist_object catalog
     UPDATE citus.pg_dist_object
@@ -152,6 +155,9 @@ BEGIN
     -- enterprise catalog tables
     INSERT INTO pg_catalog.pg_dist_authinfo SELECT * FROM public.pg_dist_authinfo;
     INSERT INTO pg_catalog.pg_dist_poolinfo SELECT * FROM public.pg_dist_poolinfo;
+    -- zone map catalog tables
+    INSERT INTO citus.pg_dist_zone_map_column SELECT * FROM public.pg_dist_zone_map_column;
+    INSERT INTO citus.pg_dist_shard_zone_map SELECT * FROM public.pg_dist_shard_zone_map;
 
     --
     -- drop backup tables
@@ -165,7 +171,9 @@ BEGIN
     DROP TABLE public.pg_dist_placement;
     DROP TABLE public.pg_dist_poolinfo;
     DROP TABLE public.pg_dist_shard;
+    DROP TABLE public.pg_dist_shard_zone_map;
     DROP TABLE public.pg_dist_transaction;
+    DROP TABLE public.pg_dist_zone_map_column;
 
     --
     -- reset sequences
@@ -224,3 +232,108 @@ $cppu$;
 
 COMMENT ON FUNCTION pg_catalog.citus_finish_pg_upgrade()
     IS 'perform tasks to restore citus settings from a location that has been prepared before pg_upgrade';
+
+CREATE TABLE citus.pg_dist_zone_map_column (
+    logicalrelid regclass NOT NULL,
+    attnum int2 NOT NULL,
+    atttypid oid NOT NULL,
+
+    CONSTRAINT pg_dist_zone_map_column_pkey PRIMARY KEY (logicalrelid, attnum)
+);
+
+CREATE TABLE citus.pg_dist_shard_zone_map (
+    shardid int8 NOT NULL,
+    attnum int2 NOT NULL,
+    minvalue text,
+    maxvalue text,
+    nullcount int8 NOT NULL,
+
+    CONSTRAINT pg_dist_shard_zone_map_pkey PRIMARY KEY (shardid, attnum)
+);
+
+CREATE FUNCTION pg_catalog.master_add_zone_map_column(table_name regclass,
+                                                      column_name text)
+    RETURNS void
+    LANGUAGE C STRICT
+    AS 'MODULE_PATHNAME', $$master_add_zone_map_column$$;
+COMMENT ON FUNCTION pg_catalog.master_add_zone_map_column(table_name regclass,
+                                                          column_name text)
+    IS 'keep per-shard min/max values of a column of an append- or range-distributed table for shard pruning';
+
+CREATE FUNCTION pg_catalog.worker_partial_agg_sfunc(internal, oid, anyelement)
+    RETURNS internal
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$worker_partial_agg_sfunc$$;
+COMMENT ON FUNCTION pg_catalog.worker_partial_agg_sfunc(internal, oid, anyelement)
+    IS 'transition function for worker_partial_agg';
+
+CREATE FUNCTION pg_catalog.worker_partial_agg_ffunc(internal)
+    RETURNS cstring
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$worker_partial_agg_ffunc$$;
+COMMENT ON FUNCTION pg_catalog.worker_partial_agg_ffunc(internal)
+    IS 'finalizer for worker_partial_agg';
+
+CREATE FUNCTION pg_catalog.coord_combine_agg_sfunc(internal, oid, cstring, anyelement)
+    RETURNS internal
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$coord_combine_agg_sfunc$$;
+COMMENT ON FUNCTION pg_catalog.coord_combine_agg_sfunc(internal, oid, cstring, anyelement)
+    IS 'transition function for coord_combine_agg';
+
+CREATE FUNCTION pg_catalog.coord_combine_agg_ffunc(internal, oid, cstring, anyelement)
+    RETURNS anyelement
+    LANGUAGE C
+    AS 'MODULE_PATHNAME', $$coord_combine_agg_ffunc$$;
+COMMENT ON FUNCTION pg_catalog.coord_combine_agg_ffunc(internal, oid, cstring, anyelement)
+    IS 'finalizer for coord_combine_agg';
+
+-- select worker_partial_agg(agg, ...)
+-- equivalent to
+-- select serialize_stype(agg_without_finalfunc(...))
+CREATE AGGREGATE pg_catalog.worker_partial_agg(oid, anyelement) (
+    STYPE = internal,
+    SFUNC = pg_catalog.worker_partial_agg_sfunc,
+    FINALFUNC = pg_catalog.worker_partial_agg_ffunc
+);
+COMMENT ON AGGREGATE pg_catalog.worker_partial_agg(oid, anyelement)
+    IS 'create partial aggregate state of the given aggregate on workers';
+
+-- select coord_combine_agg(agg, col)
+-- equivalent to
+-- select finalize(combine_agg(deserialize_stype(col)))
+CREATE AGGREGATE pg_catalog.coord_combine_agg(oid, cstring, anyelement) (
+    STYPE = internal,
+    SFUNC = pg_catalog.coord_combine_agg_sfunc,
+    FINALFUNC = pg_catalog.coord_combine_agg_ffunc,
+    FINALFUNC_EXTRA
+);
+COMMENT ON AGGREGATE pg_catalog.coord_combine_agg(oid, cstring, anyelement)
+    IS 'combine partial aggregate states of the given aggregate on the coordinator';
+
+CREATE OR REPLACE FUNCTION pg_catalog.fetch_intermediate_result_pieces(result_id text,
+                                                                      piece_ids text[],
+                                                                      node_names text[],
+                                                                      node_ports int[])
+    RETURNS bigint
+    LANGUAGE C STRICT VOLATILE
+    AS 'MODULE_PATHNAME', $$fetch_intermediate_result_pieces$$;
+COMMENT ON FUNCTION pg_catalog.fetch_intermediate_result_pieces(text,text[],text[],int[])
+    IS 'assemble an intermediate result out of pieces stored on other nodes';
+
+CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
+    result_prefix text,
+    query text,
+    partition_column_index int,
+    partition_method citus.distribution_type,
+    split_point_min_values text[],
+    split_point_max_values text[],
+    partition_indexes int[] DEFAULT NULL,
+    OUT partition_index int,
+    OUT rows_written bigint,
+    OUT bytes_written bigint)
+    RETURNS SETOF record
+    LANGUAGE C VOLATILE
+    AS 'MODULE_PATHNAME', $$worker_partition_query_result$$;
+COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text,text,int,citus.distribution_type,text[],text[],int[])
+    IS 'execute a query and write its results into intermediate results partitioned by a column';
@@ -71,6 +71,7 @@
 #include "distributed/commands/multi_copy.h"
 #include "distributed/commands/utility_hook.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/local_executor.h"
 #include "distributed/master_protocol.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_partitioning_utils.h"
@@ -84,6 +85,7 @@
 #include "distributed/remote_transaction.h"
 #include "distributed/resource_lock.h"
 #include "distributed/shard_pruning.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
 #include "executor/executor.h"
@@ -2233,8 +2235,15 @@ CitusCopyDestReceiverStartup(DestReceiver *dest, int operation,
 	const char *delimiterCharacter = "\t";
 	const char *nullPrintCharacter = "\\N";
 
+	/* COPY always sends the data over connections, even to the local node */
+	ErrorIfLocalExecutionHappened();
+
 	/* look up table properties */
 	distributedRelation = heap_open(tableId, RowExclusiveLock);
+
+	/* copied rows might fall outside of the zone maps of the shards */
+	InvalidateShardZoneMaps(tableId);
+
 	cacheEntry = DistributedTableCacheEntry(tableId);
 	partitionMethod = cacheEntry->partitionMethod;
 
@@ -2709,7 +2718,9 @@ CitusCopyDestReceiverDestroy(DestReceiver *destReceiver)
 /*
  * IsCopyResultStmt determines whether the given copy statement is a
  * COPY "resultkey" FROM STDIN WITH (format result) statement, which is used
- * to copy query results from the coordinator into workers.
+ * to copy query results from the coordinator into workers, or a
+ * COPY "resultkey" TO STDOUT WITH (format result) statement, which is used
+ * to copy query results between workers.
  */
 bool
 IsCopyResultStmt(CopyStmt *copyStatement)
@@ -2756,13 +2767,21 @@ ProcessCopyStmt(CopyStmt *copyStatement, char *completionTag, const char *queryS
 {
 	/*
 	 * Handle special COPY "resultid" FROM STDIN WITH (format result) commands
-	 * for sending intermediate results to workers.
+	 * for sending intermediate results to workers, and COPY "resultid" TO
+	 * STDOUT WITH (format result) commands for fetching them from workers.
 	 */
 	if (IsCopyResultStmt(copyStatement))
 	{
 		const char *resultId = copyStatement->relation->relname;
 
-		ReceiveQueryResultViaCopy(resultId);
+		if (copyStatement->is_from)
+		{
+			ReceiveQueryResultViaCopy(resultId);
+		}
+		else
+		{
+			SendQueryResultViaCopy(resultId);
+		}
 
 		return NULL;
 	}
@@ -23,10 +23,13 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/hash_helpers.h"
 #include "distributed/placement_connection.h"
+#include "distributed/prepared_statement_cache.h"
 #include "distributed/run_from_same_connection.h"
 #include "distributed/remote_commands.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/version_compat.h"
 #include "mb/pg_wchar.h"
+#include "storage/ipc.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
 
@@ -47,6 +50,8 @@ static void DefaultCitusNoticeProcessor(void *arg, const char *message);
 static MultiConnection * FindAvailableConnection(dlist_head *connections, uint32 flags);
 static bool RemoteTransactionIdle(MultiConnection *connection);
 static int EventSetSizeForConnectionList(List *connections);
+static void FinishConnection(MultiConnection *connection);
+static void CitusCleanupConnectionsAtExit(int code, Datum arg);
 
 /* types for async connection management */
 enum MultiConnectionPhase
@@ -114,6 +119,57 @@ InitializeConnectionManagement(void)
 }
 
 
+/*
+ * RegisterConnectionCleanup registers a callback that closes the connections
+ * of the backend when it exits, such that they are no longer counted in the
+ * shared connection stats. Since callbacks registered in the postmaster are
+ * not inherited by backends, this has to be called in every backend.
+ */
+void
+RegisterConnectionCleanup(void)
+{
+	static bool registeredCleanup = false;
+
+	if (!registeredCleanup)
+	{
+		before_shmem_exit(CitusCleanupConnectionsAtExit, 0);
+
+		registeredCleanup = true;
+	}
+}
+
+
+/*
+ * CitusCleanupConnectionsAtExit closes all the connections of the backend
+ * that is exiting.
+ */
+static void
+CitusCleanupConnectionsAtExit(int code, Datum arg)
+{
+	HASH_SEQ_STATUS status;
+	ConnectionHashEntry *entry = NULL;
+
+	if (ConnectionHash == NULL)
+	{
+		return;
+	}
+
+	hash_seq_init(&status, ConnectionHash);
+	while ((entry = (ConnectionHashEntry *) hash_seq_search(&status)) != 0)
+	{
+		dlist_iter iter;
+
+		dlist_foreach(iter, entry->connections)
+		{
+			MultiConnection *connection =
+				dlist_container(MultiConnection, connectionNode, iter.cur);
+
+			FinishConnection(connection);
+		}
+	}
+}
+
+
 /*
  * InvalidateConnParamsHashEntries sets every hash entry's isValid flag to false.
  */
@@ -255,6 +311,8 @@ GetNodeUserDatabaseConnection(uint32 flags, const char *hostname, int32 port, co
  * If user or database are NULL, the current session's defaults are used. The
  * following flags influence connection establishment behaviour:
  * - FORCE_NEW_CONNECTION - a new connection is required
+ * - OPTIONAL_CONNECTION - NULL is returned instead of establishing a new
+ *   connection if citus.max_shared_pool_size is reached for the node
  *
  * The returned connection has only been initiated, not fully
  * established. That's useful to allow parallel connection establishment. If
@@ -268,6 +326,7 @@ StartNodeUserDatabaseConnection(uint32 flags, const char *hostname, int32 port,
 	ConnectionHashEntry *entry = NULL;
 	MultiConnection *connection;
 	bool found;
+	bool sharedCounterIncremented = false;
 
 	/* do some minimal input checks */
 	strlcpy(key.hostname, hostname, MAX_NODE_LENGTH);
@@ -328,9 +387,30 @@ StartNodeUserDatabaseConnection(uint32 flags, const char *hostname, int32 port,
 
 	/*
 	 * Either no caching desired, or no pre-established, non-claimed,
-	 * connection present. Initiate connection establishment.
+	 * connection present. Before initiating connection establishment, count
+	 * the connection in the shared connection stats. Connections that are
+	 * required to make progress are always allowed, even if that exceeds
+	 * citus.max_shared_pool_size.
 	 */
+	if (GetMaxSharedPoolSize() != DISABLE_CONNECTION_THROTTLING)
+	{
+		if (flags & OPTIONAL_CONNECTION)
+		{
+			if (!TryToIncrementSharedConnectionCounter(hostname, port))
+			{
+				return NULL;
+			}
+		}
+		else
+		{
+			IncrementSharedConnectionCounter(hostname, port);
+		}
+
+		sharedCounterIncremented = true;
+	}
+
 	connection = StartConnectionEstablishment(&key);
+	connection->sharedCounterIncremented = sharedCounterIncremented;
 
 	dlist_push_tail(entry->connections, &connection->connectionNode);
 
@@ -408,8 +488,7 @@ CloseConnection(MultiConnection *connection)
 	bool found;
 
 	/* close connection */
-	PQfinish(connection->pgConn);
-	connection->pgConn = NULL;
+	FinishConnection(connection);
 
 	strlcpy(key.hostname, connection->hostname, MAX_NODE_LENGTH);
 	key.port = connection->port;
@@ -458,8 +537,30 @@ ShutdownConnection(MultiConnection *connection)
 	{
 		SendCancelationRequest(connection);
 	}
-	PQfinish(connection->pgConn);
-	connection->pgConn = NULL;
+	FinishConnection(connection);
+}
+
+
+/*
+ * FinishConnection closes the underlying libpq connection, if any, and
+ * removes it from the shared connection stats.
+ */
+static void
+FinishConnection(MultiConnection *connection)
+{
+	if (connection->pgConn != NULL)
+	{
+		PQfinish(connection->pgConn);
+		connection->pgConn = NULL;
+	}
+
+	if (connection->sharedCounterIncremented)
+	{
+		DecrementSharedConnectionCounter(connection->hostname, connection->port);
+		connection->sharedCounterIncremented = false;
+	}
+
+	ForgetPreparedStatements(connection);
 }
 
 
@@ -828,8 +929,7 @@ CloseNotReadyMultiConnectionStates(List *connectionStates)
 		}
 
 		/* close connection, otherwise we take up resource on the other side */
-		PQfinish(connection->pgConn);
-		connection->pgConn = NULL;
+		FinishConnection(connection);
 	}
 }
 
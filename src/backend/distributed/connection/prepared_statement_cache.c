@@ -0,0 +1,405 @@
+/*-------------------------------------------------------------------------
+ *
+ * prepared_statement_cache.c
+ *   Tracking of the statements that are prepared on worker connections.
+ *
+ * Parameterized task queries of prepared statements on the coordinator are
+ * sent to the workers with the same query string on every execution, which
+ * the workers would parse, analyze and plan every time. When
+ * citus.max_prepared_statements_per_connection is set, the adaptive
+ * executor instead prepares such a query as a named statement on the
+ * worker connection the first time it is sent, and executes the named
+ * statement with the parameter values afterwards.
+ *
+ * The statements that are prepared on a connection are tracked in a hash
+ * table on the MultiConnection, keyed by the query string and parameter
+ * types, which goes away along with the connection. Each statement also
+ * records the distributed tables its query accesses. Invalidation of the
+ * metadata cache entry of a distributed table, which happens on DDL commands,
+ * invalidates the statements that access the table on all connections of the
+ * backend, since the result type of the prepared queries might have changed.
+ * The adaptive executor deallocates invalidated statements on the worker the
+ * next time a parameterized query is sent over the connection, by sending the
+ * DEALLOCATE commands ahead of the query without waiting for them.
+ *
+ * Since the statements live in the session of the worker connection, this
+ * cannot be used when the workers are behind a connection pooler in
+ * transaction pooling mode.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "distributed/connection_management.h"
+#include "distributed/hash_helpers.h"
+#include "distributed/prepared_statement_cache.h"
+#include "lib/stringinfo.h"
+#include "nodes/pg_list.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+
+/* hash key of a prepared statement, pointing to memory owned by the hash */
+typedef struct PreparedStatementHashKey
+{
+	const char *command;
+	int parameterCount;
+	const Oid *parameterTypes;
+} PreparedStatementHashKey;
+
+
+/* hash entry for a statement that is prepared on a connection */
+typedef struct PreparedStatementHashEntry
+{
+	PreparedStatementHashKey key;
+
+	char *statementName;
+
+	/* distributed tables accessed by the statement */
+	List *relationIdList;
+} PreparedStatementHashEntry;
+
+
+/*
+ * Config variable for the maximum number of statements that are prepared
+ * on a single worker connection, 0 disables preparing statements.
+ */
+int MaxPreparedStatementsPerConnection = 0;
+
+
+static void InvalidateConnectionPreparedStatements(MultiConnection *connection,
+												   Oid relationId);
+static HTAB * PreparedStatementHash(MultiConnection *connection);
+static uint32 PreparedStatementHashHash(const void *key, Size keysize);
+static int PreparedStatementHashCompare(const void *a, const void *b, Size keysize);
+
+
+/*
+ * LookupPreparedStatement returns the name of the statement that was prepared
+ * for the given command and parameter types on the given connection, or NULL
+ * if there is no such statement.
+ */
+char *
+LookupPreparedStatement(MultiConnection *connection, const char *command,
+						int parameterCount, const Oid *parameterTypes)
+{
+	HTAB *preparedStatementHash = PreparedStatementHash(connection);
+	PreparedStatementHashKey key;
+	PreparedStatementHashEntry *entry = NULL;
+	bool found = false;
+
+	key.command = command;
+	key.parameterCount = parameterCount;
+	key.parameterTypes = parameterTypes;
+
+	entry = hash_search(preparedStatementHash, &key, HASH_FIND, &found);
+	if (!found)
+	{
+		return NULL;
+	}
+
+	return entry->statementName;
+}
+
+
+/*
+ * CanPrepareStatement returns true if another statement can be prepared on
+ * the given connection without exceeding
+ * citus.max_prepared_statements_per_connection.
+ */
+bool
+CanPrepareStatement(MultiConnection *connection)
+{
+	HTAB *preparedStatementHash = NULL;
+
+	if (MaxPreparedStatementsPerConnection <= 0)
+	{
+		return false;
+	}
+
+	preparedStatementHash = PreparedStatementHash(connection);
+
+	return hash_get_num_entries(preparedStatementHash) <
+		   MaxPreparedStatementsPerConnection;
+}
+
+
+/*
+ * NewPreparedStatementName returns a statement name that has not been used
+ * on the given connection before.
+ */
+char *
+NewPreparedStatementName(MultiConnection *connection)
+{
+	connection->preparedStatementCount++;
+
+	return psprintf("citus_stmt_%u", connection->preparedStatementCount);
+}
+
+
+/*
+ * RememberPreparedStatement records that the worker successfully prepared
+ * the given command, which accesses the distributed tables in the given
+ * list, as a statement with the given name on the connection.
+ */
+void
+RememberPreparedStatement(MultiConnection *connection, const char *statementName,
+						  const char *command, int parameterCount,
+						  const Oid *parameterTypes, List *relationIdList)
+{
+	HTAB *preparedStatementHash = PreparedStatementHash(connection);
+	PreparedStatementHashKey key;
+	PreparedStatementHashEntry *entry = NULL;
+	MemoryContext hashContext = connection->preparedStatementContext;
+	MemoryContext oldContext = NULL;
+	bool found = false;
+
+	key.command = command;
+	key.parameterCount = parameterCount;
+	key.parameterTypes = parameterTypes;
+
+	entry = hash_search(preparedStatementHash, &key, HASH_ENTER, &found);
+	if (found)
+	{
+		/* keep using the statement we prepared before */
+		return;
+	}
+
+	/* the key should not point to memory of the caller */
+	entry->key.command = MemoryContextStrdup(hashContext, command);
+	entry->key.parameterTypes = NULL;
+
+	if (parameterCount > 0)
+	{
+		Oid *parameterTypesCopy = MemoryContextAlloc(hashContext,
+													 parameterCount * sizeof(Oid));
+
+		memcpy(parameterTypesCopy, parameterTypes, parameterCount * sizeof(Oid));
+		entry->key.parameterTypes = parameterTypesCopy;
+	}
+
+	entry->statementName = MemoryContextStrdup(hashContext, statementName);
+
+	oldContext = MemoryContextSwitchTo(hashContext);
+	entry->relationIdList = list_copy(relationIdList);
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * ForgetPreparedStatements forgets the statements that were prepared on the
+ * given connection, for instance when the connection is closed.
+ */
+void
+ForgetPreparedStatements(MultiConnection *connection)
+{
+	if (connection->preparedStatementContext != NULL)
+	{
+		MemoryContextDelete(connection->preparedStatementContext);
+		connection->preparedStatementContext = NULL;
+		connection->preparedStatementHash = NULL;
+		connection->invalidatedStatementNameList = NIL;
+	}
+}
+
+
+/*
+ * DeallocateInvalidatedStatementsCommand returns a command that deallocates
+ * the statements on the worker that were prepared on the given connection
+ * before they were invalidated, or NULL if there are no such statements. The
+ * statements are considered deallocated once the command is returned.
+ */
+char *
+DeallocateInvalidatedStatementsCommand(MultiConnection *connection)
+{
+	StringInfo deallocateCommand = NULL;
+	ListCell *statementNameCell = NULL;
+
+	if (connection->invalidatedStatementNameList == NIL)
+	{
+		return NULL;
+	}
+
+	deallocateCommand = makeStringInfo();
+
+	foreach(statementNameCell, connection->invalidatedStatementNameList)
+	{
+		char *statementName = (char *) lfirst(statementNameCell);
+
+		appendStringInfo(deallocateCommand, "DEALLOCATE %s;", statementName);
+		pfree(statementName);
+	}
+
+	list_free(connection->invalidatedStatementNameList);
+	connection->invalidatedStatementNameList = NIL;
+
+	return deallocateCommand->data;
+}
+
+
+/*
+ * InvalidateWorkerPreparedStatements makes sure that the statements that
+ * were prepared on the connections before and that access the given
+ * distributed table are no longer used, and deallocated later on. This is
+ * called when the schema of the table changes. If relationId is InvalidOid,
+ * all statements are invalidated.
+ */
+void
+InvalidateWorkerPreparedStatements(Oid relationId)
+{
+	HASH_SEQ_STATUS status;
+	ConnectionHashEntry *connectionEntry = NULL;
+
+	if (ConnectionHash == NULL)
+	{
+		return;
+	}
+
+	hash_seq_init(&status, ConnectionHash);
+	while ((connectionEntry = (ConnectionHashEntry *) hash_seq_search(&status)) != 0)
+	{
+		dlist_iter iter;
+
+		dlist_foreach(iter, connectionEntry->connections)
+		{
+			MultiConnection *connection =
+				dlist_container(MultiConnection, connectionNode, iter.cur);
+
+			InvalidateConnectionPreparedStatements(connection, relationId);
+		}
+	}
+}
+
+
+/*
+ * InvalidateConnectionPreparedStatements removes the statements that access
+ * the given distributed table, or all statements if relationId is
+ * InvalidOid, from the hash of the given connection and adds their names to
+ * the list of statements to deallocate.
+ */
+static void
+InvalidateConnectionPreparedStatements(MultiConnection *connection, Oid relationId)
+{
+	HTAB *preparedStatementHash = connection->preparedStatementHash;
+	HASH_SEQ_STATUS status;
+	PreparedStatementHashEntry *entry = NULL;
+	MemoryContext oldContext = NULL;
+
+	if (preparedStatementHash == NULL)
+	{
+		return;
+	}
+
+	oldContext = MemoryContextSwitchTo(connection->preparedStatementContext);
+
+	hash_seq_init(&status, preparedStatementHash);
+	while ((entry = (PreparedStatementHashEntry *) hash_seq_search(&status)) != 0)
+	{
+		char *command = (char *) entry->key.command;
+		Oid *parameterTypes = (Oid *) entry->key.parameterTypes;
+		List *relationIdList = entry->relationIdList;
+
+		if (relationId != InvalidOid && !list_member_oid(relationIdList, relationId))
+		{
+			continue;
+		}
+
+		connection->invalidatedStatementNameList =
+			lappend(connection->invalidatedStatementNameList, entry->statementName);
+
+		/* removing the current entry during a scan is allowed */
+		hash_search(preparedStatementHash, &entry->key, HASH_REMOVE, NULL);
+
+		pfree(command);
+		if (parameterTypes != NULL)
+		{
+			pfree(parameterTypes);
+		}
+		list_free(relationIdList);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * PreparedStatementHash returns the hash table of prepared statements of the
+ * given connection, and creates it if it does not exist.
+ */
+static HTAB *
+PreparedStatementHash(MultiConnection *connection)
+{
+	HASHCTL info;
+	int hashFlags = 0;
+
+	if (connection->preparedStatementHash != NULL)
+	{
+		return connection->preparedStatementHash;
+	}
+
+	connection->preparedStatementContext =
+		AllocSetContextCreateExtended(ConnectionContext,
+									  "Prepared Statement Context",
+									  ALLOCSET_SMALL_MINSIZE,
+									  ALLOCSET_SMALL_INITSIZE,
+									  ALLOCSET_DEFAULT_MAXSIZE);
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(PreparedStatementHashKey);
+	info.entrysize = sizeof(PreparedStatementHashEntry);
+	info.hash = PreparedStatementHashHash;
+	info.match = PreparedStatementHashCompare;
+	info.hcxt = connection->preparedStatementContext;
+	hashFlags = (HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT | HASH_COMPARE);
+
+	connection->preparedStatementHash =
+		hash_create("citus prepared statement hash", 32, &info, hashFlags);
+
+	return connection->preparedStatementHash;
+}
+
+
+static uint32
+PreparedStatementHashHash(const void *key, Size keysize)
+{
+	PreparedStatementHashKey *entry = (PreparedStatementHashKey *) key;
+	uint32 hash = 0;
+
+	hash = string_hash(entry->command, strlen(entry->command) + 1);
+	hash = hash_combine(hash, hash_uint32(entry->parameterCount));
+
+	if (entry->parameterCount > 0)
+	{
+		hash = hash_combine(hash, hash_any((unsigned char *) entry->parameterTypes,
+										   entry->parameterCount * sizeof(Oid)));
+	}
+
+	return hash;
+}
+
+
+static int
+PreparedStatementHashCompare(const void *a, const void *b, Size keysize)
+{
+	PreparedStatementHashKey *ca = (PreparedStatementHashKey *) a;
+	PreparedStatementHashKey *cb = (PreparedStatementHashKey *) b;
+
+	if (ca->parameterCount != cb->parameterCount ||
+		strcmp(ca->command, cb->command) != 0)
+	{
+		return 1;
+	}
+
+	if (ca->parameterCount > 0 &&
+		memcmp(ca->parameterTypes, cb->parameterTypes,
+			   ca->parameterCount * sizeof(Oid)) != 0)
+	{
+		return 1;
+	}
+
+	return 0;
+}
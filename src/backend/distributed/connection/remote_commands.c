@@ -450,12 +450,13 @@ ExecuteOptionalRemoteCommand(MultiConnection *connection, const char *command,
  * and accepts a MultiConnection instead of a plain PGconn. It makes sure it can
  * send commands asynchronously without blocking (at the potential expense of
  * an additional memory allocation). The command string can only include a single
- * command since PQsendQueryParams() supports only that.
+ * command since PQsendQueryParams() supports only that. If binaryResults is
+ * true, the results are requested in binary format.
  */
 int
 SendRemoteCommandParams(MultiConnection *connection, const char *command,
 						int parameterCount, const Oid *parameterTypes,
-						const char *const *parameterValues)
+						const char *const *parameterValues, bool binaryResults)
 {
 	PGconn *pgConn = connection->pgConn;
 	int rc = 0;
@@ -474,7 +475,76 @@ SendRemoteCommandParams(MultiConnection *connection, const char *command,
 	Assert(PQisnonblocking(pgConn));
 
 	rc = PQsendQueryParams(pgConn, command, parameterCount, parameterTypes,
-						   parameterValues, NULL, NULL, 0);
+						   parameterValues, NULL, NULL, binaryResults ? 1 : 0);
+
+	return rc;
+}
+
+
+/*
+ * SendRemotePrepare is a PQsendPrepare wrapper that logs remote commands, and
+ * accepts a MultiConnection instead of a plain PGconn. It asks the remote node
+ * to prepare the given command as a statement with the given name, which can
+ * then be executed with SendRemotePreparedCommand.
+ */
+int
+SendRemotePrepare(MultiConnection *connection, const char *statementName,
+				  const char *command, int parameterCount, const Oid *parameterTypes)
+{
+	PGconn *pgConn = connection->pgConn;
+	int rc = 0;
+
+	LogRemoteCommand(connection, command);
+
+	/*
+	 * Don't try to send command if connection is entirely gone
+	 * (PQisnonblocking() would crash).
+	 */
+	if (!pgConn || PQstatus(pgConn) != CONNECTION_OK)
+	{
+		return 0;
+	}
+
+	Assert(PQisnonblocking(pgConn));
+
+	rc = PQsendPrepare(pgConn, statementName, command, parameterCount, parameterTypes);
+
+	return rc;
+}
+
+
+/*
+ * SendRemotePreparedCommand is a PQsendQueryPrepared wrapper that logs remote
+ * commands, and accepts a MultiConnection instead of a plain PGconn. It executes
+ * a statement that was prepared by SendRemotePrepare with the given parameter
+ * values. If binaryResults is true, the results are requested in binary format.
+ */
+int
+SendRemotePreparedCommand(MultiConnection *connection, const char *statementName,
+						  int parameterCount, const char *const *parameterValues,
+						  bool binaryResults)
+{
+	PGconn *pgConn = connection->pgConn;
+	int rc = 0;
+
+	if (LogRemoteCommands)
+	{
+		LogRemoteCommand(connection, psprintf("EXECUTE %s", statementName));
+	}
+
+	/*
+	 * Don't try to send command if connection is entirely gone
+	 * (PQisnonblocking() would crash).
+	 */
+	if (!pgConn || PQstatus(pgConn) != CONNECTION_OK)
+	{
+		return 0;
+	}
+
+	Assert(PQisnonblocking(pgConn));
+
+	rc = PQsendQueryPrepared(pgConn, statementName, parameterCount, parameterValues,
+							 NULL, NULL, binaryResults ? 1 : 0);
 
 	return rc;
 }
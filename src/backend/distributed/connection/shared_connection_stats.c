@@ -0,0 +1,454 @@
+/*-------------------------------------------------------------------------
+ *
+ * shared_connection_stats.c
+ *   Keeps track of the number of connections that all backends of this
+ *   node have open to each of the other nodes.
+ *
+ * The adaptive executor opens up to citus.max_adaptive_executor_pool_size
+ * connections per worker for every multi-shard query, so many concurrent
+ * backends can together exhaust max_connections on the workers. To prevent
+ * that, every connection that is established to a node is counted in shared
+ * memory, and backends only open connections beyond the first one to a node
+ * as long as the total stays within citus.max_shared_pool_size.
+ *
+ * Along with the connection counters, we keep decayed averages of the task
+ * durations and connection establishment times that executions observed on
+ * each node, which the adaptive executor uses to decide whether opening
+ * additional connections to a node pays off.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+
+#include "access/hash.h"
+#include "distributed/hash_helpers.h"
+#include "distributed/shared_connection_stats.h"
+#include "distributed/worker_manager.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+
+/* weight of the statistics of the latest execution in the decayed averages */
+#define NODE_LATENCY_STATS_DECAY 0.25
+
+/* latency statistics that were not updated within this time are discarded */
+#define NODE_LATENCY_STATS_EXPIRATION_MS 60000
+
+
+/*
+ * Shared memory data for the connection counters of all nodes.
+ */
+typedef struct ConnectionStatsSharedData
+{
+	/*
+	 * Lock protecting the entries in SharedConnStatsHash. It is taken in
+	 * exclusive mode to update the entries, and in shared mode to only read
+	 * the latency statistics.
+	 */
+	int trancheId;
+	char *lockTrancheName;
+	LWLock lock;
+} ConnectionStatsSharedData;
+
+
+/* hash key of the connection counters */
+typedef struct SharedConnStatsHashKey
+{
+	char hostname[MAX_NODE_LENGTH];
+	int32 port;
+} SharedConnStatsHashKey;
+
+
+/* hash entry holding the connection counter of a node */
+typedef struct SharedConnStatsHashEntry
+{
+	SharedConnStatsHashKey key;
+
+	int connectionCount;
+
+	/* decayed averages in milliseconds, 0 if not known */
+	double taskDurationMs;
+	double connectionEstablishmentMs;
+
+	/* time of the last update of the averages */
+	TimestampTz latencyStatsUpdateTime;
+} SharedConnStatsHashEntry;
+
+
+/*
+ * Config variable for the maximum number of connections that all backends
+ * together open to a single node. 0 means max_connections of this node, -1
+ * disables the limit. It can only be set at server start, since backends
+ * that disagree about the limit, or about whether connections are counted at
+ * all, would leave the shared counters meaningless.
+ */
+int MaxSharedPoolSize = 0;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ConnectionStatsSharedData *ConnectionStatsSharedState = NULL;
+
+/* hash table of connection counters, one entry for each (host, port) */
+static HTAB *SharedConnStatsHash = NULL;
+
+static size_t SharedConnectionStatsShmemSize(void);
+static void SharedConnectionStatsShmemInit(void);
+static uint32 SharedConnectionHashHash(const void *key, Size keysize);
+static int SharedConnectionHashCompare(const void *a, const void *b, Size keysize);
+static double DecayedAverage(double average, double sample);
+static SharedConnStatsHashEntry * SharedConnStatsHashEntryForNode(const
+																  char *hostname,
+																  int port,
+																  HASHACTION action);
+
+
+/*
+ * InitializeSharedConnectionStats, called at server start, requests the shared
+ * memory for the connection counters.
+ */
+void
+InitializeSharedConnectionStats(void)
+{
+	if (!IsUnderPostmaster)
+	{
+		RequestAddinShmemSpace(SharedConnectionStatsShmemSize());
+	}
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = SharedConnectionStatsShmemInit;
+}
+
+
+/*
+ * GetMaxSharedPoolSize returns the maximum number of connections that all
+ * backends together may open to a single node, or -1 if there is no limit.
+ */
+int
+GetMaxSharedPoolSize(void)
+{
+	if (MaxSharedPoolSize == 0)
+	{
+		return MaxConnections;
+	}
+
+	return MaxSharedPoolSize;
+}
+
+
+/*
+ * TryToIncrementSharedConnectionCounter increments the connection counter of
+ * the given node and returns true if that does not exceed the limit set by
+ * citus.max_shared_pool_size. Otherwise, it returns false and the caller
+ * should not open a new connection to the node.
+ */
+bool
+TryToIncrementSharedConnectionCounter(const char *hostname, int port)
+{
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+	bool counterIncremented = true;
+	int maxSharedPoolSize = GetMaxSharedPoolSize();
+
+	if (maxSharedPoolSize == DISABLE_CONNECTION_THROTTLING)
+	{
+		return true;
+	}
+
+	LWLockAcquire(&ConnectionStatsSharedState->lock, LW_EXCLUSIVE);
+
+	connectionEntry = SharedConnStatsHashEntryForNode(hostname, port, HASH_ENTER_NULL);
+
+	/* if there is no space left to track the node, do not limit connections */
+	if (connectionEntry != NULL)
+	{
+		if (connectionEntry->connectionCount + 1 > maxSharedPoolSize)
+		{
+			counterIncremented = false;
+		}
+		else
+		{
+			connectionEntry->connectionCount++;
+		}
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->lock);
+
+	return counterIncremented;
+}
+
+
+/*
+ * IncrementSharedConnectionCounter increments the connection counter of the
+ * given node regardless of the limit. This is used for connections that are
+ * required to make progress, such as the first connection to a node.
+ */
+void
+IncrementSharedConnectionCounter(const char *hostname, int port)
+{
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+
+	LWLockAcquire(&ConnectionStatsSharedState->lock, LW_EXCLUSIVE);
+
+	connectionEntry = SharedConnStatsHashEntryForNode(hostname, port, HASH_ENTER_NULL);
+	if (connectionEntry != NULL)
+	{
+		connectionEntry->connectionCount++;
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->lock);
+}
+
+
+/*
+ * DecrementSharedConnectionCounter decrements the connection counter of the
+ * given node once a connection to it is closed.
+ */
+void
+DecrementSharedConnectionCounter(const char *hostname, int port)
+{
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+
+	LWLockAcquire(&ConnectionStatsSharedState->lock, LW_EXCLUSIVE);
+
+	connectionEntry = SharedConnStatsHashEntryForNode(hostname, port, HASH_FIND);
+	if (connectionEntry != NULL && connectionEntry->connectionCount > 0)
+	{
+		connectionEntry->connectionCount--;
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->lock);
+}
+
+
+/*
+ * UpdateNodeLatencyStats adds the average task duration and connection
+ * establishment time that an execution observed on the given node to the
+ * decayed averages of the node. Fields of the given statistics that are 0
+ * are ignored.
+ */
+void
+UpdateNodeLatencyStats(const char *hostname, int port, NodeLatencyStats *latencyStats)
+{
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+	TimestampTz now = GetCurrentTimestamp();
+
+	LWLockAcquire(&ConnectionStatsSharedState->lock, LW_EXCLUSIVE);
+
+	connectionEntry = SharedConnStatsHashEntryForNode(hostname, port, HASH_ENTER_NULL);
+	if (connectionEntry != NULL)
+	{
+		if (TimestampDifferenceExceeds(connectionEntry->latencyStatsUpdateTime, now,
+									   NODE_LATENCY_STATS_EXPIRATION_MS))
+		{
+			/* the averages are outdated, start over */
+			connectionEntry->taskDurationMs = 0;
+			connectionEntry->connectionEstablishmentMs = 0;
+		}
+
+		if (latencyStats->taskDurationMs > 0)
+		{
+			connectionEntry->taskDurationMs =
+				DecayedAverage(connectionEntry->taskDurationMs,
+							   latencyStats->taskDurationMs);
+		}
+
+		if (latencyStats->connectionEstablishmentMs > 0)
+		{
+			connectionEntry->connectionEstablishmentMs =
+				DecayedAverage(connectionEntry->connectionEstablishmentMs,
+							   latencyStats->connectionEstablishmentMs);
+		}
+
+		connectionEntry->latencyStatsUpdateTime = now;
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->lock);
+}
+
+
+/*
+ * GetNodeLatencyStats copies the decayed averages of the task duration and
+ * connection establishment time of the given node into latencyStats. It
+ * returns false if there are no recent statistics for the node.
+ */
+bool
+GetNodeLatencyStats(const char *hostname, int port, NodeLatencyStats *latencyStats)
+{
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+	TimestampTz now = GetCurrentTimestamp();
+	bool statsFound = false;
+
+	memset(latencyStats, 0, sizeof(NodeLatencyStats));
+
+	LWLockAcquire(&ConnectionStatsSharedState->lock, LW_SHARED);
+
+	connectionEntry = SharedConnStatsHashEntryForNode(hostname, port, HASH_FIND);
+	if (connectionEntry != NULL &&
+		!TimestampDifferenceExceeds(connectionEntry->latencyStatsUpdateTime, now,
+									NODE_LATENCY_STATS_EXPIRATION_MS))
+	{
+		latencyStats->taskDurationMs = connectionEntry->taskDurationMs;
+		latencyStats->connectionEstablishmentMs =
+			connectionEntry->connectionEstablishmentMs;
+		statsFound = true;
+	}
+
+	LWLockRelease(&ConnectionStatsSharedState->lock);
+
+	return statsFound;
+}
+
+
+/*
+ * DecayedAverage adds a sample to an exponentially decayed average, or returns
+ * the sample if there is no average yet.
+ */
+static double
+DecayedAverage(double average, double sample)
+{
+	if (average <= 0)
+	{
+		return sample;
+	}
+
+	return (1.0 - NODE_LATENCY_STATS_DECAY) * average + NODE_LATENCY_STATS_DECAY * sample;
+}
+
+
+/*
+ * SharedConnStatsHashEntryForNode looks up the connection counter of the given
+ * node with the given action. The caller should hold the lock.
+ */
+static SharedConnStatsHashEntry *
+SharedConnStatsHashEntryForNode(const char *hostname, int port, HASHACTION action)
+{
+	SharedConnStatsHashKey key;
+	SharedConnStatsHashEntry *connectionEntry = NULL;
+	bool entryFound = false;
+
+	memset(&key, 0, sizeof(key));
+	strlcpy(key.hostname, hostname, MAX_NODE_LENGTH);
+	key.port = port;
+
+	connectionEntry = hash_search(SharedConnStatsHash, &key, action, &entryFound);
+	if (connectionEntry != NULL && !entryFound)
+	{
+		connectionEntry->connectionCount = 0;
+		connectionEntry->taskDurationMs = 0;
+		connectionEntry->connectionEstablishmentMs = 0;
+		connectionEntry->latencyStatsUpdateTime = 0;
+	}
+
+	return connectionEntry;
+}
+
+
+/*
+ * SharedConnectionStatsShmemSize returns the size of the shared memory that
+ * is needed for the connection counters.
+ */
+static size_t
+SharedConnectionStatsShmemSize(void)
+{
+	Size size = 0;
+	Size hashSize = 0;
+
+	size = add_size(size, sizeof(ConnectionStatsSharedData));
+
+	/* we do not connect to more nodes than we track */
+	hashSize = hash_estimate_size(MaxWorkerNodesTracked,
+								  sizeof(SharedConnStatsHashEntry));
+	size = add_size(size, hashSize);
+
+	return size;
+}
+
+
+/*
+ * SharedConnectionStatsShmemInit initializes the shared memory for the
+ * connection counters.
+ */
+static void
+SharedConnectionStatsShmemInit(void)
+{
+	bool alreadyInitialized = false;
+	HASHCTL hashInfo;
+	int hashFlags = 0;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	ConnectionStatsSharedState =
+		(ConnectionStatsSharedData *) ShmemInitStruct("Shared Connection Stats Data",
+													  sizeof(ConnectionStatsSharedData),
+													  &alreadyInitialized);
+
+	/*
+	 * Might already be initialized on EXEC_BACKEND type platforms that call
+	 * shared library initialization functions in every backend.
+	 */
+	if (!alreadyInitialized)
+	{
+		ConnectionStatsSharedState->trancheId = LWLockNewTrancheId();
+		ConnectionStatsSharedState->lockTrancheName = "Shared Connection Tracking";
+		LWLockRegisterTranche(ConnectionStatsSharedState->trancheId,
+							  ConnectionStatsSharedState->lockTrancheName);
+
+		LWLockInitialize(&ConnectionStatsSharedState->lock,
+						 ConnectionStatsSharedState->trancheId);
+	}
+
+	memset(&hashInfo, 0, sizeof(hashInfo));
+	hashInfo.keysize = sizeof(SharedConnStatsHashKey);
+	hashInfo.entrysize = sizeof(SharedConnStatsHashEntry);
+	hashInfo.hash = SharedConnectionHashHash;
+	hashInfo.match = SharedConnectionHashCompare;
+	hashFlags = (HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+
+	SharedConnStatsHash = ShmemInitHash("Shared Connection Stats Hash",
+										MaxWorkerNodesTracked, MaxWorkerNodesTracked,
+										&hashInfo, hashFlags);
+
+	LWLockRelease(AddinShmemInitLock);
+
+	if (prev_shmem_startup_hook != NULL)
+	{
+		prev_shmem_startup_hook();
+	}
+}
+
+
+static uint32
+SharedConnectionHashHash(const void *key, Size keysize)
+{
+	SharedConnStatsHashKey *entry = (SharedConnStatsHashKey *) key;
+	uint32 hash = 0;
+
+	hash = string_hash(entry->hostname, MAX_NODE_LENGTH);
+	hash = hash_combine(hash, hash_uint32(entry->port));
+
+	return hash;
+}
+
+
+static int
+SharedConnectionHashCompare(const void *a, const void *b, Size keysize)
+{
+	SharedConnStatsHashKey *ca = (SharedConnStatsHashKey *) a;
+	SharedConnStatsHashKey *cb = (SharedConnStatsHashKey *) b;
+
+	if (strncmp(ca->hostname, cb->hostname, MAX_NODE_LENGTH) != 0 ||
+		ca->port != cb->port)
+	{
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
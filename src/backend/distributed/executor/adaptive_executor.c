@@ -53,6 +53,13 @@
  * from pendingTaskQueue to readyTaskQueue. The same approach is used to
  * fail over read-only tasks to another placement.
  *
+ * Read-only tasks outside of transaction blocks may also be "hedged": when
+ * a task has not responded within citus.hedged_execution_threshold (or the
+ * 95th percentile of the durations of the tasks that already finished,
+ * whichever is higher), the next placement is moved to the readyTaskQueue
+ * while the first one keeps running. The placement execution that responds
+ * first provides the results and the other one is cancelled.
+ *
  * Once all the tasks are added to a queue, the main loop in
  * RunDistributedExecution repeatedly does the following:
  *
@@ -82,7 +89,11 @@
  *
  * When a connection is ready to execute a new task, it first checks its
  * own readyTaskQueue and otherwise takes a task from the worker pool's
- * readyTaskQueue (on a first-come-first-serve basis).
+ * readyTaskQueue (on a first-come-first-serve basis). When
+ * citus.enable_size_aware_scheduling is enabled, the tasks of read-only
+ * queries are added to the queues in order of decreasing shard size, such
+ * that a large shard does not start last, and tasks that can run on any
+ * of several placements start on the worker with the least work.
  *
  * In cases where the tasks finish quickly (e.g. <1ms), a single
  * connection will often be sufficient to finish all tasks. It is
@@ -112,6 +123,11 @@
  * writes to a reference table that has foreign keys from a distributed
  * table.
  *
+ * Tasks with a placement on the node executing the query may be executed
+ * locally instead of over a connection to the node itself, see
+ * local_executor.c for details. In that case only the remaining tasks are
+ * executed via the distributed execution described above.
+ *
  * Execution finishes when all tasks are done, the query errors out, or
  * the user cancels the query.
  *
@@ -127,10 +143,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "access/htup_details.h"
+#include "access/transam.h"
 #include "access/xact.h"
 #include "commands/dbcommands.h"
 #include "distributed/citus_custom_scan.h"
+#include "distributed/commands/multi_copy.h"
 #include "distributed/connection_management.h"
+#include "distributed/local_executor.h"
+#include "distributed/master_metadata_utility.h"
+#include "distributed/metadata_cache.h"
 #include "distributed/multi_client_executor.h"
 #include "distributed/multi_executor.h"
 #include "distributed/multi_physical_planner.h"
@@ -138,20 +160,60 @@
 #include "distributed/multi_router_executor.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/placement_connection.h"
+#include "distributed/prepared_statement_cache.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
 #include "distributed/resource_lock.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/transaction_management.h"
 #include "distributed/worker_protocol.h"
 #include "distributed/version_compat.h"
+#include "executor/executor.h"
 #include "lib/ilist.h"
 #include "storage/fd.h"
 #include "storage/latch.h"
 #include "utils/int8.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/timestamp.h"
 
+/*
+ * BinaryResultReceiver contains the receive functions and buffers for building
+ * tuples out of rows that were received in binary format.
+ */
+typedef struct BinaryResultReceiver
+{
+	TupleDesc tupleDescriptor;
+	FmgrInfo *receiveFunctionArray;
+	Oid *typeIoParamArray;
+	Datum *columnValues;
+	bool *columnNulls;
+} BinaryResultReceiver;
+
+
+/*
+ * TaskResultDestination describes where the rows of a list of tasks are
+ * stored when the tasks of several distributed plans are executed in a
+ * single distributed execution, see ExecuteTaskListsIntoTupleStores.
+ */
+typedef struct TaskResultDestination
+{
+	List *taskList;
+
+	TupleDesc tupleDescriptor;
+	Tuplestorestate *tupleStore;
+	AttInMetadata *attributeInputMetadata;
+	char **columnArray;
+
+	/* set when the execution requests binary results */
+	BinaryResultReceiver *binaryResultReceiver;
+
+	/* statistics used to enforce the intermediate result size limit */
+	DistributedExecutionStats *executionStats;
+} TaskResultDestination;
+
+
 /*
  * DistributedExecution represents the execution of a distributed query
  * plan.
@@ -173,6 +235,36 @@ typedef struct DistributedExecution
 	TupleDesc tupleDescriptor;
 	Tuplestorestate *tupleStore;
 
+	/*
+	 * Destinations of the rows of tasks that do not go into tupleStore, when
+	 * the execution runs the tasks of several distributed plans.
+	 */
+	List *taskResultDestinationList;
+
+	/*
+	 * Input function metadata and column buffer for building tuples out of
+	 * the received rows, shared by all calls to ReceiveResults. Only set
+	 * when tupleDescriptor is not NULL.
+	 */
+	AttInMetadata *attributeInputMetadata;
+	char **columnArray;
+
+	/* memory context that is reset after building each tuple */
+	MemoryContext ioContext;
+
+	/*
+	 * Whether the results are requested from the workers in binary format,
+	 * and the receive functions and buffers for building tuples out of them.
+	 */
+	bool binaryResults;
+	BinaryResultReceiver *binaryResultReceiver;
+
+	/*
+	 * Read pointer of the tuple store that the custom scan reads from when
+	 * the results are streamed.
+	 */
+	int streamingReadPointer;
+
 
 	/* list of workers involved in the execution */
 	List *workerList;
@@ -252,6 +344,37 @@ typedef struct DistributedExecution
 	 */
 	uint64 rowsProcessed;
 
+	/*
+	 * The number of rows after which the remaining tasks are no longer needed
+	 * to answer the query, or -1 if all tasks need to be executed. This is set
+	 * for queries that only apply a LIMIT to the rows from the workers.
+	 */
+	int64 rowLimit;
+
+	/*
+	 * Whether slow tasks may be executed on another placement in parallel,
+	 * see HedgeSlowPlacementExecutions. In that case, we keep track of the
+	 * durations of the tasks that finished so far to derive the threshold
+	 * after which a task is considered slow.
+	 */
+	bool enableHedging;
+	long *taskDurations;
+	int taskDurationCount;
+
+	/* threshold in milliseconds, computed for hedgingThresholdTaskCount durations */
+	long hedgingThreshold;
+	int hedgingThresholdTaskCount;
+
+	/* time at which the next running task exceeds the threshold, or 0 */
+	TimestampTz nextHedgeTime;
+
+	/* number of cancelled placement executions whose command is still running */
+	int cancelledPlacementExecutionCount;
+
+	/* number of commands and tasks sent when pipelining, for logging */
+	int pipelinedCommandCount;
+	int pipelinedTaskCount;
+
 	/* statistics on distributed execution */
 	DistributedExecutionStats *executionStats;
 } DistributedExecution;
@@ -338,9 +461,32 @@ typedef struct WorkerPool
 	/* last time we opened a connection */
 	TimestampTz lastConnectionOpenTime;
 
+	/*
+	 * Last time an additional connection could not be opened because the
+	 * shared pool of connections to the worker was exhausted, or 0.
+	 */
+	TimestampTz sharedPoolExhaustedTime;
+
 	/* maximum number of connections we are allowed to open at once */
 	uint32 maxNewConnectionsPerCycle;
 
+	/*
+	 * Estimated size of the tasks that are scheduled to run on this worker
+	 * first, used to balance tasks across workers by size.
+	 */
+	uint64 scheduledTaskSize;
+
+	/*
+	 * Average task duration and connection establishment time on the node
+	 * observed by earlier executions, and the totals observed by this
+	 * execution. Used by citus.enable_latency_aware_pool_sizing.
+	 */
+	NodeLatencyStats nodeLatencyStats;
+	double totalTaskDurationMs;
+	int finishedTaskCount;
+	double totalConnectionEstablishmentMs;
+	int establishedConnectionCount;
+
 	/*
 	 * This is only set in WorkerPoolFailed() function. Once a pool fails, we do not
 	 * use it anymore.
@@ -382,6 +528,12 @@ typedef struct WorkerSession
 	/* task the worker should work on or NULL */
 	struct TaskPlacementExecution *currentTask;
 
+	/*
+	 * Tasks that were sent along with currentTask in a single command, whose
+	 * results follow the results of currentTask in order.
+	 */
+	List *pipelinedTaskList;
+
 	/*
 	 * The number of commands sent to the worker over the session. Excludes
 	 * distributed transaction related commands such as BEGIN/COMMIT etc.
@@ -393,6 +545,33 @@ typedef struct WorkerSession
 
 	/* events reported by the latest call to WaitEventSetWait */
 	int latestUnconsumedWaitEvents;
+
+	/* time at which a new connection started connecting, 0 for cached connections */
+	TimestampTz connectionStartTime;
+
+	/*
+	 * Whether invalidated prepared statements are being deallocated before
+	 * the parameterized query of currentTask is sent.
+	 */
+	bool deallocatingStatements;
+
+	/*
+	 * Name of the statement that is being prepared for currentTask, or NULL.
+	 * Once the worker prepared it, the statement is executed.
+	 */
+	char *preparingStatementName;
+
+	/* parameters of the query of currentTask */
+	int taskParameterCount;
+	Oid *taskParameterTypes;
+	const char **taskParameterValues;
+
+	/*
+	 * Whether a cancellation request was sent for currentTask. The connection
+	 * is closed once the command returns, since the asynchronous request could
+	 * otherwise interrupt the next command sent over the connection.
+	 */
+	bool cancelRequested;
 } WorkerSession;
 
 
@@ -442,12 +621,21 @@ typedef struct ShardCommandExecution
 	/* whether we expect results to come back */
 	bool expectResults;
 
+	/* where to store the results, or NULL to use the tuple store of the execution */
+	TaskResultDestination *resultDestination;
+
 	/*
 	 * RETURNING results from other shard placements can be ignored
 	 * after we got results from the first placements.
 	 */
 	bool gotResults;
 
+	/* whether the task was started on another placement because it was slow */
+	bool hedged;
+
+	/* the placement execution that responded first, if any */
+	struct TaskPlacementExecution *firstRespondingPlacementExecution;
+
 	TaskExecutionState executionState;
 } ShardCommandExecution;
 
@@ -499,6 +687,21 @@ typedef struct TaskPlacementExecution
 
 	/* index in array of placement executions in a ShardCommandExecution */
 	int placementExecutionIndex;
+
+	/* time at which the command was sent to the worker */
+	TimestampTz startTime;
+
+	/*
+	 * Set when another placement execution of the same task responded first,
+	 * in which case the command is cancelled and its results are ignored.
+	 */
+	bool cancelled;
+
+	/*
+	 * Set when the worker returned the complete result of the command, which
+	 * may happen even if the command was cancelled in the meantime.
+	 */
+	bool completed;
 } TaskPlacementExecution;
 
 
@@ -509,6 +712,49 @@ int MaxAdaptiveExecutorPoolSize = 16;
 /* GUC, number of ms to wait between opening connections to the same worker */
 int ExecutorSlowStartInterval = 10;
 
+/* GUC, determining whether task results are requested in binary format */
+bool EnableBinaryProtocol = false;
+
+/* controlled via GUC, used mostly for testing */
+bool LogTaskExecution = false;
+
+/* GUC, determining whether results are returned while the execution continues */
+bool EnableStreamingExecution = false;
+
+/*
+ * GUC, number of ms after which a read-only task is also started on another
+ * placement, or -1 to disable
+ */
+int HedgedExecutionThreshold = -1;
+
+/* GUC, determining whether large tasks are started before small tasks */
+bool EnableSizeAwareScheduling = false;
+
+/* GUC, maximum number of read-only tasks sent in one command over a connection */
+int MaxPipelinedTasksPerConnection = 1;
+
+/* GUC, determining whether pools grow based on observed task and connection latency */
+bool EnableLatencyAwarePoolSizing = false;
+
+/*
+ * Number of ms to wait before trying to open additional connections to a
+ * worker again after citus.max_shared_pool_size was reached.
+ */
+static const long SharedPoolRetryIntervalMs = 100;
+
+
+/*
+ * TaskSizeEstimate is used to sort tasks by their estimated size.
+ */
+typedef struct TaskSizeEstimate
+{
+	Task *task;
+	uint64 taskSize;
+
+	/* position in the original task list, to keep the order of equal sizes */
+	int taskIndex;
+} TaskSizeEstimate;
+
 
 /* local functions */
 static DistributedExecution * CreateDistributedExecution(RowModifyLevel modLevel,
@@ -524,18 +770,31 @@ static bool ShouldRunTasksSequentially(List *taskList);
 static void SequentialRunDistributedExecution(DistributedExecution *execution);
 
 static void FinishDistributedExecution(DistributedExecution *execution);
+static void RecordNodeLatencyStats(DistributedExecution *execution);
 static void CleanUpSessions(DistributedExecution *execution);
 
 static void LockPartitionsForDistributedPlan(DistributedPlan *distributedPlan);
 static void AcquireExecutorShardLocksForExecution(DistributedExecution *execution);
 static bool DistributedExecutionModifiesDatabase(DistributedExecution *execution);
 static bool DistributedPlanModifiesDatabase(DistributedPlan *plan);
+static bool ModifiesReferenceTable(DistributedPlan *plan);
 static bool TaskListModifiesDatabase(RowModifyLevel modLevel, List *taskList);
 static bool DistributedExecutionRequiresRollback(DistributedExecution *execution);
 static bool SelectForUpdateOnReferenceTable(RowModifyLevel modLevel, List *taskList);
 static void AssignTasksToConnections(DistributedExecution *execution);
+static TaskResultDestination * TaskResultDestinationForTask(DistributedExecution *
+															execution, Task *task);
 static void UnclaimAllSessionConnections(List *sessionList);
 static bool UseConnectionPerPlacement(void);
+static bool ShouldUseSizeAwareScheduling(DistributedExecution *execution);
+static List * SortTaskListBySize(List *taskList, uint64 **taskSizeArray);
+static void LogSortedTaskList(List *taskList);
+static int CompareTaskSizeEstimates(const void *leftElement, const void *rightElement);
+static uint64 EstimatedTaskSize(Task *task);
+static uint64 EstimatedShardSize(uint64 shardId);
+static List * TaskPlacementListByScheduledSize(DistributedExecution *execution,
+											   List *taskPlacementList,
+											   uint64 taskSize);
 static PlacementExecutionOrder ExecutionOrderForTask(RowModifyLevel modLevel, Task *task);
 static WorkerPool * FindOrCreateWorkerPool(DistributedExecution *execution,
 										   char *nodeName, int nodePort);
@@ -544,13 +803,26 @@ static WorkerSession * FindOrCreateWorkerSession(WorkerPool *workerPool,
 static void ManageWorkerPool(WorkerPool *workerPool);
 static void CheckConnectionTimeout(WorkerPool *workerPool);
 static int UsableConnectionCount(WorkerPool *workerPool);
+static bool PoolLatencyStats(WorkerPool *workerPool, NodeLatencyStats *latencyStats);
+static int ProfitableNewConnectionCount(WorkerPool *workerPool,
+										NodeLatencyStats *latencyStats);
 static long NextEventTimeout(DistributedExecution *execution);
 static long MillisecondsBetweenTimestamps(TimestampTz startTime, TimestampTz endTime);
+static double FractionalMillisecondsBetweenTimestamps(TimestampTz startTime,
+													  TimestampTz endTime);
 static WaitEventSet * BuildWaitEventSet(List *sessionList);
 static void UpdateWaitEventSetFlags(WaitEventSet *waitEventSet, List *sessionList);
 static TaskPlacementExecution * PopPlacementExecution(WorkerSession *session);
 static TaskPlacementExecution * PopAssignedPlacementExecution(WorkerSession *session);
 static TaskPlacementExecution * PopUnassignedPlacementExecution(WorkerPool *workerPool);
+static int SendParameterizedTaskQuery(WorkerSession *session, char *queryString);
+static bool FinishDeallocatingStatements(WorkerSession *session);
+static bool FinishPreparingStatement(WorkerSession *session);
+static bool ConsumeDeferredCommandResults(WorkerSession *session);
+static List * TaskRelationIdList(Task *task);
+static bool ShouldPipelinePlacementExecutions(DistributedExecution *execution);
+static List * PopPipelinedPlacementExecutions(WorkerSession *session);
+static char * PipelinedQueryString(char *queryString, List *placementExecutionList);
 static bool StartPlacementExecutionOnSession(TaskPlacementExecution *placementExecution,
 											 WorkerSession *session);
 static List * PlacementAccessListForTask(Task *task, ShardPlacement *taskPlacement);
@@ -561,6 +833,32 @@ static void TransactionStateMachine(WorkerSession *session);
 static void UpdateConnectionWaitFlags(WorkerSession *session, int waitFlags);
 static bool CheckConnectionReady(WorkerSession *session);
 static bool ReceiveResults(WorkerSession *session, bool storeRows);
+static void ContinueDistributedExecution(DistributedExecution *execution,
+										 bool returnOnNewRows);
+static bool ShouldStreamDistributedExecution(CitusScanState *scanState,
+											 DistributedExecution *execution);
+static void StartStreamingExecution(CitusScanState *scanState,
+									DistributedExecution *execution);
+static bool RowLimitReached(DistributedExecution *execution);
+static void CancelSessions(DistributedExecution *execution);
+static void CloseCancelledSessions(DistributedExecution *execution);
+static void HedgeSlowPlacementExecutions(DistributedExecution *execution);
+static long HedgingThreshold(DistributedExecution *execution);
+static int CompareTaskDurations(const void *leftElement, const void *rightElement);
+static bool CanHedgePlacementExecution(TaskPlacementExecution *placementExecution);
+static TaskPlacementExecution * NextPlacementExecutionForHedging(
+	TaskPlacementExecution *placementExecution);
+static void CancelRedundantPlacementExecutions(
+	TaskPlacementExecution *respondingPlacementExecution);
+static bool PlacementExecutionInProgress(ShardCommandExecution *shardCommandExecution,
+										 TaskPlacementExecution *placementExecution);
+static void RecordTaskDuration(TaskPlacementExecution *placementExecution);
+static bool CanUseBinaryResults(TupleDesc tupleDescriptor);
+static BinaryResultReceiver * CreateBinaryResultReceiver(TupleDesc tupleDescriptor);
+static void ErrorIfUnexpectedBinaryResult(BinaryResultReceiver *binaryResultReceiver,
+										  PGresult *result);
+static HeapTuple BuildTupleFromBinaryResult(BinaryResultReceiver *binaryResultReceiver,
+											PGresult *result, int rowIndex);
 static void WorkerSessionFailed(WorkerSession *session);
 static void WorkerPoolFailed(WorkerPool *workerPool);
 static void PlacementExecutionDone(TaskPlacementExecution *placementExecution,
@@ -596,6 +894,8 @@ AdaptiveExecutor(CustomScanState *node)
 
 	Job *job = distributedPlan->workerJob;
 	List *taskList = job->taskList;
+	List *localTaskList = NIL;
+	List *remoteTaskList = NIL;
 
 	/* we should only call this once before the scan finished */
 	Assert(!scanState->finishedRemoteScan);
@@ -609,6 +909,30 @@ AdaptiveExecutor(CustomScanState *node)
 
 	ExecuteSubPlans(distributedPlan);
 
+	/*
+	 * The tasks of subplans may have been executed together with the tasks of
+	 * other subplans that do not depend on them, see ExecuteSubPlans.
+	 */
+	scanState->tuplestorestate = TakePrefetchedSubPlanResult(distributedPlan);
+	if (scanState->tuplestorestate != NULL)
+	{
+		return resultSlot;
+	}
+
+	if (ShouldExecuteTasksLocally(taskList))
+	{
+		bool readOnlyPlan = !TaskListModifiesDatabase(distributedPlan->modLevel,
+													  taskList);
+
+		ExtractLocalAndRemoteTasks(readOnlyPlan, taskList, &localTaskList,
+								   &remoteTaskList);
+	}
+	else
+	{
+		/* all tasks should be executed via remote connections */
+		remoteTaskList = taskList;
+	}
+
 	scanState->tuplestorestate =
 		tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
 	tupleStore = scanState->tuplestorestate;
@@ -623,12 +947,69 @@ AdaptiveExecutor(CustomScanState *node)
 										   paramListInfo, tupleDescriptor,
 										   tupleStore, targetPoolSize);
 
+	/*
+	 * Make sure that we acquire the appropriate locks and set up the
+	 * coordinated transaction for all tasks, including the ones that are
+	 * going to be executed locally.
+	 */
 	StartDistributedExecution(execution);
 
+	/*
+	 * Outside of coordinated transactions, we can cancel the tasks that are
+	 * no longer needed once we have enough rows for the LIMIT of the query.
+	 */
+	if (distributedPlan->modLevel == ROW_MODIFY_READONLY && !execution->isTransaction)
+	{
+		execution->rowLimit = MasterQueryRowLimit(distributedPlan->masterQuery);
+	}
+
+	if (localTaskList != NIL)
+	{
+		uint64 localRowsProcessed = ExecuteLocalTaskList(scanState, localTaskList,
+														 execution->rowLimit);
+
+		if (distributedPlan->modLevel != ROW_MODIFY_READONLY)
+		{
+			executorState->es_processed = localRowsProcessed;
+		}
+		else
+		{
+			/* rows returned by local tasks count towards the LIMIT */
+			execution->rowsProcessed = localRowsProcessed;
+		}
+
+		if (ModifiesReferenceTable(distributedPlan))
+		{
+			/*
+			 * The remote placements of a reference table return the same rows
+			 * as the local placement, which are already in the tuple store.
+			 */
+			execution->hasReturning = false;
+		}
+
+		/* only the remaining tasks are executed over connections */
+		if (RowLimitReached(execution))
+		{
+			remoteTaskList = NIL;
+		}
+
+		execution->tasksToExecute = remoteTaskList;
+		execution->totalTaskCount = list_length(remoteTaskList);
+		execution->unfinishedTaskCount = list_length(remoteTaskList);
+	}
+
 	if (ShouldRunTasksSequentially(execution->tasksToExecute))
 	{
 		SequentialRunDistributedExecution(execution);
 	}
+	else if (localTaskList == NIL &&
+			 ShouldStreamDistributedExecution(scanState, execution))
+	{
+		/* the execution continues as the custom scan returns tuples */
+		StartStreamingExecution(scanState, execution);
+
+		return resultSlot;
+	}
 	else
 	{
 		RunDistributedExecution(execution);
@@ -636,7 +1017,18 @@ AdaptiveExecutor(CustomScanState *node)
 
 	if (distributedPlan->modLevel != ROW_MODIFY_READONLY)
 	{
-		executorState->es_processed = execution->rowsProcessed;
+		if (localTaskList == NIL)
+		{
+			executorState->es_processed = execution->rowsProcessed;
+		}
+		else if (!ModifiesReferenceTable(distributedPlan))
+		{
+			/*
+			 * For reference tables the remote tasks modify the same rows on other
+			 * placements, which we already counted during the local execution.
+			 */
+			executorState->es_processed += execution->rowsProcessed;
+		}
 	}
 
 	FinishDistributedExecution(execution);
@@ -705,6 +1097,12 @@ ExecuteTaskListExtended(RowModifyLevel modLevel, List *taskList,
 	DistributedExecution *execution = NULL;
 	ParamListInfo paramListInfo = NULL;
 
+	/*
+	 * The code-paths that rely on this function do not know how to execute
+	 * commands locally.
+	 */
+	ErrorIfLocalExecutionHappened();
+
 	if (MultiShardConnectionType == SEQUENTIAL_CONNECTION)
 	{
 		targetPoolSize = 1;
@@ -722,6 +1120,94 @@ ExecuteTaskListExtended(RowModifyLevel modLevel, List *taskList,
 }
 
 
+/*
+ * ExecuteTaskListsIntoTupleStores executes the given read-only task lists in
+ * a single distributed execution, such that the tasks of all lists run
+ * concurrently, and stores the rows of the tasks of each list in the tuple
+ * store at the same position in tupleStoreList. The tuple descriptors in
+ * tupleDescriptorList describe the rows of each task list.
+ *
+ * Since the format of the results is chosen for the whole execution, the
+ * results are only requested in binary format if the rows of all task lists
+ * can be transferred that way.
+ */
+void
+ExecuteTaskListsIntoTupleStores(List *taskListList, List *tupleDescriptorList,
+								List *tupleStoreList)
+{
+	DistributedExecution *execution = NULL;
+	List *taskList = NIL;
+	List *taskResultDestinationList = NIL;
+	ListCell *taskListCell = NULL;
+	ListCell *tupleDescriptorCell = NULL;
+	ListCell *tupleStoreCell = NULL;
+	ParamListInfo paramListInfo = NULL;
+	bool hasReturning = false;
+	bool binaryResults = EnableBinaryProtocol;
+	int targetPoolSize = MaxAdaptiveExecutorPoolSize;
+
+	ErrorIfLocalExecutionHappened();
+
+	if (MultiShardConnectionType == SEQUENTIAL_CONNECTION)
+	{
+		targetPoolSize = 1;
+	}
+
+	forthree(taskListCell, taskListList, tupleDescriptorCell, tupleDescriptorList,
+			 tupleStoreCell, tupleStoreList)
+	{
+		List *destinationTaskList = (List *) lfirst(taskListCell);
+		TupleDesc tupleDescriptor = (TupleDesc) lfirst(tupleDescriptorCell);
+		TaskResultDestination *resultDestination =
+			(TaskResultDestination *) palloc0(sizeof(TaskResultDestination));
+
+		resultDestination->taskList = destinationTaskList;
+		resultDestination->tupleDescriptor = tupleDescriptor;
+		resultDestination->tupleStore = (Tuplestorestate *) lfirst(tupleStoreCell);
+		resultDestination->attributeInputMetadata =
+			TupleDescGetAttInMetadata(tupleDescriptor);
+		resultDestination->columnArray =
+			(char **) palloc0(tupleDescriptor->natts * sizeof(char *));
+		resultDestination->executionStats =
+			(DistributedExecutionStats *) palloc0(sizeof(DistributedExecutionStats));
+
+		taskResultDestinationList = lappend(taskResultDestinationList,
+											resultDestination);
+		taskList = list_concat(taskList, list_copy(destinationTaskList));
+
+		if (!CanUseBinaryResults(tupleDescriptor))
+		{
+			binaryResults = false;
+		}
+	}
+
+	/* the rows are stored via the result destinations of the tasks */
+	execution = CreateDistributedExecution(ROW_MODIFY_READONLY, taskList, hasReturning,
+										   paramListInfo, NULL, NULL, targetPoolSize);
+	execution->taskResultDestinationList = taskResultDestinationList;
+
+	if (binaryResults)
+	{
+		ListCell *resultDestinationCell = NULL;
+
+		foreach(resultDestinationCell, taskResultDestinationList)
+		{
+			TaskResultDestination *resultDestination =
+				(TaskResultDestination *) lfirst(resultDestinationCell);
+
+			resultDestination->binaryResultReceiver =
+				CreateBinaryResultReceiver(resultDestination->tupleDescriptor);
+		}
+
+		execution->binaryResults = true;
+	}
+
+	StartDistributedExecution(execution);
+	RunDistributedExecution(execution);
+	FinishDistributedExecution(execution);
+}
+
+
 /*
  * CreateDistributedExecution creates a distributed execution data structure for
  * a distributed plan.
@@ -744,6 +1230,32 @@ CreateDistributedExecution(RowModifyLevel modLevel, List *taskList, bool hasRetu
 	execution->tupleDescriptor = tupleDescriptor;
 	execution->tupleStore = tupleStore;
 
+	if (tupleDescriptor != NULL)
+	{
+		/* look up the input functions once rather than on every ReceiveResults */
+		execution->attributeInputMetadata = TupleDescGetAttInMetadata(tupleDescriptor);
+		execution->columnArray =
+			(char **) palloc0(tupleDescriptor->natts * sizeof(char *));
+	}
+
+	execution->ioContext = AllocSetContextCreate(CurrentMemoryContext,
+												 "ReceiveResults",
+												 ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
+
+	/*
+	 * Binary results can only be requested for single statement tasks, so we
+	 * only consider them for queries and modifications with RETURNING.
+	 */
+	if (EnableBinaryProtocol && tupleDescriptor != NULL &&
+		(modLevel == ROW_MODIFY_READONLY || hasReturning) &&
+		CanUseBinaryResults(tupleDescriptor))
+	{
+		execution->binaryResults = true;
+		execution->binaryResultReceiver = CreateBinaryResultReceiver(tupleDescriptor);
+	}
+
 	execution->workerList = NIL;
 	execution->sessionList = NIL;
 	execution->targetPoolSize = targetPoolSize;
@@ -751,6 +1263,7 @@ CreateDistributedExecution(RowModifyLevel modLevel, List *taskList, bool hasRetu
 	execution->totalTaskCount = list_length(taskList);
 	execution->unfinishedTaskCount = list_length(taskList);
 	execution->rowsProcessed = 0;
+	execution->rowLimit = -1;
 
 	execution->raiseInterrupts = true;
 
@@ -813,6 +1326,20 @@ StartDistributedExecution(DistributedExecution *execution)
 
 	execution->isTransaction = InCoordinatedTransaction();
 
+	/*
+	 * Slow read-only tasks can be started on another placement, as long as we
+	 * are not in a transaction block, since cancelling the redundant execution
+	 * would abort the remote transaction.
+	 */
+	if (HedgedExecutionThreshold >= 0 && execution->modLevel == ROW_MODIFY_READONLY &&
+		!execution->isTransaction)
+	{
+		execution->enableHedging = true;
+		execution->taskDurations =
+			(long *) palloc0(execution->totalTaskCount * sizeof(long));
+		execution->hedgingThreshold = HedgedExecutionThreshold;
+	}
+
 	/*
 	 * We should not record parallel access if the target pool size is less than 2.
 	 * The reason is that we define parallel access as at least two connections
@@ -855,6 +1382,24 @@ DistributedPlanModifiesDatabase(DistributedPlan *plan)
 }
 
 
+/*
+ * ModifiesReferenceTable returns true if the plan modifies a reference table,
+ * in which case every task is executed on all placements of the shard.
+ */
+static bool
+ModifiesReferenceTable(DistributedPlan *plan)
+{
+	Oid targetRelationId = plan->targetRelationId;
+
+	if (plan->modLevel <= ROW_MODIFY_READONLY || targetRelationId == InvalidOid)
+	{
+		return false;
+	}
+
+	return PartitionMethod(targetRelationId) == DISTRIBUTE_BY_NONE;
+}
+
+
 /*
  *  TaskListModifiesDatabase is a helper function for DistributedExecutionModifiesDatabase and
  *  DistributedPlanModifiesDatabase.
@@ -1103,6 +1648,70 @@ FinishDistributedExecution(DistributedExecution *execution)
 		/* prevent copying shards in same transaction */
 		XactModificationLevel = XACT_MODIFICATION_DATA;
 	}
+
+	if (EnableLatencyAwarePoolSizing)
+	{
+		RecordNodeLatencyStats(execution);
+	}
+
+	if (LogTaskExecution && execution->binaryResults)
+	{
+		ereport(DEBUG1, (errmsg("received " UINT64_FORMAT " rows in binary format",
+								execution->rowsProcessed)));
+	}
+
+	if (LogTaskExecution && execution->pipelinedCommandCount > 0)
+	{
+		ereport(DEBUG1, (errmsg("sent %d tasks in %d pipelined commands",
+								execution->pipelinedTaskCount,
+								execution->pipelinedCommandCount)));
+	}
+
+	/* the context for building tuples is created for every execution */
+	if (execution->ioContext != NULL)
+	{
+		MemoryContextDelete(execution->ioContext);
+		execution->ioContext = NULL;
+	}
+}
+
+
+/*
+ * RecordNodeLatencyStats adds the average task duration and connection
+ * establishment time observed on each node by the execution to the
+ * statistics of the node in shared memory.
+ */
+static void
+RecordNodeLatencyStats(DistributedExecution *execution)
+{
+	ListCell *workerCell = NULL;
+
+	foreach(workerCell, execution->workerList)
+	{
+		WorkerPool *workerPool = (WorkerPool *) lfirst(workerCell);
+		NodeLatencyStats latencyStats;
+
+		memset(&latencyStats, 0, sizeof(latencyStats));
+
+		if (workerPool->finishedTaskCount > 0)
+		{
+			latencyStats.taskDurationMs =
+				workerPool->totalTaskDurationMs / workerPool->finishedTaskCount;
+		}
+
+		if (workerPool->establishedConnectionCount > 0)
+		{
+			latencyStats.connectionEstablishmentMs =
+				workerPool->totalConnectionEstablishmentMs /
+				workerPool->establishedConnectionCount;
+		}
+
+		if (latencyStats.taskDurationMs > 0 || latencyStats.connectionEstablishmentMs > 0)
+		{
+			UpdateNodeLatencyStats(workerPool->nodeName, workerPool->nodePort,
+								   &latencyStats);
+		}
+	}
 }
 
 
@@ -1216,6 +1825,10 @@ UnclaimAllSessionConnections(List *sessionList)
  * task placements need to be assigned to particular connections because of preceding
  * operations in the transaction. It then adds those connections to the pool and adds
  * the task placement executions to the assigned task queue of the connection.
+ *
+ * With size-aware scheduling, the tasks are added to the queues in order of
+ * decreasing estimated size, and the placement on the worker with the least
+ * scheduled work is tried first.
  */
 static void
 AssignTasksToConnections(DistributedExecution *execution)
@@ -1223,18 +1836,41 @@ AssignTasksToConnections(DistributedExecution *execution)
 	RowModifyLevel modLevel = execution->modLevel;
 	List *taskList = execution->tasksToExecute;
 	bool hasReturning = execution->hasReturning;
+	bool sizeAwareScheduling = ShouldUseSizeAwareScheduling(execution);
+	uint64 *taskSizeArray = NULL;
+	int taskIndex = 0;
 
 	ListCell *taskCell = NULL;
 	ListCell *sessionCell = NULL;
 
+	if (sizeAwareScheduling)
+	{
+		taskList = SortTaskListBySize(taskList, &taskSizeArray);
+
+		if (LogTaskExecution)
+		{
+			LogSortedTaskList(taskList);
+		}
+	}
+
 	foreach(taskCell, taskList)
 	{
 		Task *task = (Task *) lfirst(taskCell);
 		ShardCommandExecution *shardCommandExecution = NULL;
+		List *taskPlacementList = task->taskPlacementList;
 		ListCell *taskPlacementCell = NULL;
 		bool placementExecutionReady = true;
 		int placementExecutionIndex = 0;
-		int placementExecutionCount = list_length(task->taskPlacementList);
+		int placementExecutionCount = list_length(taskPlacementList);
+
+		if (sizeAwareScheduling)
+		{
+			taskPlacementList = TaskPlacementListByScheduledSize(execution,
+																 taskPlacementList,
+																 taskSizeArray[taskIndex]);
+		}
+
+		taskIndex++;
 
 		/*
 		 * Execution of a command on a shard, which may have multiple replicas.
@@ -1251,9 +1887,11 @@ AssignTasksToConnections(DistributedExecution *execution)
 
 		shardCommandExecution->expectResults = hasReturning ||
 											   modLevel == ROW_MODIFY_READONLY;
+		shardCommandExecution->resultDestination =
+			TaskResultDestinationForTask(execution, task);
 
 
-		foreach(taskPlacementCell, task->taskPlacementList)
+		foreach(taskPlacementCell, taskPlacementList)
 		{
 			ShardPlacement *taskPlacement = (ShardPlacement *) lfirst(taskPlacementCell);
 			List *placementAccessList = NULL;
@@ -1387,11 +2025,269 @@ AssignTasksToConnections(DistributedExecution *execution)
 
 
 /*
- * UseConnectionPerPlacement returns whether we should use a separate connection
- * per placement even if another connection is idle. We mostly use this in testing
- * scenarios.
+ * TaskResultDestinationForTask returns the destination of the rows of the
+ * given task, or NULL if the rows go into the tuple store of the execution.
  */
-static bool
+static TaskResultDestination *
+TaskResultDestinationForTask(DistributedExecution *execution, Task *task)
+{
+	ListCell *resultDestinationCell = NULL;
+
+	foreach(resultDestinationCell, execution->taskResultDestinationList)
+	{
+		TaskResultDestination *resultDestination =
+			(TaskResultDestination *) lfirst(resultDestinationCell);
+
+		if (list_member_ptr(resultDestination->taskList, task))
+		{
+			return resultDestination;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * ShouldUseSizeAwareScheduling returns true if the tasks of the given
+ * execution should be scheduled by their estimated size. We only do this for
+ * read-only executions with multiple tasks, since modifications rely on the
+ * order of the task list to acquire locks in a consistent order, and only
+ * outside of coordinated transactions, where the placements that were
+ * already accessed in the transaction determine where tasks run.
+ */
+static bool
+ShouldUseSizeAwareScheduling(DistributedExecution *execution)
+{
+	if (!EnableSizeAwareScheduling)
+	{
+		return false;
+	}
+
+	if (execution->modLevel != ROW_MODIFY_READONLY || execution->isTransaction)
+	{
+		return false;
+	}
+
+	return list_length(execution->tasksToExecute) > 1;
+}
+
+
+/*
+ * SortTaskListBySize returns a new list with the tasks of the given list in
+ * order of decreasing estimated size. Tasks of the same size keep their
+ * relative order. The estimated sizes of the tasks in the returned list are
+ * returned via taskSizeArray.
+ */
+static List *
+SortTaskListBySize(List *taskList, uint64 **taskSizeArray)
+{
+	int taskCount = list_length(taskList);
+	TaskSizeEstimate *taskSizeEstimates =
+		(TaskSizeEstimate *) palloc0(taskCount * sizeof(TaskSizeEstimate));
+	List *sortedTaskList = NIL;
+	ListCell *taskCell = NULL;
+	int taskIndex = 0;
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+
+		taskSizeEstimates[taskIndex].task = task;
+		taskSizeEstimates[taskIndex].taskSize = EstimatedTaskSize(task);
+		taskSizeEstimates[taskIndex].taskIndex = taskIndex;
+
+		taskIndex++;
+	}
+
+	qsort(taskSizeEstimates, taskCount, sizeof(TaskSizeEstimate),
+		  CompareTaskSizeEstimates);
+
+	*taskSizeArray = (uint64 *) palloc0(taskCount * sizeof(uint64));
+
+	for (taskIndex = 0; taskIndex < taskCount; taskIndex++)
+	{
+		sortedTaskList = lappend(sortedTaskList, taskSizeEstimates[taskIndex].task);
+		(*taskSizeArray)[taskIndex] = taskSizeEstimates[taskIndex].taskSize;
+	}
+
+	pfree(taskSizeEstimates);
+
+	return sortedTaskList;
+}
+
+
+/*
+ * LogSortedTaskList logs the shards of the tasks in the order in which they
+ * are started by size-aware scheduling.
+ */
+static void
+LogSortedTaskList(List *taskList)
+{
+	StringInfo shardIdString = makeStringInfo();
+	ListCell *taskCell = NULL;
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+
+		if (shardIdString->len > 0)
+		{
+			appendStringInfoString(shardIdString, ", ");
+		}
+
+		appendStringInfo(shardIdString, UINT64_FORMAT, task->anchorShardId);
+	}
+
+	ereport(DEBUG1, (errmsg("starting the tasks on shards %s in order of "
+							"estimated size", shardIdString->data)));
+}
+
+
+/*
+ * CompareTaskSizeEstimates is a comparison function for sorting tasks by
+ * decreasing size, and by their original position for equal sizes.
+ */
+static int
+CompareTaskSizeEstimates(const void *leftElement, const void *rightElement)
+{
+	const TaskSizeEstimate *leftEstimate = (const TaskSizeEstimate *) leftElement;
+	const TaskSizeEstimate *rightEstimate = (const TaskSizeEstimate *) rightElement;
+
+	if (leftEstimate->taskSize > rightEstimate->taskSize)
+	{
+		return -1;
+	}
+	else if (leftEstimate->taskSize < rightEstimate->taskSize)
+	{
+		return 1;
+	}
+
+	return leftEstimate->taskIndex - rightEstimate->taskIndex;
+}
+
+
+/*
+ * EstimatedTaskSize returns the total size of the shards that the given task
+ * accesses, according to the shard statistics in pg_dist_placement. The
+ * statistics are kept up to date for append-distributed tables and can be
+ * refreshed for any shard using master_update_shard_statistics. Shards
+ * without statistics count as empty.
+ */
+static uint64
+EstimatedTaskSize(Task *task)
+{
+	uint64 taskSize = 0;
+	ListCell *relationShardCell = NULL;
+
+	if (task->relationShardList == NIL)
+	{
+		return EstimatedShardSize(task->anchorShardId);
+	}
+
+	foreach(relationShardCell, task->relationShardList)
+	{
+		RelationShard *relationShard = (RelationShard *) lfirst(relationShardCell);
+
+		taskSize += EstimatedShardSize(relationShard->shardId);
+	}
+
+	return taskSize;
+}
+
+
+/*
+ * EstimatedShardSize returns the largest shard length of the placements of
+ * the given shard, or 0 if there is no such shard.
+ */
+static uint64
+EstimatedShardSize(uint64 shardId)
+{
+	uint64 shardSize = 0;
+	List *shardPlacementList = NIL;
+	ListCell *shardPlacementCell = NULL;
+
+	if (shardId == INVALID_SHARD_ID)
+	{
+		return 0;
+	}
+
+	shardPlacementList = ShardPlacementList(shardId);
+
+	foreach(shardPlacementCell, shardPlacementList)
+	{
+		ShardPlacement *shardPlacement = (ShardPlacement *) lfirst(shardPlacementCell);
+
+		shardSize = Max(shardSize, shardPlacement->shardLength);
+	}
+
+	return shardSize;
+}
+
+
+/*
+ * TaskPlacementListByScheduledSize returns the given task placement list with
+ * the placement on the worker that has the smallest size of scheduled tasks
+ * first, and adds the given task size to that worker. For tasks that run on
+ * any of the placements, that is where the task is tried first, such that
+ * workers get a similar amount of work rather than a similar number of tasks.
+ *
+ * Placements on workers with the same scheduled size keep the order that was
+ * chosen by the planner.
+ */
+static List *
+TaskPlacementListByScheduledSize(DistributedExecution *execution,
+								 List *taskPlacementList, uint64 taskSize)
+{
+	ShardPlacement *selectedPlacement = NULL;
+	WorkerPool *selectedWorkerPool = NULL;
+	ListCell *taskPlacementCell = NULL;
+
+	if (taskPlacementList == NIL)
+	{
+		return taskPlacementList;
+	}
+
+	foreach(taskPlacementCell, taskPlacementList)
+	{
+		ShardPlacement *taskPlacement = (ShardPlacement *) lfirst(taskPlacementCell);
+		WorkerPool *workerPool = FindOrCreateWorkerPool(execution,
+														taskPlacement->nodeName,
+														taskPlacement->nodePort);
+
+		if (selectedWorkerPool == NULL ||
+			workerPool->scheduledTaskSize < selectedWorkerPool->scheduledTaskSize)
+		{
+			selectedPlacement = taskPlacement;
+			selectedWorkerPool = workerPool;
+		}
+
+		if (TaskAssignmentPolicy != TASK_ASSIGNMENT_GREEDY)
+		{
+			/* respect the placement order of other task assignment policies */
+			break;
+		}
+	}
+
+	selectedWorkerPool->scheduledTaskSize += taskSize;
+
+	if (selectedPlacement == linitial(taskPlacementList))
+	{
+		return taskPlacementList;
+	}
+
+	taskPlacementList = list_delete_ptr(list_copy(taskPlacementList), selectedPlacement);
+
+	return lcons(selectedPlacement, taskPlacementList);
+}
+
+
+/*
+ * UseConnectionPerPlacement returns whether we should use a separate connection
+ * per placement even if another connection is idle. We mostly use this in testing
+ * scenarios.
+ */
+static bool
 UseConnectionPerPlacement(void)
 {
 	return ForceMaxQueryParallelization &&
@@ -1482,6 +2378,20 @@ FindOrCreateWorkerPool(DistributedExecution *execution, char *nodeName, int node
 	nodeConnectionCount = MaxCachedConnectionsPerWorker;
 	workerPool->maxNewConnectionsPerCycle = Max(1, nodeConnectionCount);
 
+	if (EnableLatencyAwarePoolSizing &&
+		GetNodeLatencyStats(nodeName, nodePort, &workerPool->nodeLatencyStats) &&
+		LogTaskExecution)
+	{
+		NodeLatencyStats *latencyStats = &workerPool->nodeLatencyStats;
+
+		if (latencyStats->taskDurationMs > 0 &&
+			latencyStats->connectionEstablishmentMs > 0)
+		{
+			ereport(DEBUG1, (errmsg("using the latency observed on %s:%d to size "
+									"the connection pool", nodeName, nodePort)));
+		}
+	}
+
 	dlist_init(&workerPool->pendingTaskQueue);
 	dlist_init(&workerPool->readyTaskQueue);
 
@@ -1633,10 +2543,24 @@ SequentialRunDistributedExecution(DistributedExecution *execution)
 void
 RunDistributedExecution(DistributedExecution *execution)
 {
-	WaitEvent *events = NULL;
-
 	AssignTasksToConnections(execution);
 
+	ContinueDistributedExecution(execution, false);
+}
+
+
+/*
+ * ContinueDistributedExecution runs the event loop of an execution whose tasks
+ * have been assigned to connections until all tasks are finished. If
+ * returnOnNewRows is true, it instead returns as soon as new rows have been
+ * added to the tuple store, and can be called again to continue from there.
+ */
+static void
+ContinueDistributedExecution(DistributedExecution *execution, bool returnOnNewRows)
+{
+	WaitEvent *events = NULL;
+	uint64 rowsProcessedBefore = execution->rowsProcessed;
+
 	PG_TRY();
 	{
 		bool cancellationReceived = false;
@@ -1652,7 +2576,26 @@ RunDistributedExecution(DistributedExecution *execution)
 			int eventCount = 0;
 			int eventIndex = 0;
 			ListCell *workerCell = NULL;
-			long timeout = NextEventTimeout(execution);
+			long timeout = 0;
+
+			if (returnOnNewRows && execution->rowsProcessed > rowsProcessedBefore)
+			{
+				/* let the caller consume the new rows first */
+				break;
+			}
+
+			if (RowLimitReached(execution))
+			{
+				/* we have enough rows, the remaining tasks are cancelled below */
+				break;
+			}
+
+			if (execution->enableHedging)
+			{
+				HedgeSlowPlacementExecutions(execution);
+			}
+
+			timeout = NextEventTimeout(execution);
 
 			foreach(workerCell, execution->workerList)
 			{
@@ -1738,6 +2681,8 @@ RunDistributedExecution(DistributedExecution *execution)
 
 				ConnectionStateMachine(session);
 			}
+
+			CloseCancelledSessions(execution);
 		}
 
 		if (events != NULL)
@@ -1751,7 +2696,25 @@ RunDistributedExecution(DistributedExecution *execution)
 			execution->waitEventSet = NULL;
 		}
 
-		CleanUpSessions(execution);
+		if (execution->unfinishedTaskCount > 0 && RowLimitReached(execution))
+		{
+			CancelSessions(execution);
+
+			/* none of the remaining tasks needs to be executed anymore */
+			execution->unfinishedTaskCount = 0;
+		}
+		else if (!returnOnNewRows || execution->unfinishedTaskCount == 0)
+		{
+			if (execution->cancelledPlacementExecutionCount > 0)
+			{
+				/* close the connections that are still running cancelled commands */
+				CancelSessions(execution);
+			}
+			else
+			{
+				CleanUpSessions(execution);
+			}
+		}
 	}
 	PG_CATCH();
 	{
@@ -1774,516 +2737,1536 @@ RunDistributedExecution(DistributedExecution *execution)
 
 
 /*
- * ManageWorkerPool ensures the worker pool has the appropriate number of connections
- * based on the number of pending tasks.
+ * ShouldStreamDistributedExecution returns true if the results of the given
+ * execution can be returned to the custom scan while the execution is still
+ * in progress. This is only done for read-only queries that are not part of a
+ * coordinated transaction, such that we can cancel the execution at any point
+ * if the remaining results are not needed, and for scans that only move
+ * forward, since results are discarded once they have been read.
  */
-static void
-ManageWorkerPool(WorkerPool *workerPool)
+static bool
+ShouldStreamDistributedExecution(CitusScanState *scanState,
+								 DistributedExecution *execution)
 {
-	DistributedExecution *execution = workerPool->distributedExecution;
-	int targetPoolSize = execution->targetPoolSize;
-	int initiatedConnectionCount = list_length(workerPool->sessionList);
-	int activeConnectionCount PG_USED_FOR_ASSERTS_ONLY =
-		workerPool->activeConnectionCount;
-	int idleConnectionCount PG_USED_FOR_ASSERTS_ONLY =
-		workerPool->idleConnectionCount;
-	int failedConnectionCount = workerPool->failedConnectionCount;
-	int readyTaskCount = workerPool->readyTaskCount;
-	int newConnectionCount = 0;
-	int connectionIndex = 0;
-
-	/* we should always have more (or equal) active connections than idle connections */
-	Assert(activeConnectionCount >= idleConnectionCount);
-
-	/* we should always have more (or equal) initiated connections than active connections */
-	Assert(initiatedConnectionCount >= activeConnectionCount);
-
-	/* we should never have less than 0 connections ever */
-	Assert(activeConnectionCount >= 0 && idleConnectionCount >= 0);
+	EState *executorState = ScanStateGetExecutorState(scanState);
 
-	if (workerPool->failed)
+	if (!EnableStreamingExecution)
 	{
-		/* connection pool failed */
-		return;
+		return false;
 	}
 
-	/* we might fail the execution or warn the user about connection timeouts */
-	if (workerPool->checkForPoolTimeout)
+	if (execution->modLevel != ROW_MODIFY_READONLY || execution->isTransaction)
 	{
-		CheckConnectionTimeout(workerPool);
+		return false;
 	}
 
-	if (failedConnectionCount >= 1)
+	if (executorState->es_top_eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_REWIND))
 	{
-		/* do not attempt to open more connections after one failed */
-		return;
+		return false;
 	}
 
-	if (UseConnectionPerPlacement())
-	{
-		int unusedConnectionCount = workerPool->unusedConnectionCount;
+	return true;
+}
 
-		/*
-		 * If force_max_query_parallelization is enabled then we ignore pool size
-		 * and idle connections. Instead, we open new connections as long as there
-		 * are more tasks than unused connections.
-		 */
 
-		newConnectionCount = Max(readyTaskCount - unusedConnectionCount, 0);
-	}
-	else
-	{
-		/* cannot open more than targetPoolSize connections */
-		int maxNewConnectionCount = targetPoolSize - initiatedConnectionCount;
+/*
+ * StartStreamingExecution assigns the tasks of the execution to connections
+ * and hands the execution over to the custom scan, which continues it via
+ * ReturnTupleFromStreamingExecution.
+ *
+ * The custom scan reads from its own read pointer, since the active read
+ * pointer of a tuple store does not see tuples that are added after it
+ * reached the end. The active read pointer is moved to the end once, such
+ * that it does not prevent the tuple store from discarding tuples that have
+ * already been read.
+ */
+static void
+StartStreamingExecution(CitusScanState *scanState, DistributedExecution *execution)
+{
+	Tuplestorestate *tupleStore = execution->tupleStore;
 
-		/* total number of connections that are (almost) available for tasks */
-		int usableConnectionCount = UsableConnectionCount(workerPool);
+	tuplestore_set_eflags(tupleStore, 0);
+	execution->streamingReadPointer = tuplestore_alloc_read_pointer(tupleStore, 0);
+	tuplestore_advance(tupleStore, true);
 
-		/*
-		 * Number of additional connections we would need to run all ready tasks in
-		 * parallel.
-		 */
-		int newConnectionsForReadyTasks = readyTaskCount - usableConnectionCount;
+	AssignTasksToConnections(execution);
 
-		/*
-		 * Open enough connections to handle all tasks that are ready, but no more
-		 * than the target pool size.
-		 */
-		newConnectionCount = Min(newConnectionsForReadyTasks, maxNewConnectionCount);
+	scanState->streamingExecution = execution;
+}
 
-		if (newConnectionCount > 0 && ExecutorSlowStartInterval > 0)
+
+/*
+ * ReturnTupleFromStreamingExecution returns the next tuple of a streaming
+ * execution, continuing the execution until new rows are received if no
+ * unread rows are left. Once all tasks are finished and all rows are read,
+ * the execution is finished and an empty slot is returned.
+ */
+TupleTableSlot *
+ReturnTupleFromStreamingExecution(CitusScanState *scanState)
+{
+	DistributedExecution *execution = scanState->streamingExecution;
+	Tuplestorestate *tupleStore = scanState->tuplestorestate;
+	TupleTableSlot *resultSlot = scanState->customScanState.ss.ps.ps_ResultTupleSlot;
+
+	while (true)
+	{
+		bool gotTuple = false;
+
+		tuplestore_select_read_pointer(tupleStore, execution->streamingReadPointer);
+		gotTuple = tuplestore_gettupleslot(tupleStore, true, false, resultSlot);
+		tuplestore_select_read_pointer(tupleStore, 0);
+
+		if (gotTuple)
 		{
-			TimestampTz now = GetCurrentTimestamp();
+			/* discard the rows that have already been read */
+			tuplestore_trim(tupleStore);
 
-			if (TimestampDifferenceExceeds(workerPool->lastConnectionOpenTime, now,
-										   ExecutorSlowStartInterval))
-			{
-				newConnectionCount = Min(newConnectionCount,
-										 workerPool->maxNewConnectionsPerCycle);
+			return resultSlot;
+		}
 
-				/* increase the open rate every cycle (like TCP slow start) */
-				workerPool->maxNewConnectionsPerCycle += 1;
-			}
-			else
-			{
-				/* wait a bit until opening more connections */
-				return;
-			}
+		if (execution->unfinishedTaskCount == 0)
+		{
+			FinishDistributedExecution(execution);
+			scanState->streamingExecution = NULL;
+
+			return resultSlot;
 		}
+
+		ContinueDistributedExecution(execution, true);
 	}
+}
 
-	if (newConnectionCount <= 0)
+
+/*
+ * CancelStreamingExecution stops a streaming execution whose remaining results
+ * are not needed. The commands that are still running are cancelled and their
+ * connections are closed, since the results would otherwise need to be
+ * consumed before the connections could be used again. Idle connections are
+ * kept for subsequent executions.
+ */
+void
+CancelStreamingExecution(CitusScanState *scanState)
+{
+	DistributedExecution *execution = scanState->streamingExecution;
+
+	/* if all tasks are done, the sessions have already been cleaned up */
+	if (execution->unfinishedTaskCount > 0)
 	{
-		return;
+		CancelSessions(execution);
 	}
 
-	ereport(DEBUG4, (errmsg("opening %d new connections to %s:%d", newConnectionCount,
-							workerPool->nodeName, workerPool->nodePort)));
+	FinishDistributedExecution(execution);
+	scanState->streamingExecution = NULL;
+}
 
-	for (connectionIndex = 0; connectionIndex < newConnectionCount; connectionIndex++)
-	{
-		MultiConnection *connection = NULL;
-		WorkerSession *session = NULL;
 
-		/* experimental: just to see the perf benefits of caching connections */
-		int connectionFlags = 0;
+/*
+ * CancelSessions is the counterpart of CleanUpSessions for executions that
+ * stop before all tasks are finished. The commands that are still running are
+ * cancelled and their connections are closed, since the results would
+ * otherwise need to be consumed before the connections could be used again.
+ * Idle connections are kept for subsequent executions.
+ *
+ * Cancelling a command in a remote transaction block would abort the
+ * transaction, so this can only be used outside of coordinated transactions.
+ */
+static void
+CancelSessions(DistributedExecution *execution)
+{
+	ListCell *sessionCell = NULL;
 
-		/* open a new connection to the worker */
-		connection = StartNodeUserDatabaseConnection(connectionFlags,
-													 workerPool->nodeName,
-													 workerPool->nodePort,
-													 NULL, NULL);
+	Assert(!execution->isTransaction);
 
-		/*
-		 * Assign the initial state in the connection state machine. The connection
-		 * may already be open, but ConnectionStateMachine will immediately detect
-		 * this.
-		 */
-		connection->connectionState = MULTI_CONNECTION_CONNECTING;
+	foreach(sessionCell, execution->sessionList)
+	{
+		WorkerSession *session = lfirst(sessionCell);
+		MultiConnection *connection = session->connection;
 
-		/*
-		 * Ensure that subsequent calls to StartNodeUserDatabaseConnection get a
-		 * different connection.
-		 */
-		connection->claimedExclusively = true;
+		UnclaimConnection(connection);
 
-		/* create a session for the connection */
-		session = FindOrCreateWorkerSession(workerPool, connection);
+		if (connection->connectionState == MULTI_CONNECTION_CONNECTED &&
+			PQtransactionStatus(connection->pgConn) == PQTRANS_IDLE)
+		{
+			continue;
+		}
 
-		/* always poll the connection in the first round */
-		UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+		ShutdownConnection(connection);
+		CloseConnection(connection);
 	}
-
-	workerPool->lastConnectionOpenTime = GetCurrentTimestamp();
-	execution->connectionSetChanged = true;
 }
 
 
 /*
- * CheckConnectionTimeout makes sure that the execution enforces the connection
- * establishment timeout defined by the user (NodeConnectionTimeout).
- *
- * The rule is that if a worker pool has already initiated connection establishment
- * and has not succeeded to finish establishments that are necessary to execute tasks,
- * take an action. For the types of actions, see the comments in the function.
- *
- * Enforcing the timeout per pool (over per session) helps the execution to continue
- * even if we can establish a single connection as we expect to have target pool size
- * number of connections. In the end, the executor is capable of using one connection
- * to execute multiple tasks.
+ * MasterQueryRowLimit returns the number of rows from the workers that are
+ * sufficient to answer the given master query, or -1 if the master query
+ * needs all rows. That is the case unless the master query only applies a
+ * LIMIT (and OFFSET) to the rows, without sorting, grouping, aggregating or
+ * filtering them first. The same LIMIT is then pushed down to the workers by
+ * WorkerLimitCount, but each worker still returns up to that many rows.
  */
-static void
-CheckConnectionTimeout(WorkerPool *workerPool)
+int64
+MasterQueryRowLimit(Query *masterQuery)
 {
-	DistributedExecution *execution = workerPool->distributedExecution;
-	TimestampTz poolStartTime = workerPool->poolStartTime;
-	TimestampTz now = GetCurrentTimestamp();
-
-	int initiatedConnectionCount = list_length(workerPool->sessionList);
-	int activeConnectionCount = workerPool->activeConnectionCount;
-	int requiredActiveConnectionCount = 1;
+	Const *limitCount = NULL;
+	int64 rowLimit = 0;
 
-	if (initiatedConnectionCount == 0)
+	if (masterQuery == NULL || masterQuery->limitCount == NULL ||
+		!IsA(masterQuery->limitCount, Const))
 	{
-		/* no connection has been planned for the pool yet */
-		Assert(poolStartTime == 0);
-		return;
+		return -1;
 	}
 
-	/*
-	 * This is a special case where we assign tasks to sessions even before
-	 * the connections are established. So, make sure to apply similar
-	 * restrictions. In this case, make sure that we get all the connections
-	 * established.
-	 */
-	if (UseConnectionPerPlacement())
+	if (masterQuery->sortClause != NIL || masterQuery->groupClause != NIL ||
+		masterQuery->groupingSets != NIL || masterQuery->distinctClause != NIL ||
+		masterQuery->hasAggs || masterQuery->hasWindowFuncs ||
+		masterQuery->hasTargetSRFs || masterQuery->havingQual != NULL ||
+		masterQuery->jointree->quals != NULL)
 	{
-		requiredActiveConnectionCount = initiatedConnectionCount;
+		return -1;
 	}
 
-	if (TimestampDifferenceExceeds(poolStartTime, now, NodeConnectionTimeout))
+	limitCount = (Const *) masterQuery->limitCount;
+	if (limitCount->constisnull)
 	{
-		if (activeConnectionCount < requiredActiveConnectionCount)
-		{
-			int logLevel = WARNING;
+		/* LIMIT NULL means no limit */
+		return -1;
+	}
 
-			/*
-			 * First fail the pool and create an opportunity to execute tasks
-			 * over other pools when tasks have more than one placement to execute.
-			 */
-			WorkerPoolFailed(workerPool);
+	rowLimit = DatumGetInt64(limitCount->constvalue);
 
-			/*
-			 * The enforcement is not always erroring out. For example, if a SELECT task
-			 * has two different placements, we'd warn the user, fail the pool and continue
-			 * with the next placement.
-			 */
-			if (execution->errorOnAnyFailure || execution->failed)
-			{
-				logLevel = ERROR;
-			}
+	if (masterQuery->limitOffset != NULL)
+	{
+		Const *limitOffset = (Const *) masterQuery->limitOffset;
 
-			ereport(logLevel, (errcode(ERRCODE_CONNECTION_FAILURE),
-							   errmsg("could not establish any connections to the node "
-									  "%s:%d after %u ms", workerPool->nodeName,
-									  workerPool->nodePort,
-									  NodeConnectionTimeout)));
+		if (!IsA(limitOffset, Const))
+		{
+			return -1;
 		}
-		else
+
+		if (!limitOffset->constisnull)
 		{
-			/* stop interrupting WaitEventSetWait for timeouts */
-			workerPool->checkForPoolTimeout = false;
+			rowLimit += DatumGetInt64(limitOffset->constvalue);
 		}
 	}
+
+	return rowLimit;
 }
 
 
 /*
- * UsableConnectionCount returns the number of connections in the worker pool
- * that are (soon to be) usable for sending commands, this includes both idle
- * connections and connections that are still establishing.
+ * RowLimitReached returns true if the execution received enough rows to
+ * answer the query and the remaining tasks are no longer needed.
  */
-static int
-UsableConnectionCount(WorkerPool *workerPool)
+static bool
+RowLimitReached(DistributedExecution *execution)
 {
-	int initiatedConnectionCount = list_length(workerPool->sessionList);
-	int activeConnectionCount = workerPool->activeConnectionCount;
-	int failedConnectionCount = workerPool->failedConnectionCount;
-	int idleConnectionCount = workerPool->idleConnectionCount;
-
-	/* connections that are still establishing will soon be available for tasks */
-	int establishingConnectionCount =
-		initiatedConnectionCount - activeConnectionCount - failedConnectionCount;
-
-	int usableConnectionCount = idleConnectionCount + establishingConnectionCount;
+	if (execution->rowLimit < 0)
+	{
+		return false;
+	}
 
-	return usableConnectionCount;
+	return execution->rowsProcessed >= (uint64) execution->rowLimit;
 }
 
 
 /*
- * NextEventTimeout finds the earliest time at which we need to interrupt
- * WaitEventSetWait because of a timeout and returns the number of milliseconds
- * until that event with a minimum of 1ms and a maximum of 1000ms.
+ * HedgeSlowPlacementExecutions starts the tasks that have not responded within
+ * the hedging threshold on the next placement of the shard, while the slow
+ * execution keeps running. Whichever placement execution responds first
+ * provides the results and the other one is cancelled (see
+ * CancelRedundantPlacementExecutions). This prevents a single slow worker,
+ * e.g. one that is running a checkpoint, from determining the latency of a
+ * multi-shard query on replicated or reference tables.
  *
- * This code may be sensitive to clock jumps, but only has the effect of waking
- * up WaitEventSetWait slightly earlier to later.
+ * The function also sets the time at which the next running task exceeds the
+ * threshold, such that the execution wakes up in time.
  */
-static long
-NextEventTimeout(DistributedExecution *execution)
+static void
+HedgeSlowPlacementExecutions(DistributedExecution *execution)
 {
-	ListCell *workerCell = NULL;
+	ListCell *sessionCell = NULL;
 	TimestampTz now = GetCurrentTimestamp();
-	long eventTimeout = 1000; /* milliseconds */
+	long hedgingThreshold = HedgingThreshold(execution);
 
-	foreach(workerCell, execution->workerList)
+	execution->nextHedgeTime = 0;
+
+	foreach(sessionCell, execution->sessionList)
 	{
-		WorkerPool *workerPool = (WorkerPool *) lfirst(workerCell);
-		int initiatedConnectionCount = 0;
+		WorkerSession *session = lfirst(sessionCell);
+		TaskPlacementExecution *placementExecution = session->currentTask;
+		TimestampTz hedgeTime = 0;
 
-		if (workerPool->failed)
+		if (placementExecution == NULL || !CanHedgePlacementExecution(placementExecution))
 		{
-			/* worker pool may have already timed out */
 			continue;
 		}
 
-		if (workerPool->poolStartTime != 0 && workerPool->checkForPoolTimeout)
+		hedgeTime = TimestampTzPlusMilliseconds(placementExecution->startTime,
+												hedgingThreshold);
+		if (hedgeTime <= now)
 		{
-			long timeSincePoolStartMs =
-				MillisecondsBetweenTimestamps(workerPool->poolStartTime, now);
+			ShardCommandExecution *shardCommandExecution =
+				placementExecution->shardCommandExecution;
+			TaskPlacementExecution *nextPlacementExecution =
+				NextPlacementExecutionForHedging(placementExecution);
+			WorkerPool *nextWorkerPool = nextPlacementExecution->workerPool;
 
-			/*
-			 * This could go into the negative if the connection timeout just passed.
-			 * In that case we want to wake up as soon as possible. Once the timeout
-			 * has been processed, checkForPoolTimeout will be false so we will skip
-			 * this check.
-			 */
-			long timeUntilConnectionTimeoutMs =
-				NodeConnectionTimeout - timeSincePoolStartMs;
+			ereport(DEBUG4, (errmsg("task on shard " UINT64_FORMAT " did not respond "
+									"within %ld ms, also starting it on %s:%d",
+									shardCommandExecution->task->anchorShardId,
+									hedgingThreshold, nextWorkerPool->nodeName,
+									nextWorkerPool->nodePort)));
 
-			if (timeUntilConnectionTimeoutMs < eventTimeout)
-			{
-				eventTimeout = timeUntilConnectionTimeoutMs;
-			}
+			shardCommandExecution->hedged = true;
+
+			PlacementExecutionReady(nextPlacementExecution);
+		}
+		else if (execution->nextHedgeTime == 0 || hedgeTime < execution->nextHedgeTime)
+		{
+			execution->nextHedgeTime = hedgeTime;
 		}
+	}
+}
 
-		initiatedConnectionCount = list_length(workerPool->sessionList);
 
-		/*
-		 * If there are connections to open we wait at most up to the end of the
-		 * current slow start interval.
-		 */
-		if (workerPool->readyTaskCount > UsableConnectionCount(workerPool) &&
-			initiatedConnectionCount < execution->targetPoolSize)
-		{
-			long timeSinceLastConnectMs =
-				MillisecondsBetweenTimestamps(workerPool->lastConnectionOpenTime, now);
-			long timeUntilSlowStartInterval =
-				ExecutorSlowStartInterval - timeSinceLastConnectMs;
+/*
+ * HedgingThreshold returns the number of milliseconds after which a task that
+ * did not respond is started on another placement. That is the 95th
+ * percentile of the durations of the tasks that finished so far, but at least
+ * citus.hedged_execution_threshold.
+ */
+static long
+HedgingThreshold(DistributedExecution *execution)
+{
+	int taskDurationCount = execution->taskDurationCount;
 
-			if (timeUntilSlowStartInterval < eventTimeout)
-			{
-				eventTimeout = timeUntilSlowStartInterval;
-			}
-		}
+	/* only recompute the threshold when more tasks finished */
+	if (execution->hedgingThresholdTaskCount != taskDurationCount)
+	{
+		long *sortedDurations = (long *) palloc(taskDurationCount * sizeof(long));
+		int percentileIndex = (taskDurationCount * 95 + 99) / 100 - 1;
+
+		memcpy(sortedDurations, execution->taskDurations,
+			   taskDurationCount * sizeof(long));
+		qsort(sortedDurations, taskDurationCount, sizeof(long), CompareTaskDurations);
+
+		execution->hedgingThreshold = Max(HedgedExecutionThreshold,
+										  sortedDurations[percentileIndex]);
+		execution->hedgingThresholdTaskCount = taskDurationCount;
+
+		pfree(sortedDurations);
 	}
 
-	return Max(1, eventTimeout);
+	return execution->hedgingThreshold;
 }
 
 
 /*
- * MillisecondsBetweenTimestamps is a helper to get the number of milliseconds
- * between timestamps when it is expected to be small enough to fit in a
- * long.
+ * CompareTaskDurations is a comparison function for sorting task durations.
  */
-static long
-MillisecondsBetweenTimestamps(TimestampTz startTime, TimestampTz endTime)
+static int
+CompareTaskDurations(const void *leftElement, const void *rightElement)
 {
-	long secs = 0;
-	int micros = 0;
+	long leftDuration = *((const long *) leftElement);
+	long rightDuration = *((const long *) rightElement);
 
-	TimestampDifference(startTime, endTime, &secs, &micros);
+	if (leftDuration < rightDuration)
+	{
+		return -1;
+	}
+	else if (leftDuration > rightDuration)
+	{
+		return 1;
+	}
 
-	return secs * 1000 + micros / 1000;
+	return 0;
 }
 
 
 /*
- * ConnectionStateMachine opens a connection and descends into the transaction
- * state machine when ready.
+ * RecordTaskDuration adds the duration of the given placement execution, which
+ * just finished successfully, to the task durations of the execution.
  */
 static void
-ConnectionStateMachine(WorkerSession *session)
+RecordTaskDuration(TaskPlacementExecution *placementExecution)
 {
-	WorkerPool *workerPool = session->workerPool;
-	DistributedExecution *execution = workerPool->distributedExecution;
+	DistributedExecution *execution = placementExecution->workerPool->distributedExecution;
+	long taskDuration = MillisecondsBetweenTimestamps(placementExecution->startTime,
+													  GetCurrentTimestamp());
 
-	MultiConnection *connection = session->connection;
-	MultiConnectionState currentState;
+	/* a task finishes successfully at most once */
+	if (execution->taskDurationCount < execution->totalTaskCount)
+	{
+		execution->taskDurations[execution->taskDurationCount] = taskDuration;
+		execution->taskDurationCount++;
+	}
+}
 
-	do {
-		currentState = connection->connectionState;
+
+/*
+ * CanHedgePlacementExecution returns true if the given placement execution is
+ * running, its task has not been hedged before, none of its placements
+ * responded yet, and there is another placement to run the task on.
+ */
+static bool
+CanHedgePlacementExecution(TaskPlacementExecution *placementExecution)
+{
+	ShardCommandExecution *shardCommandExecution =
+		placementExecution->shardCommandExecution;
+
+	/* only tasks that can run on any of the placements are hedged, and only once */
+	if (shardCommandExecution->executionOrder != EXECUTION_ORDER_ANY ||
+		shardCommandExecution->hedged)
+	{
+		return false;
+	}
+
+	/* once a worker is sending results, we have to wait for the rest */
+	if (shardCommandExecution->firstRespondingPlacementExecution != NULL)
+	{
+		return false;
+	}
+
+	if (placementExecution->executionState != PLACEMENT_EXECUTION_RUNNING)
+	{
+		return false;
+	}
+
+	return NextPlacementExecutionForHedging(placementExecution) != NULL;
+}
+
+
+/*
+ * NextPlacementExecutionForHedging returns a placement execution of the same
+ * task that is not ready yet and can be executed over any connection to a
+ * worker that did not fail, or NULL if there is none.
+ */
+static TaskPlacementExecution *
+NextPlacementExecutionForHedging(TaskPlacementExecution *placementExecution)
+{
+	ShardCommandExecution *shardCommandExecution =
+		placementExecution->shardCommandExecution;
+	int placementExecutionCount = shardCommandExecution->placementExecutionCount;
+	int placementExecutionIndex = 0;
+
+	for (; placementExecutionIndex < placementExecutionCount; placementExecutionIndex++)
+	{
+		TaskPlacementExecution *otherPlacementExecution =
+			shardCommandExecution->placementExecutions[placementExecutionIndex];
+
+		if (otherPlacementExecution->executionState == PLACEMENT_EXECUTION_NOT_READY &&
+			otherPlacementExecution->assignedSession == NULL &&
+			!otherPlacementExecution->workerPool->failed)
+		{
+			return otherPlacementExecution;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * CancelRedundantPlacementExecutions is called when a placement execution of
+ * a hedged task is the first to respond. The other running placement
+ * executions of the task are cancelled and their results are ignored. A
+ * placement execution that did not start yet is moved back to the pending
+ * queue, such that we can still fail over to it.
+ */
+static void
+CancelRedundantPlacementExecutions(TaskPlacementExecution *respondingPlacementExecution)
+{
+	ShardCommandExecution *shardCommandExecution =
+		respondingPlacementExecution->shardCommandExecution;
+	DistributedExecution *execution =
+		respondingPlacementExecution->workerPool->distributedExecution;
+	int placementExecutionCount = shardCommandExecution->placementExecutionCount;
+	int placementExecutionIndex = 0;
+
+	for (; placementExecutionIndex < placementExecutionCount; placementExecutionIndex++)
+	{
+		TaskPlacementExecution *placementExecution =
+			shardCommandExecution->placementExecutions[placementExecutionIndex];
+		WorkerPool *workerPool = placementExecution->workerPool;
+
+		if (placementExecution == respondingPlacementExecution)
+		{
+			continue;
+		}
+
+		if (placementExecution->executionState == PLACEMENT_EXECUTION_RUNNING)
+		{
+			ListCell *sessionCell = NULL;
+
+			placementExecution->cancelled = true;
+			execution->cancelledPlacementExecutionCount++;
+
+			foreach(sessionCell, workerPool->sessionList)
+			{
+				WorkerSession *session = lfirst(sessionCell);
+
+				if (session->currentTask == placementExecution)
+				{
+					SendCancelationRequest(session->connection);
+					session->cancelRequested = true;
+					break;
+				}
+			}
+		}
+		else if (placementExecution->executionState == PLACEMENT_EXECUTION_READY)
+		{
+			/* hedged placement executions are never assigned to a session */
+			Assert(placementExecution->assignedSession == NULL);
+
+			dlist_delete(&placementExecution->workerReadyQueueNode);
+			dlist_push_tail(&workerPool->pendingTaskQueue,
+							&placementExecution->workerPendingQueueNode);
+			workerPool->readyTaskCount--;
+
+			placementExecution->executionState = PLACEMENT_EXECUTION_NOT_READY;
+		}
+	}
+}
+
+
+/*
+ * CloseCancelledSessions closes the connections over which we sent a
+ * cancellation request once the cancelled command returned. The backend on
+ * the worker might still receive the cancellation request after that, so we
+ * do not send any further commands over these connections. Closing them also
+ * allows ManageWorkerPool to open new connections in their place.
+ */
+static void
+CloseCancelledSessions(DistributedExecution *execution)
+{
+	List *cancelledSessionList = NIL;
+	ListCell *sessionCell = NULL;
+
+	if (!execution->enableHedging)
+	{
+		/* only hedged placement executions are cancelled while running */
+		return;
+	}
+
+	foreach(sessionCell, execution->sessionList)
+	{
+		WorkerSession *session = lfirst(sessionCell);
+
+		if (session->cancelRequested && session->currentTask == NULL)
+		{
+			cancelledSessionList = lappend(cancelledSessionList, session);
+		}
+	}
+
+	foreach(sessionCell, cancelledSessionList)
+	{
+		WorkerSession *session = lfirst(sessionCell);
+		WorkerPool *workerPool = session->workerPool;
+		MultiConnection *connection = session->connection;
+
+		workerPool->sessionList = list_delete_ptr(workerPool->sessionList, session);
+		execution->sessionList = list_delete_ptr(execution->sessionList, session);
+		workerPool->activeConnectionCount--;
+
+		UnclaimConnection(connection);
+		ShutdownConnection(connection);
+		CloseConnection(connection);
+
+		execution->connectionSetChanged = true;
+	}
+}
+
+
+/*
+ * ManageWorkerPool ensures the worker pool has the appropriate number of connections
+ * based on the number of pending tasks.
+ */
+static void
+ManageWorkerPool(WorkerPool *workerPool)
+{
+	DistributedExecution *execution = workerPool->distributedExecution;
+	int targetPoolSize = execution->targetPoolSize;
+	int initiatedConnectionCount = list_length(workerPool->sessionList);
+	int activeConnectionCount PG_USED_FOR_ASSERTS_ONLY =
+		workerPool->activeConnectionCount;
+	int idleConnectionCount PG_USED_FOR_ASSERTS_ONLY =
+		workerPool->idleConnectionCount;
+	int failedConnectionCount = workerPool->failedConnectionCount;
+	int readyTaskCount = workerPool->readyTaskCount;
+	int newConnectionCount = 0;
+	int connectionIndex = 0;
+	NodeLatencyStats latencyStats;
+
+	/* we should always have more (or equal) active connections than idle connections */
+	Assert(activeConnectionCount >= idleConnectionCount);
+
+	/* we should always have more (or equal) initiated connections than active connections */
+	Assert(initiatedConnectionCount >= activeConnectionCount);
+
+	/* we should never have less than 0 connections ever */
+	Assert(activeConnectionCount >= 0 && idleConnectionCount >= 0);
+
+	if (workerPool->failed)
+	{
+		/* connection pool failed */
+		return;
+	}
+
+	/* we might fail the execution or warn the user about connection timeouts */
+	if (workerPool->checkForPoolTimeout)
+	{
+		CheckConnectionTimeout(workerPool);
+	}
+
+	if (failedConnectionCount >= 1)
+	{
+		/* do not attempt to open more connections after one failed */
+		return;
+	}
+
+	if (workerPool->sharedPoolExhaustedTime != 0 &&
+		!TimestampDifferenceExceeds(workerPool->sharedPoolExhaustedTime,
+									GetCurrentTimestamp(),
+									SharedPoolRetryIntervalMs))
+	{
+		/* other backends are unlikely to have released connections already */
+		return;
+	}
+
+	if (UseConnectionPerPlacement())
+	{
+		int unusedConnectionCount = workerPool->unusedConnectionCount;
+
+		/*
+		 * If force_max_query_parallelization is enabled then we ignore pool size
+		 * and idle connections. Instead, we open new connections as long as there
+		 * are more tasks than unused connections.
+		 */
+
+		newConnectionCount = Max(readyTaskCount - unusedConnectionCount, 0);
+	}
+	else
+	{
+		/* cannot open more than targetPoolSize connections */
+		int maxNewConnectionCount = targetPoolSize - initiatedConnectionCount;
+
+		/* total number of connections that are (almost) available for tasks */
+		int usableConnectionCount = UsableConnectionCount(workerPool);
+
+		/*
+		 * Number of additional connections we would need to run all ready tasks in
+		 * parallel.
+		 */
+		int newConnectionsForReadyTasks = readyTaskCount - usableConnectionCount;
+
+		/*
+		 * Open enough connections to handle all tasks that are ready, but no more
+		 * than the target pool size.
+		 */
+		newConnectionCount = Min(newConnectionsForReadyTasks, maxNewConnectionCount);
+
+		if (newConnectionCount > 0 && EnableLatencyAwarePoolSizing &&
+			PoolLatencyStats(workerPool, &latencyStats))
+		{
+			/*
+			 * Instead of slowly ramping up, open as many connections as will
+			 * pay off given how long tasks and connection establishment take.
+			 */
+			newConnectionCount = Min(newConnectionCount,
+									 ProfitableNewConnectionCount(workerPool,
+																  &latencyStats));
+		}
+		else if (newConnectionCount > 0 && ExecutorSlowStartInterval > 0)
+		{
+			TimestampTz now = GetCurrentTimestamp();
+
+			if (TimestampDifferenceExceeds(workerPool->lastConnectionOpenTime, now,
+										   ExecutorSlowStartInterval))
+			{
+				newConnectionCount = Min(newConnectionCount,
+										 workerPool->maxNewConnectionsPerCycle);
+
+				/* increase the open rate every cycle (like TCP slow start) */
+				workerPool->maxNewConnectionsPerCycle += 1;
+			}
+			else
+			{
+				/* wait a bit until opening more connections */
+				return;
+			}
+		}
+	}
+
+	if (newConnectionCount <= 0)
+	{
+		return;
+	}
+
+	ereport(DEBUG4, (errmsg("opening %d new connections to %s:%d", newConnectionCount,
+							workerPool->nodeName, workerPool->nodePort)));
+
+	for (connectionIndex = 0; connectionIndex < newConnectionCount; connectionIndex++)
+	{
+		MultiConnection *connection = NULL;
+		WorkerSession *session = NULL;
+
+		/* experimental: just to see the perf benefits of caching connections */
+		int connectionFlags = 0;
+
+		/*
+		 * The first connection to the worker is required to make progress, but
+		 * additional connections are only opened as long as the shared pool of
+		 * connections to the worker is not exhausted by other backends.
+		 */
+		if (!UseConnectionPerPlacement() &&
+			initiatedConnectionCount + connectionIndex > 0)
+		{
+			connectionFlags |= OPTIONAL_CONNECTION;
+		}
+
+		/* open a new connection to the worker */
+		connection = StartNodeUserDatabaseConnection(connectionFlags,
+													 workerPool->nodeName,
+													 workerPool->nodePort,
+													 NULL, NULL);
+		if (connection == NULL)
+		{
+			/* limit reached, continue with the connections we already have */
+			ereport(DEBUG4, (errmsg("citus.max_shared_pool_size reached for %s:%d",
+									workerPool->nodeName, workerPool->nodePort)));
+
+			workerPool->sharedPoolExhaustedTime = GetCurrentTimestamp();
+			break;
+		}
+
+		workerPool->sharedPoolExhaustedTime = 0;
+
+		/*
+		 * Assign the initial state in the connection state machine. The connection
+		 * may already be open, but ConnectionStateMachine will immediately detect
+		 * this.
+		 */
+		connection->connectionState = MULTI_CONNECTION_CONNECTING;
+
+		/*
+		 * Ensure that subsequent calls to StartNodeUserDatabaseConnection get a
+		 * different connection.
+		 */
+		connection->claimedExclusively = true;
+
+		/* create a session for the connection */
+		session = FindOrCreateWorkerSession(workerPool, connection);
+
+		if (PQstatus(connection->pgConn) != CONNECTION_OK)
+		{
+			/* measure how long it takes to establish the new connection */
+			session->connectionStartTime = connection->connectionStart;
+		}
+
+		/* always poll the connection in the first round */
+		UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+	}
+
+	workerPool->lastConnectionOpenTime = GetCurrentTimestamp();
+	execution->connectionSetChanged = true;
+}
+
+
+/*
+ * CheckConnectionTimeout makes sure that the execution enforces the connection
+ * establishment timeout defined by the user (NodeConnectionTimeout).
+ *
+ * The rule is that if a worker pool has already initiated connection establishment
+ * and has not succeeded to finish establishments that are necessary to execute tasks,
+ * take an action. For the types of actions, see the comments in the function.
+ *
+ * Enforcing the timeout per pool (over per session) helps the execution to continue
+ * even if we can establish a single connection as we expect to have target pool size
+ * number of connections. In the end, the executor is capable of using one connection
+ * to execute multiple tasks.
+ */
+static void
+CheckConnectionTimeout(WorkerPool *workerPool)
+{
+	DistributedExecution *execution = workerPool->distributedExecution;
+	TimestampTz poolStartTime = workerPool->poolStartTime;
+	TimestampTz now = GetCurrentTimestamp();
+
+	int initiatedConnectionCount = list_length(workerPool->sessionList);
+	int activeConnectionCount = workerPool->activeConnectionCount;
+	int requiredActiveConnectionCount = 1;
+
+	if (initiatedConnectionCount == 0)
+	{
+		/* no connection has been planned for the pool yet */
+		Assert(poolStartTime == 0);
+		return;
+	}
+
+	/*
+	 * This is a special case where we assign tasks to sessions even before
+	 * the connections are established. So, make sure to apply similar
+	 * restrictions. In this case, make sure that we get all the connections
+	 * established.
+	 */
+	if (UseConnectionPerPlacement())
+	{
+		requiredActiveConnectionCount = initiatedConnectionCount;
+	}
+
+	if (TimestampDifferenceExceeds(poolStartTime, now, NodeConnectionTimeout))
+	{
+		if (activeConnectionCount < requiredActiveConnectionCount)
+		{
+			int logLevel = WARNING;
+
+			/*
+			 * First fail the pool and create an opportunity to execute tasks
+			 * over other pools when tasks have more than one placement to execute.
+			 */
+			WorkerPoolFailed(workerPool);
+
+			/*
+			 * The enforcement is not always erroring out. For example, if a SELECT task
+			 * has two different placements, we'd warn the user, fail the pool and continue
+			 * with the next placement.
+			 */
+			if (execution->errorOnAnyFailure || execution->failed)
+			{
+				logLevel = ERROR;
+			}
+
+			ereport(logLevel, (errcode(ERRCODE_CONNECTION_FAILURE),
+							   errmsg("could not establish any connections to the node "
+									  "%s:%d after %u ms", workerPool->nodeName,
+									  workerPool->nodePort,
+									  NodeConnectionTimeout)));
+		}
+		else
+		{
+			/* stop interrupting WaitEventSetWait for timeouts */
+			workerPool->checkForPoolTimeout = false;
+		}
+	}
+}
+
+
+/*
+ * UsableConnectionCount returns the number of connections in the worker pool
+ * that are (soon to be) usable for sending commands, this includes both idle
+ * connections and connections that are still establishing.
+ */
+static int
+UsableConnectionCount(WorkerPool *workerPool)
+{
+	int initiatedConnectionCount = list_length(workerPool->sessionList);
+	int activeConnectionCount = workerPool->activeConnectionCount;
+	int failedConnectionCount = workerPool->failedConnectionCount;
+	int idleConnectionCount = workerPool->idleConnectionCount;
+
+	/* connections that are still establishing will soon be available for tasks */
+	int establishingConnectionCount =
+		initiatedConnectionCount - activeConnectionCount - failedConnectionCount;
+
+	int usableConnectionCount = idleConnectionCount + establishingConnectionCount;
+
+	return usableConnectionCount;
+}
+
+
+/*
+ * PoolLatencyStats sets latencyStats to the best known estimates of the task
+ * duration and connection establishment time on the node of the pool, which
+ * are the averages observed by the current execution if there are any, and
+ * the averages of earlier executions otherwise. It returns false if either
+ * of them is unknown.
+ */
+static bool
+PoolLatencyStats(WorkerPool *workerPool, NodeLatencyStats *latencyStats)
+{
+	*latencyStats = workerPool->nodeLatencyStats;
+
+	if (workerPool->finishedTaskCount > 0)
+	{
+		latencyStats->taskDurationMs =
+			workerPool->totalTaskDurationMs / workerPool->finishedTaskCount;
+	}
+
+	if (workerPool->establishedConnectionCount > 0)
+	{
+		latencyStats->connectionEstablishmentMs =
+			workerPool->totalConnectionEstablishmentMs /
+			workerPool->establishedConnectionCount;
+	}
+
+	return latencyStats->taskDurationMs > 0 &&
+		   latencyStats->connectionEstablishmentMs > 0;
+}
+
+
+/*
+ * ProfitableNewConnectionCount returns the number of connections to open in
+ * addition to the current ones, such that every connection gets to execute
+ * ready tasks for at least as long as it takes to establish a connection.
+ * Short tasks are therefore executed over the existing connections, while
+ * long tasks quickly get a connection each. The first connection is always
+ * opened.
+ */
+static int
+ProfitableNewConnectionCount(WorkerPool *workerPool, NodeLatencyStats *latencyStats)
+{
+	int connectionCount =
+		list_length(workerPool->sessionList) - workerPool->failedConnectionCount;
+	double remainingTaskDurationMs =
+		workerPool->readyTaskCount * latencyStats->taskDurationMs;
+	double profitableConnectionCount =
+		remainingTaskDurationMs / latencyStats->connectionEstablishmentMs;
+	int newConnectionCount = 0;
+
+	if (profitableConnectionCount > connectionCount)
+	{
+		newConnectionCount = (int) Min(profitableConnectionCount - connectionCount,
+									   (double) workerPool->readyTaskCount);
+	}
+
+	if (connectionCount == 0)
+	{
+		newConnectionCount = Max(newConnectionCount, 1);
+	}
+
+	return newConnectionCount;
+}
+
+
+/*
+ * NextEventTimeout finds the earliest time at which we need to interrupt
+ * WaitEventSetWait because of a timeout and returns the number of milliseconds
+ * until that event with a minimum of 1ms and a maximum of 1000ms.
+ *
+ * This code may be sensitive to clock jumps, but only has the effect of waking
+ * up WaitEventSetWait slightly earlier to later.
+ */
+static long
+NextEventTimeout(DistributedExecution *execution)
+{
+	ListCell *workerCell = NULL;
+	TimestampTz now = GetCurrentTimestamp();
+	long eventTimeout = 1000; /* milliseconds */
+
+	foreach(workerCell, execution->workerList)
+	{
+		WorkerPool *workerPool = (WorkerPool *) lfirst(workerCell);
+		int initiatedConnectionCount = 0;
+
+		if (workerPool->failed)
+		{
+			/* worker pool may have already timed out */
+			continue;
+		}
+
+		if (workerPool->poolStartTime != 0 && workerPool->checkForPoolTimeout)
+		{
+			long timeSincePoolStartMs =
+				MillisecondsBetweenTimestamps(workerPool->poolStartTime, now);
+
+			/*
+			 * This could go into the negative if the connection timeout just passed.
+			 * In that case we want to wake up as soon as possible. Once the timeout
+			 * has been processed, checkForPoolTimeout will be false so we will skip
+			 * this check.
+			 */
+			long timeUntilConnectionTimeoutMs =
+				NodeConnectionTimeout - timeSincePoolStartMs;
+
+			if (timeUntilConnectionTimeoutMs < eventTimeout)
+			{
+				eventTimeout = timeUntilConnectionTimeoutMs;
+			}
+		}
+
+		initiatedConnectionCount = list_length(workerPool->sessionList);
+
+		/*
+		 * If there are connections to open we wait at most up to the end of the
+		 * current slow start interval, or until we retry opening connections
+		 * when the shared pool was exhausted. In the latter case, we do not
+		 * wake up earlier, since the existing connections wake us up when
+		 * they finish their tasks.
+		 */
+		if (workerPool->readyTaskCount > UsableConnectionCount(workerPool) &&
+			initiatedConnectionCount < execution->targetPoolSize &&
+			workerPool->sharedPoolExhaustedTime != 0)
+		{
+			long timeSinceExhaustedMs =
+				MillisecondsBetweenTimestamps(workerPool->sharedPoolExhaustedTime, now);
+			long timeUntilRetryMs = SharedPoolRetryIntervalMs - timeSinceExhaustedMs;
+
+			if (timeUntilRetryMs < eventTimeout)
+			{
+				eventTimeout = timeUntilRetryMs;
+			}
+		}
+		else if (workerPool->readyTaskCount > UsableConnectionCount(workerPool) &&
+				 initiatedConnectionCount < execution->targetPoolSize)
+		{
+			long timeSinceLastConnectMs =
+				MillisecondsBetweenTimestamps(workerPool->lastConnectionOpenTime, now);
+			long timeUntilSlowStartInterval =
+				ExecutorSlowStartInterval - timeSinceLastConnectMs;
+
+			if (timeUntilSlowStartInterval < eventTimeout)
+			{
+				eventTimeout = timeUntilSlowStartInterval;
+			}
+		}
+	}
+
+	/* wake up when the next running task should be hedged */
+	if (execution->nextHedgeTime != 0)
+	{
+		long timeUntilHedgeMs =
+			MillisecondsBetweenTimestamps(now, execution->nextHedgeTime);
+
+		if (timeUntilHedgeMs < eventTimeout)
+		{
+			eventTimeout = timeUntilHedgeMs;
+		}
+	}
+
+	return Max(1, eventTimeout);
+}
+
+
+/*
+ * MillisecondsBetweenTimestamps is a helper to get the number of milliseconds
+ * between timestamps when it is expected to be small enough to fit in a
+ * long.
+ */
+static long
+MillisecondsBetweenTimestamps(TimestampTz startTime, TimestampTz endTime)
+{
+	long secs = 0;
+	int micros = 0;
+
+	TimestampDifference(startTime, endTime, &secs, &micros);
+
+	return secs * 1000 + micros / 1000;
+}
+
+
+/*
+ * FractionalMillisecondsBetweenTimestamps is a helper to get the number of
+ * milliseconds between timestamps with sub-millisecond precision.
+ */
+static double
+FractionalMillisecondsBetweenTimestamps(TimestampTz startTime, TimestampTz endTime)
+{
+	long secs = 0;
+	int micros = 0;
+
+	TimestampDifference(startTime, endTime, &secs, &micros);
+
+	return secs * 1000.0 + micros / 1000.0;
+}
+
+
+/*
+ * ConnectionStateMachine opens a connection and descends into the transaction
+ * state machine when ready.
+ */
+static void
+ConnectionStateMachine(WorkerSession *session)
+{
+	WorkerPool *workerPool = session->workerPool;
+	DistributedExecution *execution = workerPool->distributedExecution;
+
+	MultiConnection *connection = session->connection;
+	MultiConnectionState currentState;
+
+	do {
+		currentState = connection->connectionState;
+
+		switch (currentState)
+		{
+			case MULTI_CONNECTION_INITIAL:
+			{
+				/* simply iterate the state machine */
+				connection->connectionState = MULTI_CONNECTION_CONNECTING;
+				break;
+			}
+
+			case MULTI_CONNECTION_CONNECTING:
+			{
+				PostgresPollingStatusType pollMode;
+
+				ConnStatusType status = PQstatus(connection->pgConn);
+				if (status == CONNECTION_OK)
+				{
+					ereport(DEBUG4, (errmsg("established connection to %s:%d for "
+											"session %ld",
+											connection->hostname, connection->port,
+											session->sessionId)));
+
+					workerPool->activeConnectionCount++;
+					workerPool->idleConnectionCount++;
+
+					UpdateConnectionWaitFlags(session,
+											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+
+					connection->connectionState = MULTI_CONNECTION_CONNECTED;
+					break;
+				}
+				else if (status == CONNECTION_BAD)
+				{
+					connection->connectionState = MULTI_CONNECTION_FAILED;
+					break;
+				}
+
+				pollMode = PQconnectPoll(connection->pgConn);
+				if (pollMode == PGRES_POLLING_FAILED)
+				{
+					connection->connectionState = MULTI_CONNECTION_FAILED;
+				}
+				else if (pollMode == PGRES_POLLING_READING)
+				{
+					UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
+				}
+				else if (pollMode == PGRES_POLLING_WRITING)
+				{
+					UpdateConnectionWaitFlags(session, WL_SOCKET_WRITEABLE);
+				}
+				else
+				{
+					ereport(DEBUG4, (errmsg("established connection to %s:%d for "
+											"session %ld",
+											connection->hostname, connection->port,
+											session->sessionId)));
+
+					workerPool->activeConnectionCount++;
+					workerPool->idleConnectionCount++;
+
+					if (session->connectionStartTime != 0)
+					{
+						TimestampTz now = GetCurrentTimestamp();
+
+						workerPool->totalConnectionEstablishmentMs +=
+							FractionalMillisecondsBetweenTimestamps(
+								session->connectionStartTime, now);
+						workerPool->establishedConnectionCount++;
+					}
+
+					UpdateConnectionWaitFlags(session,
+											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+
+					connection->connectionState = MULTI_CONNECTION_CONNECTED;
+				}
+
+				break;
+			}
+
+			case MULTI_CONNECTION_CONNECTED:
+			{
+				/* connection is ready, run the transaction state machine */
+				TransactionStateMachine(session);
+				break;
+			}
+
+			case MULTI_CONNECTION_LOST:
+			{
+				/* managed to connect, but connection was lost */
+				workerPool->activeConnectionCount--;
+
+				if (session->currentTask == NULL)
+				{
+					/* this was an idle connection */
+					workerPool->idleConnectionCount--;
+				}
+
+				connection->connectionState = MULTI_CONNECTION_FAILED;
+				break;
+			}
+
+			case MULTI_CONNECTION_FAILED:
+			{
+				/* connection failed or was lost */
+				int totalConnectionCount = list_length(workerPool->sessionList);
+
+				workerPool->failedConnectionCount++;
+
+				/* if the connection executed a critical command it should fail */
+				MarkRemoteTransactionFailed(connection, false);
+
+				/* mark all assigned placement executions as failed */
+				WorkerSessionFailed(session);
+
+				if (workerPool->failedConnectionCount >= totalConnectionCount)
+				{
+					/*
+					 * All current connection attempts have failed.
+					 * Mark all unassigned placement executions as failed.
+					 *
+					 * We do not currently retry if the first connection
+					 * attempt fails.
+					 */
+					WorkerPoolFailed(workerPool);
+				}
+
+				/*
+				 * The execution may have failed as a result of WorkerSessionFailed
+				 * or WorkerPoolFailed.
+				 */
+				if (execution->failed || execution->errorOnAnyFailure)
+				{
+					/* a task has failed due to this connection failure */
+					ReportConnectionError(connection, ERROR);
+				}
+				else
+				{
+					/* can continue with the remaining nodes */
+					ReportConnectionError(connection, WARNING);
+				}
+
+				/* remove the connection */
+				UnclaimConnection(connection);
+
+				/*
+				 * We forcefully close the underlying libpq connection because
+				 * we don't want any subsequent execution (either subPlan executions
+				 * or new command executions within a transaction block) use the
+				 * connection.
+				 *
+				 * However, we prefer to keep the MultiConnection around until
+				 * the end of FinishDistributedExecution() to simplify the code.
+				 * Thus, we prefer ShutdownConnection() over CloseConnection().
+				 */
+				ShutdownConnection(connection);
+
+				/* remove connection from wait event set */
+				execution->connectionSetChanged = true;
+
+				/*
+				 * Reset the transaction state machine since CloseConnection()
+				 * relies on it and even if we're not inside a distributed transaction
+				 * we set the transaction state (e.g., REMOTE_TRANS_SENT_COMMAND).
+				 */
+				if (!connection->remoteTransaction.beginSent)
+				{
+					connection->remoteTransaction.transactionState =
+						REMOTE_TRANS_INVALID;
+				}
+
+				break;
+			}
+
+			default:
+			{
+				break;
+			}
+		}
+	} while (connection->connectionState != currentState);
+}
+
+
+/*
+ * Activate2PCIfModifyingTransactionExpandsToNewNode sets the coordinated
+ * transaction to use 2PC under the following circumstances:
+ *     - We're already in a transaction block
+ *     - At least one of the previous commands in the transaction block
+ *       made a modification, which have not set 2PC itself because it
+ *       was a single shard command
+ *     - The input "session" is used for a distributed execution which
+ *       modifies the database. However, the session (and hence the
+ *       connection) is established to a different worker than the ones
+ *       that is used previously in the transaction.
+ *
+ *  To give an example,
+ *      BEGIN;
+ *          -- assume that the following INSERT goes to worker-A
+ *          -- also note that this single command does not activate
+ *          -- 2PC itself since it is a single shard mofication
+ *          INSERT INTO distributed_table (dist_key) VALUES (1);
+ *
+ *          -- do one more single shard UPDATE hitting the same
+ *          shard (or worker node in general)
+ *          -- this wouldn't activate 2PC, since we're operating on the
+ *          -- same worker node that we've modified earlier
+ *          -- so the executor would use the same connection
+ *			UPDATE distributed_table SET value = 10 WHERE dist_key = 1;
+ *
+ *          -- now, do one more INSERT, which goes to worker-B
+ *          -- At this point, this function would activate 2PC
+ *          -- since we're now expanding to a new node
+ *          -- for example, if this command were a SELECT, we wouldn't
+ *          -- activate 2PC since we're only interested in modifications/DDLs
+ *          INSERT INTO distributed_table (dist_key) VALUES (2);
+ */
+static void
+Activate2PCIfModifyingTransactionExpandsToNewNode(WorkerSession *session)
+{
+	DistributedExecution *execution = NULL;
+
+	if (MultiShardCommitProtocol != COMMIT_PROTOCOL_2PC)
+	{
+		/* we don't need 2PC, so no need to continue */
+		return;
+	}
+
+	execution = session->workerPool->distributedExecution;
+	if (TransactionModifiedDistributedTable(execution) &&
+		DistributedExecutionModifiesDatabase(execution) &&
+		!ConnectionModifiedPlacement(session->connection))
+	{
+		/*
+		 * We already did a modification, but not on the connection that we
+		 * just opened, which means we're now going to make modifications
+		 * over multiple connections. Activate 2PC!
+		 */
+		CoordinatedTransactionUse2PC();
+	}
+}
+
+
+/*
+ * TransactionModifiedDistributedTable returns true if the current transaction already
+ * executed a command which modified at least one distributed table in the current
+ * transaction.
+ */
+static bool
+TransactionModifiedDistributedTable(DistributedExecution *execution)
+{
+	/*
+	 * We need to explicitly check for isTransaction due to
+	 * citus.function_opens_transaction_block flag. When set to false, we
+	 * should not be pretending that we're in a coordinated transaction even
+	 * if XACT_MODIFICATION_DATA is set. That's why we implemented this workaround.
+	 */
+	return execution->isTransaction && XactModificationLevel == XACT_MODIFICATION_DATA;
+}
+
+
+/*
+ * TransactionStateMachine manages the execution of tasks over a connection.
+ */
+static void
+TransactionStateMachine(WorkerSession *session)
+{
+	WorkerPool *workerPool = session->workerPool;
+	DistributedExecution *execution = workerPool->distributedExecution;
+
+	MultiConnection *connection = session->connection;
+	RemoteTransaction *transaction = &(connection->remoteTransaction);
+	RemoteTransactionState currentState;
+
+	do {
+		currentState = transaction->transactionState;
+
+		if (!CheckConnectionReady(session))
+		{
+			/* connection is busy, no state transitions to make */
+			break;
+		}
 
 		switch (currentState)
 		{
-			case MULTI_CONNECTION_INITIAL:
+			case REMOTE_TRANS_INVALID:
 			{
-				/* simply iterate the state machine */
-				connection->connectionState = MULTI_CONNECTION_CONNECTING;
+				if (execution->isTransaction)
+				{
+					/* if we're expanding the nodes in a transaction, use 2PC */
+					Activate2PCIfModifyingTransactionExpandsToNewNode(session);
+
+					/* need to open a transaction block first */
+					StartRemoteTransactionBegin(connection);
+
+					transaction->transactionState = REMOTE_TRANS_CLEARING_RESULTS;
+				}
+				else
+				{
+					TaskPlacementExecution *placementExecution = NULL;
+
+					placementExecution = PopPlacementExecution(session);
+					if (placementExecution == NULL)
+					{
+						/*
+						 * No tasks are ready to be executed at the moment. But we
+						 * still mark the socket readable to get any notices if exists.
+						 */
+						UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
+
+						break;
+					}
+
+					StartPlacementExecutionOnSession(placementExecution, session);
+					transaction->transactionState = REMOTE_TRANS_SENT_COMMAND;
+				}
+
+				UpdateConnectionWaitFlags(session,
+										  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
 				break;
 			}
 
-			case MULTI_CONNECTION_CONNECTING:
+			case REMOTE_TRANS_SENT_BEGIN:
+			case REMOTE_TRANS_CLEARING_RESULTS:
 			{
-				PostgresPollingStatusType pollMode;
+				PGresult *result = NULL;
 
-				ConnStatusType status = PQstatus(connection->pgConn);
-				if (status == CONNECTION_OK)
+				result = PQgetResult(connection->pgConn);
+				if (result != NULL)
 				{
-					ereport(DEBUG4, (errmsg("established connection to %s:%d for "
-											"session %ld",
-											connection->hostname, connection->port,
-											session->sessionId)));
+					if (!IsResponseOK(result))
+					{
+						/* query failures are always hard errors */
+						ReportResultError(connection, result, ERROR);
+					}
 
-					workerPool->activeConnectionCount++;
-					workerPool->idleConnectionCount++;
+					PQclear(result);
 
+					/* wake up WaitEventSetWait */
 					UpdateConnectionWaitFlags(session,
 											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
 
-					connection->connectionState = MULTI_CONNECTION_CONNECTED;
-					break;
-				}
-				else if (status == CONNECTION_BAD)
-				{
-					connection->connectionState = MULTI_CONNECTION_FAILED;
 					break;
 				}
 
-				pollMode = PQconnectPoll(connection->pgConn);
-				if (pollMode == PGRES_POLLING_FAILED)
-				{
-					connection->connectionState = MULTI_CONNECTION_FAILED;
-				}
-				else if (pollMode == PGRES_POLLING_READING)
-				{
-					UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
-				}
-				else if (pollMode == PGRES_POLLING_WRITING)
-				{
-					UpdateConnectionWaitFlags(session, WL_SOCKET_WRITEABLE);
-				}
-				else
+				if (session->currentTask != NULL)
 				{
-					ereport(DEBUG4, (errmsg("established connection to %s:%d for "
-											"session %ld",
-											connection->hostname, connection->port,
-											session->sessionId)));
+					TaskPlacementExecution *placementExecution = session->currentTask;
 
-					workerPool->activeConnectionCount++;
-					workerPool->idleConnectionCount++;
+					/*
+					 * A cancelled command only counts as a successful execution
+					 * if it completed before the cancellation took effect.
+					 */
+					bool succeeded = !placementExecution->cancelled ||
+									 placementExecution->completed;
 
-					UpdateConnectionWaitFlags(session,
-											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+					/*
+					 * Once we finished a task on a connection, we no longer
+					 * allow that connection to fail.
+					 */
+					MarkRemoteTransactionCritical(connection);
 
-					connection->connectionState = MULTI_CONNECTION_CONNECTED;
+					session->currentTask = NULL;
+
+					PlacementExecutionDone(placementExecution, succeeded);
+
+					/*
+					 * The connection is ready to use for executing commands, unless
+					 * we sent a cancellation request over it, in which case it is
+					 * closed by CloseCancelledSessions.
+					 */
+					if (!session->cancelRequested)
+					{
+						workerPool->idleConnectionCount++;
+					}
 				}
 
-				break;
-			}
+				/* connection needs to be writeable to send next command */
+				UpdateConnectionWaitFlags(session,
+										  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
 
-			case MULTI_CONNECTION_CONNECTED:
-			{
-				/* connection is ready, run the transaction state machine */
-				TransactionStateMachine(session);
+				if (execution->isTransaction)
+				{
+					transaction->transactionState = REMOTE_TRANS_STARTED;
+				}
+				else
+				{
+					transaction->transactionState = REMOTE_TRANS_INVALID;
+				}
 				break;
 			}
 
-			case MULTI_CONNECTION_LOST:
+			case REMOTE_TRANS_STARTED:
 			{
-				/* managed to connect, but connection was lost */
-				workerPool->activeConnectionCount--;
+				TaskPlacementExecution *placementExecution = NULL;
 
-				if (session->currentTask == NULL)
+				placementExecution = PopPlacementExecution(session);
+				if (placementExecution == NULL)
 				{
-					/* this was an idle connection */
-					workerPool->idleConnectionCount--;
+					/* no tasks are ready to be executed at the moment */
+					UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
+					break;
 				}
 
-				connection->connectionState = MULTI_CONNECTION_FAILED;
+				StartPlacementExecutionOnSession(placementExecution, session);
+				transaction->transactionState = REMOTE_TRANS_SENT_COMMAND;
 				break;
 			}
 
-			case MULTI_CONNECTION_FAILED:
+			case REMOTE_TRANS_SENT_COMMAND:
 			{
-				/* connection failed or was lost */
-				int totalConnectionCount = list_length(workerPool->sessionList);
-
-				workerPool->failedConnectionCount++;
-
-				/* if the connection executed a critical command it should fail */
-				MarkRemoteTransactionFailed(connection, false);
-
-				/* mark all assigned placement executions as failed */
-				WorkerSessionFailed(session);
+				bool fetchDone = false;
+				TaskPlacementExecution *placementExecution = session->currentTask;
+				ShardCommandExecution *shardCommandExecution =
+					placementExecution->shardCommandExecution;
+				bool storeRows = shardCommandExecution->expectResults;
 
-				if (workerPool->failedConnectionCount >= totalConnectionCount)
+				if (session->deallocatingStatements)
 				{
-					/*
-					 * All current connection attempts have failed.
-					 * Mark all unassigned placement executions as failed.
-					 *
-					 * We do not currently retry if the first connection
-					 * attempt fails.
-					 */
-					WorkerPoolFailed(workerPool);
+					if (!FinishDeallocatingStatements(session) ||
+						!placementExecution->cancelled)
+					{
+						/* wait for the deallocate or the query to return */
+						break;
+					}
 				}
 
-				/*
-				 * The execution may have failed as a result of WorkerSessionFailed
-				 * or WorkerPoolFailed.
-				 */
-				if (execution->failed || execution->errorOnAnyFailure)
+				if (session->preparingStatementName != NULL)
 				{
-					/* a task has failed due to this connection failure */
-					ReportConnectionError(connection, ERROR);
+					if (!FinishPreparingStatement(session) ||
+						!placementExecution->cancelled)
+					{
+						/* wait for the prepare or the execute to return */
+						break;
+					}
 				}
-				else
+
+				if (shardCommandExecution->firstRespondingPlacementExecution == NULL)
 				{
-					/* can continue with the remaining nodes */
-					ReportConnectionError(connection, WARNING);
+					/* the connection is ready, so the worker started responding */
+					shardCommandExecution->firstRespondingPlacementExecution =
+						placementExecution;
+
+					if (shardCommandExecution->hedged)
+					{
+						CancelRedundantPlacementExecutions(placementExecution);
+					}
 				}
 
-				/* remove the connection */
-				UnclaimConnection(connection);
+				if (shardCommandExecution->gotResults || placementExecution->cancelled)
+				{
+					/* already received results from another replica */
+					storeRows = false;
+				}
 
-				/*
-				 * We forcefully close the underlying libpq connection because
-				 * we don't want any subsequent execution (either subPlan executions
-				 * or new command executions within a transaction block) use the
-				 * connection.
-				 *
-				 * However, we prefer to keep the MultiConnection around until
-				 * the end of FinishDistributedExecution() to simplify the code.
-				 * Thus, we prefer ShutdownConnection() over CloseConnection().
-				 */
-				ShutdownConnection(connection);
+				fetchDone = ReceiveResults(session, storeRows);
+				if (!fetchDone)
+				{
+					break;
+				}
 
-				/* remove connection from wait event set */
-				execution->connectionSetChanged = true;
+				shardCommandExecution->gotResults = true;
 
-				/*
-				 * Reset the transaction state machine since CloseConnection()
-				 * relies on it and even if we're not inside a distributed transaction
-				 * we set the transaction state (e.g., REMOTE_TRANS_SENT_COMMAND).
-				 */
-				if (!connection->remoteTransaction.beginSent)
+				if (session->pipelinedTaskList != NIL)
 				{
-					connection->remoteTransaction.transactionState =
-						REMOTE_TRANS_INVALID;
+					bool succeeded = !placementExecution->cancelled ||
+									 placementExecution->completed;
+
+					MarkRemoteTransactionCritical(connection);
+
+					/* the results of the next task in the command follow */
+					session->currentTask = linitial(session->pipelinedTaskList);
+					session->pipelinedTaskList =
+						list_delete_first(session->pipelinedTaskList);
+
+					PlacementExecutionDone(placementExecution, succeeded);
+
+					/* results may already be buffered, wake up WaitEventSetWait */
+					UpdateConnectionWaitFlags(session,
+											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+					break;
 				}
 
+				transaction->transactionState = REMOTE_TRANS_CLEARING_RESULTS;
 				break;
 			}
 
@@ -2292,499 +4275,648 @@ ConnectionStateMachine(WorkerSession *session)
 				break;
 			}
 		}
-	} while (connection->connectionState != currentState);
+	}
+
+	/* iterate in case we can perform multiple transitions at once */
+	while (transaction->transactionState != currentState);
 }
 
 
 /*
- * Activate2PCIfModifyingTransactionExpandsToNewNode sets the coordinated
- * transaction to use 2PC under the following circumstances:
- *     - We're already in a transaction block
- *     - At least one of the previous commands in the transaction block
- *       made a modification, which have not set 2PC itself because it
- *       was a single shard command
- *     - The input "session" is used for a distributed execution which
- *       modifies the database. However, the session (and hence the
- *       connection) is established to a different worker than the ones
- *       that is used previously in the transaction.
- *
- *  To give an example,
- *      BEGIN;
- *          -- assume that the following INSERT goes to worker-A
- *          -- also note that this single command does not activate
- *          -- 2PC itself since it is a single shard mofication
- *          INSERT INTO distributed_table (dist_key) VALUES (1);
- *
- *          -- do one more single shard UPDATE hitting the same
- *          shard (or worker node in general)
- *          -- this wouldn't activate 2PC, since we're operating on the
- *          -- same worker node that we've modified earlier
- *          -- so the executor would use the same connection
- *			UPDATE distributed_table SET value = 10 WHERE dist_key = 1;
+ * UpdateConnectionWaitFlags is a wrapper around setting waitFlags of the connection.
  *
- *          -- now, do one more INSERT, which goes to worker-B
- *          -- At this point, this function would activate 2PC
- *          -- since we're now expanding to a new node
- *          -- for example, if this command were a SELECT, we wouldn't
- *          -- activate 2PC since we're only interested in modifications/DDLs
- *          INSERT INTO distributed_table (dist_key) VALUES (2);
+ * This function might further improved in a sense that to use use ModifyWaitEvent on
+ * waitFlag changes as opposed to what we do now: always rebuild the wait event sets.
+ * Our initial benchmarks didn't show any significant performance improvements, but
+ * good to keep in mind the potential improvements.
  */
 static void
-Activate2PCIfModifyingTransactionExpandsToNewNode(WorkerSession *session)
+UpdateConnectionWaitFlags(WorkerSession *session, int waitFlags)
 {
-	DistributedExecution *execution = NULL;
+	MultiConnection *connection = session->connection;
+	DistributedExecution *execution = session->workerPool->distributedExecution;
 
-	if (MultiShardCommitProtocol != COMMIT_PROTOCOL_2PC)
+	/* do not take any actions if the flags not changed */
+	if (connection->waitFlags == waitFlags)
 	{
-		/* we don't need 2PC, so no need to continue */
 		return;
 	}
 
-	execution = session->workerPool->distributedExecution;
-	if (TransactionModifiedDistributedTable(execution) &&
-		DistributedExecutionModifiesDatabase(execution) &&
-		!ConnectionModifiedPlacement(session->connection))
-	{
-		/*
-		 * We already did a modification, but not on the connection that we
-		 * just opened, which means we're now going to make modifications
-		 * over multiple connections. Activate 2PC!
-		 */
-		CoordinatedTransactionUse2PC();
-	}
+	connection->waitFlags = waitFlags;
+
+	/* without signalling the execution, the flag changes won't be reflected */
+	execution->waitFlagsChanged = true;
 }
 
 
 /*
- * TransactionModifiedDistributedTable returns true if the current transaction already
- * executed a command which modified at least one distributed table in the current
- * transaction.
+ * CheckConnectionReady returns true if the the connection is ready to
+ * read or write, or false if it still has bytes to send/receive.
  */
 static bool
-TransactionModifiedDistributedTable(DistributedExecution *execution)
+CheckConnectionReady(WorkerSession *session)
 {
-	/*
-	 * We need to explicitly check for isTransaction due to
-	 * citus.function_opens_transaction_block flag. When set to false, we
-	 * should not be pretending that we're in a coordinated transaction even
-	 * if XACT_MODIFICATION_DATA is set. That's why we implemented this workaround.
-	 */
-	return execution->isTransaction && XactModificationLevel == XACT_MODIFICATION_DATA;
+	int sendStatus = 0;
+	MultiConnection *connection = session->connection;
+	int waitFlags = WL_SOCKET_READABLE;
+	bool connectionReady = false;
+
+	ConnStatusType status = PQstatus(connection->pgConn);
+	if (status == CONNECTION_BAD)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return false;
+	}
+
+	/* try to send all pending data */
+	sendStatus = PQflush(connection->pgConn);
+	if (sendStatus == -1)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return false;
+	}
+	else if (sendStatus == 1)
+	{
+		/* more data to send, wait for socket to become writable */
+		waitFlags = waitFlags | WL_SOCKET_WRITEABLE;
+	}
+
+	if ((session->latestUnconsumedWaitEvents & WL_SOCKET_READABLE) != 0)
+	{
+		if (PQconsumeInput(connection->pgConn) == 0)
+		{
+			connection->connectionState = MULTI_CONNECTION_LOST;
+			return false;
+		}
+	}
+
+	if (!PQisBusy(connection->pgConn))
+	{
+		connectionReady = true;
+	}
+
+	UpdateConnectionWaitFlags(session, waitFlags);
+
+	/* don't consume input redundantly if we cycle back into CheckConnectionReady */
+	session->latestUnconsumedWaitEvents = 0;
+
+	return connectionReady;
 }
 
 
 /*
- * TransactionStateMachine manages the execution of tasks over a connection.
+ * PopPlacementExecution returns the next available assigned or unassigned
+ * placement execution for the given session.
  */
-static void
-TransactionStateMachine(WorkerSession *session)
+static TaskPlacementExecution *
+PopPlacementExecution(WorkerSession *session)
 {
+	TaskPlacementExecution *placementExecution = NULL;
 	WorkerPool *workerPool = session->workerPool;
-	DistributedExecution *execution = workerPool->distributedExecution;
-
-	MultiConnection *connection = session->connection;
-	RemoteTransaction *transaction = &(connection->remoteTransaction);
-	RemoteTransactionState currentState;
 
-	do {
-		currentState = transaction->transactionState;
+	if (session->cancelRequested)
+	{
+		/* the connection is about to be closed */
+		return NULL;
+	}
 
-		if (!CheckConnectionReady(session))
+	placementExecution = PopAssignedPlacementExecution(session);
+	if (placementExecution == NULL)
+	{
+		if (session->commandsSent > 0 && UseConnectionPerPlacement())
 		{
-			/* connection is busy, no state transitions to make */
-			break;
+			/*
+			 * Only send one command per connection if force_max_query_parallelisation
+			 * is enabled, unless it's an assigned placement execution.
+			 */
+			return NULL;
 		}
 
-		switch (currentState)
-		{
-			case REMOTE_TRANS_INVALID:
-			{
-				if (execution->isTransaction)
-				{
-					/* if we're expanding the nodes in a transaction, use 2PC */
-					Activate2PCIfModifyingTransactionExpandsToNewNode(session);
+		/* no more assigned tasks, pick an unassigned task */
+		placementExecution = PopUnassignedPlacementExecution(workerPool);
+	}
 
-					/* need to open a transaction block first */
-					StartRemoteTransactionBegin(connection);
+	return placementExecution;
+}
 
-					transaction->transactionState = REMOTE_TRANS_CLEARING_RESULTS;
-				}
-				else
-				{
-					TaskPlacementExecution *placementExecution = NULL;
 
-					placementExecution = PopPlacementExecution(session);
-					if (placementExecution == NULL)
-					{
-						/*
-						 * No tasks are ready to be executed at the moment. But we
-						 * still mark the socket readable to get any notices if exists.
-						 */
-						UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
+/*
+ * PopAssignedPlacementExecution finds an executable task from the queue of assigned tasks.
+ */
+static TaskPlacementExecution *
+PopAssignedPlacementExecution(WorkerSession *session)
+{
+	TaskPlacementExecution *placementExecution = NULL;
+	dlist_head *readyTaskQueue = &(session->readyTaskQueue);
 
-						break;
-					}
+	if (dlist_is_empty(readyTaskQueue))
+	{
+		return NULL;
+	}
 
-					StartPlacementExecutionOnSession(placementExecution, session);
-					transaction->transactionState = REMOTE_TRANS_SENT_COMMAND;
-				}
+	placementExecution = dlist_container(TaskPlacementExecution,
+										 sessionReadyQueueNode,
+										 dlist_pop_head_node(readyTaskQueue));
 
-				UpdateConnectionWaitFlags(session,
-										  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
-				break;
-			}
+	return placementExecution;
+}
+
+
+/*
+ * PopAssignedPlacementExecution finds an executable task from the queue of assigned tasks.
+ */
+static TaskPlacementExecution *
+PopUnassignedPlacementExecution(WorkerPool *workerPool)
+{
+	TaskPlacementExecution *placementExecution = NULL;
+	dlist_head *readyTaskQueue = &(workerPool->readyTaskQueue);
+
+	if (dlist_is_empty(readyTaskQueue))
+	{
+		return NULL;
+	}
+
+	placementExecution = dlist_container(TaskPlacementExecution,
+										 workerReadyQueueNode,
+										 dlist_pop_head_node(readyTaskQueue));
+
+	workerPool->readyTaskCount--;
+
+	return placementExecution;
+}
 
-			case REMOTE_TRANS_SENT_BEGIN:
-			case REMOTE_TRANS_CLEARING_RESULTS:
-			{
-				PGresult *result = NULL;
 
-				result = PQgetResult(connection->pgConn);
-				if (result != NULL)
-				{
-					if (!IsResponseOK(result))
-					{
-						/* query failures are always hard errors */
-						ReportResultError(connection, result, ERROR);
-					}
+/*
+ * StartPlacementExecutionOnSession gets a TaskPlacementExecition and
+ * WorkerSession, the task's query is sent to the worker via the session.
+ *
+ * The function does some bookkeeping such as associating the placement
+ * accesses with the connection and updating session's local variables. For
+ * details read the comments in the function.
+ *
+ * The function returns true if the query is successfully sent over the
+ * connection, otherwise false.
+ */
+static bool
+StartPlacementExecutionOnSession(TaskPlacementExecution *placementExecution,
+								 WorkerSession *session)
+{
+	WorkerPool *workerPool = session->workerPool;
+	DistributedExecution *execution = workerPool->distributedExecution;
+	ParamListInfo paramListInfo = execution->paramListInfo;
+	MultiConnection *connection = session->connection;
+	ShardCommandExecution *shardCommandExecution =
+		placementExecution->shardCommandExecution;
+	Task *task = shardCommandExecution->task;
+	ShardPlacement *taskPlacement = placementExecution->shardPlacement;
+	List *placementAccessList = PlacementAccessListForTask(task, taskPlacement);
+	char *queryString = task->queryString;
+	int querySent = 0;
+	bool taskQueryDeferred = false;
+	List *pipelinedPlacementExecutionList = NIL;
+	ListCell *placementExecutionCell = NULL;
+	int singleRowMode = 0;
 
-					PQclear(result);
+	/*
+	 * Make sure that subsequent commands on the same placement
+	 * use the same connection.
+	 */
+	AssignPlacementListToConnection(placementAccessList, connection);
 
-					/* wake up WaitEventSetWait */
-					UpdateConnectionWaitFlags(session,
-											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+	/* one more command is sent over the session */
+	session->commandsSent++;
 
-					break;
-				}
+	if (session->commandsSent == 1)
+	{
+		/* first time we send a command, consider the connection used (not unused) */
+		workerPool->unusedConnectionCount--;
+	}
 
-				if (session->currentTask != NULL)
-				{
-					TaskPlacementExecution *placementExecution = session->currentTask;
-					bool succeeded = true;
+	/* connection is going to be in use */
+	workerPool->idleConnectionCount--;
 
-					/*
-					 * Once we finished a task on a connection, we no longer
-					 * allow that connection to fail.
-					 */
-					MarkRemoteTransactionCritical(connection);
+	if (paramListInfo != NULL)
+	{
+		char *deallocateCommand = NULL;
 
-					session->currentTask = NULL;
+		/* force evaluation of bound params */
+		paramListInfo = copyParamList(paramListInfo);
 
-					PlacementExecutionDone(placementExecution, succeeded);
+		session->taskParameterCount = paramListInfo->numParams;
+		ExtractParametersFromParamListInfo(paramListInfo,
+										   &session->taskParameterTypes,
+										   &session->taskParameterValues);
 
-					/* connection is ready to use for executing commands */
-					workerPool->idleConnectionCount++;
-				}
+		/* do not leave statements behind that we will no longer use */
+		deallocateCommand = DeallocateInvalidatedStatementsCommand(connection);
+		if (deallocateCommand != NULL)
+		{
+			/* the query is sent once the worker deallocated the statements */
+			querySent = SendRemoteCommand(connection, deallocateCommand);
+			session->deallocatingStatements = true;
+		}
+		else
+		{
+			querySent = SendParameterizedTaskQuery(session, queryString);
+		}
 
-				/* connection needs to be writeable to send next command */
-				UpdateConnectionWaitFlags(session,
-										  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+		taskQueryDeferred = session->deallocatingStatements ||
+							session->preparingStatementName != NULL;
+	}
+	else if (execution->binaryResults)
+	{
+		/* binary results can only be requested via the extended protocol */
+		querySent = SendRemoteCommandParams(connection, queryString, 0, NULL, NULL,
+											true);
+	}
+	else
+	{
+		if (ShouldPipelinePlacementExecutions(execution))
+		{
+			pipelinedPlacementExecutionList = PopPipelinedPlacementExecutions(session);
+			queryString = PipelinedQueryString(queryString,
+											   pipelinedPlacementExecutionList);
 
-				if (execution->isTransaction)
-				{
-					transaction->transactionState = REMOTE_TRANS_STARTED;
-				}
-				else
-				{
-					transaction->transactionState = REMOTE_TRANS_INVALID;
-				}
-				break;
-			}
+			execution->pipelinedCommandCount++;
+			execution->pipelinedTaskCount +=
+				list_length(pipelinedPlacementExecutionList) + 1;
+		}
 
-			case REMOTE_TRANS_STARTED:
-			{
-				TaskPlacementExecution *placementExecution = NULL;
+		querySent = SendRemoteCommand(connection, queryString);
+	}
 
-				placementExecution = PopPlacementExecution(session);
-				if (placementExecution == NULL)
-				{
-					/* no tasks are ready to be executed at the moment */
-					UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE);
-					break;
-				}
+	/* do the bookkeeping for the tasks sent along with the first one */
+	foreach(placementExecutionCell, pipelinedPlacementExecutionList)
+	{
+		TaskPlacementExecution *pipelinedPlacementExecution =
+			lfirst(placementExecutionCell);
+		Task *pipelinedTask = pipelinedPlacementExecution->shardCommandExecution->task;
+		List *pipelinedPlacementAccessList =
+			PlacementAccessListForTask(pipelinedTask,
+									   pipelinedPlacementExecution->shardPlacement);
 
-				StartPlacementExecutionOnSession(placementExecution, session);
-				transaction->transactionState = REMOTE_TRANS_SENT_COMMAND;
-				break;
-			}
+		AssignPlacementListToConnection(pipelinedPlacementAccessList, connection);
 
-			case REMOTE_TRANS_SENT_COMMAND:
-			{
-				bool fetchDone = false;
-				TaskPlacementExecution *placementExecution = session->currentTask;
-				ShardCommandExecution *shardCommandExecution =
-					placementExecution->shardCommandExecution;
-				bool storeRows = shardCommandExecution->expectResults;
+		session->commandsSent++;
 
-				if (shardCommandExecution->gotResults)
-				{
-					/* already received results from another replica */
-					storeRows = false;
-				}
+		pipelinedPlacementExecution->executionState = PLACEMENT_EXECUTION_RUNNING;
+		pipelinedPlacementExecution->startTime = GetCurrentTimestamp();
+	}
 
-				fetchDone = ReceiveResults(session, storeRows);
-				if (!fetchDone)
-				{
-					break;
-				}
+	session->pipelinedTaskList = pipelinedPlacementExecutionList;
 
-				shardCommandExecution->gotResults = true;
-				transaction->transactionState = REMOTE_TRANS_CLEARING_RESULTS;
-				break;
-			}
+	if (querySent == 0)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return false;
+	}
 
-			default:
-			{
-				break;
-			}
+	/*
+	 * A deallocate or prepare does not return rows, single-row mode is enabled
+	 * when the query of the task is sent.
+	 */
+	if (!taskQueryDeferred)
+	{
+		singleRowMode = PQsetSingleRowMode(connection->pgConn);
+		if (singleRowMode == 0)
+		{
+			connection->connectionState = MULTI_CONNECTION_LOST;
+			return false;
 		}
 	}
 
-	/* iterate in case we can perform multiple transitions at once */
-	while (transaction->transactionState != currentState);
+	session->currentTask = placementExecution;
+	placementExecution->executionState = PLACEMENT_EXECUTION_RUNNING;
+	placementExecution->startTime = GetCurrentTimestamp();
+
+	return true;
 }
 
 
 /*
- * UpdateConnectionWaitFlags is a wrapper around setting waitFlags of the connection.
- *
- * This function might further improved in a sense that to use use ModifyWaitEvent on
- * waitFlag changes as opposed to what we do now: always rebuild the wait event sets.
- * Our initial benchmarks didn't show any significant performance improvements, but
- * good to keep in mind the potential improvements.
+ * SendParameterizedTaskQuery sends the given parameterized query of the
+ * current task of the session with the parameters stored in the session. If
+ * the query can be prepared on the connection, the statement is prepared
+ * first and executed by FinishPreparingStatement.
  */
-static void
-UpdateConnectionWaitFlags(WorkerSession *session, int waitFlags)
+static int
+SendParameterizedTaskQuery(WorkerSession *session, char *queryString)
 {
 	MultiConnection *connection = session->connection;
 	DistributedExecution *execution = session->workerPool->distributedExecution;
+	int parameterCount = session->taskParameterCount;
+	Oid *parameterTypes = session->taskParameterTypes;
+	const char **parameterValues = session->taskParameterValues;
+	char *statementName = NULL;
 
-	/* do not take any actions if the flags not changed */
-	if (connection->waitFlags == waitFlags)
+	if (MaxPreparedStatementsPerConnection > 0)
 	{
-		return;
+		statementName = LookupPreparedStatement(connection, queryString,
+												parameterCount, parameterTypes);
+		if (statementName == NULL && CanPrepareStatement(connection))
+		{
+			/* the statement is executed once the worker prepared it */
+			statementName = NewPreparedStatementName(connection);
+			session->preparingStatementName = statementName;
+
+			return SendRemotePrepare(connection, statementName, queryString,
+									 parameterCount, parameterTypes);
+		}
 	}
 
-	connection->waitFlags = waitFlags;
+	if (statementName != NULL)
+	{
+		return SendRemotePreparedCommand(connection, statementName, parameterCount,
+										 parameterValues, execution->binaryResults);
+	}
 
-	/* without signalling the execution, the flag changes won't be reflected */
-	execution->waitFlagsChanged = true;
+	return SendRemoteCommandParams(connection, queryString, parameterCount,
+								   parameterTypes, parameterValues,
+								   execution->binaryResults);
 }
 
 
 /*
- * CheckConnectionReady returns true if the the connection is ready to
- * read or write, or false if it still has bytes to send/receive.
+ * FinishDeallocatingStatements consumes the response to the deallocation of
+ * invalidated statements that was sent ahead of the current task of the
+ * session and then sends the query of the task.
+ *
+ * The function returns false if the worker did not finish deallocating the
+ * statements yet. If the task was cancelled in the meantime, the query is
+ * not sent.
  */
 static bool
-CheckConnectionReady(WorkerSession *session)
+FinishDeallocatingStatements(WorkerSession *session)
 {
-	int sendStatus = 0;
 	MultiConnection *connection = session->connection;
-	int waitFlags = WL_SOCKET_READABLE;
-	bool connectionReady = false;
+	TaskPlacementExecution *placementExecution = session->currentTask;
+	Task *task = placementExecution->shardCommandExecution->task;
+	int querySent = 0;
 
-	ConnStatusType status = PQstatus(connection->pgConn);
-	if (status == CONNECTION_BAD)
+	if (!ConsumeDeferredCommandResults(session))
 	{
-		connection->connectionState = MULTI_CONNECTION_LOST;
+		/* wait for the rest of the response */
 		return false;
 	}
 
-	/* try to send all pending data */
-	sendStatus = PQflush(connection->pgConn);
-	if (sendStatus == -1)
+	session->deallocatingStatements = false;
+
+	if (placementExecution->cancelled)
+	{
+		return true;
+	}
+
+	querySent = SendParameterizedTaskQuery(session, task->queryString);
+	if (querySent == 0)
 	{
 		connection->connectionState = MULTI_CONNECTION_LOST;
-		return false;
+		return true;
 	}
-	else if (sendStatus == 1)
+
+	if (session->preparingStatementName == NULL &&
+		PQsetSingleRowMode(connection->pgConn) == 0)
 	{
-		/* more data to send, wait for socket to become writable */
-		waitFlags = waitFlags | WL_SOCKET_WRITEABLE;
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return true;
 	}
 
-	if ((session->latestUnconsumedWaitEvents & WL_SOCKET_READABLE) != 0)
+	UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+
+	return true;
+}
+
+
+/*
+ * FinishPreparingStatement consumes the response to the prepare that was sent
+ * for the current task of the session and, once the worker prepared the
+ * statement, executes the statement with the parameters of the task.
+ *
+ * The function returns false if the worker did not finish preparing the
+ * statement yet. If the task was cancelled in the meantime, the statement is
+ * not executed.
+ */
+static bool
+FinishPreparingStatement(WorkerSession *session)
+{
+	MultiConnection *connection = session->connection;
+	TaskPlacementExecution *placementExecution = session->currentTask;
+	Task *task = placementExecution->shardCommandExecution->task;
+	DistributedExecution *execution = session->workerPool->distributedExecution;
+	char *statementName = session->preparingStatementName;
+	int querySent = 0;
+
+	if (!ConsumeDeferredCommandResults(session))
 	{
-		if (PQconsumeInput(connection->pgConn) == 0)
-		{
-			connection->connectionState = MULTI_CONNECTION_LOST;
-			return false;
-		}
+		/* wait for the rest of the response */
+		return false;
 	}
 
-	if (!PQisBusy(connection->pgConn))
+	session->preparingStatementName = NULL;
+
+	if (placementExecution->cancelled)
 	{
-		connectionReady = true;
+		return true;
 	}
 
-	UpdateConnectionWaitFlags(session, waitFlags);
+	RememberPreparedStatement(connection, statementName, task->queryString,
+							  session->taskParameterCount,
+							  session->taskParameterTypes,
+							  TaskRelationIdList(task));
 
-	/* don't consume input redundantly if we cycle back into CheckConnectionReady */
-	session->latestUnconsumedWaitEvents = 0;
+	querySent = SendRemotePreparedCommand(connection, statementName,
+										  session->taskParameterCount,
+										  session->taskParameterValues,
+										  execution->binaryResults);
+	if (querySent == 0)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return true;
+	}
 
-	return connectionReady;
+	if (PQsetSingleRowMode(connection->pgConn) == 0)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return true;
+	}
+
+	UpdateConnectionWaitFlags(session, WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+
+	return true;
 }
 
 
 /*
- * PopPlacementExecution returns the next available assigned or unassigned
- * placement execution for the given session.
- */
-static TaskPlacementExecution *
-PopPlacementExecution(WorkerSession *session)
+ * ConsumeDeferredCommandResults consumes the results of the deallocate or
+ * prepare command that was sent ahead of the query of the current task of the
+ * session, and returns whether all results were received. Failures are hard
+ * errors, unless the task was cancelled.
+ */
+static bool
+ConsumeDeferredCommandResults(WorkerSession *session)
 {
-	TaskPlacementExecution *placementExecution = NULL;
-	WorkerPool *workerPool = session->workerPool;
+	MultiConnection *connection = session->connection;
+	TaskPlacementExecution *placementExecution = session->currentTask;
 
-	placementExecution = PopAssignedPlacementExecution(session);
-	if (placementExecution == NULL)
+	while (!PQisBusy(connection->pgConn))
 	{
-		if (session->commandsSent > 0 && UseConnectionPerPlacement())
+		PGresult *result = PQgetResult(connection->pgConn);
+		if (result == NULL)
 		{
-			/*
-			 * Only send one command per connection if force_max_query_parallelisation
-			 * is enabled, unless it's an assigned placement execution.
-			 */
-			return NULL;
+			return true;
 		}
 
-		/* no more assigned tasks, pick an unassigned task */
-		placementExecution = PopUnassignedPlacementExecution(workerPool);
+		if (!IsResponseOK(result) && !placementExecution->cancelled)
+		{
+			ReportResultError(connection, result, ERROR);
+		}
+
+		PQclear(result);
 	}
 
-	return placementExecution;
+	return false;
 }
 
 
 /*
- * PopAssignedPlacementExecution finds an executable task from the queue of assigned tasks.
+ * TaskRelationIdList returns the distributed tables accessed by the given
+ * task.
  */
-static TaskPlacementExecution *
-PopAssignedPlacementExecution(WorkerSession *session)
+static List *
+TaskRelationIdList(Task *task)
 {
-	TaskPlacementExecution *placementExecution = NULL;
-	dlist_head *readyTaskQueue = &(session->readyTaskQueue);
+	List *relationIdList = NIL;
+	ListCell *relationShardCell = NULL;
 
-	if (dlist_is_empty(readyTaskQueue))
+	foreach(relationShardCell, task->relationShardList)
 	{
-		return NULL;
+		RelationShard *relationShard = (RelationShard *) lfirst(relationShardCell);
+
+		relationIdList = list_append_unique_oid(relationIdList,
+												relationShard->relationId);
 	}
 
-	placementExecution = dlist_container(TaskPlacementExecution,
-										 sessionReadyQueueNode,
-										 dlist_pop_head_node(readyTaskQueue));
+	if (relationIdList == NIL && task->anchorShardId != INVALID_SHARD_ID)
+	{
+		relationIdList = list_make1_oid(RelationIdForShard(task->anchorShardId));
+	}
 
-	return placementExecution;
+	return relationIdList;
 }
 
 
 /*
- * PopAssignedPlacementExecution finds an executable task from the queue of assigned tasks.
+ * ShouldPipelinePlacementExecutions returns true if multiple tasks of the
+ * execution may be sent in a single command over a connection.
+ *
+ * The tasks are sent as a multi-statement query, which the worker runs in a
+ * single implicit transaction when there is no transaction block and which
+ * only supports the simple query protocol. We therefore only pipeline:
+ *
+ * - read-only tasks, since a failing modification would roll back the
+ *   modifications of the earlier tasks in the same command, which already
+ *   finished as far as the executor is concerned;
+ * - tasks without parameters and with text results, since parameters and
+ *   binary results require the extended query protocol, which libpq only
+ *   allows one statement at a time for;
+ * - tasks that are not hedged, since cancelling one of them would cancel all
+ *   tasks in the same command.
+ *
+ * Pipelining is most useful when there are fewer connections than tasks,
+ * such as in sequential mode (citus.multi_shard_modify_mode), which uses a
+ * single connection per worker for read-only queries as well. On the other
+ * hand, citus.force_max_query_parallelization outside of sequential mode
+ * asks for a connection per task, so there is nothing to pipeline.
  */
-static TaskPlacementExecution *
-PopUnassignedPlacementExecution(WorkerPool *workerPool)
+static bool
+ShouldPipelinePlacementExecutions(DistributedExecution *execution)
 {
-	TaskPlacementExecution *placementExecution = NULL;
-	dlist_head *readyTaskQueue = &(workerPool->readyTaskQueue);
+	if (MaxPipelinedTasksPerConnection <= 1)
+	{
+		return false;
+	}
 
-	if (dlist_is_empty(readyTaskQueue))
+	if (execution->modLevel != ROW_MODIFY_READONLY)
 	{
-		return NULL;
+		return false;
 	}
 
-	placementExecution = dlist_container(TaskPlacementExecution,
-										 workerReadyQueueNode,
-										 dlist_pop_head_node(readyTaskQueue));
+	if (execution->paramListInfo != NULL || execution->binaryResults)
+	{
+		return false;
+	}
 
-	workerPool->readyTaskCount--;
+	if (execution->enableHedging || UseConnectionPerPlacement())
+	{
+		return false;
+	}
 
-	return placementExecution;
+	return true;
 }
 
 
 /*
- * StartPlacementExecutionOnSession gets a TaskPlacementExecition and
- * WorkerSession, the task's query is sent to the worker via the session.
- *
- * The function does some bookkeeping such as associating the placement
- * accesses with the connection and updating session's local variables. For
- * details read the comments in the function.
- *
- * The function returns true if the query is successfully sent over the
- * connection, otherwise false.
+ * PopPipelinedPlacementExecutions returns up to
+ * citus.max_pipelined_tasks_per_connection - 1 ready placement executions to
+ * send along with the current task of the session. Unassigned placement
+ * executions are only taken as long as there are more of them than idle
+ * connections that could execute them in parallel.
  */
-static bool
-StartPlacementExecutionOnSession(TaskPlacementExecution *placementExecution,
-								 WorkerSession *session)
+static List *
+PopPipelinedPlacementExecutions(WorkerSession *session)
 {
 	WorkerPool *workerPool = session->workerPool;
-	DistributedExecution *execution = workerPool->distributedExecution;
-	ParamListInfo paramListInfo = execution->paramListInfo;
-	MultiConnection *connection = session->connection;
-	ShardCommandExecution *shardCommandExecution =
-		placementExecution->shardCommandExecution;
-	Task *task = shardCommandExecution->task;
-	ShardPlacement *taskPlacement = placementExecution->shardPlacement;
-	List *placementAccessList = PlacementAccessListForTask(task, taskPlacement);
-	char *queryString = task->queryString;
-	int querySent = 0;
-	int singleRowMode = 0;
+	List *placementExecutionList = NIL;
 
-	/*
-	 * Make sure that subsequent commands on the same placement
-	 * use the same connection.
-	 */
-	AssignPlacementListToConnection(placementAccessList, connection);
+	while (list_length(placementExecutionList) + 1 < MaxPipelinedTasksPerConnection)
+	{
+		TaskPlacementExecution *placementExecution =
+			PopAssignedPlacementExecution(session);
 
-	/* one more command is sent over the session */
-	session->commandsSent++;
+		if (placementExecution == NULL &&
+			workerPool->readyTaskCount > workerPool->idleConnectionCount)
+		{
+			placementExecution = PopUnassignedPlacementExecution(workerPool);
+		}
 
-	if (session->commandsSent == 1)
-	{
-		/* first time we send a command, consider the connection used (not unused) */
-		workerPool->unusedConnectionCount--;
+		if (placementExecution == NULL)
+		{
+			break;
+		}
+
+		placementExecutionList = lappend(placementExecutionList, placementExecution);
 	}
 
-	/* connection is going to be in use */
-	workerPool->idleConnectionCount--;
+	return placementExecutionList;
+}
 
-	if (paramListInfo != NULL)
-	{
-		int parameterCount = paramListInfo->numParams;
-		Oid *parameterTypes = NULL;
-		const char **parameterValues = NULL;
 
-		/* force evaluation of bound params */
-		paramListInfo = copyParamList(paramListInfo);
+/*
+ * PipelinedQueryString returns a multi-statement query string that contains the
+ * given query string followed by the queries of the given placement executions.
+ */
+static char *
+PipelinedQueryString(char *queryString, List *placementExecutionList)
+{
+	StringInfo pipelinedQueryString = NULL;
+	ListCell *placementExecutionCell = NULL;
 
-		ExtractParametersFromParamListInfo(paramListInfo, &parameterTypes,
-										   &parameterValues);
-		querySent = SendRemoteCommandParams(connection, queryString, parameterCount,
-											parameterTypes, parameterValues);
-	}
-	else
+	if (placementExecutionList == NIL)
 	{
-		querySent = SendRemoteCommand(connection, queryString);
+		return queryString;
 	}
 
-	if (querySent == 0)
-	{
-		connection->connectionState = MULTI_CONNECTION_LOST;
-		return false;
-	}
+	pipelinedQueryString = makeStringInfo();
+	appendStringInfoString(pipelinedQueryString, queryString);
 
-	singleRowMode = PQsetSingleRowMode(connection->pgConn);
-	if (singleRowMode == 0)
+	foreach(placementExecutionCell, placementExecutionList)
 	{
-		connection->connectionState = MULTI_CONNECTION_LOST;
-		return false;
-	}
+		TaskPlacementExecution *placementExecution = lfirst(placementExecutionCell);
+		Task *task = placementExecution->shardCommandExecution->task;
 
-	session->currentTask = placementExecution;
-	placementExecution->executionState = PLACEMENT_EXECUTION_RUNNING;
+		appendStringInfo(pipelinedQueryString, ";\n%s", task->queryString);
+	}
 
-	return true;
+	return pipelinedQueryString->data;
 }
 
 
@@ -2876,24 +5008,30 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 	DistributedExecution *execution = workerPool->distributedExecution;
 	DistributedExecutionStats *executionStats = execution->executionStats;
 	TupleDesc tupleDescriptor = execution->tupleDescriptor;
-	AttInMetadata *attributeInputMetadata = NULL;
+	AttInMetadata *attributeInputMetadata = execution->attributeInputMetadata;
 	uint32 expectedColumnCount = 0;
-	char **columnArray = NULL;
+	char **columnArray = execution->columnArray;
+	BinaryResultReceiver *binaryResultReceiver = execution->binaryResultReceiver;
 	Tuplestorestate *tupleStore = execution->tupleStore;
+	MemoryContext ioContext = execution->ioContext;
+	TaskResultDestination *resultDestination =
+		session->currentTask->shardCommandExecution->resultDestination;
+
+	if (resultDestination != NULL)
+	{
+		tupleDescriptor = resultDestination->tupleDescriptor;
+		attributeInputMetadata = resultDestination->attributeInputMetadata;
+		columnArray = resultDestination->columnArray;
+		binaryResultReceiver = resultDestination->binaryResultReceiver;
+		tupleStore = resultDestination->tupleStore;
+		executionStats = resultDestination->executionStats;
+	}
 
-	MemoryContext ioContext = AllocSetContextCreate(CurrentMemoryContext,
-													"ReceiveResults",
-													ALLOCSET_DEFAULT_MINSIZE,
-													ALLOCSET_DEFAULT_INITSIZE,
-													ALLOCSET_DEFAULT_MAXSIZE);
 	if (tupleDescriptor != NULL)
 	{
-		attributeInputMetadata = TupleDescGetAttInMetadata(tupleDescriptor);
 		expectedColumnCount = tupleDescriptor->natts;
-		columnArray = (char **) palloc0(expectedColumnCount * sizeof(char *));
 	}
 
-
 	while (!PQisBusy(connection->pgConn))
 	{
 		uint32 rowIndex = 0;
@@ -2927,6 +5065,8 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 				execution->rowsProcessed += currentAffectedTupleCount;
 			}
 
+			session->currentTask->completed = true;
+
 			PQclear(result);
 
 			/* no more results, break out of loop and free allocated memory */
@@ -2942,9 +5082,17 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 			Assert(PQntuples(result) == 0);
 			PQclear(result);
 
+			session->currentTask->completed = true;
+
 			fetchDone = true;
 			break;
 		}
+		else if (resultStatus != PGRES_SINGLE_TUPLE && session->currentTask->cancelled)
+		{
+			/* the command was cancelled since another placement responded first */
+			PQclear(result);
+			continue;
+		}
 		else if (resultStatus != PGRES_SINGLE_TUPLE)
 		{
 			/* query failures are always hard errors */
@@ -2970,6 +5118,11 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 								   columnCount, expectedColumnCount)));
 		}
 
+		if (execution->binaryResults)
+		{
+			ErrorIfUnexpectedBinaryResult(binaryResultReceiver, result);
+		}
+
 		for (rowIndex = 0; rowIndex < rowsProcessed; rowIndex++)
 		{
 			HeapTuple heapTuple = NULL;
@@ -3001,7 +5154,15 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 			 */
 			oldContext = MemoryContextSwitchTo(ioContext);
 
-			heapTuple = BuildTupleFromCStrings(attributeInputMetadata, columnArray);
+			if (execution->binaryResults)
+			{
+				heapTuple = BuildTupleFromBinaryResult(binaryResultReceiver, result,
+													   rowIndex);
+			}
+			else
+			{
+				heapTuple = BuildTupleFromCStrings(attributeInputMetadata, columnArray);
+			}
 
 			MemoryContextSwitchTo(oldContext);
 
@@ -3019,14 +5180,169 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 		}
 	}
 
-	if (columnArray != NULL)
+	return fetchDone;
+}
+
+
+/*
+ * CanUseBinaryResults returns true if all columns of the given tuple
+ * descriptor can be transferred in binary format. Similar to COPY, this
+ * requires the type to have binary send and receive functions and not to
+ * embed the Oids of user-defined types, which are generally not the same on
+ * the coordinator and the workers.
+ */
+static bool
+CanUseBinaryResults(TupleDesc tupleDescriptor)
+{
+	int columnIndex = 0;
+
+	for (columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Form_pg_attribute attribute = TupleDescAttr(tupleDescriptor, columnIndex);
+		Oid typeId = attribute->atttypid;
+		Oid receiveFunctionId = InvalidOid;
+		Oid typeIoParam = InvalidOid;
+		int16 typeLength = 0;
+		bool typeByVal = false;
+		char typeAlign = 0;
+		char typeDelim = 0;
+
+		if (attribute->attisdropped || !CanUseBinaryCopyFormatForType(typeId))
+		{
+			return false;
+		}
+
+		get_type_io_data(typeId, IOFunc_receive, &typeLength, &typeByVal,
+						 &typeAlign, &typeDelim, &typeIoParam, &receiveFunctionId);
+		if (!OidIsValid(receiveFunctionId))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * CreateBinaryResultReceiver looks up the receive functions of the columns of
+ * the given tuple descriptor once for all rows that are received in binary
+ * format.
+ */
+static BinaryResultReceiver *
+CreateBinaryResultReceiver(TupleDesc tupleDescriptor)
+{
+	BinaryResultReceiver *binaryResultReceiver =
+		(BinaryResultReceiver *) palloc0(sizeof(BinaryResultReceiver));
+	int columnCount = tupleDescriptor->natts;
+	int columnIndex = 0;
+
+	binaryResultReceiver->tupleDescriptor = tupleDescriptor;
+	binaryResultReceiver->receiveFunctionArray = palloc0(columnCount * sizeof(FmgrInfo));
+	binaryResultReceiver->typeIoParamArray = palloc0(columnCount * sizeof(Oid));
+	binaryResultReceiver->columnValues = palloc0(columnCount * sizeof(Datum));
+	binaryResultReceiver->columnNulls = palloc0(columnCount * sizeof(bool));
+
+	for (columnIndex = 0; columnIndex < columnCount; columnIndex++)
 	{
-		pfree(columnArray);
+		Form_pg_attribute attribute = TupleDescAttr(tupleDescriptor, columnIndex);
+		Oid receiveFunctionId = InvalidOid;
+
+		getTypeBinaryInputInfo(attribute->atttypid, &receiveFunctionId,
+							   &binaryResultReceiver->typeIoParamArray[columnIndex]);
+		fmgr_info(receiveFunctionId,
+				  &binaryResultReceiver->receiveFunctionArray[columnIndex]);
 	}
 
-	MemoryContextDelete(ioContext);
+	return binaryResultReceiver;
+}
 
-	return fetchDone;
+
+/*
+ * ErrorIfUnexpectedBinaryResult errors out if a result that was requested in
+ * binary format does not have the format or the built-in column types that
+ * the receive functions expect.
+ */
+static void
+ErrorIfUnexpectedBinaryResult(BinaryResultReceiver *binaryResultReceiver,
+							  PGresult *result)
+{
+	TupleDesc tupleDescriptor = binaryResultReceiver->tupleDescriptor;
+	int columnIndex = 0;
+
+	for (columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Oid expectedTypeId = TupleDescAttr(tupleDescriptor, columnIndex)->atttypid;
+		Oid receivedTypeId = PQftype(result, columnIndex);
+
+		if (PQfformat(result, columnIndex) != 1)
+		{
+			ereport(ERROR, (errmsg("unexpected text result from worker for column "
+								   "%d", columnIndex + 1)));
+		}
+
+		/* the Oids of user-defined types differ across nodes */
+		if (expectedTypeId < FirstNormalObjectId && receivedTypeId != expectedTypeId)
+		{
+			ereport(ERROR, (errmsg("unexpected type of column %d from worker: %u, "
+								   "expected %u", columnIndex + 1, receivedTypeId,
+								   expectedTypeId)));
+		}
+	}
+}
+
+
+/*
+ * BuildTupleFromBinaryResult builds a heap tuple out of a row of a result that
+ * was received in binary format, using the cached receive functions.
+ */
+static HeapTuple
+BuildTupleFromBinaryResult(BinaryResultReceiver *binaryResultReceiver,
+						   PGresult *result, int rowIndex)
+{
+	TupleDesc tupleDescriptor = binaryResultReceiver->tupleDescriptor;
+	Datum *columnValues = binaryResultReceiver->columnValues;
+	bool *columnNulls = binaryResultReceiver->columnNulls;
+	int columnIndex = 0;
+
+	for (columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		Form_pg_attribute attribute = TupleDescAttr(tupleDescriptor, columnIndex);
+		FmgrInfo *receiveFunction =
+			&binaryResultReceiver->receiveFunctionArray[columnIndex];
+		Oid typeIoParam = binaryResultReceiver->typeIoParamArray[columnIndex];
+		StringInfoData valueBuffer;
+
+		if (PQgetisnull(result, rowIndex, columnIndex))
+		{
+			/* call the receive function anyway, for domain constraints */
+			columnValues[columnIndex] = ReceiveFunctionCall(receiveFunction, NULL,
+															typeIoParam,
+															attribute->atttypmod);
+			columnNulls[columnIndex] = true;
+			continue;
+		}
+
+		/* libpq null-terminates binary values as well, like receive functions expect */
+		valueBuffer.data = PQgetvalue(result, rowIndex, columnIndex);
+		valueBuffer.len = PQgetlength(result, rowIndex, columnIndex);
+		valueBuffer.maxlen = valueBuffer.len + 1;
+		valueBuffer.cursor = 0;
+
+		columnValues[columnIndex] = ReceiveFunctionCall(receiveFunction, &valueBuffer,
+														typeIoParam,
+														attribute->atttypmod);
+		columnNulls[columnIndex] = false;
+
+		if (valueBuffer.cursor != valueBuffer.len)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							errmsg("incorrect binary data format in column %d "
+								   "received from worker", columnIndex + 1)));
+		}
+	}
+
+	return heap_form_tuple(tupleDescriptor, columnValues, columnNulls);
 }
 
 
@@ -3114,6 +5430,7 @@ WorkerSessionFailed(WorkerSession *session)
 	TaskPlacementExecution *placementExecution = session->currentTask;
 	bool succeeded = false;
 	dlist_iter iter;
+	ListCell *placementExecutionCell = NULL;
 
 	if (placementExecution != NULL)
 	{
@@ -3121,6 +5438,13 @@ WorkerSessionFailed(WorkerSession *session)
 		PlacementExecutionDone(placementExecution, succeeded);
 	}
 
+	foreach(placementExecutionCell, session->pipelinedTaskList)
+	{
+		placementExecution = lfirst(placementExecutionCell);
+
+		PlacementExecutionDone(placementExecution, succeeded);
+	}
+
 	dlist_foreach(iter, &session->pendingTaskQueue)
 	{
 		placementExecution =
@@ -3156,10 +5480,30 @@ PlacementExecutionDone(TaskPlacementExecution *placementExecution, bool succeede
 	TaskExecutionState newExecutionState = TASK_EXECUTION_NOT_FINISHED;
 	bool failedPlacementExecutionIsOnPendingQueue = false;
 
+	if (placementExecution->cancelled &&
+		placementExecution->executionState == PLACEMENT_EXECUTION_RUNNING)
+	{
+		/* the cancelled command is no longer running */
+		execution->cancelledPlacementExecutionCount--;
+	}
+
 	/* mark the placement execution as finished */
 	if (succeeded)
 	{
 		placementExecution->executionState = PLACEMENT_EXECUTION_FINISHED;
+
+		if (execution->enableHedging)
+		{
+			RecordTaskDuration(placementExecution);
+		}
+
+		if (EnableLatencyAwarePoolSizing)
+		{
+			workerPool->totalTaskDurationMs +=
+				FractionalMillisecondsBetweenTimestamps(placementExecution->startTime,
+														GetCurrentTimestamp());
+			workerPool->finishedTaskCount++;
+		}
 	}
 	else
 	{
@@ -3245,13 +5589,23 @@ ScheduleNextPlacementExecution(TaskPlacementExecution *placementExecution, bool
 		executionOrder == EXECUTION_ORDER_SEQUENTIAL)
 	{
 		TaskPlacementExecution *nextPlacementExecution = NULL;
+		int nextPlacementExecutionIndex = placementExecution->placementExecutionIndex;
 		int placementExecutionCount PG_USED_FOR_ASSERTS_ONLY =
 			shardCommandExecution->placementExecutionCount;
 
+		/*
+		 * When the task is hedged, another placement execution may still be
+		 * running. Once that one finishes, we either are done or schedule the
+		 * next placement execution.
+		 */
+		if (PlacementExecutionInProgress(shardCommandExecution, placementExecution))
+		{
+			return;
+		}
+
 		/* find a placement execution that is not yet marked as failed */
 		do {
-			int nextPlacementExecutionIndex =
-				placementExecution->placementExecutionIndex + 1;
+			nextPlacementExecutionIndex++;
 
 			/* if all tasks failed then we should already have errored out */
 			Assert(nextPlacementExecutionIndex < placementExecutionCount);
@@ -3270,6 +5624,36 @@ ScheduleNextPlacementExecution(TaskPlacementExecution *placementExecution, bool
 }
 
 
+/*
+ * PlacementExecutionInProgress returns true if a placement execution of the
+ * given task, other than the given one, is ready or running.
+ */
+static bool
+PlacementExecutionInProgress(ShardCommandExecution *shardCommandExecution,
+							 TaskPlacementExecution *placementExecution)
+{
+	int placementExecutionCount = shardCommandExecution->placementExecutionCount;
+	int placementExecutionIndex = 0;
+
+	for (; placementExecutionIndex < placementExecutionCount; placementExecutionIndex++)
+	{
+		TaskPlacementExecution *otherPlacementExecution =
+			shardCommandExecution->placementExecutions[placementExecutionIndex];
+		TaskPlacementExecutionState executionState =
+			otherPlacementExecution->executionState;
+
+		if (otherPlacementExecution != placementExecution &&
+			(executionState == PLACEMENT_EXECUTION_READY ||
+			 executionState == PLACEMENT_EXECUTION_RUNNING))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * ShouldMarkPlacementsInvalidOnFailure returns true if the failure
  * should trigger marking placements invalid.
@@ -14,16 +14,24 @@
 #include "commands/copy.h"
 #include "distributed/backend_data.h"
 #include "distributed/citus_custom_scan.h"
+#include "distributed/distributed_planner.h"
 #include "distributed/insert_select_executor.h"
 #include "distributed/insert_select_planner.h"
+#include "distributed/metadata_cache.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/multi_router_executor.h"
 #include "distributed/multi_router_planner.h"
 #include "distributed/query_stats.h"
+#include "distributed/shard_pruning.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/worker_protocol.h"
 #include "executor/executor.h"
 #include "nodes/makefuncs.h"
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/clauses.h"
+#endif
 #include "utils/memutils.h"
 #include "utils/rel.h"
 
@@ -38,6 +46,7 @@ static Node * DelayedErrorCreateScan(CustomScan *scan);
 
 /* functions that are common to different scans */
 static void CitusBeginScan(CustomScanState *node, EState *estate, int eflags);
+static void CitusSelectBeginScan(CustomScanState *node, EState *estate, int eflags);
 static void CitusEndScan(CustomScanState *node);
 static void CitusReScan(CustomScanState *node);
 
@@ -168,6 +177,14 @@ CitusBeginScan(CustomScanState *node, EState *estate, int eflags)
 #endif
 
 	distributedPlan = scanState->distributedPlan;
+	if (distributedPlan->modLevel == ROW_MODIFY_READONLY &&
+		distributedPlan->workerJob != NULL &&
+		distributedPlan->workerJob->deferredPruning)
+	{
+		CitusSelectBeginScan(node, estate, eflags);
+		return;
+	}
+
 	if (distributedPlan->modLevel == ROW_MODIFY_READONLY ||
 		distributedPlan->insertSelectSubquery != NULL)
 	{
@@ -179,11 +196,76 @@ CitusBeginScan(CustomScanState *node, EState *estate, int eflags)
 }
 
 
+/*
+ * CitusSelectBeginScan prunes the tasks of a generic SELECT plan, which has
+ * a task for every shard, using the parameter values of the current
+ * execution.
+ */
+static void
+CitusSelectBeginScan(CustomScanState *node, EState *estate, int eflags)
+{
+	CitusScanState *scanState = (CitusScanState *) node;
+	DistributedPlan *distributedPlan = NULL;
+	Job *workerJob = NULL;
+	ParamListInfo boundParams = NULL;
+	List *whereClauseList = NIL;
+	List *prunedShardList = NIL;
+	List *prunedTaskList = NIL;
+	ListCell *taskCell = NULL;
+	Task *firstTask = NULL;
+	Oid relationId = InvalidOid;
+
+	/*
+	 * We must not change the distributed plan since it may be reused across multiple
+	 * executions of a prepared statement. Instead we create a deep copy that we only
+	 * use for the current execution.
+	 */
+	distributedPlan = scanState->distributedPlan = copyObject(scanState->distributedPlan);
+
+	workerJob = distributedPlan->workerJob;
+	if (workerJob->taskList == NIL)
+	{
+		return;
+	}
+
+	firstTask = (Task *) linitial(workerJob->taskList);
+	relationId = RelationIdForShard(firstTask->anchorShardId);
+
+	/* force evaluation of bound params and replace them in the WHERE clause */
+	boundParams = copyParamList(estate->es_param_list_info);
+	whereClauseList = (List *) ResolveExternalParams(
+		(Node *) copyObject(workerJob->deferredPruningClauseList), boundParams);
+	whereClauseList = (List *) eval_const_expressions(NULL, (Node *) whereClauseList);
+
+	prunedShardList = PruneShards(relationId, 1, whereClauseList, NULL);
+
+	foreach(taskCell, workerJob->taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+		ListCell *shardCell = NULL;
+
+		foreach(shardCell, prunedShardList)
+		{
+			ShardInterval *shardInterval = (ShardInterval *) lfirst(shardCell);
+
+			if (shardInterval->shardId == task->anchorShardId)
+			{
+				prunedTaskList = lappend(prunedTaskList, task);
+				break;
+			}
+		}
+	}
+
+	workerJob->taskList = prunedTaskList;
+}
+
+
 /*
  * CitusExecScan is called when a tuple is pulled from a custom scan.
  * On the first call, it executes the distributed query and writes the
  * results to a tuple store. The postgres executor calls this function
- * repeatedly to read tuples from the tuple store.
+ * repeatedly to read tuples from the tuple store. If the results are
+ * streamed, the execution continues as tuples are read.
  */
 TupleTableSlot *
 CitusExecScan(CustomScanState *node)
@@ -198,6 +280,11 @@ CitusExecScan(CustomScanState *node)
 		scanState->finishedRemoteScan = true;
 	}
 
+	if (scanState->streamingExecution != NULL)
+	{
+		return ReturnTupleFromStreamingExecution(scanState);
+	}
+
 	resultSlot = ReturnTupleFromTuplestore(scanState);
 
 	return resultSlot;
@@ -373,6 +460,12 @@ CitusEndScan(CustomScanState *node)
 		CitusQueryStatsExecutorsEntry(queryId, executorType, partitionKeyString);
 	}
 
+	if (scanState->streamingExecution != NULL)
+	{
+		/* the rest of the results are not needed, e.g., because of a LIMIT */
+		CancelStreamingExecution(scanState);
+	}
+
 	if (scanState->tuplestorestate)
 	{
 		tuplestore_end(scanState->tuplestorestate);
@@ -7,6 +7,8 @@
  *
  *-------------------------------------------------------------------------
  */
+#include <arpa/inet.h> /* for htons */
+#include <netinet/in.h> /* for htons */
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -16,8 +18,14 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 
+#include "access/hash.h"
+#include "access/nbtree.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_enum.h"
+#include "catalog/pg_type.h"
 #include "commands/copy.h"
+#include "common/pg_lzcompress.h"
 #include "distributed/commands/multi_copy.h"
 #include "distributed/connection_management.h"
 #include "distributed/intermediate_results.h"
@@ -25,15 +33,19 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
 #include "distributed/remote_commands.h"
+#include "distributed/remote_transaction.h"
+#include "distributed/shardinterval_utils.h"
 #include "distributed/transmit.h"
 #include "distributed/transaction_identifier.h"
 #include "distributed/tuplestore.h"
 #include "distributed/version_compat.h"
+#include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
 #include "nodes/makefuncs.h"
 #include "nodes/parsenodes.h"
 #include "nodes/primnodes.h"
 #include "storage/fd.h"
+#include "storage/latch.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -43,6 +55,18 @@
 
 static bool CreatedResultsDirectory = false;
 
+/* signature at the start of files in the binary COPY format */
+static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
+
+/* signature at the start of intermediate results written in compressed blocks */
+static const char CompressedResultSignature[12] = "CITUSLZ\n\377\r\n\0";
+
+/* amount of COPY data that is collected before compressing it as a block */
+static const int CompressedResultBlockSize = 65536; /* 64 KB */
+
+/* whether intermediate results are written in compressed blocks */
+bool CompressIntermediateResults = false;
+
 
 /* CopyDestReceiver can be used to stream results into a distributed table */
 typedef struct RemoteFileDestReceiver
@@ -73,22 +97,160 @@ typedef struct RemoteFileDestReceiver
 	CopyOutState copyOutState;
 	FmgrInfo *columnOutputFunctions;
 
+	/* whether to compress the data, and the data of the current block */
+	bool compressed;
+	StringInfo blockData;
+
 	/* number of tuples sent */
 	uint64 tuplesSent;
 } RemoteFileDestReceiver;
 
 
+/*
+ * IntermediateResultReader reads the COPY data in an intermediate result
+ * file, decompressing the blocks of results that are written in compressed
+ * blocks.
+ */
+typedef struct IntermediateResultReader
+{
+	File fileDesc;
+	FileCompat fileCompat;
+	bool compressed;
+
+	/* data that was read from the file, but not yet returned */
+	StringInfo pendingData;
+	int pendingOffset;
+} IntermediateResultReader;
+
+
+/*
+ * RemotePieceFetch copies the pieces of an intermediate result that are
+ * stored on one node into local files, one piece at a time, over a single
+ * connection to that node.
+ */
+typedef struct RemotePieceFetch
+{
+	MultiConnection *connection;
+
+	/* pieces stored on the node and the piece that is being copied */
+	List *pieceList;
+	ListCell *pieceCell;
+
+	/* local file of the piece that is being copied */
+	File pieceFileDesc;
+	FileCompat pieceFile;
+} RemotePieceFetch;
+
+
+/* reader of the intermediate result that read_intermediate_result is parsing */
+static IntermediateResultReader *CopyDataReader = NULL;
+
+
+/*
+ * PartitionedResultDestReceiver writes the rows it receives into one of a
+ * number of local intermediate results, based on the value of the partition
+ * column. Partition i contains the rows whose (hashed) value falls into the
+ * i-th interval of the split points.
+ */
+typedef struct PartitionedResultDestReceiver
+{
+	/* public DestReceiver interface */
+	DestReceiver pub;
+
+	/* EState for per-tuple memory allocation */
+	EState *executorState;
+
+	/* how to partition the rows */
+	int partitionColumnIndex;
+	char partitionMethod;
+	int partitionCount;
+	Datum *splitPointMinValueArray;
+	Datum *splitPointMaxValueArray;
+
+	/* set up based on the type of the partition column during startup */
+	ShardInterval **partitionIntervalArray;
+	FmgrInfo *hashFunction;
+	FmgrInfo *compareFunction;
+	Oid partitionColumnCollation;
+
+	/* receivers that write the rows of each partition, NULL to discard them */
+	DestReceiver **partitionDestArray;
+} PartitionedResultDestReceiver;
+
+
+/*
+ * TeeDestReceiver passes the rows it receives on to each of a list of
+ * receivers, such that a single execution can write several results.
+ */
+typedef struct TeeDestReceiver
+{
+	/* public DestReceiver interface */
+	DestReceiver pub;
+
+	List *destReceiverList;
+} TeeDestReceiver;
+
+
 static void RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
 										  TupleDesc inputTupleDescriptor);
 static StringInfo ConstructCopyResultStatement(const char *resultId);
 static void WriteToLocalFile(StringInfo copyData, FileCompat *fileCompat);
 static bool RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
+static void SendResultData(RemoteFileDestReceiver *resultDest, StringInfo data);
+static void FlushResultBlock(RemoteFileDestReceiver *resultDest);
+static void SendResultBytes(RemoteFileDestReceiver *resultDest, StringInfo data);
+static StringInfo CompressResultBlock(const char *data, int32 rawLength);
 static void BroadcastCopyData(StringInfo dataBuffer, List *connectionList);
 static void SendCopyDataOverConnection(StringInfo dataBuffer,
 									   MultiConnection *connection);
 static void RemoteFileDestReceiverShutdown(DestReceiver *destReceiver);
 static void RemoteFileDestReceiverDestroy(DestReceiver *destReceiver);
 
+static DestReceiver * CreatePartitionedResultDestReceiver(EState *executorState,
+															int partitionColumnIndex,
+															char partitionMethod,
+															int partitionCount,
+															Datum *splitPointMinValueArray,
+															Datum *splitPointMaxValueArray,
+															DestReceiver **
+															partitionDestArray);
+static void PartitionedResultDestReceiverStartup(DestReceiver *dest, int operation,
+												 TupleDesc inputTupleDescriptor);
+static bool PartitionedResultDestReceiverReceive(TupleTableSlot *slot,
+												 DestReceiver *dest);
+static void PartitionedResultDestReceiverShutdown(DestReceiver *destReceiver);
+static void PartitionedResultDestReceiverDestroy(DestReceiver *destReceiver);
+static int PartitionIndexForRow(PartitionedResultDestReceiver *resultDest,
+								TupleTableSlot *slot);
+static void ErrorIfSplitPointsOverlap(PartitionedResultDestReceiver *resultDest);
+static void TeeDestReceiverStartup(DestReceiver *dest, int operation,
+								   TupleDesc inputTupleDescriptor);
+static bool TeeDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
+static void TeeDestReceiverShutdown(DestReceiver *destReceiver);
+static void TeeDestReceiverDestroy(DestReceiver *destReceiver);
+static List * IntermediateResultPieceList(ArrayType *pieceIdArray,
+										  ArrayType *nodeNameArray,
+										  ArrayType *nodePortArray);
+static void FetchRemoteIntermediateResultPieces(List *pieceList);
+static List * RemotePieceFetchList(List *pieceList);
+static void StartRemotePieceCopy(RemotePieceFetch *fetch);
+static bool ReceiveRemotePieceData(RemotePieceFetch *fetch);
+static WaitEventSet * BuildRemotePieceFetchWaitEventSet(List *fetchList);
+static int64 AssembleIntermediateResult(char *resultId, List *pieceList);
+static void AppendIntermediateResultPiece(FileCompat *resultFile, StringInfo resultData,
+										  IntermediateResultPiece *piece,
+										  bool isFirstPiece, bool *binaryFormat,
+										  bool *compressed);
+static void WriteAssembledData(FileCompat *resultFile, StringInfo resultData,
+							   bool compressed, bool flush);
+static IntermediateResultReader * OpenIntermediateResultReader(const char *fileName);
+static int ReadIntermediateResultData(IntermediateResultReader *reader, char *buffer,
+									  int amount);
+static bool ReadCompressedResultBlock(IntermediateResultReader *reader);
+static void CloseIntermediateResultReader(IntermediateResultReader *reader);
+static int ReadIntermediateResultCopyData(void *outbuf, int minread, int maxread);
+static int ReadFileData(FileCompat *fileCompat, char *buffer, int amount);
+static void ReadFromFile(FileCompat *fileCompat, char *buffer, int amount);
 static char * CreateIntermediateResultsDirectory(void);
 static char * IntermediateResultsDirectory(void);
 static char * QueryResultFileName(const char *resultId);
@@ -98,6 +260,8 @@ static char * QueryResultFileName(const char *resultId);
 PG_FUNCTION_INFO_V1(read_intermediate_result);
 PG_FUNCTION_INFO_V1(broadcast_intermediate_result);
 PG_FUNCTION_INFO_V1(create_intermediate_result);
+PG_FUNCTION_INFO_V1(fetch_intermediate_result_pieces);
+PG_FUNCTION_INFO_V1(worker_partition_query_result);
 
 
 /*
@@ -165,9 +329,14 @@ create_intermediate_result(PG_FUNCTION_ARGS)
 	 * Make sure that this transaction has a distributed transaction ID.
 	 *
 	 * Intermediate results will be stored in a directory that is derived
-	 * from the distributed transaction ID.
+	 * from the distributed transaction ID. Tasks that write the pieces of an
+	 * intermediate result on the workers are already part of a distributed
+	 * transaction, which they should not coordinate themselves.
 	 */
-	BeginOrContinueCoordinatedTransaction();
+	if (GetCurrentDistributedTransactionId()->transactionNumber == 0)
+	{
+		BeginOrContinueCoordinatedTransaction();
+	}
 
 	estate = CreateExecutorState();
 	resultDest = (RemoteFileDestReceiver *) CreateRemoteFileDestReceiver(resultIdString,
@@ -184,127 +353,1798 @@ create_intermediate_result(PG_FUNCTION_ARGS)
 
 
 /*
- * CreateRemoteFileDestReceiver creates a DestReceiver that streams results
- * to a set of worker nodes. If the scope of the intermediate result is a
- * distributed transaction, then it's up to the caller to ensure that a
- * coordinated transaction is started prior to using the DestReceiver.
+ * worker_partition_query_result executes a query and writes the results into
+ * a local intermediate result per partition, e.g.:
+ *
+ * SELECT * FROM worker_partition_query_result('1_1', 'SELECT a, b FROM t', 0,
+ *											   'hash', ARRAY['-2147483648', '0'],
+ *											   ARRAY['-1', '2147483647'])
+ *
+ * writes the rows of the query into the results 1_1_0 and 1_1_1 based on
+ * the hash of the first column. For range partitioning, the split points are
+ * values of the partition column. The split points must be sorted and must
+ * not overlap. The function returns the number of rows and bytes written to
+ * each partition.
+ *
+ * If partition indexes are given, only the rows of those partitions are
+ * written and the rows of other partitions are discarded, which lets a node
+ * keep only the partitions that its shards read.
+ *
+ * Rows in which the partition column is NULL are written to the first
+ * partition, such that the partitions together contain all rows.
+ */
+Datum
+worker_partition_query_result(PG_FUNCTION_ARGS)
+{
+	text *resultPrefixText = NULL;
+	char *resultPrefixString = NULL;
+	text *queryText = NULL;
+	char *queryString = NULL;
+	int partitionColumnIndex = 0;
+	Oid partitionMethodOid = InvalidOid;
+	ArrayType *minValueArray = NULL;
+	ArrayType *maxValueArray = NULL;
+	bool *writePartitionArray = NULL;
+	DestReceiver **partitionDestArray = NULL;
+	char partitionMethod = 0;
+	int partitionCount = 0;
+	int partitionIndex = 0;
+	int argumentIndex = 0;
+	EState *estate = NULL;
+	PartitionedResultDestReceiver *resultDest = NULL;
+	ParamListInfo paramListInfo = NULL;
+	Tuplestorestate *tupleStore = NULL;
+	TupleDesc tupleDescriptor = NULL;
+
+	CheckCitusVersion(ERROR);
+
+	/* only the partition indexes may be NULL */
+	for (argumentIndex = 0; argumentIndex < 6; argumentIndex++)
+	{
+		if (PG_ARGISNULL(argumentIndex))
+		{
+			ereport(ERROR, (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+							errmsg("only the partition indexes of "
+								   "worker_partition_query_result can be NULL")));
+		}
+	}
+
+	resultPrefixText = PG_GETARG_TEXT_P(0);
+	resultPrefixString = text_to_cstring(resultPrefixText);
+	queryText = PG_GETARG_TEXT_P(1);
+	queryString = text_to_cstring(queryText);
+	partitionColumnIndex = PG_GETARG_INT32(2);
+	partitionMethodOid = PG_GETARG_OID(3);
+	minValueArray = PG_GETARG_ARRAYTYPE_P(4);
+	maxValueArray = PG_GETARG_ARRAYTYPE_P(5);
+
+	partitionMethod = LookupDistributionMethod(partitionMethodOid);
+	if (partitionMethod != DISTRIBUTE_BY_HASH && partitionMethod != DISTRIBUTE_BY_RANGE)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("only hash and range partitioning are supported for "
+							   "intermediate results")));
+	}
+
+	partitionCount = ArrayObjectCount(minValueArray);
+	if (partitionCount == 0 || ArrayObjectCount(maxValueArray) != partitionCount)
+	{
+		ereport(ERROR, (errmsg("the number of split point min and max values must "
+							   "be equal and larger than zero")));
+	}
+
+	writePartitionArray = (bool *) palloc0(partitionCount * sizeof(bool));
+
+	if (PG_ARGISNULL(6))
+	{
+		memset(writePartitionArray, true, partitionCount * sizeof(bool));
+	}
+	else
+	{
+		ArrayType *partitionIndexArray = PG_GETARG_ARRAYTYPE_P(6);
+		Datum *partitionIndexDatumArray = DeconstructArrayObject(partitionIndexArray);
+		int partitionIndexCount = ArrayObjectCount(partitionIndexArray);
+		int arrayIndex = 0;
+
+		for (arrayIndex = 0; arrayIndex < partitionIndexCount; arrayIndex++)
+		{
+			partitionIndex = DatumGetInt32(partitionIndexDatumArray[arrayIndex]);
+			if (partitionIndex < 0 || partitionIndex >= partitionCount)
+			{
+				ereport(ERROR, (errmsg("partition index %d is out of range",
+									   partitionIndex)));
+			}
+
+			writePartitionArray[partitionIndex] = true;
+		}
+	}
+
+	estate = CreateExecutorState();
+
+	/* the rows of partitions that are not written are discarded */
+	partitionDestArray =
+		(DestReceiver **) palloc0(partitionCount * sizeof(DestReceiver *));
+
+	for (partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
+	{
+		char *partitionResultId = NULL;
+		List *nodeList = NIL;
+		bool writeLocalFile = true;
+
+		if (!writePartitionArray[partitionIndex])
+		{
+			continue;
+		}
+
+		partitionResultId = PartitionedResultId(resultPrefixString, partitionIndex);
+		partitionDestArray[partitionIndex] =
+			CreateRemoteFileDestReceiver(partitionResultId, estate, nodeList,
+										 writeLocalFile);
+	}
+
+	resultDest = (PartitionedResultDestReceiver *)
+				 CreatePartitionedResultDestReceiver(estate, partitionColumnIndex,
+													 partitionMethod, partitionCount,
+													 DeconstructArrayObject(minValueArray),
+													 DeconstructArrayObject(maxValueArray),
+													 partitionDestArray);
+
+	ExecuteQueryStringIntoDestReceiver(queryString, paramListInfo,
+									   (DestReceiver *) resultDest);
+
+	tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
+
+	for (partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
+	{
+		RemoteFileDestReceiver *partitionDest =
+			(RemoteFileDestReceiver *) resultDest->partitionDestArray[partitionIndex];
+		Datum values[3];
+		bool nulls[3];
+
+		if (partitionDest == NULL)
+		{
+			continue;
+		}
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = Int32GetDatum(partitionIndex);
+		values[1] = Int64GetDatum(partitionDest->tuplesSent);
+		values[2] = Int64GetDatum(IntermediateResultSize(partitionDest->resultId));
+
+		tuplestore_putvalues(tupleStore, tupleDescriptor, values, nulls);
+	}
+
+	tuplestore_donestoring(tupleStore);
+
+	PartitionedResultDestReceiverDestroy((DestReceiver *) resultDest);
+	FreeExecutorState(estate);
+
+	return (Datum) 0;
+}
+
+
+/*
+ * PartitionedResultId returns the identifier of the given partition of a
+ * partitioned intermediate result.
+ */
+char *
+PartitionedResultId(char *resultPrefix, int partitionIndex)
+{
+	StringInfo resultId = makeStringInfo();
+
+	appendStringInfo(resultId, "%s_%d", resultPrefix, partitionIndex);
+
+	return resultId->data;
+}
+
+
+/*
+ * CreateShardPartitionedDestReceiver creates a DestReceiver that splits the
+ * rows it receives along the hash ranges of the shards of the given relation,
+ * based on the value of the column at partitionColumnIndex. The rows of
+ * partition i are sent to the nodes in the i-th list of partitionNodeListList,
+ * which store them in the result with the given prefix and the index of the
+ * partition. The rows of partitions without nodes are discarded.
  */
 DestReceiver *
-CreateRemoteFileDestReceiver(char *resultId, EState *executorState,
-							 List *initialNodeList, bool writeLocalFile)
+CreateShardPartitionedDestReceiver(char *resultPrefix, EState *executorState,
+								   Oid relationId, int partitionColumnIndex,
+								   List *partitionNodeListList)
 {
-	RemoteFileDestReceiver *resultDest = NULL;
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	int partitionCount = cacheEntry->shardIntervalArrayLength;
+	Datum *splitPointMinValueArray = (Datum *) palloc0(partitionCount * sizeof(Datum));
+	Datum *splitPointMaxValueArray = (Datum *) palloc0(partitionCount * sizeof(Datum));
+	DestReceiver **partitionDestArray =
+		(DestReceiver **) palloc0(partitionCount * sizeof(DestReceiver *));
+	ListCell *nodeListCell = NULL;
+	int partitionIndex = 0;
+
+	Assert(list_length(partitionNodeListList) == partitionCount);
+
+	foreach(nodeListCell, partitionNodeListList)
+	{
+		ShardInterval *shardInterval = cacheEntry->sortedShardIntervalArray[partitionIndex];
+		List *nodeList = (List *) lfirst(nodeListCell);
+		char *partitionResultId = NULL;
+		bool writeLocalFile = false;
+
+		/* split points are text, as for worker_partition_query_result */
+		splitPointMinValueArray[partitionIndex] =
+			CStringGetTextDatum(psprintf("%d", DatumGetInt32(shardInterval->minValue)));
+		splitPointMaxValueArray[partitionIndex] =
+			CStringGetTextDatum(psprintf("%d", DatumGetInt32(shardInterval->maxValue)));
+
+		if (nodeList != NIL)
+		{
+			partitionResultId = PartitionedResultId(resultPrefix, partitionIndex);
+			partitionDestArray[partitionIndex] =
+				CreateRemoteFileDestReceiver(partitionResultId, executorState, nodeList,
+											 writeLocalFile);
+		}
 
-	resultDest = (RemoteFileDestReceiver *) palloc0(sizeof(RemoteFileDestReceiver));
+		partitionIndex++;
+	}
+
+	return CreatePartitionedResultDestReceiver(executorState, partitionColumnIndex,
+											   DISTRIBUTE_BY_HASH, partitionCount,
+											   splitPointMinValueArray,
+											   splitPointMaxValueArray,
+											   partitionDestArray);
+}
+
+
+/*
+ * CreatePartitionedResultDestReceiver creates a DestReceiver that passes the
+ * rows it receives on to the receiver of their partition in
+ * partitionDestArray. The split points are text datums, which are converted
+ * to the type of the partition column (or int4 for hash partitioning) during
+ * startup. The rows of partitions whose receiver is NULL are discarded.
+ */
+static DestReceiver *
+CreatePartitionedResultDestReceiver(EState *executorState, int partitionColumnIndex,
+									char partitionMethod, int partitionCount,
+									Datum *splitPointMinValueArray,
+									Datum *splitPointMaxValueArray,
+									DestReceiver **partitionDestArray)
+{
+	PartitionedResultDestReceiver *resultDest = NULL;
+
+	resultDest = (PartitionedResultDestReceiver *)
+				 palloc0(sizeof(PartitionedResultDestReceiver));
 
 	/* set up the DestReceiver function pointers */
-	resultDest->pub.receiveSlot = RemoteFileDestReceiverReceive;
-	resultDest->pub.rStartup = RemoteFileDestReceiverStartup;
-	resultDest->pub.rShutdown = RemoteFileDestReceiverShutdown;
-	resultDest->pub.rDestroy = RemoteFileDestReceiverDestroy;
+	resultDest->pub.receiveSlot = PartitionedResultDestReceiverReceive;
+	resultDest->pub.rStartup = PartitionedResultDestReceiverStartup;
+	resultDest->pub.rShutdown = PartitionedResultDestReceiverShutdown;
+	resultDest->pub.rDestroy = PartitionedResultDestReceiverDestroy;
 	resultDest->pub.mydest = DestCopyOut;
 
-	/* set up output parameters */
-	resultDest->resultId = resultId;
 	resultDest->executorState = executorState;
-	resultDest->initialNodeList = initialNodeList;
-	resultDest->memoryContext = CurrentMemoryContext;
-	resultDest->writeLocalFile = writeLocalFile;
+	resultDest->partitionColumnIndex = partitionColumnIndex;
+	resultDest->partitionMethod = partitionMethod;
+	resultDest->partitionCount = partitionCount;
+	resultDest->splitPointMinValueArray = splitPointMinValueArray;
+	resultDest->splitPointMaxValueArray = splitPointMaxValueArray;
+	resultDest->partitionDestArray = partitionDestArray;
 
 	return (DestReceiver *) resultDest;
 }
 
 
 /*
- * RemoteFileDestReceiverStartup implements the rStartup interface of
- * RemoteFileDestReceiver. It opens connections to the nodes in initialNodeList,
- * and sends the COPY command on all connections.
+ * PartitionedResultDestReceiverStartup implements the rStartup interface of
+ * PartitionedResultDestReceiver. It sets up the partitioning functions for the
+ * type of the partition column and opens the files of all partitions that
+ * are written, such that empty partitions exist as well.
  */
 static void
-RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
-							  TupleDesc inputTupleDescriptor)
+PartitionedResultDestReceiverStartup(DestReceiver *dest, int operation,
+									 TupleDesc inputTupleDescriptor)
 {
-	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) dest;
+	PartitionedResultDestReceiver *resultDest = (PartitionedResultDestReceiver *) dest;
+	int partitionColumnIndex = resultDest->partitionColumnIndex;
+	int partitionCount = resultDest->partitionCount;
+	Form_pg_attribute partitionColumn = NULL;
+	Oid splitPointType = InvalidOid;
+	Oid inputFunctionId = InvalidOid;
+	Oid typeIOParam = InvalidOid;
+	int partitionIndex = 0;
+
+	if (partitionColumnIndex < 0 || partitionColumnIndex >= inputTupleDescriptor->natts)
+	{
+		ereport(ERROR, (errmsg("partition column index %d is out of range",
+							   partitionColumnIndex)));
+	}
 
-	const char *resultId = resultDest->resultId;
+	partitionColumn = TupleDescAttr(inputTupleDescriptor, partitionColumnIndex);
+	resultDest->partitionColumnCollation = partitionColumn->attcollation;
 
-	CopyOutState copyOutState = NULL;
-	const char *delimiterCharacter = "\t";
-	const char *nullPrintCharacter = "\\N";
+	if (resultDest->partitionMethod == DISTRIBUTE_BY_HASH)
+	{
+		/* use the same hash function as for distribution columns of this type */
+		resultDest->hashFunction = GetFunctionInfo(partitionColumn->atttypid,
+												   HASH_AM_OID, HASHSTANDARD_PROC);
+		splitPointType = INT4OID;
+	}
+	else
+	{
+		splitPointType = partitionColumn->atttypid;
+	}
 
-	List *initialNodeList = resultDest->initialNodeList;
-	ListCell *initialNodeCell = NULL;
-	List *connectionList = NIL;
-	ListCell *connectionCell = NULL;
+	resultDest->compareFunction = GetFunctionInfo(splitPointType, BTREE_AM_OID,
+												  BTORDER_PROC);
 
-	resultDest->tupleDescriptor = inputTupleDescriptor;
+	getTypeInputInfo(splitPointType, &inputFunctionId, &typeIOParam);
 
-	/* define how tuples will be serialised */
-	copyOutState = (CopyOutState) palloc0(sizeof(CopyOutStateData));
-	copyOutState->delim = (char *) delimiterCharacter;
-	copyOutState->null_print = (char *) nullPrintCharacter;
-	copyOutState->null_print_client = (char *) nullPrintCharacter;
-	copyOutState->binary = CanUseBinaryCopyFormat(inputTupleDescriptor);
-	copyOutState->fe_msgbuf = makeStringInfo();
-	copyOutState->rowcontext = GetPerTupleMemoryContext(resultDest->executorState);
-	resultDest->copyOutState = copyOutState;
+	resultDest->partitionIntervalArray =
+		(ShardInterval **) palloc0(partitionCount * sizeof(ShardInterval *));
 
-	resultDest->columnOutputFunctions = ColumnOutputFunctions(inputTupleDescriptor,
-															  copyOutState->binary);
+	for (partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
+	{
+		ShardInterval *partitionInterval = CitusMakeNode(ShardInterval);
+		char *minValueString =
+			TextDatumGetCString(resultDest->splitPointMinValueArray[partitionIndex]);
+		char *maxValueString =
+			TextDatumGetCString(resultDest->splitPointMaxValueArray[partitionIndex]);
+
+		partitionInterval->minValue = OidInputFunctionCall(inputFunctionId,
+														   minValueString,
+														   typeIOParam, -1);
+		partitionInterval->maxValue = OidInputFunctionCall(inputFunctionId,
+														   maxValueString,
+														   typeIOParam, -1);
+
+		resultDest->partitionIntervalArray[partitionIndex] = partitionInterval;
+	}
 
-	if (resultDest->writeLocalFile)
+	ErrorIfSplitPointsOverlap(resultDest);
+
+	for (partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
 	{
-		const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
-		const int fileMode = (S_IRUSR | S_IWUSR);
-		const char *fileName = NULL;
+		DestReceiver *partitionDest = resultDest->partitionDestArray[partitionIndex];
+
+		if (partitionDest != NULL)
+		{
+			partitionDest->rStartup(partitionDest, operation, inputTupleDescriptor);
+		}
+	}
+}
+
+
+/*
+ * ErrorIfSplitPointsOverlap errors out if the partition intervals are not
+ * sorted or overlap, since rows are assigned to partitions using a binary
+ * search over the intervals.
+ */
+static void
+ErrorIfSplitPointsOverlap(PartitionedResultDestReceiver *resultDest)
+{
+	ShardInterval **partitionIntervalArray = resultDest->partitionIntervalArray;
+	FmgrInfo *compareFunction = resultDest->compareFunction;
+	int partitionIndex = 0;
+
+	for (partitionIndex = 0; partitionIndex < resultDest->partitionCount;
+		 partitionIndex++)
+	{
+		ShardInterval *partitionInterval = partitionIntervalArray[partitionIndex];
+		ShardInterval *previousInterval = NULL;
+		Datum comparison = FunctionCall2Coll(compareFunction, DEFAULT_COLLATION_OID,
+											 partitionInterval->minValue,
+											 partitionInterval->maxValue);
+
+		if (DatumGetInt32(comparison) > 0)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("split point min value of partition %d is "
+								   "larger than its max value", partitionIndex)));
+		}
+
+		if (partitionIndex == 0)
+		{
+			continue;
+		}
+
+		previousInterval = partitionIntervalArray[partitionIndex - 1];
+		comparison = FunctionCall2Coll(compareFunction, DEFAULT_COLLATION_OID,
+									   previousInterval->maxValue,
+									   partitionInterval->minValue);
+
+		if (DatumGetInt32(comparison) >= 0)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("split points must be sorted and must not overlap"),
+							errdetail("Partition %d starts before partition %d ends.",
+									  partitionIndex, partitionIndex - 1)));
+		}
+	}
+}
+
+
+/*
+ * PartitionedResultDestReceiverReceive implements the receiveSlot function of
+ * PartitionedResultDestReceiver. It writes the row to the result of the
+ * partition that its partition column value falls into.
+ */
+static bool
+PartitionedResultDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
+{
+	PartitionedResultDestReceiver *resultDest = (PartitionedResultDestReceiver *) dest;
+	int partitionIndex = PartitionIndexForRow(resultDest, slot);
+	DestReceiver *partitionDest = resultDest->partitionDestArray[partitionIndex];
+
+	if (partitionDest == NULL)
+	{
+		/* the partition is not written */
+		return true;
+	}
+
+	return partitionDest->receiveSlot(slot, partitionDest);
+}
+
+
+/*
+ * PartitionIndexForRow returns the index of the partition that the row in the
+ * given slot belongs to.
+ */
+static int
+PartitionIndexForRow(PartitionedResultDestReceiver *resultDest, TupleTableSlot *slot)
+{
+	EState *executorState = resultDest->executorState;
+	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
+	MemoryContext oldContext = NULL;
+	Datum partitionValue = 0;
+	bool partitionValueNull = false;
+	int partitionIndex = 0;
+
+	partitionValue = slot_getattr(slot, resultDest->partitionColumnIndex + 1,
+								  &partitionValueNull);
+	if (partitionValueNull)
+	{
+		return 0;
+	}
+
+	/* the per-tuple context is reset after the row is written */
+	oldContext = MemoryContextSwitchTo(executorTupleContext);
+
+	if (resultDest->partitionMethod == DISTRIBUTE_BY_HASH)
+	{
+		partitionValue = FunctionCall1Coll(resultDest->hashFunction,
+										   resultDest->partitionColumnCollation,
+										   partitionValue);
+	}
+
+	partitionIndex = SearchCachedShardInterval(partitionValue,
+											   resultDest->partitionIntervalArray,
+											   resultDest->partitionCount,
+											   resultDest->compareFunction);
+
+	MemoryContextSwitchTo(oldContext);
+
+	if (partitionIndex == INVALID_SHARD_INDEX)
+	{
+		ereport(ERROR, (errmsg("could not find the partition of a row in the "
+							   "intermediate result")));
+	}
+
+	return partitionIndex;
+}
+
+
+/*
+ * PartitionedResultDestReceiverShutdown implements the rShutdown interface of
+ * PartitionedResultDestReceiver by shutting down the receivers of all
+ * partitions.
+ */
+static void
+PartitionedResultDestReceiverShutdown(DestReceiver *destReceiver)
+{
+	PartitionedResultDestReceiver *resultDest =
+		(PartitionedResultDestReceiver *) destReceiver;
+	int partitionIndex = 0;
+
+	for (partitionIndex = 0; partitionIndex < resultDest->partitionCount;
+		 partitionIndex++)
+	{
+		DestReceiver *partitionDest = resultDest->partitionDestArray[partitionIndex];
+
+		if (partitionDest != NULL)
+		{
+			partitionDest->rShutdown(partitionDest);
+		}
+	}
+}
+
+
+/*
+ * PartitionedResultDestReceiverDestroy frees memory allocated as part of the
+ * PartitionedResultDestReceiver and the receivers of its partitions.
+ */
+static void
+PartitionedResultDestReceiverDestroy(DestReceiver *destReceiver)
+{
+	PartitionedResultDestReceiver *resultDest =
+		(PartitionedResultDestReceiver *) destReceiver;
+	int partitionIndex = 0;
+
+	for (partitionIndex = 0; partitionIndex < resultDest->partitionCount;
+		 partitionIndex++)
+	{
+		DestReceiver *partitionDest = resultDest->partitionDestArray[partitionIndex];
+
+		if (partitionDest != NULL)
+		{
+			partitionDest->rDestroy(partitionDest);
+		}
+	}
+
+	pfree(resultDest->partitionDestArray);
+	pfree(resultDest);
+}
+
+
+/*
+ * CreateTeeDestReceiver creates a DestReceiver that passes the rows it
+ * receives on to each receiver in destReceiverList.
+ */
+DestReceiver *
+CreateTeeDestReceiver(List *destReceiverList)
+{
+	TeeDestReceiver *teeDest = (TeeDestReceiver *) palloc0(sizeof(TeeDestReceiver));
+
+	/* set up the DestReceiver function pointers */
+	teeDest->pub.receiveSlot = TeeDestReceiverReceive;
+	teeDest->pub.rStartup = TeeDestReceiverStartup;
+	teeDest->pub.rShutdown = TeeDestReceiverShutdown;
+	teeDest->pub.rDestroy = TeeDestReceiverDestroy;
+	teeDest->pub.mydest = DestCopyOut;
+
+	teeDest->destReceiverList = destReceiverList;
+
+	return (DestReceiver *) teeDest;
+}
+
+
+/*
+ * TeeDestReceiverStartup implements the rStartup interface of TeeDestReceiver
+ * by starting up all of its receivers.
+ */
+static void
+TeeDestReceiverStartup(DestReceiver *dest, int operation, TupleDesc inputTupleDescriptor)
+{
+	TeeDestReceiver *teeDest = (TeeDestReceiver *) dest;
+	ListCell *destReceiverCell = NULL;
+
+	foreach(destReceiverCell, teeDest->destReceiverList)
+	{
+		DestReceiver *destReceiver = (DestReceiver *) lfirst(destReceiverCell);
+
+		destReceiver->rStartup(destReceiver, operation, inputTupleDescriptor);
+	}
+}
+
+
+/*
+ * TeeDestReceiverReceive implements the receiveSlot function of
+ * TeeDestReceiver by passing the row on to all of its receivers.
+ */
+static bool
+TeeDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
+{
+	TeeDestReceiver *teeDest = (TeeDestReceiver *) dest;
+	ListCell *destReceiverCell = NULL;
+
+	foreach(destReceiverCell, teeDest->destReceiverList)
+	{
+		DestReceiver *destReceiver = (DestReceiver *) lfirst(destReceiverCell);
+
+		if (!destReceiver->receiveSlot(slot, destReceiver))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * TeeDestReceiverShutdown implements the rShutdown interface of
+ * TeeDestReceiver by shutting down all of its receivers.
+ */
+static void
+TeeDestReceiverShutdown(DestReceiver *destReceiver)
+{
+	TeeDestReceiver *teeDest = (TeeDestReceiver *) destReceiver;
+	ListCell *destReceiverCell = NULL;
+
+	foreach(destReceiverCell, teeDest->destReceiverList)
+	{
+		DestReceiver *teeDestReceiver = (DestReceiver *) lfirst(destReceiverCell);
+
+		teeDestReceiver->rShutdown(teeDestReceiver);
+	}
+}
+
+
+/*
+ * TeeDestReceiverDestroy frees memory allocated as part of the
+ * TeeDestReceiver and its receivers.
+ */
+static void
+TeeDestReceiverDestroy(DestReceiver *destReceiver)
+{
+	TeeDestReceiver *teeDest = (TeeDestReceiver *) destReceiver;
+	ListCell *destReceiverCell = NULL;
+
+	foreach(destReceiverCell, teeDest->destReceiverList)
+	{
+		DestReceiver *teeDestReceiver = (DestReceiver *) lfirst(destReceiverCell);
+
+		teeDestReceiver->rDestroy(teeDestReceiver);
+	}
+
+	list_free(teeDest->destReceiverList);
+	pfree(teeDest);
+}
+
+
+/*
+ * CreateRemoteFileDestReceiver creates a DestReceiver that streams results
+ * to a set of worker nodes. If the scope of the intermediate result is a
+ * distributed transaction, then it's up to the caller to ensure that a
+ * coordinated transaction is started prior to using the DestReceiver.
+ */
+DestReceiver *
+CreateRemoteFileDestReceiver(char *resultId, EState *executorState,
+							 List *initialNodeList, bool writeLocalFile)
+{
+	RemoteFileDestReceiver *resultDest = NULL;
+
+	resultDest = (RemoteFileDestReceiver *) palloc0(sizeof(RemoteFileDestReceiver));
+
+	/* set up the DestReceiver function pointers */
+	resultDest->pub.receiveSlot = RemoteFileDestReceiverReceive;
+	resultDest->pub.rStartup = RemoteFileDestReceiverStartup;
+	resultDest->pub.rShutdown = RemoteFileDestReceiverShutdown;
+	resultDest->pub.rDestroy = RemoteFileDestReceiverDestroy;
+	resultDest->pub.mydest = DestCopyOut;
+
+	/* set up output parameters */
+	resultDest->resultId = resultId;
+	resultDest->executorState = executorState;
+	resultDest->initialNodeList = initialNodeList;
+	resultDest->memoryContext = CurrentMemoryContext;
+	resultDest->writeLocalFile = writeLocalFile;
+	resultDest->compressed = CompressIntermediateResults;
+
+	return (DestReceiver *) resultDest;
+}
+
+
+/*
+ * RemoteFileDestReceiverStartup implements the rStartup interface of
+ * RemoteFileDestReceiver. It opens connections to the nodes in initialNodeList,
+ * and sends the COPY command on all connections.
+ */
+static void
+RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
+							  TupleDesc inputTupleDescriptor)
+{
+	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) dest;
+
+	const char *resultId = resultDest->resultId;
+
+	CopyOutState copyOutState = NULL;
+	const char *delimiterCharacter = "\t";
+	const char *nullPrintCharacter = "\\N";
+
+	List *initialNodeList = resultDest->initialNodeList;
+	ListCell *initialNodeCell = NULL;
+	List *connectionList = NIL;
+	ListCell *connectionCell = NULL;
+
+	resultDest->tupleDescriptor = inputTupleDescriptor;
+
+	/* define how tuples will be serialised */
+	copyOutState = (CopyOutState) palloc0(sizeof(CopyOutStateData));
+	copyOutState->delim = (char *) delimiterCharacter;
+	copyOutState->null_print = (char *) nullPrintCharacter;
+	copyOutState->null_print_client = (char *) nullPrintCharacter;
+	copyOutState->binary = CanUseBinaryCopyFormat(inputTupleDescriptor);
+	copyOutState->fe_msgbuf = makeStringInfo();
+	copyOutState->rowcontext = GetPerTupleMemoryContext(resultDest->executorState);
+	resultDest->copyOutState = copyOutState;
+
+	resultDest->columnOutputFunctions = ColumnOutputFunctions(inputTupleDescriptor,
+															  copyOutState->binary);
+
+	if (resultDest->writeLocalFile)
+	{
+		const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
+		const int fileMode = (S_IRUSR | S_IWUSR);
+		const char *fileName = NULL;
+
+		/* make sure the directory exists */
+		CreateIntermediateResultsDirectory();
+
+		fileName = QueryResultFileName(resultId);
+
+		elog(DEBUG4, "writing to local file \"%s\"", fileName);
+
+		resultDest->fileCompat = FileCompatFromFileStart(FileOpenForTransmit(fileName,
+																			 fileFlags,
+																			 fileMode));
+	}
+
+	foreach(initialNodeCell, initialNodeList)
+	{
+		WorkerNode *workerNode = (WorkerNode *) lfirst(initialNodeCell);
+		char *nodeName = workerNode->workerName;
+		int nodePort = workerNode->workerPort;
+		MultiConnection *connection = NULL;
+
+		/*
+		 * We prefer to use a connection that is not associcated with
+		 * any placements. The reason is that we claim this connection
+		 * exclusively and that would prevent the consecutive DML/DDL
+		 * use the same connection.
+		 */
+		connection = StartNonDataAccessConnection(nodeName, nodePort);
+		ClaimConnectionExclusively(connection);
+		MarkRemoteTransactionCritical(connection);
+
+		connectionList = lappend(connectionList, connection);
+	}
+
+	FinishConnectionListEstablishment(connectionList);
+
+	/* must open transaction blocks to use intermediate results */
+	RemoteTransactionsBeginIfNecessary(connectionList);
+
+	foreach(connectionCell, connectionList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+		StringInfo copyCommand = NULL;
+		bool querySent = false;
+
+		copyCommand = ConstructCopyResultStatement(resultId);
+
+		querySent = SendRemoteCommand(connection, copyCommand->data);
+		if (!querySent)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+	}
+
+	foreach(connectionCell, connectionList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+		bool raiseInterrupts = true;
+
+		PGresult *result = GetRemoteCommandResult(connection, raiseInterrupts);
+		if (PQresultStatus(result) != PGRES_COPY_IN)
+		{
+			ReportResultError(connection, result, ERROR);
+		}
+
+		PQclear(result);
+	}
+
+	resultDest->connectionList = connectionList;
+
+	if (resultDest->compressed)
+	{
+		/* the signature tells readers that the blocks need to be decompressed */
+		StringInfo signature = makeStringInfo();
+
+		appendBinaryStringInfo(signature, CompressedResultSignature,
+							   sizeof(CompressedResultSignature));
+		SendResultBytes(resultDest, signature);
+
+		FreeStringInfo(signature);
+
+		resultDest->blockData = makeStringInfo();
+	}
+
+	if (copyOutState->binary)
+	{
+		/* send headers when using binary encoding */
+		resetStringInfo(copyOutState->fe_msgbuf);
+		AppendCopyBinaryHeaders(copyOutState);
+		SendResultData(resultDest, copyOutState->fe_msgbuf);
+	}
+}
+
+
+/*
+ * ConstructCopyResultStatement constructs the text of a COPY statement
+ * for copying into a result file.
+ */
+static StringInfo
+ConstructCopyResultStatement(const char *resultId)
+{
+	StringInfo command = makeStringInfo();
+
+	appendStringInfo(command, "COPY \"%s\" FROM STDIN WITH (format result)",
+					 resultId);
+
+	return command;
+}
+
+
+/*
+ * RemoteFileDestReceiverReceive implements the receiveSlot function of
+ * RemoteFileDestReceiver. It takes a TupleTableSlot and sends the contents to
+ * all worker nodes.
+ */
+static bool
+RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
+{
+	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) dest;
+
+	TupleDesc tupleDescriptor = resultDest->tupleDescriptor;
+
+	CopyOutState copyOutState = resultDest->copyOutState;
+	FmgrInfo *columnOutputFunctions = resultDest->columnOutputFunctions;
+
+	Datum *columnValues = NULL;
+	bool *columnNulls = NULL;
+	StringInfo copyData = copyOutState->fe_msgbuf;
+
+	EState *executorState = resultDest->executorState;
+	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
+	MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
+
+	slot_getallattrs(slot);
+
+	columnValues = slot->tts_values;
+	columnNulls = slot->tts_isnull;
+
+	resetStringInfo(copyData);
+
+	/* construct row in COPY format */
+	AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
+					  copyOutState, columnOutputFunctions, NULL);
+
+	/* send row to nodes and write to local file (if applicable) */
+	SendResultData(resultDest, copyData);
+
+	MemoryContextSwitchTo(oldContext);
+
+	resultDest->tuplesSent++;
+
+	ResetPerTupleExprContext(executorState);
+
+	return true;
+}
+
+
+/*
+ * SendResultData sends COPY data of the intermediate result to the nodes and
+ * writes it to the local file (if applicable). When compressing, the data is
+ * collected until it fills a block, which is compressed and then sent.
+ */
+static void
+SendResultData(RemoteFileDestReceiver *resultDest, StringInfo data)
+{
+	if (!resultDest->compressed)
+	{
+		SendResultBytes(resultDest, data);
+		return;
+	}
+
+	appendBinaryStringInfo(resultDest->blockData, data->data, data->len);
+
+	if (resultDest->blockData->len >= CompressedResultBlockSize)
+	{
+		FlushResultBlock(resultDest);
+	}
+}
+
+
+/*
+ * FlushResultBlock compresses the COPY data collected in the current block
+ * and sends the block to the nodes and the local file (if applicable).
+ */
+static void
+FlushResultBlock(RemoteFileDestReceiver *resultDest)
+{
+	StringInfo blockData = resultDest->blockData;
+	StringInfo block = NULL;
+
+	if (blockData->len == 0)
+	{
+		return;
+	}
+
+	block = CompressResultBlock(blockData->data, blockData->len);
+	SendResultBytes(resultDest, block);
+
+	FreeStringInfo(block);
+	resetStringInfo(blockData);
+}
+
+
+/*
+ * SendResultBytes sends the given bytes as they are to the nodes and writes
+ * them to the local file (if applicable).
+ */
+static void
+SendResultBytes(RemoteFileDestReceiver *resultDest, StringInfo data)
+{
+	BroadcastCopyData(data, resultDest->connectionList);
+
+	if (resultDest->writeLocalFile)
+	{
+		WriteToLocalFile(data, &resultDest->fileCompat);
+	}
+}
+
+
+/*
+ * CompressResultBlock returns a block of a compressed intermediate result
+ * that contains the given data. A block starts with the length of the data
+ * and the length of the stored bytes in network byte order, followed by the
+ * stored bytes. Data that pglz cannot compress is stored as is, which
+ * readers recognise by the lengths being equal.
+ */
+static StringInfo
+CompressResultBlock(const char *data, int32 rawLength)
+{
+	StringInfo block = makeStringInfo();
+	const int headerLength = 2 * sizeof(uint32);
+	int32 storedLength = 0;
+	uint32 networkLength = 0;
+
+	enlargeStringInfo(block, headerLength + PGLZ_MAX_OUTPUT(rawLength));
+
+	storedLength = pglz_compress(data, rawLength, block->data + headerLength,
+								 PGLZ_strategy_default);
+	if (storedLength < 0)
+	{
+		memcpy(block->data + headerLength, data, rawLength);
+		storedLength = rawLength;
+	}
+
+	networkLength = htonl((uint32) rawLength);
+	memcpy(block->data, &networkLength, sizeof(uint32));
+	networkLength = htonl((uint32) storedLength);
+	memcpy(block->data + sizeof(uint32), &networkLength, sizeof(uint32));
+
+	block->len = headerLength + storedLength;
+	block->data[block->len] = '\0';
+
+	return block;
+}
+
+
+/*
+ * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file.
+ */
+static void
+WriteToLocalFile(StringInfo copyData, FileCompat *fileCompat)
+{
+	int bytesWritten = FileWriteCompat(fileCompat, copyData->data,
+									   copyData->len,
+									   PG_WAIT_IO);
+	if (bytesWritten < 0)
+	{
+		ereport(ERROR, (errcode_for_file_access(),
+						errmsg("could not append to file: %m")));
+	}
+}
+
+
+/*
+ * RemoteFileDestReceiverShutdown implements the rShutdown interface of
+ * RemoteFileDestReceiver. It ends the COPY on all the open connections and closes
+ * the relation.
+ */
+static void
+RemoteFileDestReceiverShutdown(DestReceiver *destReceiver)
+{
+	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) destReceiver;
+
+	List *connectionList = resultDest->connectionList;
+	CopyOutState copyOutState = resultDest->copyOutState;
+
+	if (copyOutState->binary)
+	{
+		/* send footers when using binary encoding */
+		resetStringInfo(copyOutState->fe_msgbuf);
+		AppendCopyBinaryFooters(copyOutState);
+		SendResultData(resultDest, copyOutState->fe_msgbuf);
+	}
+
+	if (resultDest->compressed)
+	{
+		/* send the last, partially filled block */
+		FlushResultBlock(resultDest);
+	}
+
+	/* close the COPY input */
+	EndRemoteCopy(0, connectionList);
+
+	if (resultDest->writeLocalFile)
+	{
+		FileClose(resultDest->fileCompat.fd);
+	}
+}
+
+
+/*
+ * BroadcastCopyData sends copy data to all connections in a list.
+ */
+static void
+BroadcastCopyData(StringInfo dataBuffer, List *connectionList)
+{
+	ListCell *connectionCell = NULL;
+	foreach(connectionCell, connectionList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+		SendCopyDataOverConnection(dataBuffer, connection);
+	}
+}
+
+
+/*
+ * SendCopyDataOverConnection sends serialized COPY data over the given
+ * connection.
+ */
+static void
+SendCopyDataOverConnection(StringInfo dataBuffer, MultiConnection *connection)
+{
+	if (!PutRemoteCopyData(connection, dataBuffer->data, dataBuffer->len))
+	{
+		ReportConnectionError(connection, ERROR);
+	}
+}
+
+
+/*
+ * RemoteFileDestReceiverDestroy frees memory allocated as part of the
+ * RemoteFileDestReceiver and closes file descriptors.
+ */
+static void
+RemoteFileDestReceiverDestroy(DestReceiver *destReceiver)
+{
+	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) destReceiver;
+
+	if (resultDest->copyOutState)
+	{
+		pfree(resultDest->copyOutState);
+	}
+
+	if (resultDest->columnOutputFunctions)
+	{
+		pfree(resultDest->columnOutputFunctions);
+	}
+
+	if (resultDest->blockData)
+	{
+		FreeStringInfo(resultDest->blockData);
+	}
+
+	pfree(resultDest);
+}
+
+
+/*
+ * ReceiveQueryResultViaCopy is called when a COPY "resultid" FROM
+ * STDIN WITH (format result) command is received from the client.
+ * The command is followed by the raw copy data stream, which is
+ * redirected to a file.
+ *
+ * File names are automatically prefixed with the user OID. Users
+ * are only allowed to read query results from their own directory.
+ */
+void
+ReceiveQueryResultViaCopy(const char *resultId)
+{
+	const char *resultFileName = NULL;
+
+	CreateIntermediateResultsDirectory();
+
+	resultFileName = QueryResultFileName(resultId);
+
+	RedirectCopyDataToRegularFile(resultFileName);
+}
+
+
+/*
+ * SendQueryResultViaCopy is called when a COPY "resultid" TO STDOUT
+ * WITH (format result) command is received from the client. The
+ * contents of the result file are sent using the copy protocol.
+ */
+void
+SendQueryResultViaCopy(const char *resultId)
+{
+	const char *resultFileName = QueryResultFileName(resultId);
+
+	SendRegularFile(resultFileName);
+}
+
+
+/*
+ * fetch_intermediate_result_pieces is a UDF that assembles an intermediate
+ * result out of pieces that are stored on other nodes, e.g.:
+ *
+ * SELECT fetch_intermediate_result_pieces('1_1', ARRAY['1_1_5', '1_1_6'],
+ *										   ARRAY['host1', 'host2'],
+ *										   ARRAY[5432, 5432])
+ *
+ * Pieces that are not stored on the local node are fetched in parallel over
+ * one dedicated connection per node, which assigns the distributed
+ * transaction ID of the caller, since
+ * the pieces are stored in the directory of the distributed transaction that
+ * created them. The function returns the size of the assembled result in
+ * bytes.
+ */
+Datum
+fetch_intermediate_result_pieces(PG_FUNCTION_ARGS)
+{
+	text *resultIdText = PG_GETARG_TEXT_P(0);
+	char *resultIdString = text_to_cstring(resultIdText);
+	ArrayType *pieceIdArray = PG_GETARG_ARRAYTYPE_P(1);
+	ArrayType *nodeNameArray = PG_GETARG_ARRAYTYPE_P(2);
+	ArrayType *nodePortArray = PG_GETARG_ARRAYTYPE_P(3);
+	List *pieceList = NIL;
+	int64 resultSize = 0;
+
+	CheckCitusVersion(ERROR);
+
+	pieceList = IntermediateResultPieceList(pieceIdArray, nodeNameArray,
+											nodePortArray);
+
+	resultSize = AssembleIntermediateResult(resultIdString, pieceList);
+
+	PG_RETURN_INT64(resultSize);
+}
+
+
+/*
+ * IntermediateResultPieceList builds a list of intermediate result pieces out
+ * of the arguments of fetch_intermediate_result_pieces.
+ */
+static List *
+IntermediateResultPieceList(ArrayType *pieceIdArray, ArrayType *nodeNameArray,
+							ArrayType *nodePortArray)
+{
+	List *pieceList = NIL;
+	Datum *pieceIdDatumArray = DeconstructArrayObject(pieceIdArray);
+	Datum *nodeNameDatumArray = DeconstructArrayObject(nodeNameArray);
+	Datum *nodePortDatumArray = DeconstructArrayObject(nodePortArray);
+	int32 pieceCount = ArrayObjectCount(pieceIdArray);
+	int32 pieceIndex = 0;
+
+	if (ArrayObjectCount(nodeNameArray) != pieceCount ||
+		ArrayObjectCount(nodePortArray) != pieceCount)
+	{
+		ereport(ERROR, (errmsg("the number of node names and ports must match "
+							   "the number of result pieces")));
+	}
+
+	for (pieceIndex = 0; pieceIndex < pieceCount; pieceIndex++)
+	{
+		IntermediateResultPiece *piece =
+			(IntermediateResultPiece *) palloc0(sizeof(IntermediateResultPiece));
+
+		piece->pieceId = TextDatumGetCString(pieceIdDatumArray[pieceIndex]);
+		piece->nodeName = TextDatumGetCString(nodeNameDatumArray[pieceIndex]);
+		piece->nodePort = DatumGetInt32(nodePortDatumArray[pieceIndex]);
+
+		pieceList = lappend(pieceList, piece);
+	}
+
+	return pieceList;
+}
+
+
+/*
+ * FetchIntermediateResultPieces assembles an intermediate result out of the
+ * given pieces on the nodes in nodeList, and on the local node if
+ * writeLocalFile is set. The nodes fetch the pieces directly from the nodes
+ * that store them, such that the rows do not pass through this node.
+ */
+void
+FetchIntermediateResultPieces(char *resultId, List *pieceList, List *nodeList,
+							  bool writeLocalFile)
+{
+	StringInfo fetchCommand = FetchIntermediateResultPiecesCommand(resultId,
+																   pieceList);
+	List *commandList = NIL;
+	List *connectionList = NIL;
+	ListCell *nodeCell = NULL;
+
+	foreach(nodeCell, nodeList)
+	{
+		commandList = lappend(commandList, fetchCommand->data);
+	}
+
+	connectionList = StartIntermediateResultCommands(nodeList, commandList);
+
+	/* assemble the local copy while the other nodes fetch the pieces */
+	if (writeLocalFile)
+	{
+		AssembleIntermediateResult(resultId, pieceList);
+	}
+
+	FinishIntermediateResultCommands(connectionList);
+}
+
+
+/*
+ * StartIntermediateResultCommands sends the commands in commandList to the
+ * nodes at the same position in nodeList over connections that take part in
+ * the distributed transaction, such that the commands see the intermediate
+ * results of the transaction. A command may consist of several statements.
+ * The function returns the connections, which should be passed to
+ * FinishIntermediateResultCommands.
+ */
+List *
+StartIntermediateResultCommands(List *nodeList, List *commandList)
+{
+	List *connectionList = NIL;
+	ListCell *nodeCell = NULL;
+	ListCell *connectionCell = NULL;
+	ListCell *commandCell = NULL;
+
+	foreach(nodeCell, nodeList)
+	{
+		WorkerNode *workerNode = (WorkerNode *) lfirst(nodeCell);
+		MultiConnection *connection =
+			StartNonDataAccessConnection(workerNode->workerName,
+										 workerNode->workerPort);
+
+		ClaimConnectionExclusively(connection);
+		MarkRemoteTransactionCritical(connection);
+
+		connectionList = lappend(connectionList, connection);
+	}
+
+	FinishConnectionListEstablishment(connectionList);
+
+	/* must open transaction blocks to use intermediate results */
+	RemoteTransactionsBeginIfNecessary(connectionList);
+
+	forboth(connectionCell, connectionList, commandCell, commandList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+		char *command = (char *) lfirst(commandCell);
+
+		if (!SendRemoteCommand(connection, command))
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+	}
+
+	return connectionList;
+}
+
+
+/*
+ * FinishIntermediateResultCommands waits for the results of the commands
+ * sent by StartIntermediateResultCommands and errors out if any of them
+ * failed.
+ */
+void
+FinishIntermediateResultCommands(List *connectionList)
+{
+	ListCell *connectionCell = NULL;
+
+	foreach(connectionCell, connectionList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+		bool raiseInterrupts = true;
+		PGresult *result = GetRemoteCommandResult(connection, raiseInterrupts);
+
+		while (result != NULL)
+		{
+			if (!IsResponseOK(result))
+			{
+				ReportResultError(connection, result, ERROR);
+			}
+
+			PQclear(result);
+			result = GetRemoteCommandResult(connection, raiseInterrupts);
+		}
+
+		UnclaimConnection(connection);
+	}
+}
+
+
+/*
+ * FetchIntermediateResultPiecesCommand returns the fetch_intermediate_result_pieces
+ * call that assembles the given result out of the given pieces.
+ */
+StringInfo
+FetchIntermediateResultPiecesCommand(char *resultId, List *pieceList)
+{
+	StringInfo command = makeStringInfo();
+	StringInfo pieceIdArray = makeStringInfo();
+	StringInfo nodeNameArray = makeStringInfo();
+	StringInfo nodePortArray = makeStringInfo();
+	ListCell *pieceCell = NULL;
+
+	foreach(pieceCell, pieceList)
+	{
+		IntermediateResultPiece *piece = (IntermediateResultPiece *) lfirst(pieceCell);
+		const char *separator = (pieceCell == list_head(pieceList)) ? "" : ",";
+
+		appendStringInfo(pieceIdArray, "%s%s", separator,
+						 quote_literal_cstr(piece->pieceId));
+		appendStringInfo(nodeNameArray, "%s%s", separator,
+						 quote_literal_cstr(piece->nodeName));
+		appendStringInfo(nodePortArray, "%s%d", separator, piece->nodePort);
+	}
+
+	appendStringInfo(command,
+					 "SELECT pg_catalog.fetch_intermediate_result_pieces(%s, "
+					 "ARRAY[%s]::text[], ARRAY[%s]::text[], ARRAY[%s]::int[])",
+					 quote_literal_cstr(resultId), pieceIdArray->data,
+					 nodeNameArray->data, nodePortArray->data);
+
+	return command;
+}
+
+
+/*
+ * AssembleIntermediateResult writes the given pieces into the local file of
+ * the intermediate result, fetching the pieces that are not stored locally
+ * first. Since the pieces are files in the COPY format, the header and
+ * trailer of binary files are only written once. The result is written in
+ * compressed blocks if the first piece is. The function returns the size of
+ * the result in bytes.
+ */
+static int64
+AssembleIntermediateResult(char *resultId, List *pieceList)
+{
+	const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
+	const int fileMode = (S_IRUSR | S_IWUSR);
+	const char *resultFileName = NULL;
+	File resultFileDesc = -1;
+	FileCompat resultFile;
+	StringInfo resultData = makeStringInfo();
+	ListCell *pieceCell = NULL;
+	bool binaryFormat = false;
+	bool compressed = false;
+
+	FetchRemoteIntermediateResultPieces(pieceList);
+
+	CreateIntermediateResultsDirectory();
+
+	resultFileName = QueryResultFileName(resultId);
+	resultFileDesc = FileOpenForTransmit(resultFileName, fileFlags, fileMode);
+	resultFile = FileCompatFromFileStart(resultFileDesc);
+
+	foreach(pieceCell, pieceList)
+	{
+		IntermediateResultPiece *piece = (IntermediateResultPiece *) lfirst(pieceCell);
+		bool isFirstPiece = (pieceCell == list_head(pieceList));
+
+		AppendIntermediateResultPiece(&resultFile, resultData, piece, isFirstPiece,
+									  &binaryFormat, &compressed);
+	}
+
+	if (binaryFormat)
+	{
+		/* the trailer of binary files is a field count of -1 */
+		uint16 fieldCount = htons((uint16) -1);
+
+		appendBinaryStringInfo(resultData, (char *) &fieldCount, sizeof(fieldCount));
+	}
+
+	WriteAssembledData(&resultFile, resultData, compressed, true);
+
+	FreeStringInfo(resultData);
+	FileClose(resultFileDesc);
+
+	return IntermediateResultSize(resultId);
+}
+
+
+/*
+ * AppendIntermediateResultPiece appends the rows in the file of the given
+ * piece to the result data, and writes the result data to the result file
+ * as it grows. For binary files, the header is only written for the first
+ * piece and the trailer is skipped. Whether the pieces are in the binary
+ * format and whether the result is compressed is determined from the first
+ * piece.
+ */
+static void
+AppendIntermediateResultPiece(FileCompat *resultFile, StringInfo resultData,
+							  IntermediateResultPiece *piece, bool isFirstPiece,
+							  bool *binaryFormat, bool *compressed)
+{
+	const int bufferSize = 32768; /* 32 KB */
+	const int binaryHeaderLength = sizeof(BinarySignature) + 2 * sizeof(uint32);
+	const int binaryTrailerLength = sizeof(uint16);
+	const char *pieceFileName = QueryResultFileName(piece->pieceId);
+	IntermediateResultReader *reader = OpenIntermediateResultReader(pieceFileName);
+	StringInfo buffer = makeStringInfo();
+	int heldBackLength = 0;
+
+	enlargeStringInfo(buffer, bufferSize + binaryTrailerLength);
+
+	if (isFirstPiece)
+	{
+		*compressed = reader->compressed;
+		if (*compressed)
+		{
+			appendBinaryStringInfo(buffer, CompressedResultSignature,
+								   sizeof(CompressedResultSignature));
+			WriteToLocalFile(buffer, resultFile);
+			resetStringInfo(buffer);
+		}
+
+		/* peek at the signature without consuming the header */
+		buffer->len = ReadIntermediateResultData(reader, buffer->data,
+												 sizeof(BinarySignature));
+		*binaryFormat = buffer->len == sizeof(BinarySignature) &&
+						memcmp(buffer->data, BinarySignature,
+							   sizeof(BinarySignature)) == 0;
+
+		appendBinaryStringInfo(resultData, buffer->data, buffer->len);
+	}
+
+	if (*binaryFormat)
+	{
+		int headerRemaining = binaryHeaderLength;
+		uint32 extensionLength = 0;
+
+		if (isFirstPiece)
+		{
+			headerRemaining -= sizeof(BinarySignature);
+		}
+
+		/* the header ends with the length of the header extension */
+		resetStringInfo(buffer);
+		buffer->len = ReadIntermediateResultData(reader, buffer->data, headerRemaining);
+		if (buffer->len < headerRemaining)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+							errmsg("intermediate result \"%s\" is truncated",
+								   piece->pieceId)));
+		}
+
+		memcpy(&extensionLength, buffer->data + headerRemaining - sizeof(uint32),
+			   sizeof(uint32));
+		extensionLength = ntohl(extensionLength);
+
+		enlargeStringInfo(buffer, extensionLength);
+		buffer->len += ReadIntermediateResultData(reader, buffer->data + buffer->len,
+												  extensionLength);
+
+		if (isFirstPiece)
+		{
+			appendBinaryStringInfo(resultData, buffer->data, buffer->len);
+		}
+
+		/* hold back the trailer, which is only known once the piece ends */
+		heldBackLength = binaryTrailerLength;
+	}
+
+	resetStringInfo(buffer);
+
+	while (true)
+	{
+		int bytesRead = ReadIntermediateResultData(reader, buffer->data + buffer->len,
+												   bufferSize);
+		int appendLength = 0;
+
+		if (bytesRead == 0)
+		{
+			break;
+		}
+
+		buffer->len += bytesRead;
+
+		appendLength = Max(buffer->len - heldBackLength, 0);
+		appendBinaryStringInfo(resultData, buffer->data, appendLength);
+
+		memmove(buffer->data, buffer->data + appendLength, buffer->len - appendLength);
+		buffer->len -= appendLength;
+
+		WriteAssembledData(resultFile, resultData, *compressed, false);
+	}
+
+	FreeStringInfo(buffer);
+	CloseIntermediateResultReader(reader);
+}
+
+
+/*
+ * WriteAssembledData writes the data collected in resultData to the result
+ * file. Compressed results are written in blocks, such that data is only
+ * written once it fills a block, or when flush is set.
+ */
+static void
+WriteAssembledData(FileCompat *resultFile, StringInfo resultData, bool compressed,
+				   bool flush)
+{
+	if (resultData->len == 0)
+	{
+		return;
+	}
+
+	if (!compressed)
+	{
+		WriteToLocalFile(resultData, resultFile);
+		resetStringInfo(resultData);
+	}
+	else if (flush || resultData->len >= CompressedResultBlockSize)
+	{
+		StringInfo block = CompressResultBlock(resultData->data, resultData->len);
+
+		WriteToLocalFile(block, resultFile);
+		FreeStringInfo(block);
+		resetStringInfo(resultData);
+	}
+}
+
+
+/*
+ * OpenIntermediateResultReader opens the given intermediate result file for
+ * reading its COPY data, and checks whether it is written in compressed
+ * blocks.
+ */
+static IntermediateResultReader *
+OpenIntermediateResultReader(const char *fileName)
+{
+	const int fileFlags = (O_RDONLY | PG_BINARY);
+	const int fileMode = 0;
+	IntermediateResultReader *reader =
+		(IntermediateResultReader *) palloc0(sizeof(IntermediateResultReader));
+	StringInfo pendingData = makeStringInfo();
+
+	reader->fileDesc = FileOpenForTransmit(fileName, fileFlags, fileMode);
+	reader->fileCompat = FileCompatFromFileStart(reader->fileDesc);
+
+	/* the bytes that are not a signature are returned by the first reads */
+	enlargeStringInfo(pendingData, sizeof(CompressedResultSignature));
+	pendingData->len = ReadFileData(&reader->fileCompat, pendingData->data,
+									sizeof(CompressedResultSignature));
+
+	if (pendingData->len == sizeof(CompressedResultSignature) &&
+		memcmp(pendingData->data, CompressedResultSignature,
+			   sizeof(CompressedResultSignature)) == 0)
+	{
+		reader->compressed = true;
+		resetStringInfo(pendingData);
+	}
+
+	reader->pendingData = pendingData;
+	reader->pendingOffset = 0;
+
+	return reader;
+}
+
+
+/*
+ * ReadIntermediateResultData reads up to the given amount of COPY data into
+ * the buffer and returns the number of bytes read, which is less than the
+ * amount only at the end of the file.
+ */
+static int
+ReadIntermediateResultData(IntermediateResultReader *reader, char *buffer, int amount)
+{
+	int totalRead = 0;
+
+	while (totalRead < amount)
+	{
+		StringInfo pendingData = reader->pendingData;
+		int pendingLength = pendingData->len - reader->pendingOffset;
+
+		if (pendingLength > 0)
+		{
+			int copyLength = Min(pendingLength, amount - totalRead);
+
+			memcpy(buffer + totalRead, pendingData->data + reader->pendingOffset,
+				   copyLength);
+
+			reader->pendingOffset += copyLength;
+			totalRead += copyLength;
+		}
+		else if (reader->compressed)
+		{
+			if (!ReadCompressedResultBlock(reader))
+			{
+				break;
+			}
+		}
+		else
+		{
+			totalRead += ReadFileData(&reader->fileCompat, buffer + totalRead,
+									  amount - totalRead);
+			break;
+		}
+	}
+
+	return totalRead;
+}
+
+
+/*
+ * ReadCompressedResultBlock reads the next block of a compressed intermediate
+ * result into the pending data of the reader and returns true, or returns
+ * false at the end of the file.
+ */
+static bool
+ReadCompressedResultBlock(IntermediateResultReader *reader)
+{
+	StringInfo pendingData = reader->pendingData;
+	uint32 blockHeader[2];
+	int headerLength = 0;
+	uint32 rawLength = 0;
+	uint32 storedLength = 0;
+
+	headerLength = ReadFileData(&reader->fileCompat, (char *) blockHeader,
+								sizeof(blockHeader));
+	if (headerLength == 0)
+	{
+		return false;
+	}
+
+	rawLength = ntohl(blockHeader[0]);
+	storedLength = ntohl(blockHeader[1]);
+
+	if (headerLength < sizeof(blockHeader) || storedLength > rawLength ||
+		rawLength > MaxAllocSize)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+						errmsg("invalid block in compressed intermediate result")));
+	}
+
+	resetStringInfo(pendingData);
+	enlargeStringInfo(pendingData, rawLength);
+	reader->pendingOffset = 0;
+
+	if (storedLength == rawLength)
+	{
+		ReadFromFile(&reader->fileCompat, pendingData->data, rawLength);
+	}
+	else
+	{
+		char *storedData = palloc(storedLength);
+
+		ReadFromFile(&reader->fileCompat, storedData, storedLength);
+
+		if (PglzDecompressCompat(storedData, storedLength, pendingData->data,
+								 rawLength) != rawLength)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+							errmsg("could not decompress intermediate result block")));
+		}
+
+		pfree(storedData);
+	}
+
+	pendingData->len = rawLength;
+
+	return true;
+}
+
+
+/*
+ * CloseIntermediateResultReader closes the file of the reader and frees it.
+ */
+static void
+CloseIntermediateResultReader(IntermediateResultReader *reader)
+{
+	FileClose(reader->fileDesc);
+	FreeStringInfo(reader->pendingData);
+	pfree(reader);
+}
+
+
+/*
+ * ReadIntermediateResultCopyData is the data source of the COPY that parses
+ * the intermediate result in read_intermediate_result. It reads the data
+ * from CopyDataReader, which returns less than maxread bytes only at the end
+ * of the file.
+ */
+static int
+ReadIntermediateResultCopyData(void *outbuf, int minread, int maxread)
+{
+	return ReadIntermediateResultData(CopyDataReader, (char *) outbuf, maxread);
+}
+
+
+/*
+ * ReadFileData reads up to the given number of bytes from the file into the
+ * buffer and returns the number of bytes read, which is less than the amount
+ * only at the end of the file.
+ */
+static int
+ReadFileData(FileCompat *fileCompat, char *buffer, int amount)
+{
+	int totalRead = 0;
+
+	while (totalRead < amount)
+	{
+		int bytesRead = FileReadCompat(fileCompat, buffer + totalRead,
+									   amount - totalRead, PG_WAIT_IO);
+		if (bytesRead < 0)
+		{
+			ereport(ERROR, (errcode_for_file_access(),
+							errmsg("could not read intermediate result file: %m")));
+		}
+		else if (bytesRead == 0)
+		{
+			break;
+		}
 
-		/* make sure the directory exists */
-		CreateIntermediateResultsDirectory();
+		totalRead += bytesRead;
+	}
 
-		fileName = QueryResultFileName(resultId);
+	return totalRead;
+}
 
-		elog(DEBUG1, "writing to local file \"%s\"", fileName);
 
-		resultDest->fileCompat = FileCompatFromFileStart(FileOpenForTransmit(fileName,
-																			 fileFlags,
-																			 fileMode));
+/*
+ * ReadFromFile reads exactly the given number of bytes from the file into
+ * the buffer, and errors out if the file is shorter.
+ */
+static void
+ReadFromFile(FileCompat *fileCompat, char *buffer, int amount)
+{
+	if (ReadFileData(fileCompat, buffer, amount) < amount)
+	{
+		ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+						errmsg("intermediate result file is truncated")));
 	}
+}
 
-	foreach(initialNodeCell, initialNodeList)
+
+/*
+ * FetchRemoteIntermediateResultPieces copies the files of the given pieces
+ * that are not stored locally from the nodes that store them into local
+ * files. The pieces are stored in the directory of the distributed
+ * transaction, so we fetch them over new connections that assign the same
+ * distributed transaction ID. We open one connection per node and copy the
+ * pieces of different nodes in parallel. Since the connections do not modify
+ * anything, they do not take part in the distributed transaction and are
+ * closed once the pieces are copied.
+ */
+static void
+FetchRemoteIntermediateResultPieces(List *pieceList)
+{
+	List *fetchList = RemotePieceFetchList(pieceList);
+	List *connectionList = NIL;
+	List *pendingFetchList = NIL;
+	StringInfo beginCommand = NULL;
+	WaitEventSet *waitEventSet = NULL;
+	WaitEvent *events = NULL;
+	ListCell *fetchCell = NULL;
+	ListCell *connectionCell = NULL;
+	bool raiseErrors = true;
+
+	if (fetchList == NIL)
 	{
-		WorkerNode *workerNode = (WorkerNode *) lfirst(initialNodeCell);
-		char *nodeName = workerNode->workerName;
-		int nodePort = workerNode->workerPort;
-		MultiConnection *connection = NULL;
+		return;
+	}
 
-		/*
-		 * We prefer to use a connection that is not associcated with
-		 * any placements. The reason is that we claim this connection
-		 * exclusively and that would prevent the consecutive DML/DDL
-		 * use the same connection.
-		 */
-		connection = StartNonDataAccessConnection(nodeName, nodePort);
-		ClaimConnectionExclusively(connection);
-		MarkRemoteTransactionCritical(connection);
+	foreach(fetchCell, fetchList)
+	{
+		RemotePieceFetch *fetch = (RemotePieceFetch *) lfirst(fetchCell);
 
-		connectionList = lappend(connectionList, connection);
+		connectionList = lappend(connectionList, fetch->connection);
 	}
 
 	FinishConnectionListEstablishment(connectionList);
 
-	/* must open transaction blocks to use intermediate results */
-	RemoteTransactionsBeginIfNecessary(connectionList);
+	beginCommand = BeginAndSetDistributedTransactionIdCommand();
 
 	foreach(connectionCell, connectionList)
 	{
 		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
-		StringInfo copyCommand = NULL;
-		bool querySent = false;
-
-		copyCommand = ConstructCopyResultStatement(resultId);
 
-		querySent = SendRemoteCommand(connection, copyCommand->data);
-		if (!querySent)
+		if (PQstatus(connection->pgConn) != CONNECTION_OK ||
+			!SendRemoteCommand(connection, beginCommand->data))
 		{
 			ReportConnectionError(connection, ERROR);
 		}
@@ -313,228 +2153,314 @@ RemoteFileDestReceiverStartup(DestReceiver *dest, int operation,
 	foreach(connectionCell, connectionList)
 	{
 		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
-		bool raiseInterrupts = true;
 
-		PGresult *result = GetRemoteCommandResult(connection, raiseInterrupts);
-		if (PQresultStatus(result) != PGRES_COPY_IN)
-		{
-			ReportResultError(connection, result, ERROR);
-		}
-
-		PQclear(result);
+		ClearResults(connection, raiseErrors);
 	}
 
-	if (copyOutState->binary)
+	CreateIntermediateResultsDirectory();
+
+	foreach(fetchCell, fetchList)
 	{
-		/* send headers when using binary encoding */
-		resetStringInfo(copyOutState->fe_msgbuf);
-		AppendCopyBinaryHeaders(copyOutState);
-		BroadcastCopyData(copyOutState->fe_msgbuf, connectionList);
+		RemotePieceFetch *fetch = (RemotePieceFetch *) lfirst(fetchCell);
+
+		fetch->pieceCell = list_head(fetch->pieceList);
+		StartRemotePieceCopy(fetch);
 
-		if (resultDest->writeLocalFile)
+		/* the first rows may already have arrived with the response to COPY */
+		if (!ReceiveRemotePieceData(fetch))
 		{
-			WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
+			pendingFetchList = lappend(pendingFetchList, fetch);
 		}
 	}
 
-	resultDest->connectionList = connectionList;
-}
-
-
-/*
- * ConstructCopyResultStatement constructs the text of a COPY statement
- * for copying into a result file.
- */
-static StringInfo
-ConstructCopyResultStatement(const char *resultId)
-{
-	StringInfo command = makeStringInfo();
+	/* allocate pending connections + 2 for the signal latch and postmaster death */
+	events = palloc((list_length(fetchList) + 2) * sizeof(WaitEvent));
 
-	appendStringInfo(command, "COPY \"%s\" FROM STDIN WITH (format result)",
-					 resultId);
+	PG_TRY();
+	{
+		bool rebuildWaitEventSet = true;
 
-	return command;
-}
+		while (pendingFetchList != NIL)
+		{
+			int eventIndex = 0;
+			int eventCount = 0;
+			long timeout = -1;
 
+			/* rebuild the WaitEventSet whenever a node has sent all its pieces */
+			if (rebuildWaitEventSet)
+			{
+				if (waitEventSet != NULL)
+				{
+					FreeWaitEventSet(waitEventSet);
+				}
 
-/*
- * RemoteFileDestReceiverReceive implements the receiveSlot function of
- * RemoteFileDestReceiver. It takes a TupleTableSlot and sends the contents to
- * all worker nodes.
- */
-static bool
-RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
-{
-	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) dest;
+				waitEventSet = BuildRemotePieceFetchWaitEventSet(pendingFetchList);
 
-	TupleDesc tupleDescriptor = resultDest->tupleDescriptor;
+				rebuildWaitEventSet = false;
+			}
 
-	List *connectionList = resultDest->connectionList;
-	CopyOutState copyOutState = resultDest->copyOutState;
-	FmgrInfo *columnOutputFunctions = resultDest->columnOutputFunctions;
+			eventCount = WaitEventSetWait(waitEventSet, timeout, events,
+										  list_length(pendingFetchList) + 2,
+										  WAIT_EVENT_CLIENT_READ);
 
-	Datum *columnValues = NULL;
-	bool *columnNulls = NULL;
-	StringInfo copyData = copyOutState->fe_msgbuf;
+			for (eventIndex = 0; eventIndex < eventCount; eventIndex++)
+			{
+				WaitEvent *event = &events[eventIndex];
+				RemotePieceFetch *fetch = NULL;
 
-	EState *executorState = resultDest->executorState;
-	MemoryContext executorTupleContext = GetPerTupleMemoryContext(executorState);
-	MemoryContext oldContext = MemoryContextSwitchTo(executorTupleContext);
+				if (event->events & WL_POSTMASTER_DEATH)
+				{
+					ereport(ERROR, (errmsg("postmaster was shut down, exiting")));
+				}
 
-	slot_getallattrs(slot);
+				if (event->events & WL_LATCH_SET)
+				{
+					ResetLatch(MyLatch);
+					CHECK_FOR_INTERRUPTS();
 
-	columnValues = slot->tts_values;
-	columnNulls = slot->tts_isnull;
+					continue;
+				}
 
-	resetStringInfo(copyData);
+				fetch = (RemotePieceFetch *) event->user_data;
 
-	/* construct row in COPY format */
-	AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
-					  copyOutState, columnOutputFunctions, NULL);
+				if (ReceiveRemotePieceData(fetch))
+				{
+					pendingFetchList = list_delete_ptr(pendingFetchList, fetch);
+					rebuildWaitEventSet = true;
+				}
+			}
+		}
+	}
+	PG_CATCH();
+	{
+		if (waitEventSet != NULL)
+		{
+			FreeWaitEventSet(waitEventSet);
+		}
 
-	/* send row to nodes */
-	BroadcastCopyData(copyData, connectionList);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
 
-	/* write to local file (if applicable) */
-	if (resultDest->writeLocalFile)
+	if (waitEventSet != NULL)
 	{
-		WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
+		FreeWaitEventSet(waitEventSet);
 	}
 
-	MemoryContextSwitchTo(oldContext);
-
-	resultDest->tuplesSent++;
-
-	ResetPerTupleExprContext(executorState);
+	pfree(events);
 
-	return true;
-}
+	foreach(connectionCell, connectionList)
+	{
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
 
+		if (!SendRemoteCommand(connection, "END"))
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+	}
 
-/*
- * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file.
- */
-static void
-WriteToLocalFile(StringInfo copyData, FileCompat *fileCompat)
-{
-	int bytesWritten = FileWriteCompat(fileCompat, copyData->data,
-									   copyData->len,
-									   PG_WAIT_IO);
-	if (bytesWritten < 0)
+	foreach(connectionCell, connectionList)
 	{
-		ereport(ERROR, (errcode_for_file_access(),
-						errmsg("could not append to file: %m")));
+		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
+
+		ClearResults(connection, raiseErrors);
+		CloseConnection(connection);
 	}
 }
 
 
 /*
- * RemoteFileDestReceiverShutdown implements the rShutdown interface of
- * RemoteFileDestReceiver. It ends the COPY on all the open connections and closes
- * the relation.
+ * RemotePieceFetchList groups the given pieces that are not stored locally by
+ * the node that stores them, and starts a new connection to each of those
+ * nodes.
  */
-static void
-RemoteFileDestReceiverShutdown(DestReceiver *destReceiver)
+static List *
+RemotePieceFetchList(List *pieceList)
 {
-	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) destReceiver;
+	List *fetchList = NIL;
+	ListCell *pieceCell = NULL;
 
-	List *connectionList = resultDest->connectionList;
-	CopyOutState copyOutState = resultDest->copyOutState;
-
-	if (copyOutState->binary)
+	foreach(pieceCell, pieceList)
 	{
-		/* send footers when using binary encoding */
-		resetStringInfo(copyOutState->fe_msgbuf);
-		AppendCopyBinaryFooters(copyOutState);
-		BroadcastCopyData(copyOutState->fe_msgbuf, connectionList);
+		IntermediateResultPiece *piece = (IntermediateResultPiece *) lfirst(pieceCell);
+		RemotePieceFetch *nodeFetch = NULL;
+		ListCell *fetchCell = NULL;
 
-		if (resultDest->writeLocalFile)
+		/* pieces are unique in the transaction, so a local file is the piece */
+		if (IntermediateResultSize(piece->pieceId) >= 0)
 		{
-			WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
+			continue;
 		}
-	}
 
-	/* close the COPY input */
-	EndRemoteCopy(0, connectionList);
+		foreach(fetchCell, fetchList)
+		{
+			RemotePieceFetch *fetch = (RemotePieceFetch *) lfirst(fetchCell);
+			IntermediateResultPiece *firstPiece =
+				(IntermediateResultPiece *) linitial(fetch->pieceList);
 
-	if (resultDest->writeLocalFile)
-	{
-		FileClose(resultDest->fileCompat.fd);
-	}
-}
+			if (strcmp(firstPiece->nodeName, piece->nodeName) == 0 &&
+				firstPiece->nodePort == piece->nodePort)
+			{
+				nodeFetch = fetch;
+				break;
+			}
+		}
 
+		if (nodeFetch == NULL)
+		{
+			int connectionFlags = FORCE_NEW_CONNECTION;
 
-/*
- * BroadcastCopyData sends copy data to all connections in a list.
- */
-static void
-BroadcastCopyData(StringInfo dataBuffer, List *connectionList)
-{
-	ListCell *connectionCell = NULL;
-	foreach(connectionCell, connectionList)
-	{
-		MultiConnection *connection = (MultiConnection *) lfirst(connectionCell);
-		SendCopyDataOverConnection(dataBuffer, connection);
+			nodeFetch = (RemotePieceFetch *) palloc0(sizeof(RemotePieceFetch));
+			nodeFetch->connection = StartNodeConnection(connectionFlags,
+														piece->nodeName,
+														piece->nodePort);
+			nodeFetch->pieceFileDesc = -1;
+
+			fetchList = lappend(fetchList, nodeFetch);
+		}
+
+		nodeFetch->pieceList = lappend(nodeFetch->pieceList, piece);
 	}
+
+	return fetchList;
 }
 
 
 /*
- * SendCopyDataOverConnection sends serialized COPY data over the given
- * connection.
+ * StartRemotePieceCopy sends the COPY command for the current piece of the
+ * given fetch and opens the local file of the piece.
  */
 static void
-SendCopyDataOverConnection(StringInfo dataBuffer, MultiConnection *connection)
+StartRemotePieceCopy(RemotePieceFetch *fetch)
 {
-	if (!PutRemoteCopyData(connection, dataBuffer->data, dataBuffer->len))
+	const int fileFlags = (O_APPEND | O_CREAT | O_RDWR | O_TRUNC | PG_BINARY);
+	const int fileMode = (S_IRUSR | S_IWUSR);
+	IntermediateResultPiece *piece =
+		(IntermediateResultPiece *) lfirst(fetch->pieceCell);
+	MultiConnection *connection = fetch->connection;
+	StringInfo copyCommand = makeStringInfo();
+	PGresult *result = NULL;
+	bool raiseInterrupts = true;
+
+	appendStringInfo(copyCommand, "COPY \"%s\" TO STDOUT WITH (format result)",
+					 piece->pieceId);
+
+	if (!SendRemoteCommand(connection, copyCommand->data))
 	{
 		ReportConnectionError(connection, ERROR);
 	}
+
+	result = GetRemoteCommandResult(connection, raiseInterrupts);
+	if (PQresultStatus(result) != PGRES_COPY_OUT)
+	{
+		ReportResultError(connection, result, ERROR);
+	}
+
+	PQclear(result);
+
+	fetch->pieceFileDesc = FileOpenForTransmit(QueryResultFileName(piece->pieceId),
+											   fileFlags, fileMode);
+	fetch->pieceFile = FileCompatFromFileStart(fetch->pieceFileDesc);
 }
 
 
 /*
- * RemoteFileDestReceiverDestroy frees memory allocated as part of the
- * RemoteFileDestReceiver and closes file descriptors.
+ * ReceiveRemotePieceData writes the COPY data that is available on the
+ * connection of the given fetch into the file of the current piece, without
+ * blocking. When the COPY of a piece finishes, it starts the COPY of the next
+ * piece. The function returns true once all pieces of the fetch are copied.
  */
-static void
-RemoteFileDestReceiverDestroy(DestReceiver *destReceiver)
+static bool
+ReceiveRemotePieceData(RemotePieceFetch *fetch)
 {
-	RemoteFileDestReceiver *resultDest = (RemoteFileDestReceiver *) destReceiver;
+	MultiConnection *connection = fetch->connection;
+	bool raiseInterrupts = true;
 
-	if (resultDest->copyOutState)
+	if (PQconsumeInput(connection->pgConn) == 0)
 	{
-		pfree(resultDest->copyOutState);
+		ReportConnectionError(connection, ERROR);
 	}
 
-	if (resultDest->columnOutputFunctions)
+	while (true)
 	{
-		pfree(resultDest->columnOutputFunctions);
-	}
+		char *copyData = NULL;
+		int copyDataLength = PQgetCopyData(connection->pgConn, &copyData, true);
+		PGresult *result = NULL;
 
-	pfree(resultDest);
+		if (copyDataLength > 0)
+		{
+			int bytesWritten = FileWriteCompat(&fetch->pieceFile, copyData,
+											   copyDataLength, PG_WAIT_IO);
+			if (bytesWritten != copyDataLength)
+			{
+				ereport(ERROR, (errcode_for_file_access(),
+								errmsg("could not append to intermediate result "
+									   "file: %m")));
+			}
+
+			PQfreemem(copyData);
+			continue;
+		}
+		else if (copyDataLength == 0)
+		{
+			/* wait for more data */
+			return false;
+		}
+		else if (copyDataLength == -2)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+
+		/* the COPY of the current piece is done */
+		FileClose(fetch->pieceFileDesc);
+		fetch->pieceFileDesc = -1;
+
+		result = GetRemoteCommandResult(connection, raiseInterrupts);
+		if (!IsResponseOK(result))
+		{
+			ReportResultError(connection, result, ERROR);
+		}
+
+		PQclear(result);
+		ForgetResults(connection);
+
+		fetch->pieceCell = lnext(fetch->pieceCell);
+		if (fetch->pieceCell == NULL)
+		{
+			return true;
+		}
+
+		StartRemotePieceCopy(fetch);
+	}
 }
 
 
 /*
- * ReceiveQueryResultViaCopy is called when a COPY "resultid" FROM
- * STDIN WITH (format result) command is received from the client.
- * The command is followed by the raw copy data stream, which is
- * redirected to a file.
- *
- * File names are automatically prefixed with the user OID. Users
- * are only allowed to read query results from their own directory.
+ * BuildRemotePieceFetchWaitEventSet creates a WaitEventSet that can be used to
+ * wait for the connections of the given fetches to become read-ready.
  */
-void
-ReceiveQueryResultViaCopy(const char *resultId)
+static WaitEventSet *
+BuildRemotePieceFetchWaitEventSet(List *fetchList)
 {
-	const char *resultFileName = NULL;
+	WaitEventSet *waitEventSet = NULL;
+	ListCell *fetchCell = NULL;
 
-	CreateIntermediateResultsDirectory();
+	/* allocate pending connections + 2 for the signal latch and postmaster death */
+	waitEventSet = CreateWaitEventSet(CurrentMemoryContext, list_length(fetchList) + 2);
 
-	resultFileName = QueryResultFileName(resultId);
+	foreach(fetchCell, fetchList)
+	{
+		RemotePieceFetch *fetch = (RemotePieceFetch *) lfirst(fetchCell);
+		int socket = PQsocket(fetch->connection->pgConn);
 
-	RedirectCopyDataToRegularFile(resultFileName);
+		AddWaitEventToSet(waitEventSet, WL_SOCKET_READABLE, socket, NULL,
+						  (void *) fetch);
+	}
+
+	AddWaitEventToSet(waitEventSet, WL_POSTMASTER_DEATH, PGINVALID_SOCKET, NULL, NULL);
+	AddWaitEventToSet(waitEventSet, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch, NULL);
+
+	return waitEventSet;
 }
 
 
@@ -731,7 +2657,28 @@ read_intermediate_result(PG_FUNCTION_ARGS)
 
 	tupstore = SetupTuplestore(fcinfo, &tupleDescriptor);
 
-	ReadFileIntoTupleStore(resultFileName, copyFormatLabel, tupleDescriptor, tupstore);
+	/* parse the COPY data through the reader, which decompresses if needed */
+	CopyDataReader = OpenIntermediateResultReader(resultFileName);
+
+	PG_TRY();
+	{
+		ReadCopyDataIntoTupleStore(NULL, ReadIntermediateResultCopyData,
+								   copyFormatLabel, tupleDescriptor, tupstore);
+	}
+	PG_CATCH();
+	{
+		/* do not leave a dangling reader behind for the next call */
+		IntermediateResultReader *reader = CopyDataReader;
+
+		CopyDataReader = NULL;
+		CloseIntermediateResultReader(reader);
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	CloseIntermediateResultReader(CopyDataReader);
+	CopyDataReader = NULL;
 
 	tuplestore_donestoring(tupstore);
 
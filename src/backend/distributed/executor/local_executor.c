@@ -0,0 +1,407 @@
+/*-------------------------------------------------------------------------
+ *
+ * local_executor.c
+ *
+ * The local executor runs tasks whose shard placements live on the node that
+ * is executing the distributed query directly in the current backend, rather
+ * than opening a (loopback) connection to the node itself. This is mostly
+ * useful on Citus MX workers, which have both the metadata and the shards,
+ * where the majority of router queries hit shards on the same node.
+ *
+ * Instead of sending the deparsed shard query over a libpq connection, the
+ * executor parses and plans the shard query via PostgreSQL's planner and
+ * runs it with PostgreSQL's executor, writing the results into the tuple
+ * store of the Citus custom scan. That way we skip the network round-trip,
+ * the connection establishment and the text serialization of the results.
+ *
+ * The local executor is an extension of the adaptive executor: the adaptive
+ * executor decides which tasks can be executed locally and passes the rest
+ * of the tasks to the regular distributed execution.
+ *
+ * Transaction semantics require some care. Once a task is executed locally,
+ * its effects are only visible to the current backend's transaction, so any
+ * subsequent access to the local placements in the same transaction has to
+ * be executed locally as well. Conversely, once a command accessed local
+ * placements over a connection, we cannot switch to local execution in the
+ * same transaction. Code paths that always use connections (e.g., COPY and
+ * DDL) therefore error out if local execution already happened in the
+ * transaction.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+#include "miscadmin.h"
+
+#include "distributed/citus_custom_scan.h"
+#include "distributed/errormessage.h"
+#include "distributed/local_executor.h"
+#include "distributed/multi_executor.h"
+#include "distributed/master_metadata_utility.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/placement_connection.h"
+#include "distributed/remote_commands.h"
+#include "distributed/transaction_management.h"
+#include "executor/tstoreReceiver.h"
+#include "executor/tuptable.h"
+#include "nodes/params.h"
+#include "optimizer/planner.h"
+#include "utils/queryenvironment.h"
+#include "utils/snapmgr.h"
+
+
+/* controlled via a GUC */
+bool EnableLocalExecution = false;
+bool LogLocalCommands = false;
+
+/* set when a task is executed locally in the current transaction */
+bool LocalExecutionHappened = false;
+
+
+static void SplitLocalAndRemotePlacements(List *taskPlacementList,
+										  List **localTaskPlacementList,
+										  List **remoteTaskPlacementList);
+static uint64 ExecuteLocalTaskPlan(CitusScanState *scanState, PlannedStmt *taskPlan,
+								   char *queryString);
+static bool TaskAccessesLocalNode(Task *task);
+static void LogLocalCommand(const char *command);
+
+
+/*
+ * ExecuteLocalTaskList gets a CitusScanState node and a list of local tasks.
+ *
+ * The function goes over the task list and executes them locally. The
+ * returned tuples (if any) are stored in the tuple store of the CitusScanState.
+ * Once the tasks returned rowLimit rows, the remaining tasks are skipped. A
+ * negative rowLimit means that all tasks are executed.
+ *
+ * The function returns the total number of rows processed by the tasks,
+ * which are the modified rows for modifications and the returned rows for
+ * SELECTs.
+ */
+uint64
+ExecuteLocalTaskList(CitusScanState *scanState, List *taskList, int64 rowLimit)
+{
+	EState *executorState = ScanStateGetExecutorState(scanState);
+	ParamListInfo paramListInfo = copyParamList(executorState->es_param_list_info);
+	int numParams = 0;
+	Oid *parameterTypes = NULL;
+	ListCell *taskCell = NULL;
+	uint64 totalRowsProcessed = 0;
+
+	if (paramListInfo != NULL)
+	{
+		int parameterIndex = 0;
+
+		numParams = paramListInfo->numParams;
+		parameterTypes = (Oid *) palloc0(numParams * sizeof(Oid));
+
+		/*
+		 * Unlike the remote execution, we can use the local type oids as they
+		 * are, since the shard query is parsed on the same node.
+		 */
+		for (parameterIndex = 0; parameterIndex < numParams; parameterIndex++)
+		{
+			parameterTypes[parameterIndex] = paramListInfo->params[parameterIndex].ptype;
+		}
+	}
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+		PlannedStmt *localPlan = NULL;
+		int cursorOptions = 0;
+		const char *shardQueryString = task->queryString;
+		Query *shardQuery = NULL;
+
+		if (rowLimit >= 0 && totalRowsProcessed >= (uint64) rowLimit)
+		{
+			break;
+		}
+
+		shardQuery = ParseQueryString(shardQueryString, parameterTypes, numParams);
+
+		/*
+		 * Although the shardQuery is local to this node, we prefer planner()
+		 * over standard_planner(). Citus relies on the restriction hooks being
+		 * called via distributed_planner(), so let planner() call
+		 * distributed_planner(), which eventually calls standard_planner().
+		 */
+		localPlan = planner(shardQuery, cursorOptions, paramListInfo);
+
+		LogLocalCommand(shardQueryString);
+
+		totalRowsProcessed +=
+			ExecuteLocalTaskPlan(scanState, localPlan, task->queryString);
+	}
+
+	/* subsequent accesses in the transaction should also be executed locally */
+	LocalExecutionHappened = true;
+
+	return totalRowsProcessed;
+}
+
+
+/*
+ * ExtractLocalAndRemoteTasks gets a taskList and generates two task lists,
+ * namely localTaskList and remoteTaskList. The function goes over the input
+ * taskList and puts the tasks that are local to the node into localTaskList
+ * and the others into the remoteTaskList. Either of the lists can be NIL
+ * depending on the input taskList.
+ *
+ * A task with multiple placements (e.g., a reference table task) that has
+ * a local placement is split into a local task and, unless the plan is
+ * read-only, a remote task for the remaining placements.
+ */
+void
+ExtractLocalAndRemoteTasks(bool readOnlyPlan, List *taskList, List **localTaskList,
+						   List **remoteTaskList)
+{
+	ListCell *taskCell = NULL;
+
+	*remoteTaskList = NIL;
+	*localTaskList = NIL;
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+
+		List *localTaskPlacementList = NIL;
+		List *remoteTaskPlacementList = NIL;
+
+		SplitLocalAndRemotePlacements(task->taskPlacementList, &localTaskPlacementList,
+									  &remoteTaskPlacementList);
+
+		/* either the local or the remote should be non-nil */
+		Assert(!(localTaskPlacementList == NIL && remoteTaskPlacementList == NIL));
+
+		if (localTaskPlacementList == NIL)
+		{
+			*remoteTaskList = lappend(*remoteTaskList, task);
+		}
+		else if (remoteTaskPlacementList == NIL)
+		{
+			*localTaskList = lappend(*localTaskList, task);
+		}
+		else
+		{
+			/*
+			 * At this point, we're dealing with reference tables or replicated
+			 * tables where the task has placements on both the local and remote
+			 * nodes. We always prefer the local placement, and use the remote
+			 * placements only for modifications.
+			 */
+			Task *localTask = copyObject(task);
+
+			localTask->taskPlacementList = localTaskPlacementList;
+			*localTaskList = lappend(*localTaskList, localTask);
+
+			if (!readOnlyPlan)
+			{
+				Task *remoteTask = copyObject(task);
+
+				remoteTask->taskPlacementList = remoteTaskPlacementList;
+				*remoteTaskList = lappend(*remoteTaskList, remoteTask);
+			}
+		}
+	}
+}
+
+
+/*
+ * SplitLocalAndRemotePlacements is a helper function which iterates over the
+ * input taskPlacementList and puts the placements into the corresponding
+ * list: either localTaskPlacementList or remoteTaskPlacementList.
+ */
+static void
+SplitLocalAndRemotePlacements(List *taskPlacementList, List **localTaskPlacementList,
+							  List **remoteTaskPlacementList)
+{
+	ListCell *placementCell = NULL;
+	int32 localGroupId = GetLocalGroupId();
+
+	*localTaskPlacementList = NIL;
+	*remoteTaskPlacementList = NIL;
+
+	foreach(placementCell, taskPlacementList)
+	{
+		ShardPlacement *taskPlacement = (ShardPlacement *) lfirst(placementCell);
+
+		if (taskPlacement->groupId == localGroupId)
+		{
+			*localTaskPlacementList = lappend(*localTaskPlacementList, taskPlacement);
+		}
+		else
+		{
+			*remoteTaskPlacementList = lappend(*remoteTaskPlacementList, taskPlacement);
+		}
+	}
+}
+
+
+/*
+ * ExecuteLocalTaskPlan gets a planned statement which can be executed locally.
+ * The function simply follows the steps to have a local execution, sets the
+ * tupleStore if necessary. The function returns the number of rows processed
+ * by a modification, or the number of rows returned by a SELECT.
+ */
+static uint64
+ExecuteLocalTaskPlan(CitusScanState *scanState, PlannedStmt *taskPlan, char *queryString)
+{
+	EState *executorState = ScanStateGetExecutorState(scanState);
+	ParamListInfo paramListInfo = executorState->es_param_list_info;
+	DestReceiver *tupleStoreDestReceiver = CreateDestReceiver(DestTuplestore);
+	ScanDirection scanDirection = ForwardScanDirection;
+	QueryEnvironment *queryEnv = create_queryEnv();
+	QueryDesc *queryDesc = NULL;
+	int eflags = 0;
+	uint64 totalRowsProcessed = 0;
+
+	/*
+	 * Use the tupleStore provided by the scanState because it is shared across
+	 * the other task executions and the adaptive executor.
+	 */
+	SetTuplestoreDestReceiverParams(tupleStoreDestReceiver,
+									scanState->tuplestorestate,
+									CurrentMemoryContext, false);
+
+	queryDesc = CreateQueryDesc(taskPlan, queryString,
+								GetActiveSnapshot(), InvalidSnapshot,
+								tupleStoreDestReceiver, paramListInfo,
+								queryEnv, 0);
+
+	ExecutorStart(queryDesc, eflags);
+	ExecutorRun(queryDesc, scanDirection, 0L, true);
+
+	/*
+	 * The caller sets executorState->es_processed, we only report the
+	 * number of modified or returned rows.
+	 */
+	totalRowsProcessed = queryDesc->estate->es_processed;
+
+	ExecutorFinish(queryDesc);
+	ExecutorEnd(queryDesc);
+
+	FreeQueryDesc(queryDesc);
+
+	return totalRowsProcessed;
+}
+
+
+/*
+ * ShouldExecuteTasksLocally gets a task list and returns true if any of
+ * the tasks should be executed locally. This function does not guarantee
+ * that any task has to be executed locally.
+ */
+bool
+ShouldExecuteTasksLocally(List *taskList)
+{
+	bool singleTask = false;
+
+	if (!EnableLocalExecution)
+	{
+		return false;
+	}
+
+	if (LocalExecutionHappened)
+	{
+		/*
+		 * For various reasons, including the transaction visibility rules
+		 * (e.g., read-your-own-writes), we have to use local execution again
+		 * if it has already happened within this transaction block.
+		 */
+		Assert(IsMultiStatementTransaction() || InCoordinatedTransaction());
+
+		return true;
+	}
+
+	singleTask = (list_length(taskList) == 1);
+	if (singleTask && TaskAccessesLocalNode((Task *) linitial(taskList)))
+	{
+		/*
+		 * This is the valuable time to use local execution. We are likely to
+		 * avoid any network round-trips by simply executing the command within
+		 * this session.
+		 *
+		 * We shouldn't use local execution if any distributed execution has
+		 * already accessed placements in the transaction, because the
+		 * connections may hold locks or uncommitted writes that would not be
+		 * visible to the local execution.
+		 */
+		return !AnyConnectionAccessedPlacements();
+	}
+
+	/*
+	 * For multi-task executions, switching to local execution would likely
+	 * perform poorly, because we'd lose the parallelism. Note that the local
+	 * execution happens one task at a time.
+	 */
+	return false;
+}
+
+
+/*
+ * TaskAccessesLocalNode returns true if any placement of the task resides on
+ * the node that we're executing the query.
+ */
+static bool
+TaskAccessesLocalNode(Task *task)
+{
+	ListCell *placementCell = NULL;
+	int32 localGroupId = GetLocalGroupId();
+
+	foreach(placementCell, task->taskPlacementList)
+	{
+		ShardPlacement *taskPlacement = (ShardPlacement *) lfirst(placementCell);
+
+		if (taskPlacement->groupId == localGroupId)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * ErrorIfLocalExecutionHappened errors out if a local query execution has
+ * already happened in the current transaction.
+ *
+ * This check is required for the code paths that can only execute commands
+ * over connections, which would not see the effects of the local execution
+ * and might self-deadlock on the locks it holds.
+ */
+void
+ErrorIfLocalExecutionHappened(void)
+{
+	if (LocalExecutionHappened)
+	{
+		ereport(ERROR, (errmsg("cannot execute command because a local execution has "
+							   "already been done in the transaction"),
+						errdetail("Some parallel commands cannot be executed if a "
+								  "previous command has already been executed locally"),
+						errhint("Try re-running the transaction with "
+								"\"SET LOCAL citus.enable_local_execution TO OFF;\"")));
+	}
+}
+
+
+/*
+ * LogLocalCommand logs commands executed locally on this node. Although we're
+ * talking about local execution, the function relies on citus.log_remote_commands
+ * GUC as well. The reason is that the local execution is replacing the remote
+ * execution, so it makes sense to log it with the same flag.
+ */
+static void
+LogLocalCommand(const char *command)
+{
+	if (!(LogRemoteCommands || LogLocalCommands))
+	{
+		return;
+	}
+
+	ereport(LOG, (errmsg("executing the command locally: %s",
+						 ApplyLogRedaction(command))));
+}
@@ -318,6 +318,20 @@ LoadTuplesIntoTupleStore(CitusScanState *citusScanState, Job *workerJob)
 void
 ReadFileIntoTupleStore(char *fileName, char *copyFormat, TupleDesc tupleDescriptor,
 					   Tuplestorestate *tupstore)
+{
+	ReadCopyDataIntoTupleStore(fileName, NULL, copyFormat, tupleDescriptor, tupstore);
+}
+
+
+/*
+ * ReadCopyDataIntoTupleStore parses COPY-formatted records according to the
+ * given tuple descriptor and stores the records in a tuple store. The data is
+ * read from the given file, or from dataSourceCallback if fileName is NULL.
+ */
+void
+ReadCopyDataIntoTupleStore(char *fileName, copy_data_source_cb dataSourceCallback,
+						   char *copyFormat, TupleDesc tupleDescriptor,
+						   Tuplestorestate *tupstore)
 {
 	CopyState copyState = NULL;
 
@@ -342,7 +356,7 @@ ReadFileIntoTupleStore(char *fileName, char *copyFormat, TupleDesc tupleDescript
 	copyOption = makeDefElem("format", (Node *) makeString(copyFormat), location);
 	copyOptions = lappend(copyOptions, copyOption);
 
-	copyState = BeginCopyFrom(NULL, stubRelation, fileName, false, NULL,
+	copyState = BeginCopyFrom(NULL, stubRelation, fileName, false, dataSourceCallback,
 							  NULL, copyOptions);
 
 	while (true)
@@ -397,21 +411,23 @@ void
 ExecuteQueryStringIntoDestReceiver(const char *queryString, ParamListInfo params,
 								   DestReceiver *dest)
 {
-	Query *query = ParseQueryString(queryString);
+	Query *query = ParseQueryString(queryString, NULL, 0);
 
 	ExecuteQueryIntoDestReceiver(query, params, dest);
 }
 
 
 /*
- * ParseQuery parses query string and returns a Query struct.
+ * ParseQueryString parses query string and returns a Query struct. The types
+ * of the parameters referenced in the query (if any) are given by paramOids.
  */
 Query *
-ParseQueryString(const char *queryString)
+ParseQueryString(const char *queryString, Oid *paramOids, int numParams)
 {
 	Query *query = NULL;
 	RawStmt *rawStmt = (RawStmt *) ParseTreeRawStmt(queryString);
-	List *queryTreeList = pg_analyze_and_rewrite(rawStmt, queryString, NULL, 0, NULL);
+	List *queryTreeList =
+		pg_analyze_and_rewrite(rawStmt, queryString, paramOids, numParams, NULL);
 
 	if (list_length(queryTreeList) != 1)
 	{
@@ -50,6 +50,7 @@
 #include "distributed/remote_commands.h"
 #include "distributed/remote_transaction.h"
 #include "distributed/resource_lock.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/version_compat.h"
 #include "executor/execdesc.h"
 #include "executor/executor.h"
@@ -556,6 +557,15 @@ CitusModifyBeginScan(CustomScanState *node, EState *estate, int eflags)
 	/* prevent concurrent placement changes */
 	AcquireMetadataLocks(taskList);
 
+	/* written rows might fall outside of the zone maps of the shards */
+	if ((jobQuery->commandType == CMD_INSERT || jobQuery->commandType == CMD_UPDATE) &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		RangeTblEntry *resultRangeTableEntry = ExtractResultRelationRTE(jobQuery);
+
+		InvalidateShardZoneMaps(resultRangeTableEntry->relid);
+	}
+
 	/*
 	 * We are taking locks on partitions of partitioned tables. These locks are
 	 * necessary for locking tables that appear in the SELECT part of the query.
@@ -1716,7 +1726,7 @@ SendQueryInSingleRowMode(MultiConnection *connection, char *query,
 										   &parameterValues);
 
 		querySent = SendRemoteCommandParams(connection, query, parameterCount,
-											parameterTypes, parameterValues);
+											parameterTypes, parameterValues, false);
 	}
 	else
 	{
@@ -10,33 +10,109 @@
 
 #include "postgres.h"
 
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "distributed/citus_custom_scan.h"
+#include "distributed/commands/multi_copy.h"
+#include "distributed/distributed_planner.h"
+#include "distributed/intermediate_result_pruning.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/local_executor.h"
+#include "distributed/master_metadata_utility.h"
+#include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/recursive_planning.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/transaction_management.h"
+#include "distributed/version_compat.h"
 #include "distributed/worker_manager.h"
 #include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 
 int MaxIntermediateResult = 1048576; /* maximum size in KB the intermediate result can grow to */
 /* when this is true, we enforce intermediate result size limit in all executors */
 int SubPlanLevel = 0;
 
+/* whether the tasks of independent subplans are executed concurrently */
+bool EnableParallelSubPlanExecution = false;
+
+/* whether subplan results may be kept on the workers that produce them */
+bool EnableWorkerToWorkerIntermediateResults = false;
+
+
+/*
+ * PrefetchedSubPlanResult contains the rows returned by the tasks of the
+ * distributed plan of a subplan, which were executed before the subplan
+ * itself.
+ */
+typedef struct PrefetchedSubPlanResult
+{
+	DistributedPlan *distributedPlan;
+	Tuplestorestate *tupleStore;
+
+	/* subtransaction in which the tasks were executed */
+	SubTransactionId subId;
+} PrefetchedSubPlanResult;
+
+
+/*
+ * Prefetched results that were not yet taken by the subplans. The list and
+ * its entries are allocated in TopTransactionContext, such that the results
+ * of aborted subtransactions can be removed after their memory is gone.
+ */
+static List *PrefetchedSubPlanResultList = NIL;
+
+
+static List * IndependentSubPlanList(List *subPlanList, int startIndex);
+static List * PrefetchSubPlanResults(uint64 planId, List *subPlanList);
+static bool CanPrefetchSubPlanResult(CustomScan *customScan);
+static void DiscardPrefetchedSubPlanResults(List *prefetchedResultList);
+static void ExecuteSubPlan(uint64 planId, DistributedSubPlan *subPlan,
+						   List *workerNodeList);
+static bool CanKeepSubPlanResultOnWorkers(DistributedSubPlan *subPlan);
+static void ExecuteSubPlanOnWorkers(char *resultId, DistributedSubPlan *subPlan,
+									List *nodeList, List *workerNodeList,
+									bool writeLocalFile);
+static void FetchPartitionedResultPieces(char *resultId, DistributedSubPlan *subPlan,
+										 List *pieceListList, List *nodeList,
+										 bool writeLocalFile, List *workerNodeList);
+static void AppendNodeCommand(List **commandNodeList, List **commandList,
+							  WorkerNode *workerNode, char *command);
+static DestReceiver * PartitionedSubPlanDestReceiver(char *resultId,
+													 DistributedSubPlan *subPlan,
+													 EState *estate, List *nodeList,
+													 bool writeLocalFile,
+													 List *workerNodeList);
+static List * ShardPlacementNodeList(uint64 shardId, List *workerNodeList);
+static char * PartitionQueryResultCommand(char *resultPrefix, char *queryString,
+										  Oid relationId, int partitionColumnIndex);
+static void LogSubPlanDestinations(char *resultId, List *nodeList, bool writeLocalFile);
+
 
 /*
  * ExecuteSubPlans executes a list of subplans from a distributed plan
- * by sequentially executing each plan from the top.
+ * from the top.
+ *
+ * Subplans that do not read each other's results are independent. Before
+ * executing a group of consecutive independent subplans, we execute the
+ * tasks of their distributed plans together, such that the workers run them
+ * concurrently. The subplans then only need to combine the rows of their
+ * tasks and write the intermediate results.
  */
 void
 ExecuteSubPlans(DistributedPlan *distributedPlan)
 {
 	uint64 planId = distributedPlan->planId;
 	List *subPlanList = distributedPlan->subPlanList;
-	ListCell *subPlanCell = NULL;
-	List *nodeList = NIL;
-	bool writeLocalFile = false;
+	int subPlanCount = list_length(subPlanList);
+	int subPlanIndex = 0;
+	List *workerNodeList = NIL;
 
 	if (subPlanList == NIL)
 	{
@@ -52,28 +128,852 @@ ExecuteSubPlans(DistributedPlan *distributedPlan)
 	 */
 	BeginOrContinueCoordinatedTransaction();
 
-	nodeList = ActiveReadableNodeList();
+	workerNodeList = ActiveReadableNodeList();
+
+	while (subPlanIndex < subPlanCount)
+	{
+		List *independentSubPlanList = IndependentSubPlanList(subPlanList,
+															  subPlanIndex);
+		List *prefetchedResultList = NIL;
+		ListCell *subPlanCell = NULL;
+
+		if (EnableParallelSubPlanExecution && list_length(independentSubPlanList) > 1)
+		{
+			prefetchedResultList = PrefetchSubPlanResults(planId,
+														  independentSubPlanList);
+		}
+
+		foreach(subPlanCell, independentSubPlanList)
+		{
+			DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
+
+			ExecuteSubPlan(planId, subPlan, workerNodeList);
+		}
+
+		DiscardPrefetchedSubPlanResults(prefetchedResultList);
+
+		subPlanIndex += list_length(independentSubPlanList);
+	}
+}
+
+
+/*
+ * IndependentSubPlanList returns the consecutive subplans starting at
+ * startIndex that do not read the results of each other.
+ */
+static List *
+IndependentSubPlanList(List *subPlanList, int startIndex)
+{
+	List *independentSubPlanList = NIL;
+	List *independentSubPlanIdList = NIL;
+	int subPlanCount = list_length(subPlanList);
+	int subPlanIndex = 0;
+
+	for (subPlanIndex = startIndex; subPlanIndex < subPlanCount; subPlanIndex++)
+	{
+		DistributedSubPlan *subPlan =
+			(DistributedSubPlan *) list_nth(subPlanList, subPlanIndex);
+		ListCell *dependedSubPlanIdCell = NULL;
+
+		foreach(dependedSubPlanIdCell, subPlan->dependedSubPlanIdList)
+		{
+			int dependedSubPlanId = lfirst_int(dependedSubPlanIdCell);
+
+			if (list_member_int(independentSubPlanIdList, dependedSubPlanId))
+			{
+				return independentSubPlanList;
+			}
+		}
+
+		independentSubPlanList = lappend(independentSubPlanList, subPlan);
+		independentSubPlanIdList = lappend_int(independentSubPlanIdList,
+											   subPlan->subPlanId);
+	}
+
+	return independentSubPlanList;
+}
+
+
+/*
+ * PrefetchSubPlanResults executes the tasks of the distributed plans of the
+ * given subplans in a single distributed execution and keeps their rows until
+ * the subplans are executed. It returns the prefetched results, or NIL if
+ * there are less than two subplans whose tasks can be executed this way.
+ */
+static List *
+PrefetchSubPlanResults(uint64 planId, List *subPlanList)
+{
+	List *prefetchedResultList = NIL;
+	List *taskListList = NIL;
+	List *tupleDescriptorList = NIL;
+	List *tupleStoreList = NIL;
+	ListCell *subPlanCell = NULL;
+	StringInfo resultIdString = makeStringInfo();
+	MemoryContext oldContext = NULL;
+	bool randomAccess = true;
+	bool interTransactions = false;
 
 	foreach(subPlanCell, subPlanList)
 	{
 		DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
-		PlannedStmt *plannedStmt = subPlan->plan;
-		uint32 subPlanId = subPlan->subPlanId;
-		DestReceiver *copyDest = NULL;
-		ParamListInfo params = NULL;
-		EState *estate = NULL;
+		CustomScan *customScan = FindCitusCustomScan(subPlan->plan->planTree);
+		DistributedPlan *distributedPlan = NULL;
+		PrefetchedSubPlanResult *prefetchedResult = NULL;
+
+		if (customScan == NULL || !CanPrefetchSubPlanResult(customScan))
+		{
+			continue;
+		}
+
+		/* the rows of these subplans do not pass through the coordinator */
+		if (EnableWorkerToWorkerIntermediateResults &&
+			CanKeepSubPlanResultOnWorkers(subPlan))
+		{
+			continue;
+		}
+
+		distributedPlan = GetDistributedPlan(customScan);
+
+		prefetchedResult = (PrefetchedSubPlanResult *)
+						   MemoryContextAllocZero(TopTransactionContext,
+												  sizeof(PrefetchedSubPlanResult));
+		prefetchedResult->distributedPlan = distributedPlan;
+		prefetchedResult->subId = GetCurrentSubTransactionId();
+		prefetchedResult->tupleStore =
+			tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+
+		prefetchedResultList = lappend(prefetchedResultList, prefetchedResult);
+		taskListList = lappend(taskListList, distributedPlan->workerJob->taskList);
+		tupleDescriptorList =
+			lappend(tupleDescriptorList,
+					ExecTypeFromTLCompat(customScan->scan.plan.targetlist));
+		tupleStoreList = lappend(tupleStoreList, prefetchedResult->tupleStore);
+
+		appendStringInfo(resultIdString, "%s%s", resultIdString->len > 0 ? ", " : "",
+						 GenerateResultId(planId, subPlan->subPlanId));
+	}
+
+	if (list_length(prefetchedResultList) < 2)
+	{
+		DiscardPrefetchedSubPlanResults(prefetchedResultList);
+
+		return NIL;
+	}
+
+	if (LogIntermediateResults)
+	{
+		ereport(DEBUG1, (errmsg("Subplans %s will be executed concurrently",
+								resultIdString->data)));
+	}
+
+	SubPlanLevel++;
+	ExecuteTaskListsIntoTupleStores(taskListList, tupleDescriptorList, tupleStoreList);
+	SubPlanLevel--;
+
+	oldContext = MemoryContextSwitchTo(TopTransactionContext);
+	PrefetchedSubPlanResultList = list_concat(PrefetchedSubPlanResultList,
+											  list_copy(prefetchedResultList));
+	MemoryContextSwitchTo(oldContext);
+
+	return prefetchedResultList;
+}
 
-		char *resultId = GenerateResultId(planId, subPlanId);
 
-		SubPlanLevel++;
-		estate = CreateExecutorState();
+/*
+ * CanPrefetchSubPlanResult returns whether the tasks of the given Citus custom
+ * scan can be executed before the rest of its plan. This is the case for
+ * read-only plans of the adaptive executor whose tasks are fully known during
+ * planning and run on remote nodes.
+ *
+ * The tasks of all prefetched plans run in a single execution, which cannot
+ * stop the tasks of one plan once that plan has enough rows for its LIMIT.
+ * We also only prefetch tasks with a single placement, such that failing over
+ * to other placements is left to the regular execution of the subplan.
+ */
+static bool
+CanPrefetchSubPlanResult(CustomScan *customScan)
+{
+	DistributedPlan *distributedPlan = NULL;
+	Job *workerJob = NULL;
+	ListCell *taskCell = NULL;
+
+	if (customScan->methods != &AdaptiveExecutorCustomScanMethods)
+	{
+		return false;
+	}
+
+	distributedPlan = GetDistributedPlan(customScan);
+	workerJob = distributedPlan->workerJob;
+
+	if (distributedPlan->modLevel != ROW_MODIFY_READONLY ||
+		distributedPlan->insertSelectSubquery != NULL ||
+		distributedPlan->subPlanList != NIL)
+	{
+		return false;
+	}
+
+	if (workerJob == NULL || workerJob->taskList == NIL ||
+		workerJob->dependedJobList != NIL || workerJob->deferredPruning ||
+		workerJob->requiresMasterEvaluation)
+	{
+		return false;
+	}
+
+	if (ShouldExecuteTasksLocally(workerJob->taskList))
+	{
+		return false;
+	}
+
+	if (MasterQueryRowLimit(distributedPlan->masterQuery) >= 0)
+	{
+		return false;
+	}
+
+	foreach(taskCell, workerJob->taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+
+		if (list_length(task->taskPlacementList) > 1)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * TakePrefetchedSubPlanResult returns the prefetched rows of the tasks of the
+ * given distributed plan and removes them from the prefetched results, or
+ * returns NULL if they were not prefetched.
+ */
+Tuplestorestate *
+TakePrefetchedSubPlanResult(DistributedPlan *distributedPlan)
+{
+	ListCell *prefetchedResultCell = NULL;
+
+	foreach(prefetchedResultCell, PrefetchedSubPlanResultList)
+	{
+		PrefetchedSubPlanResult *prefetchedResult =
+			(PrefetchedSubPlanResult *) lfirst(prefetchedResultCell);
+		Tuplestorestate *tupleStore = prefetchedResult->tupleStore;
+
+		if (prefetchedResult->distributedPlan == distributedPlan &&
+			tupleStore != NULL)
+		{
+			/* the scan owns the tuple store from now on */
+			prefetchedResult->tupleStore = NULL;
+			PrefetchedSubPlanResultList = list_delete_ptr(PrefetchedSubPlanResultList,
+														  prefetchedResult);
+
+			return tupleStore;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * DiscardPrefetchedSubPlanResults frees the prefetched results that were not
+ * taken, which happens when the executor of the subplan does not scan its
+ * distributed plan.
+ */
+static void
+DiscardPrefetchedSubPlanResults(List *prefetchedResultList)
+{
+	ListCell *prefetchedResultCell = NULL;
+
+	foreach(prefetchedResultCell, prefetchedResultList)
+	{
+		PrefetchedSubPlanResult *prefetchedResult =
+			(PrefetchedSubPlanResult *) lfirst(prefetchedResultCell);
+
+		if (prefetchedResult->tupleStore != NULL)
+		{
+			tuplestore_end(prefetchedResult->tupleStore);
+			prefetchedResult->tupleStore = NULL;
+		}
+
+		PrefetchedSubPlanResultList = list_delete_ptr(PrefetchedSubPlanResultList,
+													  prefetchedResult);
+	}
+}
+
+
+/*
+ * ResetPrefetchedSubPlanResults forgets the prefetched results when the
+ * transaction ends. Their tuple stores are freed together with the executor
+ * state of the aborted query.
+ */
+void
+ResetPrefetchedSubPlanResults(void)
+{
+	PrefetchedSubPlanResultList = NIL;
+}
+
+
+/*
+ * ForgetSubXactPrefetchedSubPlanResults removes the prefetched results of the
+ * given subtransaction and the subtransactions below it when it is aborted,
+ * e.g. by an EXCEPTION block in PL/pgSQL. The queries that prefetched them
+ * are aborted, so their tuple stores are already freed, while the results of
+ * queries in the parent transactions are kept.
+ */
+void
+ForgetSubXactPrefetchedSubPlanResults(SubTransactionId subId)
+{
+	ListCell *prefetchedResultCell = NULL;
+	ListCell *previousCell = NULL;
+	ListCell *nextCell = NULL;
+
+	for (prefetchedResultCell = list_head(PrefetchedSubPlanResultList);
+		 prefetchedResultCell != NULL;
+		 prefetchedResultCell = nextCell)
+	{
+		PrefetchedSubPlanResult *prefetchedResult =
+			(PrefetchedSubPlanResult *) lfirst(prefetchedResultCell);
+
+		nextCell = lnext(prefetchedResultCell);
+
+		/* subtransaction ids increase, so later ones are below the aborted one */
+		if (prefetchedResult->subId >= subId)
+		{
+			PrefetchedSubPlanResultList = list_delete_cell(PrefetchedSubPlanResultList,
+														   prefetchedResultCell,
+														   previousCell);
+		}
+		else
+		{
+			previousCell = prefetchedResultCell;
+		}
+	}
+}
+
+
+/*
+ * ExecuteSubPlan executes the subplan and sends its result to the nodes that
+ * read it.
+ */
+static void
+ExecuteSubPlan(uint64 planId, DistributedSubPlan *subPlan, List *workerNodeList)
+{
+	PlannedStmt *plannedStmt = subPlan->plan;
+	uint32 subPlanId = subPlan->subPlanId;
+	DestReceiver *copyDest = NULL;
+	ParamListInfo params = NULL;
+	EState *estate = NULL;
+	List *nodeList = NIL;
+	bool writeLocalFile = subPlan->writeLocalFile;
+
+	char *resultId = GenerateResultId(planId, subPlanId);
+
+	nodeList = SubPlanDestinationNodeList(subPlan, workerNodeList);
+	if (LogIntermediateResults)
+	{
+		LogSubPlanDestinations(resultId, nodeList, writeLocalFile);
+	}
+
+	if (EnableWorkerToWorkerIntermediateResults &&
+		CanKeepSubPlanResultOnWorkers(subPlan))
+	{
+		ExecuteSubPlanOnWorkers(resultId, subPlan, nodeList, workerNodeList,
+								writeLocalFile);
+
+		return;
+	}
+
+	SubPlanLevel++;
+	estate = CreateExecutorState();
+
+	/* nodes with shards that read partitions of the result only receive those */
+	if (subPlan->partitionRelationIdList != NIL)
+	{
+		copyDest = PartitionedSubPlanDestReceiver(resultId, subPlan, estate, nodeList,
+												  writeLocalFile, workerNodeList);
+	}
+	else
+	{
 		copyDest = (DestReceiver *) CreateRemoteFileDestReceiver(resultId, estate,
 																 nodeList,
 																 writeLocalFile);
+	}
 
-		ExecutePlanIntoDestReceiver(plannedStmt, params, copyDest);
+	ExecutePlanIntoDestReceiver(plannedStmt, params, copyDest);
 
-		SubPlanLevel--;
-		FreeExecutorState(estate);
+	SubPlanLevel--;
+	FreeExecutorState(estate);
+}
+
+
+/*
+ * PartitionedSubPlanDestReceiver returns a DestReceiver that splits the rows
+ * of the subplan into the partitions that the tasks of the reading query
+ * read, once for each way in which the result is partitioned. Each partition
+ * is sent to the nodes that have a placement of its shard. If nodeList is not
+ * empty or writeLocalFile is set, the whole result is written as well.
+ */
+static DestReceiver *
+PartitionedSubPlanDestReceiver(char *resultId, DistributedSubPlan *subPlan,
+							   EState *estate, List *nodeList, bool writeLocalFile,
+							   List *workerNodeList)
+{
+	List *destReceiverList = NIL;
+	ListCell *relationIdCell = NULL;
+	ListCell *columnIndexCell = NULL;
+
+	forboth(relationIdCell, subPlan->partitionRelationIdList,
+			columnIndexCell, subPlan->partitionColumnIndexList)
+	{
+		Oid relationId = lfirst_oid(relationIdCell);
+		int partitionColumnIndex = lfirst_int(columnIndexCell);
+		char *partitionPrefix = PartitionedResultPrefix(resultId, relationId,
+														partitionColumnIndex);
+		DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+		List *partitionNodeListList = NIL;
+		DestReceiver *partitionedDest = NULL;
+		int shardIndex = 0;
+
+		for (shardIndex = 0; shardIndex < cacheEntry->shardIntervalArrayLength;
+			 shardIndex++)
+		{
+			ShardInterval *shardInterval = cacheEntry->sortedShardIntervalArray[shardIndex];
+			List *placementNodeList = ShardPlacementNodeList(shardInterval->shardId,
+															 workerNodeList);
+
+			partitionNodeListList = lappend(partitionNodeListList, placementNodeList);
+		}
+
+		if (LogIntermediateResults)
+		{
+			ereport(DEBUG1, (errmsg("Subplan %s will be partitioned along the shards "
+									"of %s", resultId, get_rel_name(relationId))));
+		}
+
+		partitionedDest = CreateShardPartitionedDestReceiver(partitionPrefix, estate,
+															 relationId,
+															 partitionColumnIndex,
+															 partitionNodeListList);
+		destReceiverList = lappend(destReceiverList, partitionedDest);
+	}
+
+	if (nodeList != NIL || writeLocalFile)
+	{
+		DestReceiver *copyDest = CreateRemoteFileDestReceiver(resultId, estate,
+															  nodeList,
+															  writeLocalFile);
+
+		destReceiverList = lappend(destReceiverList, copyDest);
+	}
+
+	return CreateTeeDestReceiver(destReceiverList);
+}
+
+
+/*
+ * CanKeepSubPlanResultOnWorkers returns whether the rows returned by the tasks
+ * of the subplan form its result without any processing on the coordinator,
+ * such that the workers can write the rows of their tasks into pieces of the
+ * intermediate result themselves. Since the rows then never pass through the
+ * coordinator, we only do so when citus.max_intermediate_result_size does not
+ * limit the size of intermediate results.
+ */
+static bool
+CanKeepSubPlanResultOnWorkers(DistributedSubPlan *subPlan)
+{
+	Plan *planTree = subPlan->plan->planTree;
+	CustomScan *customScan = NULL;
+	DistributedPlan *distributedPlan = NULL;
+	List *workerTargetList = NIL;
+	ListCell *targetEntryCell = NULL;
+	int workerColumnCount = 0;
+
+	if (MaxIntermediateResult >= 0)
+	{
+		return false;
+	}
+
+	/* aggregates, sorting, limits and the like run on top of the scan */
+	if (FindCitusCustomScan(planTree) != (CustomScan *) planTree ||
+		planTree->qual != NIL)
+	{
+		return false;
+	}
+
+	/* the tasks can write their rows in at most one partitioning */
+	if (list_length(subPlan->partitionRelationIdList) > 1)
+	{
+		return false;
+	}
+
+	customScan = (CustomScan *) planTree;
+	if (!CanPrefetchSubPlanResult(customScan))
+	{
+		return false;
+	}
+
+	distributedPlan = GetDistributedPlan(customScan);
+	workerTargetList = distributedPlan->workerJob->jobQuery->targetList;
+
+	foreach(targetEntryCell, workerTargetList)
+	{
+		TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+
+		if (!targetEntry->resjunk)
+		{
+			workerColumnCount++;
+		}
+	}
+
+	if (workerColumnCount != list_length(planTree->targetlist))
+	{
+		return false;
+	}
+
+	/* the scan should return the columns of the tasks as they are */
+	foreach(targetEntryCell, planTree->targetlist)
+	{
+		TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+		Var *column = (Var *) targetEntry->expr;
+
+		if (targetEntry->resjunk || !IsA(column, Var) ||
+			column->varattno != targetEntry->resno)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * ExecuteSubPlanOnWorkers executes the tasks of the subplan such that each
+ * task writes its rows into a piece of the intermediate result on the worker
+ * that runs it. The nodes that read the result then assemble it by fetching
+ * the pieces directly from the other workers, such that the rows do not pass
+ * through the coordinator.
+ *
+ * If tasks read partitions of the result, each task writes its rows into a
+ * piece per partition instead. Since the partitions together contain all
+ * rows, all pieces together form the whole result.
+ *
+ * Since the location of each piece is fixed before execution, the tasks
+ * only run on their first placement.
+ */
+static void
+ExecuteSubPlanOnWorkers(char *resultId, DistributedSubPlan *subPlan, List *nodeList,
+						List *workerNodeList, bool writeLocalFile)
+{
+	CustomScan *customScan = (CustomScan *) subPlan->plan->planTree;
+	DistributedPlan *distributedPlan = GetDistributedPlan(customScan);
+	List *taskList = distributedPlan->workerJob->taskList;
+	List *pieceTaskList = NIL;
+	List *pieceList = NIL;
+	List *pieceListList = NIL;
+	ListCell *taskCell = NULL;
+	TupleDesc tupleDescriptor = NULL;
+	Tuplestorestate *tupleStore = NULL;
+	bool partitioned = (subPlan->partitionRelationIdList != NIL);
+	int partitionCount = 0;
+	int partitionIndex = 0;
+	bool randomAccess = false;
+	bool interTransactions = false;
+	bool hasReturning = false;
+
+	if (partitioned)
+	{
+		Oid relationId = linitial_oid(subPlan->partitionRelationIdList);
+
+		partitionCount = DistributedTableCacheEntry(relationId)->shardIntervalArrayLength;
+		for (partitionIndex = 0; partitionIndex < partitionCount; partitionIndex++)
+		{
+			pieceListList = lappend(pieceListList, NIL);
+		}
+	}
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+		ShardPlacement *placement = (ShardPlacement *) linitial(task->taskPlacementList);
+		Task *pieceTask = copyObject(task);
+		char *taskResultId = psprintf("%s_%u", resultId, task->taskId);
+		ListCell *pieceListCell = NULL;
+
+		if (!partitioned)
+		{
+			IntermediateResultPiece *piece =
+				(IntermediateResultPiece *) palloc0(sizeof(IntermediateResultPiece));
+
+			piece->pieceId = taskResultId;
+			piece->nodeName = placement->nodeName;
+			piece->nodePort = placement->nodePort;
+
+			pieceTask->queryString =
+				psprintf("SELECT pg_catalog.create_intermediate_result(%s, %s)",
+						 quote_literal_cstr(piece->pieceId),
+						 quote_literal_cstr(task->queryString));
+
+			pieceList = lappend(pieceList, piece);
+		}
+		else
+		{
+			pieceTask->queryString =
+				PartitionQueryResultCommand(taskResultId, task->queryString,
+											linitial_oid(subPlan->partitionRelationIdList),
+											linitial_int(subPlan->partitionColumnIndexList));
+
+			partitionIndex = 0;
+			foreach(pieceListCell, pieceListList)
+			{
+				IntermediateResultPiece *piece =
+					(IntermediateResultPiece *) palloc0(sizeof(IntermediateResultPiece));
+
+				piece->pieceId = PartitionedResultId(taskResultId, partitionIndex);
+				piece->nodeName = placement->nodeName;
+				piece->nodePort = placement->nodePort;
+
+				lfirst(pieceListCell) = lappend((List *) lfirst(pieceListCell), piece);
+				pieceList = lappend(pieceList, piece);
+
+				partitionIndex++;
+			}
+		}
+
+		pieceTask->taskPlacementList = list_make1(placement);
+		pieceTaskList = lappend(pieceTaskList, pieceTask);
+	}
+
+#if PG_VERSION_NUM < 120000
+	tupleDescriptor = CreateTemplateTupleDesc(1, false);
+#else
+	tupleDescriptor = CreateTemplateTupleDesc(1);
+#endif
+	TupleDescInitEntry(tupleDescriptor, (AttrNumber) 1, "rows_written",
+					   INT8OID, -1, 0);
+	tupleStore = tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+
+	SubPlanLevel++;
+	ExecuteTaskListExtended(ROW_MODIFY_READONLY, pieceTaskList, tupleDescriptor,
+							tupleStore, hasReturning, MaxAdaptiveExecutorPoolSize);
+	SubPlanLevel--;
+
+	tuplestore_end(tupleStore);
+
+	if (LogIntermediateResults)
+	{
+		ereport(DEBUG1, (errmsg("Subplan %s will be assembled from %d pieces on "
+								"the workers", resultId, list_length(pieceList))));
+	}
+
+	if (partitioned)
+	{
+		FetchPartitionedResultPieces(resultId, subPlan, pieceListList, nodeList,
+									 writeLocalFile, workerNodeList);
+	}
+	else
+	{
+		FetchIntermediateResultPieces(resultId, pieceList, nodeList, writeLocalFile);
+	}
+}
+
+
+/*
+ * FetchPartitionedResultPieces assembles each partition of the result on the
+ * nodes that have the shard of the partition, and the whole result on the
+ * nodes in nodeList and locally if writeLocalFile is set. The pieces of
+ * partition i are in the i-th list of pieceListList. Each node assembles all
+ * of its results in a single command.
+ */
+static void
+FetchPartitionedResultPieces(char *resultId, DistributedSubPlan *subPlan,
+							 List *pieceListList, List *nodeList, bool writeLocalFile,
+							 List *workerNodeList)
+{
+	Oid relationId = linitial_oid(subPlan->partitionRelationIdList);
+	int partitionColumnIndex = linitial_int(subPlan->partitionColumnIndexList);
+	char *partitionPrefix = PartitionedResultPrefix(resultId, relationId,
+													partitionColumnIndex);
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	List *commandNodeList = NIL;
+	List *commandList = NIL;
+	List *allPieceList = NIL;
+	List *connectionList = NIL;
+	ListCell *pieceListCell = NULL;
+	ListCell *nodeCell = NULL;
+	int partitionIndex = 0;
+
+	foreach(pieceListCell, pieceListList)
+	{
+		List *pieceList = (List *) lfirst(pieceListCell);
+		ShardInterval *shardInterval = cacheEntry->sortedShardIntervalArray[partitionIndex];
+		List *placementNodeList = ShardPlacementNodeList(shardInterval->shardId,
+														 workerNodeList);
+		char *partitionId = PartitionedResultId(partitionPrefix, partitionIndex);
+		StringInfo fetchCommand = FetchIntermediateResultPiecesCommand(partitionId,
+																	   pieceList);
+
+		foreach(nodeCell, placementNodeList)
+		{
+			WorkerNode *workerNode = (WorkerNode *) lfirst(nodeCell);
+
+			AppendNodeCommand(&commandNodeList, &commandList, workerNode,
+							  fetchCommand->data);
+		}
+
+		allPieceList = list_concat(allPieceList, list_copy(pieceList));
+		partitionIndex++;
+	}
+
+	if (nodeList != NIL)
+	{
+		StringInfo fetchCommand = FetchIntermediateResultPiecesCommand(resultId,
+																	   allPieceList);
+
+		foreach(nodeCell, nodeList)
+		{
+			WorkerNode *workerNode = (WorkerNode *) lfirst(nodeCell);
+
+			AppendNodeCommand(&commandNodeList, &commandList, workerNode,
+							  fetchCommand->data);
+		}
+	}
+
+	connectionList = StartIntermediateResultCommands(commandNodeList, commandList);
+
+	/* assemble the local copy while the other nodes fetch the pieces */
+	if (writeLocalFile)
+	{
+		FetchIntermediateResultPieces(resultId, allPieceList, NIL, writeLocalFile);
+	}
+
+	FinishIntermediateResultCommands(connectionList);
+}
+
+
+/*
+ * AppendNodeCommand appends command to the command string of the given node
+ * in commandList, which has the same position as the node in commandNodeList.
+ * Nodes that do not yet have a command string are added to both lists.
+ */
+static void
+AppendNodeCommand(List **commandNodeList, List **commandList, WorkerNode *workerNode,
+				  char *command)
+{
+	ListCell *nodeCell = NULL;
+	ListCell *commandCell = NULL;
+	StringInfo nodeCommand = NULL;
+
+	forboth(nodeCell, *commandNodeList, commandCell, *commandList)
+	{
+		if (lfirst(nodeCell) == workerNode)
+		{
+			nodeCommand = makeStringInfo();
+			appendStringInfo(nodeCommand, "%s;%s", (char *) lfirst(commandCell),
+							 command);
+			lfirst(commandCell) = nodeCommand->data;
+
+			return;
+		}
+	}
+
+	*commandNodeList = lappend(*commandNodeList, workerNode);
+	*commandList = lappend(*commandList, pstrdup(command));
+}
+
+
+/*
+ * ShardPlacementNodeList returns the nodes in workerNodeList that have a
+ * finalized placement of the given shard.
+ */
+static List *
+ShardPlacementNodeList(uint64 shardId, List *workerNodeList)
+{
+	List *placementNodeList = NIL;
+	List *placementList = FinalizedShardPlacementList(shardId);
+	ListCell *placementCell = NULL;
+
+	foreach(placementCell, placementList)
+	{
+		ShardPlacement *placement = (ShardPlacement *) lfirst(placementCell);
+		ListCell *workerNodeCell = NULL;
+
+		foreach(workerNodeCell, workerNodeList)
+		{
+			WorkerNode *workerNode = (WorkerNode *) lfirst(workerNodeCell);
+
+			if (workerNode->groupId == placement->groupId)
+			{
+				placementNodeList = list_append_unique_ptr(placementNodeList,
+														   workerNode);
+			}
+		}
+	}
+
+	return placementNodeList;
+}
+
+
+/*
+ * PartitionQueryResultCommand returns a worker_partition_query_result call
+ * that writes the result of queryString into the partitions with the given
+ * prefix that correspond to the shards of the relation. The call returns the
+ * number of rows written.
+ */
+static char *
+PartitionQueryResultCommand(char *resultPrefix, char *queryString, Oid relationId,
+							int partitionColumnIndex)
+{
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	StringInfo command = makeStringInfo();
+	StringInfo minValueArray = makeStringInfo();
+	StringInfo maxValueArray = makeStringInfo();
+	int shardIndex = 0;
+
+	for (shardIndex = 0; shardIndex < cacheEntry->shardIntervalArrayLength;
+		 shardIndex++)
+	{
+		ShardInterval *shardInterval = cacheEntry->sortedShardIntervalArray[shardIndex];
+		char *separator = (shardIndex > 0) ? "," : "";
+
+		appendStringInfo(minValueArray, "%s'%d'", separator,
+						 DatumGetInt32(shardInterval->minValue));
+		appendStringInfo(maxValueArray, "%s'%d'", separator,
+						 DatumGetInt32(shardInterval->maxValue));
+	}
+
+	appendStringInfo(command,
+					 "SELECT sum(rows_written)::bigint "
+					 "FROM pg_catalog.worker_partition_query_result(%s, %s, %d, 'hash', "
+					 "ARRAY[%s]::text[], ARRAY[%s]::text[])",
+					 quote_literal_cstr(resultPrefix), quote_literal_cstr(queryString),
+					 partitionColumnIndex, minValueArray->data, maxValueArray->data);
+
+	return command->data;
+}
+
+
+/*
+ * LogSubPlanDestinations logs the nodes to which the intermediate result is
+ * sent, and whether it is written to a local file.
+ */
+static void
+LogSubPlanDestinations(char *resultId, List *nodeList, bool writeLocalFile)
+{
+	ListCell *nodeCell = NULL;
+
+	foreach(nodeCell, nodeList)
+	{
+		WorkerNode *workerNode = (WorkerNode *) lfirst(nodeCell);
+
+		ereport(DEBUG1, (errmsg("Subplan %s will be sent to %s:%d", resultId,
+								workerNode->workerName, workerNode->workerPort)));
+	}
+
+	if (writeLocalFile)
+	{
+		ereport(DEBUG1, (errmsg("Subplan %s will be written to local file",
+								resultId)));
 	}
 }
@@ -44,6 +44,7 @@
 #include "distributed/relay_utility.h"
 #include "distributed/resource_lock.h"
 #include "distributed/remote_commands.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
 #include "distributed/version_compat.h"
@@ -154,6 +155,21 @@ citus_relation_size(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * DistributedTableSizeEstimate returns the size of the given distributed
+ * table in bytes for use in planning. The size is the sum of the shard
+ * lengths in the metadata, such that planning never needs to connect to the
+ * workers. Shard lengths of hash-distributed tables are only recorded by
+ * master_update_shard_statistics, so the function returns 0 for tables whose
+ * size is unknown.
+ */
+uint64
+DistributedTableSizeEstimate(Oid relationId)
+{
+	return TableShardLength(relationId);
+}
+
+
 /*
  * DistributedTableSize is helper function for each kind of citus size functions.
  * It first checks whether the table is distributed and size query can be run on
@@ -663,6 +679,34 @@ ShardLength(uint64 shardId)
 }
 
 
+/*
+ * TableShardLength returns the sum of the lengths of the shards of the given
+ * distributed table, as recorded in the metadata for the first placement of
+ * each shard. Since lengths are only recorded when shard statistics are
+ * updated, the function returns 0 when the size of the table is unknown.
+ */
+uint64
+TableShardLength(Oid relationId)
+{
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	uint64 tableShardLength = 0;
+	int shardIndex = 0;
+
+	for (shardIndex = 0; shardIndex < cacheEntry->shardIntervalArrayLength; shardIndex++)
+	{
+		GroupShardPlacement *placementArray =
+			cacheEntry->arrayOfPlacementArrays[shardIndex];
+
+		if (cacheEntry->arrayOfPlacementArrayLengths[shardIndex] > 0)
+		{
+			tableShardLength += placementArray[0].shardLength;
+		}
+	}
+
+	return tableShardLength;
+}
+
+
 /*
  * NodeGroupHasShardPlacements returns whether any active shards are placed on the group
  */
@@ -1116,6 +1160,8 @@ DeletePartitionRow(Oid distributedRelationId)
 
 	systable_endscan(scanDescriptor);
 
+	DeleteZoneMapColumnRows(distributedRelationId);
+
 	/* invalidate the cache */
 	CitusInvalidateRelcacheByRelid(distributedRelationId);
 
@@ -1165,6 +1211,9 @@ DeleteShardRow(uint64 shardId)
 
 	systable_endscan(scanDescriptor);
 
+	/* zone maps of the shard go away along with the shard */
+	DeleteShardZoneMapRows(shardId);
+
 	/* invalidate previous cache entry */
 	CitusInvalidateRelcacheByRelid(distributedRelationId);
 
@@ -44,6 +44,7 @@
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
 #include "distributed/resource_lock.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/transaction_management.h"
 #include "distributed/worker_manager.h"
 #include "distributed/worker_protocol.h"
@@ -946,6 +947,9 @@ UpdateShardStatistics(int64 shardId)
 	uint64 shardSize = 0;
 	text *minValue = NULL;
 	text *maxValue = NULL;
+	List *zoneMapColumnList = ZoneMapColumnList(relationId);
+	List *shardZoneMapList = NIL;
+	ListCell *shardZoneMapCell = NULL;
 
 	/* Build shard qualified name. */
 	char *shardName = get_rel_name(relationId);
@@ -967,6 +971,13 @@ UpdateShardStatistics(int64 shardId)
 								   &shardSize, &minValue, &maxValue);
 		if (statsOK)
 		{
+			if (zoneMapColumnList != NIL)
+			{
+				shardZoneMapList = WorkerShardZoneMaps(placement, relationId,
+													   shardQualifiedName,
+													   zoneMapColumnList);
+			}
+
 			break;
 		}
 	}
@@ -1008,6 +1019,25 @@ UpdateShardStatistics(int64 shardId)
 		InsertShardRow(relationId, shardId, storageType, minValue, maxValue);
 	}
 
+	/*
+	 * Replace the zone maps of the shard. If they could not be retrieved, the
+	 * shard is not pruned using zone maps.
+	 */
+	if (zoneMapColumnList != NIL)
+	{
+		DeleteShardZoneMapRows(shardId);
+
+		foreach(shardZoneMapCell, shardZoneMapList)
+		{
+			ShardZoneMap *shardZoneMap = (ShardZoneMap *) lfirst(shardZoneMapCell);
+
+			InsertShardZoneMapRow(shardId, shardZoneMap);
+		}
+
+		CitusInvalidateRelcacheByRelid(relationId);
+		CommandCounterIncrement();
+	}
+
 	if (QueryCancelPending)
 	{
 		ereport(WARNING, (errmsg("cancel requests are ignored during metadata update")));
@@ -0,0 +1,1027 @@
+/*-------------------------------------------------------------------------
+ *
+ * shard_zone_maps.c
+ *
+ * Routines for keeping the minimum and maximum values of non-partition
+ * columns of append- and range-distributed tables per shard, and for
+ * pruning shards using these values.
+ *
+ * Append-distributed tables are frequently loaded in time order, which
+ * means that columns other than the partition column (e.g. an id or a
+ * second timestamp) are often also clustered within shards. After
+ * master_add_zone_map_column is called for such a column, the minimum,
+ * maximum and number of NULL values of the column are collected along with
+ * the other shard statistics in UpdateShardStatistics, and stored in
+ * citus.pg_dist_shard_zone_map. The planner then skips shards whose values
+ * cannot satisfy the comparisons on the column in the WHERE clause.
+ *
+ * The values of a shard are only used while they are known to be correct.
+ * Modifications of the table and COPY into existing shards remove the
+ * values of all shards of the table, which then are no longer pruned using
+ * zone maps until their statistics are updated again. Zone maps of columns
+ * whose type has changed since master_add_zone_map_column are ignored.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "libpq-fe.h"
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "access/xact.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_am.h"
+#include "commands/defrem.h"
+#include "distributed/connection_management.h"
+#include "distributed/master_metadata_utility.h"
+#include "distributed/master_protocol.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/pg_dist_partition.h"
+#include "distributed/pg_dist_shard_zone_map.h"
+#include "distributed/placement_connection.h"
+#include "distributed/remote_commands.h"
+#include "distributed/shard_zone_maps.h"
+#include "distributed/version_compat.h"
+#include "distributed/worker_manager.h"
+#include "distributed/worker_protocol.h"
+#include "lib/stringinfo.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "parser/parse_coerce.h"
+#include "storage/lmgr.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+
+/*
+ * ZoneMapRestriction is a comparison or NULL test on a zone map column that
+ * is ANDed to the rest of the WHERE clause.
+ */
+typedef struct ZoneMapRestriction
+{
+	ColumnZoneMap *zoneMap;
+
+	/* btree strategy of "column op constant", invalid for NULL tests */
+	StrategyNumber strategy;
+	Const *constant;
+
+	NullTestType nullTestType;
+} ZoneMapRestriction;
+
+
+static void InsertZoneMapColumnRow(Oid relationId, AttrNumber attributeNumber,
+								   Oid columnTypeId);
+static void ExtractZoneMapRestrictions(Node *node, List *zoneMapList,
+									   Index rangeTableId, List **restrictionList);
+static ZoneMapRestriction * ComparisonZoneMapRestriction(OpExpr *opClause,
+														 List *zoneMapList,
+														 Index rangeTableId);
+static ColumnZoneMap * ColumnZoneMapForExpression(Node *expression, List *zoneMapList,
+												  Index rangeTableId);
+static bool ZoneMapRefutesRestriction(ZoneMapRestriction *restriction, int shardIndex);
+
+
+/* exports for SQL callable functions */
+PG_FUNCTION_INFO_V1(master_add_zone_map_column);
+
+
+/*
+ * master_add_zone_map_column starts keeping per-shard minimum and maximum
+ * values for the given column of an append- or range-distributed table, and
+ * collects these values for the existing shards.
+ */
+Datum
+master_add_zone_map_column(PG_FUNCTION_ARGS)
+{
+	Oid relationId = PG_GETARG_OID(0);
+	text *columnNameText = PG_GETARG_TEXT_P(1);
+	char *columnName = text_to_cstring(columnNameText);
+	char *relationName = NULL;
+	DistTableCacheEntry *cacheEntry = NULL;
+	AttrNumber attributeNumber = InvalidAttrNumber;
+	Oid columnTypeId = InvalidOid;
+	List *zoneMapColumnList = NIL;
+	ListCell *zoneMapColumnCell = NULL;
+	List *shardIntervalList = NIL;
+	ListCell *shardIntervalCell = NULL;
+
+	CheckCitusVersion(ERROR);
+	EnsureCoordinator();
+	EnsureTableOwner(relationId);
+	CheckDistributedTable(relationId);
+
+	relationName = get_rel_name(relationId);
+
+	/* don't allow concurrent appends and statistics updates */
+	LockRelationOid(relationId, ShareUpdateExclusiveLock);
+
+	cacheEntry = DistributedTableCacheEntry(relationId);
+	if (cacheEntry->partitionMethod != DISTRIBUTE_BY_APPEND &&
+		cacheEntry->partitionMethod != DISTRIBUTE_BY_RANGE)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("relation \"%s\" is not an append- or range-"
+							   "distributed table", relationName),
+						errdetail("Zone maps are only kept for append- and "
+								  "range-distributed tables.")));
+	}
+
+	attributeNumber = get_attnum(relationId, columnName);
+	if (attributeNumber == InvalidAttrNumber || attributeNumber < 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_COLUMN),
+						errmsg("column \"%s\" of relation \"%s\" does not exist",
+							   columnName, relationName)));
+	}
+
+	if (attributeNumber == cacheEntry->partitionColumn->varattno)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("column \"%s\" is the distribution column of "
+							   "relation \"%s\"", columnName, relationName),
+						errdetail("Shards are already pruned using the minimum "
+								  "and maximum values of the distribution column.")));
+	}
+
+	columnTypeId = get_atttype(relationId, attributeNumber);
+	if (!OidIsValid(GetDefaultOpClass(columnTypeId, BTREE_AM_OID)))
+	{
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_OBJECT),
+						errmsg("data type %s has no default operator class for "
+							   "access method \"btree\"",
+							   format_type_be(columnTypeId))));
+	}
+
+	zoneMapColumnList = ZoneMapColumnList(relationId);
+	foreach(zoneMapColumnCell, zoneMapColumnList)
+	{
+		ZoneMapColumn *zoneMapColumn = (ZoneMapColumn *) lfirst(zoneMapColumnCell);
+
+		if (zoneMapColumn->attributeNumber == attributeNumber)
+		{
+			ereport(ERROR, (errcode(ERRCODE_DUPLICATE_OBJECT),
+							errmsg("zone maps are already kept for column \"%s\" of "
+								   "relation \"%s\"", columnName, relationName)));
+		}
+	}
+
+	InsertZoneMapColumnRow(relationId, attributeNumber, columnTypeId);
+
+	/* collect the values of the column for the existing shards */
+	shardIntervalList = LoadShardIntervalList(relationId);
+	foreach(shardIntervalCell, shardIntervalList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+
+		UpdateShardStatistics(shardInterval->shardId);
+	}
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * ZoneMapColumnList returns the columns of the given relation for which zone
+ * maps are kept, as a list of ZoneMapColumn.
+ */
+List *
+ZoneMapColumnList(Oid relationId)
+{
+	Relation pgDistZoneMapColumn = NULL;
+	SysScanDesc scanDescriptor = NULL;
+	ScanKeyData scanKey[1];
+	int scanKeyCount = 1;
+	bool indexOK = true;
+	HeapTuple heapTuple = NULL;
+	List *zoneMapColumnList = NIL;
+
+	pgDistZoneMapColumn = heap_open(DistZoneMapColumnRelationId(), AccessShareLock);
+
+	ScanKeyInit(&scanKey[0], Anum_pg_dist_zone_map_column_logicalrelid,
+				BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(relationId));
+
+	scanDescriptor = systable_beginscan(pgDistZoneMapColumn,
+										DistZoneMapColumnPrimaryKeyIndexId(), indexOK,
+										NULL, scanKeyCount, scanKey);
+
+	heapTuple = systable_getnext(scanDescriptor);
+	while (HeapTupleIsValid(heapTuple))
+	{
+		Form_pg_dist_zone_map_column zoneMapColumnForm =
+			(Form_pg_dist_zone_map_column) GETSTRUCT(heapTuple);
+		ZoneMapColumn *zoneMapColumn = palloc0(sizeof(ZoneMapColumn));
+
+		zoneMapColumn->attributeNumber = zoneMapColumnForm->attnum;
+		zoneMapColumn->columnTypeId = zoneMapColumnForm->atttypid;
+
+		zoneMapColumnList = lappend(zoneMapColumnList, zoneMapColumn);
+
+		heapTuple = systable_getnext(scanDescriptor);
+	}
+
+	systable_endscan(scanDescriptor);
+	heap_close(pgDistZoneMapColumn, NoLock);
+
+	return zoneMapColumnList;
+}
+
+
+/*
+ * InsertZoneMapColumnRow records that zone maps are kept for the given column
+ * and invalidates the cache entry of the relation.
+ */
+static void
+InsertZoneMapColumnRow(Oid relationId, AttrNumber attributeNumber, Oid columnTypeId)
+{
+	Relation pgDistZoneMapColumn = NULL;
+	TupleDesc tupleDescriptor = NULL;
+	HeapTuple heapTuple = NULL;
+	Datum values[Natts_pg_dist_zone_map_column];
+	bool isNulls[Natts_pg_dist_zone_map_column];
+
+	memset(values, 0, sizeof(values));
+	memset(isNulls, false, sizeof(isNulls));
+
+	values[Anum_pg_dist_zone_map_column_logicalrelid - 1] =
+		ObjectIdGetDatum(relationId);
+	values[Anum_pg_dist_zone_map_column_attnum - 1] = Int16GetDatum(attributeNumber);
+	values[Anum_pg_dist_zone_map_column_atttypid - 1] = ObjectIdGetDatum(columnTypeId);
+
+	pgDistZoneMapColumn = heap_open(DistZoneMapColumnRelationId(), RowExclusiveLock);
+
+	tupleDescriptor = RelationGetDescr(pgDistZoneMapColumn);
+	heapTuple = heap_form_tuple(tupleDescriptor, values, isNulls);
+
+	CatalogTupleInsert(pgDistZoneMapColumn, heapTuple);
+
+	CitusInvalidateRelcacheByRelid(relationId);
+
+	CommandCounterIncrement();
+	heap_close(pgDistZoneMapColumn, NoLock);
+}
+
+
+/*
+ * DeleteZoneMapColumnRows stops keeping zone maps for all columns of the
+ * given relation. The values of the shards are removed along with the
+ * shards.
+ */
+void
+DeleteZoneMapColumnRows(Oid relationId)
+{
+	Relation pgDistZoneMapColumn = NULL;
+	SysScanDesc scanDescriptor = NULL;
+	ScanKeyData scanKey[1];
+	int scanKeyCount = 1;
+	bool indexOK = true;
+	HeapTuple heapTuple = NULL;
+
+	pgDistZoneMapColumn = heap_open(DistZoneMapColumnRelationId(), RowExclusiveLock);
+
+	ScanKeyInit(&scanKey[0], Anum_pg_dist_zone_map_column_logicalrelid,
+				BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(relationId));
+
+	scanDescriptor = systable_beginscan(pgDistZoneMapColumn,
+										DistZoneMapColumnPrimaryKeyIndexId(), indexOK,
+										NULL, scanKeyCount, scanKey);
+
+	heapTuple = systable_getnext(scanDescriptor);
+	while (HeapTupleIsValid(heapTuple))
+	{
+		simple_heap_delete(pgDistZoneMapColumn, &heapTuple->t_self);
+
+		heapTuple = systable_getnext(scanDescriptor);
+	}
+
+	systable_endscan(scanDescriptor);
+
+	CommandCounterIncrement();
+	heap_close(pgDistZoneMapColumn, NoLock);
+}
+
+
+/*
+ * WorkerShardZoneMaps queries the minimum, maximum and number of NULL values
+ * of the given columns in the shard on the given placement, and returns them
+ * as a list of ShardZoneMap. If the query fails, the function returns NIL.
+ */
+List *
+WorkerShardZoneMaps(ShardPlacement *placement, Oid relationId, char *shardName,
+					List *zoneMapColumnList)
+{
+	StringInfo zoneMapQuery = makeStringInfo();
+	ListCell *zoneMapColumnCell = NULL;
+	List *shardZoneMapList = NIL;
+	PGresult *queryResult = NULL;
+	int columnIndex = 0;
+	int connectionFlags = 0;
+	int executeCommand = 0;
+
+	MultiConnection *connection = GetPlacementConnection(connectionFlags, placement,
+														 NULL);
+
+	appendStringInfoString(zoneMapQuery, "SELECT ");
+
+	foreach(zoneMapColumnCell, zoneMapColumnList)
+	{
+		ZoneMapColumn *zoneMapColumn = (ZoneMapColumn *) lfirst(zoneMapColumnCell);
+		char *columnName = get_attname_internal(relationId,
+												zoneMapColumn->attributeNumber,
+												false);
+		const char *quotedColumnName = quote_identifier(columnName);
+
+		if (zoneMapColumnCell != list_head(zoneMapColumnList))
+		{
+			appendStringInfoString(zoneMapQuery, ", ");
+		}
+
+		/*
+		 * Not all types that have a btree operator class have min and max
+		 * aggregates (e.g. bool and uuid), so take the first and last value
+		 * in the sort order of the column instead.
+		 */
+		appendStringInfo(zoneMapQuery,
+						 "(SELECT %s FROM %s WHERE %s IS NOT NULL ORDER BY 1 LIMIT 1), "
+						 "(SELECT %s FROM %s WHERE %s IS NOT NULL ORDER BY 1 DESC LIMIT 1), "
+						 "count(*) - count(%s)",
+						 quotedColumnName, shardName, quotedColumnName,
+						 quotedColumnName, shardName, quotedColumnName,
+						 quotedColumnName);
+	}
+
+	appendStringInfo(zoneMapQuery, " FROM %s", shardName);
+
+	executeCommand = ExecuteOptionalRemoteCommand(connection, zoneMapQuery->data,
+												  &queryResult);
+	if (executeCommand != 0)
+	{
+		return NIL;
+	}
+
+	foreach(zoneMapColumnCell, zoneMapColumnList)
+	{
+		ZoneMapColumn *zoneMapColumn = (ZoneMapColumn *) lfirst(zoneMapColumnCell);
+		ShardZoneMap *shardZoneMap = palloc0(sizeof(ShardZoneMap));
+		int minValueIndex = columnIndex * 3;
+		int maxValueIndex = columnIndex * 3 + 1;
+		int nullCountIndex = columnIndex * 3 + 2;
+		char *nullCountString = PQgetvalue(queryResult, 0, nullCountIndex);
+
+		shardZoneMap->attributeNumber = zoneMapColumn->attributeNumber;
+		shardZoneMap->nullCount = pg_strtouint64(nullCountString, NULL, 10);
+
+		if (!PQgetisnull(queryResult, 0, minValueIndex) &&
+			!PQgetisnull(queryResult, 0, maxValueIndex))
+		{
+			char *minValueResult = PQgetvalue(queryResult, 0, minValueIndex);
+			char *maxValueResult = PQgetvalue(queryResult, 0, maxValueIndex);
+
+			shardZoneMap->minValue = cstring_to_text(minValueResult);
+			shardZoneMap->maxValue = cstring_to_text(maxValueResult);
+		}
+
+		shardZoneMapList = lappend(shardZoneMapList, shardZoneMap);
+		columnIndex++;
+	}
+
+	PQclear(queryResult);
+	ForgetResults(connection);
+
+	return shardZoneMapList;
+}
+
+
+/*
+ * InsertShardZoneMapRow stores the zone map of a column in the given shard.
+ * Callers are expected to invalidate the cache entry of the relation.
+ */
+void
+InsertShardZoneMapRow(uint64 shardId, ShardZoneMap *shardZoneMap)
+{
+	Relation pgDistShardZoneMap = NULL;
+	TupleDesc tupleDescriptor = NULL;
+	HeapTuple heapTuple = NULL;
+	Datum values[Natts_pg_dist_shard_zone_map];
+	bool isNulls[Natts_pg_dist_shard_zone_map];
+
+	memset(values, 0, sizeof(values));
+	memset(isNulls, false, sizeof(isNulls));
+
+	values[Anum_pg_dist_shard_zone_map_shardid - 1] = Int64GetDatum(shardId);
+	values[Anum_pg_dist_shard_zone_map_attnum - 1] =
+		Int16GetDatum(shardZoneMap->attributeNumber);
+	values[Anum_pg_dist_shard_zone_map_nullcount - 1] =
+		Int64GetDatum(shardZoneMap->nullCount);
+
+	if (shardZoneMap->minValue != NULL && shardZoneMap->maxValue != NULL)
+	{
+		values[Anum_pg_dist_shard_zone_map_minvalue - 1] =
+			PointerGetDatum(shardZoneMap->minValue);
+		values[Anum_pg_dist_shard_zone_map_maxvalue - 1] =
+			PointerGetDatum(shardZoneMap->maxValue);
+	}
+	else
+	{
+		isNulls[Anum_pg_dist_shard_zone_map_minvalue - 1] = true;
+		isNulls[Anum_pg_dist_shard_zone_map_maxvalue - 1] = true;
+	}
+
+	pgDistShardZoneMap = heap_open(DistShardZoneMapRelationId(), RowExclusiveLock);
+
+	tupleDescriptor = RelationGetDescr(pgDistShardZoneMap);
+	heapTuple = heap_form_tuple(tupleDescriptor, values, isNulls);
+
+	CatalogTupleInsert(pgDistShardZoneMap, heapTuple);
+
+	CommandCounterIncrement();
+	heap_close(pgDistShardZoneMap, NoLock);
+}
+
+
+/*
+ * DeleteShardZoneMapRows removes the zone maps of all columns in the given
+ * shard. Callers are expected to invalidate the cache entry of the relation.
+ */
+void
+DeleteShardZoneMapRows(uint64 shardId)
+{
+	Relation pgDistShardZoneMap = NULL;
+	SysScanDesc scanDescriptor = NULL;
+	ScanKeyData scanKey[1];
+	int scanKeyCount = 1;
+	bool indexOK = true;
+	HeapTuple heapTuple = NULL;
+
+	pgDistShardZoneMap = heap_open(DistShardZoneMapRelationId(), RowExclusiveLock);
+
+	ScanKeyInit(&scanKey[0], Anum_pg_dist_shard_zone_map_shardid,
+				BTEqualStrategyNumber, F_INT8EQ, Int64GetDatum(shardId));
+
+	scanDescriptor = systable_beginscan(pgDistShardZoneMap,
+										DistShardZoneMapPrimaryKeyIndexId(), indexOK,
+										NULL, scanKeyCount, scanKey);
+
+	heapTuple = systable_getnext(scanDescriptor);
+	while (HeapTupleIsValid(heapTuple))
+	{
+		simple_heap_delete(pgDistShardZoneMap, &heapTuple->t_self);
+
+		heapTuple = systable_getnext(scanDescriptor);
+	}
+
+	systable_endscan(scanDescriptor);
+
+	CommandCounterIncrement();
+	heap_close(pgDistShardZoneMap, NoLock);
+}
+
+
+/*
+ * InvalidateShardZoneMaps removes the zone maps of all shards of the given
+ * relation, since the rows that are about to be written to the shards might
+ * fall outside of them. The shards are no longer pruned using zone maps until
+ * their statistics are updated again.
+ */
+void
+InvalidateShardZoneMaps(Oid relationId)
+{
+	DistTableCacheEntry *cacheEntry = DistributedTableCacheEntry(relationId);
+	List *shardIntervalList = NIL;
+	ListCell *shardIntervalCell = NULL;
+
+	/* nothing to do if none of the shards have zone maps */
+	if (cacheEntry->zoneMapList == NIL)
+	{
+		return;
+	}
+
+	shardIntervalList = LoadShardIntervalList(relationId);
+	foreach(shardIntervalCell, shardIntervalList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+
+		DeleteShardZoneMapRows(shardInterval->shardId);
+	}
+
+	CitusInvalidateRelcacheByRelid(relationId);
+	CommandCounterIncrement();
+}
+
+
+/*
+ * BuildColumnZoneMapList reads the zone maps of the shards of the given
+ * relation for the metadata cache, and returns them as a list of
+ * ColumnZoneMap allocated in zoneMapContext. Columns for which none of the
+ * shards have zone maps, and columns whose type changed since zone maps
+ * were added, are left out.
+ */
+List *
+BuildColumnZoneMapList(Oid relationId, ShardInterval **sortedShardIntervalArray,
+					   int shardCount, MemoryContext zoneMapContext)
+{
+	List *zoneMapColumnList = ZoneMapColumnList(relationId);
+	ListCell *zoneMapColumnCell = NULL;
+	List *zoneMapList = NIL;
+	List *columnZoneMapList = NIL;
+	ListCell *zoneMapCell = NULL;
+	Relation pgDistShardZoneMap = NULL;
+	TupleDesc tupleDescriptor = NULL;
+	int shardIndex = 0;
+
+	if (zoneMapColumnList == NIL || shardCount == 0)
+	{
+		return NIL;
+	}
+
+	foreach(zoneMapColumnCell, zoneMapColumnList)
+	{
+		ZoneMapColumn *zoneMapColumn = (ZoneMapColumn *) lfirst(zoneMapColumnCell);
+		ColumnZoneMap *zoneMap = NULL;
+		Oid columnTypeId = InvalidOid;
+		int32 columnTypeMod = -1;
+		Oid columnCollation = InvalidOid;
+		Oid operatorClassId = InvalidOid;
+		MemoryContext oldContext = NULL;
+
+		get_atttypetypmodcoll(relationId, zoneMapColumn->attributeNumber,
+							  &columnTypeId, &columnTypeMod, &columnCollation);
+
+		/* dropped columns have an invalid type */
+		if (columnTypeId != zoneMapColumn->columnTypeId)
+		{
+			continue;
+		}
+
+		operatorClassId = GetDefaultOpClass(columnTypeId, BTREE_AM_OID);
+		if (!OidIsValid(operatorClassId))
+		{
+			continue;
+		}
+
+		oldContext = MemoryContextSwitchTo(zoneMapContext);
+
+		zoneMap = palloc0(sizeof(ColumnZoneMap));
+		zoneMap->attributeNumber = zoneMapColumn->attributeNumber;
+		zoneMap->columnTypeId = columnTypeId;
+		zoneMap->columnCollation = columnCollation;
+		zoneMap->operatorFamily = get_opclass_family(operatorClassId);
+		zoneMap->operatorClassInputType = get_opclass_input_type(operatorClassId);
+		zoneMap->compareFunction = GetFunctionInfo(columnTypeId, BTREE_AM_OID,
+												   BTORDER_PROC);
+		zoneMap->shardCount = shardCount;
+		zoneMap->zoneMapExists = palloc0(shardCount * sizeof(bool));
+		zoneMap->valuesExist = palloc0(shardCount * sizeof(bool));
+		zoneMap->minValues = palloc0(shardCount * sizeof(Datum));
+		zoneMap->maxValues = palloc0(shardCount * sizeof(Datum));
+		zoneMap->nullCounts = palloc0(shardCount * sizeof(int64));
+
+		MemoryContextSwitchTo(oldContext);
+
+		zoneMapList = lappend(zoneMapList, zoneMap);
+	}
+
+	if (zoneMapList == NIL)
+	{
+		return NIL;
+	}
+
+	pgDistShardZoneMap = heap_open(DistShardZoneMapRelationId(), AccessShareLock);
+	tupleDescriptor = RelationGetDescr(pgDistShardZoneMap);
+
+	for (shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		ShardInterval *shardInterval = sortedShardIntervalArray[shardIndex];
+		SysScanDesc scanDescriptor = NULL;
+		ScanKeyData scanKey[1];
+		int scanKeyCount = 1;
+		bool indexOK = true;
+		HeapTuple heapTuple = NULL;
+
+		ScanKeyInit(&scanKey[0], Anum_pg_dist_shard_zone_map_shardid,
+					BTEqualStrategyNumber, F_INT8EQ,
+					Int64GetDatum(shardInterval->shardId));
+
+		scanDescriptor = systable_beginscan(pgDistShardZoneMap,
+											DistShardZoneMapPrimaryKeyIndexId(),
+											indexOK, NULL, scanKeyCount, scanKey);
+
+		heapTuple = systable_getnext(scanDescriptor);
+		while (HeapTupleIsValid(heapTuple))
+		{
+			Datum datumArray[Natts_pg_dist_shard_zone_map];
+			bool isNullArray[Natts_pg_dist_shard_zone_map];
+			AttrNumber attributeNumber = InvalidAttrNumber;
+			ColumnZoneMap *zoneMap = NULL;
+
+			heap_deform_tuple(heapTuple, tupleDescriptor, datumArray, isNullArray);
+
+			attributeNumber =
+				DatumGetInt16(datumArray[Anum_pg_dist_shard_zone_map_attnum - 1]);
+
+			foreach(zoneMapCell, zoneMapList)
+			{
+				ColumnZoneMap *candidateZoneMap = (ColumnZoneMap *) lfirst(zoneMapCell);
+
+				if (candidateZoneMap->attributeNumber == attributeNumber)
+				{
+					zoneMap = candidateZoneMap;
+					break;
+				}
+			}
+
+			if (zoneMap != NULL)
+			{
+				zoneMap->zoneMapExists[shardIndex] = true;
+				zoneMap->nullCounts[shardIndex] =
+					DatumGetInt64(datumArray[Anum_pg_dist_shard_zone_map_nullcount - 1]);
+
+				if (!isNullArray[Anum_pg_dist_shard_zone_map_minvalue - 1] &&
+					!isNullArray[Anum_pg_dist_shard_zone_map_maxvalue - 1])
+				{
+					char *minValueString = TextDatumGetCString(
+						datumArray[Anum_pg_dist_shard_zone_map_minvalue - 1]);
+					char *maxValueString = TextDatumGetCString(
+						datumArray[Anum_pg_dist_shard_zone_map_maxvalue - 1]);
+					Oid inputFunctionId = InvalidOid;
+					Oid typeIoParam = InvalidOid;
+					int16 typeLength = 0;
+					bool typeByValue = false;
+					Datum minValue = 0;
+					Datum maxValue = 0;
+					MemoryContext oldContext = NULL;
+
+					getTypeInputInfo(zoneMap->columnTypeId, &inputFunctionId,
+									 &typeIoParam);
+					get_typlenbyval(zoneMap->columnTypeId, &typeLength, &typeByValue);
+
+					minValue = OidInputFunctionCall(inputFunctionId, minValueString,
+													typeIoParam, -1);
+					maxValue = OidInputFunctionCall(inputFunctionId, maxValueString,
+													typeIoParam, -1);
+
+					oldContext = MemoryContextSwitchTo(zoneMapContext);
+
+					zoneMap->valuesExist[shardIndex] = true;
+					zoneMap->minValues[shardIndex] = datumCopy(minValue, typeByValue,
+															   typeLength);
+					zoneMap->maxValues[shardIndex] = datumCopy(maxValue, typeByValue,
+															   typeLength);
+
+					MemoryContextSwitchTo(oldContext);
+				}
+			}
+
+			heapTuple = systable_getnext(scanDescriptor);
+		}
+
+		systable_endscan(scanDescriptor);
+	}
+
+	heap_close(pgDistShardZoneMap, AccessShareLock);
+
+	/* only keep the columns for which at least one shard has a zone map */
+	foreach(zoneMapCell, zoneMapList)
+	{
+		ColumnZoneMap *zoneMap = (ColumnZoneMap *) lfirst(zoneMapCell);
+
+		for (shardIndex = 0; shardIndex < shardCount; shardIndex++)
+		{
+			if (zoneMap->zoneMapExists[shardIndex])
+			{
+				MemoryContext oldContext = MemoryContextSwitchTo(zoneMapContext);
+
+				columnZoneMapList = lappend(columnZoneMapList, zoneMap);
+
+				MemoryContextSwitchTo(oldContext);
+				break;
+			}
+		}
+	}
+
+	return columnZoneMapList;
+}
+
+
+/*
+ * PruneShardsWithZoneMaps removes the shards from the given list of shards of
+ * the relation whose zone maps show that they cannot contain rows matching
+ * the WHERE clause. Only comparisons with constants and NULL tests on zone
+ * map columns that are ANDed to the rest of the clause are considered.
+ */
+List *
+PruneShardsWithZoneMaps(DistTableCacheEntry *cacheEntry, Index rangeTableId,
+						List *whereClauseList, List *shardIntervalList)
+{
+	List *restrictionList = NIL;
+	List *remainingShardList = NIL;
+	ListCell *shardIntervalCell = NULL;
+
+	ExtractZoneMapRestrictions((Node *) whereClauseList, cacheEntry->zoneMapList,
+							   rangeTableId, &restrictionList);
+	if (restrictionList == NIL)
+	{
+		return shardIntervalList;
+	}
+
+	foreach(shardIntervalCell, shardIntervalList)
+	{
+		ShardInterval *shardInterval = (ShardInterval *) lfirst(shardIntervalCell);
+		ListCell *restrictionCell = NULL;
+		bool shardRefuted = false;
+
+		foreach(restrictionCell, restrictionList)
+		{
+			ZoneMapRestriction *restriction =
+				(ZoneMapRestriction *) lfirst(restrictionCell);
+
+			if (ZoneMapRefutesRestriction(restriction, shardInterval->shardIndex))
+			{
+				shardRefuted = true;
+				break;
+			}
+		}
+
+		if (!shardRefuted)
+		{
+			remainingShardList = lappend(remainingShardList, shardInterval);
+		}
+	}
+
+	return remainingShardList;
+}
+
+
+/*
+ * ExtractZoneMapRestrictions walks the ANDed clauses of the given expression
+ * and adds the restrictions on zone map columns to restrictionList.
+ */
+static void
+ExtractZoneMapRestrictions(Node *node, List *zoneMapList, Index rangeTableId,
+						   List **restrictionList)
+{
+	if (node == NULL)
+	{
+		return;
+	}
+
+	if (IsA(node, List))
+	{
+		ListCell *clauseCell = NULL;
+
+		foreach(clauseCell, (List *) node)
+		{
+			ExtractZoneMapRestrictions((Node *) lfirst(clauseCell), zoneMapList,
+									   rangeTableId, restrictionList);
+		}
+	}
+	else if (IsA(node, BoolExpr) && ((BoolExpr *) node)->boolop == AND_EXPR)
+	{
+		ExtractZoneMapRestrictions((Node *) ((BoolExpr *) node)->args, zoneMapList,
+								   rangeTableId, restrictionList);
+	}
+	else if (IsA(node, OpExpr))
+	{
+		ZoneMapRestriction *restriction =
+			ComparisonZoneMapRestriction((OpExpr *) node, zoneMapList, rangeTableId);
+
+		if (restriction != NULL)
+		{
+			*restrictionList = lappend(*restrictionList, restriction);
+		}
+	}
+	else if (IsA(node, NullTest))
+	{
+		NullTest *nullTest = (NullTest *) node;
+		ColumnZoneMap *zoneMap = NULL;
+
+		if (nullTest->argisrow)
+		{
+			return;
+		}
+
+		zoneMap = ColumnZoneMapForExpression((Node *) nullTest->arg, zoneMapList,
+											 rangeTableId);
+		if (zoneMap != NULL)
+		{
+			ZoneMapRestriction *restriction = palloc0(sizeof(ZoneMapRestriction));
+
+			restriction->zoneMap = zoneMap;
+			restriction->strategy = InvalidStrategy;
+			restriction->nullTestType = nullTest->nulltesttype;
+
+			*restrictionList = lappend(*restrictionList, restriction);
+		}
+	}
+}
+
+
+/*
+ * ComparisonZoneMapRestriction returns the restriction for a comparison of
+ * a zone map column with a constant using an operator of the column's btree
+ * operator family, or NULL if the clause is not such a comparison.
+ */
+static ZoneMapRestriction *
+ComparisonZoneMapRestriction(OpExpr *opClause, List *zoneMapList, Index rangeTableId)
+{
+	Node *leftOperand = NULL;
+	Node *rightOperand = NULL;
+	ColumnZoneMap *zoneMap = NULL;
+	Const *constant = NULL;
+	bool constantOnLeft = false;
+	int strategy = InvalidStrategy;
+	Oid leftType = InvalidOid;
+	Oid rightType = InvalidOid;
+	ZoneMapRestriction *restriction = NULL;
+
+	if (list_length(opClause->args) != 2)
+	{
+		return NULL;
+	}
+
+	leftOperand = get_leftop((Expr *) opClause);
+	rightOperand = get_rightop((Expr *) opClause);
+
+	if (IsA(rightOperand, Const))
+	{
+		zoneMap = ColumnZoneMapForExpression(leftOperand, zoneMapList, rangeTableId);
+		constant = (Const *) rightOperand;
+	}
+	else if (IsA(leftOperand, Const))
+	{
+		zoneMap = ColumnZoneMapForExpression(rightOperand, zoneMapList, rangeTableId);
+		constant = (Const *) leftOperand;
+		constantOnLeft = true;
+	}
+
+	if (zoneMap == NULL)
+	{
+		return NULL;
+	}
+
+	/* the values were computed using the collation of the column */
+	if (opClause->inputcollid != zoneMap->columnCollation)
+	{
+		return NULL;
+	}
+
+	if (!op_in_opfamily(opClause->opno, zoneMap->operatorFamily))
+	{
+		return NULL;
+	}
+
+	get_op_opfamily_properties(opClause->opno, zoneMap->operatorFamily, false,
+							   &strategy, &leftType, &rightType);
+
+	/* the constant is compared using the comparison function of the column */
+	if (leftType != zoneMap->operatorClassInputType || rightType != leftType ||
+		!IsBinaryCoercible(constant->consttype, rightType))
+	{
+		return NULL;
+	}
+
+	if (constantOnLeft)
+	{
+		strategy = BTCommuteStrategyNumber(strategy);
+	}
+
+	restriction = palloc0(sizeof(ZoneMapRestriction));
+	restriction->zoneMap = zoneMap;
+	restriction->strategy = strategy;
+	restriction->constant = constant;
+
+	return restriction;
+}
+
+
+/*
+ * ColumnZoneMapForExpression returns the zone map of the column of the
+ * relation that the given expression refers to, or NULL if the expression
+ * is not such a column or there is no zone map for it.
+ */
+static ColumnZoneMap *
+ColumnZoneMapForExpression(Node *expression, List *zoneMapList, Index rangeTableId)
+{
+	Var *column = NULL;
+	ListCell *zoneMapCell = NULL;
+
+	/* binary compatible types are compared in the same way */
+	while (IsA(expression, RelabelType))
+	{
+		expression = (Node *) ((RelabelType *) expression)->arg;
+	}
+
+	if (!IsA(expression, Var))
+	{
+		return NULL;
+	}
+
+	column = (Var *) expression;
+	if (column->varno != rangeTableId || column->varlevelsup != 0)
+	{
+		return NULL;
+	}
+
+	foreach(zoneMapCell, zoneMapList)
+	{
+		ColumnZoneMap *zoneMap = (ColumnZoneMap *) lfirst(zoneMapCell);
+
+		if (zoneMap->attributeNumber == column->varattno)
+		{
+			return zoneMap;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * ZoneMapRefutesRestriction returns true if the zone map of the shard with
+ * the given index shows that no row of the shard satisfies the restriction.
+ */
+static bool
+ZoneMapRefutesRestriction(ZoneMapRestriction *restriction, int shardIndex)
+{
+	ColumnZoneMap *zoneMap = restriction->zoneMap;
+	Const *constant = restriction->constant;
+	int minValueComparison = 0;
+	int maxValueComparison = 0;
+
+	if (!zoneMap->zoneMapExists[shardIndex])
+	{
+		return false;
+	}
+
+	if (restriction->strategy == InvalidStrategy)
+	{
+		if (restriction->nullTestType == IS_NULL)
+		{
+			return zoneMap->nullCounts[shardIndex] == 0;
+		}
+
+		return !zoneMap->valuesExist[shardIndex];
+	}
+
+	/* btree operators are strict, comparisons with NULL are never true */
+	if (constant->constisnull || !zoneMap->valuesExist[shardIndex])
+	{
+		return true;
+	}
+
+	minValueComparison =
+		DatumGetInt32(FunctionCall2Coll(zoneMap->compareFunction,
+										zoneMap->columnCollation,
+										constant->constvalue,
+										zoneMap->minValues[shardIndex]));
+	maxValueComparison =
+		DatumGetInt32(FunctionCall2Coll(zoneMap->compareFunction,
+										zoneMap->columnCollation,
+										constant->constvalue,
+										zoneMap->maxValues[shardIndex]));
+
+	switch (restriction->strategy)
+	{
+		case BTLessStrategyNumber:
+		{
+			/* column < constant, but constant <= minimum */
+			return minValueComparison <= 0;
+		}
+
+		case BTLessEqualStrategyNumber:
+		{
+			return minValueComparison < 0;
+		}
+
+		case BTEqualStrategyNumber:
+		{
+			return minValueComparison < 0 || maxValueComparison > 0;
+		}
+
+		case BTGreaterEqualStrategyNumber:
+		{
+			return maxValueComparison > 0;
+		}
+
+		case BTGreaterStrategyNumber:
+		{
+			/* column > constant, but constant >= maximum */
+			return maxValueComparison >= 0;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
@@ -20,6 +20,7 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/relay_utility.h"
 #include "distributed/version_compat.h"
 #include "lib/stringinfo.h"
 #include "nodes/makefuncs.h"
@@ -29,6 +30,7 @@
 #include "nodes/pg_list.h"
 #include "parser/parsetree.h"
 #include "storage/lock.h"
+#include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 
@@ -36,6 +38,10 @@
 static void UpdateTaskQueryString(Query *query, Oid distributedTableId,
 								  RangeTblEntry *valuesRTE, Task *task);
 static void ConvertRteToSubqueryWithEmptyResult(RangeTblEntry *rte);
+static bool ShardReferencesWalker(Node *node, List **shardReferenceList);
+static RelationShard * FindRelationShard(List *relationShardList, Oid relationId);
+static char * ShardFragmentName(RelationShard *relationShard, bool qualified);
+static int CountSubstringOccurrences(const char *string, const char *substring);
 
 
 /*
@@ -319,3 +325,263 @@ ConvertRteToSubqueryWithEmptyResult(RangeTblEntry *rte)
 	rte->subquery = subquery;
 	rte->alias = copyObject(rte->eref);
 }
+
+
+/*
+ * ShardQueryStringIsTemplate returns true if the query string that was
+ * deparsed from the given shard query can be used as a template for the
+ * query strings of the same query on other shards, by substituting the shard
+ * names using InstantiateShardQueryTemplate.
+ *
+ * That is only the case if each shard name appears in the query string
+ * exactly as often as the shard is referenced in the range tables of the
+ * query, such that it does not appear in literals, aliases, or as part of
+ * another shard name.
+ */
+bool
+ShardQueryStringIsTemplate(Query *shardQuery, char *queryString,
+						   List *relationShardList)
+{
+	List *shardReferenceList = NIL;
+	ListCell *relationShardCell = NULL;
+
+	ShardReferencesWalker((Node *) shardQuery, &shardReferenceList);
+
+	foreach(relationShardCell, relationShardList)
+	{
+		RelationShard *relationShard = (RelationShard *) lfirst(relationShardCell);
+		char *fragmentName = NULL;
+		int referenceCount = 0;
+		ListCell *shardReferenceCell = NULL;
+
+		if (relationShard->shardId == INVALID_SHARD_ID)
+		{
+			return false;
+		}
+
+		foreach(shardReferenceCell, shardReferenceList)
+		{
+			RangeTblEntry *rangeTableEntry = (RangeTblEntry *) lfirst(shardReferenceCell);
+			char *fragmentSchemaName = NULL;
+			char *fragmentTableName = NULL;
+			char *referencedFragmentName = NULL;
+
+			if (rangeTableEntry->relid != relationShard->relationId)
+			{
+				continue;
+			}
+
+			ExtractRangeTblExtraData(rangeTableEntry, NULL, &fragmentSchemaName,
+									 &fragmentTableName, NULL);
+			referencedFragmentName =
+				(char *) quote_qualified_identifier(fragmentSchemaName,
+													fragmentTableName);
+
+			if (fragmentName == NULL)
+			{
+				fragmentName = referencedFragmentName;
+			}
+			else if (strcmp(fragmentName, referencedFragmentName) != 0)
+			{
+				return false;
+			}
+
+			referenceCount++;
+		}
+
+		if (fragmentName == NULL ||
+			CountSubstringOccurrences(queryString, fragmentName) != referenceCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * InstantiateShardQueryTemplate returns the query string for the shards in
+ * the given relation shard list, based on the query string of the shards in
+ * the template relation shard list, which passed ShardQueryStringIsTemplate.
+ * The function returns NULL if the relation shard lists do not refer to the
+ * same relations.
+ */
+char *
+InstantiateShardQueryTemplate(char *templateQueryString,
+							  List *templateRelationShardList,
+							  List *relationShardList)
+{
+	StringInfo queryString = makeStringInfo();
+	List *templateFragmentNameList = NIL;
+	List *fragmentNameList = NIL;
+	ListCell *relationShardCell = NULL;
+	const char *position = templateQueryString;
+
+	foreach(relationShardCell, templateRelationShardList)
+	{
+		RelationShard *templateRelationShard =
+			(RelationShard *) lfirst(relationShardCell);
+		RelationShard *relationShard =
+			FindRelationShard(relationShardList, templateRelationShard->relationId);
+		char *templateFragmentName = NULL;
+		bool qualified = true;
+
+		if (relationShard == NULL || relationShard->shardId == INVALID_SHARD_ID)
+		{
+			return NULL;
+		}
+
+		if (relationShard->shardId == templateRelationShard->shardId)
+		{
+			/* shard names of reference tables stay the same */
+			continue;
+		}
+
+		/* shards in the public schema might not be schema-qualified */
+		templateFragmentName = ShardFragmentName(templateRelationShard, qualified);
+		if (CountSubstringOccurrences(templateQueryString, templateFragmentName) == 0)
+		{
+			qualified = false;
+			templateFragmentName = ShardFragmentName(templateRelationShard, qualified);
+		}
+
+		templateFragmentNameList = lappend(templateFragmentNameList,
+										   templateFragmentName);
+		fragmentNameList = lappend(fragmentNameList,
+								   ShardFragmentName(relationShard, qualified));
+	}
+
+	while (*position != '\0')
+	{
+		ListCell *templateFragmentNameCell = NULL;
+		ListCell *fragmentNameCell = NULL;
+		bool replaced = false;
+
+		forboth(templateFragmentNameCell, templateFragmentNameList,
+				fragmentNameCell, fragmentNameList)
+		{
+			char *templateFragmentName = (char *) lfirst(templateFragmentNameCell);
+			int templateFragmentNameLength = strlen(templateFragmentName);
+
+			if (strncmp(position, templateFragmentName,
+						templateFragmentNameLength) == 0)
+			{
+				appendStringInfoString(queryString, (char *) lfirst(fragmentNameCell));
+				position += templateFragmentNameLength;
+				replaced = true;
+				break;
+			}
+		}
+
+		if (!replaced)
+		{
+			appendStringInfoChar(queryString, *position);
+			position++;
+		}
+	}
+
+	return queryString->data;
+}
+
+
+/*
+ * ShardReferencesWalker appends the range table entries that refer to shards
+ * in the given query tree to the list.
+ */
+static bool
+ShardReferencesWalker(Node *node, List **shardReferenceList)
+{
+	RangeTblEntry *rangeTableEntry = NULL;
+
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, ShardReferencesWalker,
+								 shardReferenceList, QTW_EXAMINE_RTES_BEFORE);
+	}
+
+	if (!IsA(node, RangeTblEntry))
+	{
+		return expression_tree_walker(node, ShardReferencesWalker,
+									  shardReferenceList);
+	}
+
+	rangeTableEntry = (RangeTblEntry *) node;
+	if (GetRangeTblKind(rangeTableEntry) == CITUS_RTE_SHARD)
+	{
+		*shardReferenceList = lappend(*shardReferenceList, rangeTableEntry);
+	}
+
+	return false;
+}
+
+
+/*
+ * FindRelationShard returns the first entry of the relation shard list for
+ * the given relation, or NULL if there is none.
+ */
+static RelationShard *
+FindRelationShard(List *relationShardList, Oid relationId)
+{
+	ListCell *relationShardCell = NULL;
+
+	foreach(relationShardCell, relationShardList)
+	{
+		RelationShard *relationShard = (RelationShard *) lfirst(relationShardCell);
+
+		if (relationShard->relationId == relationId)
+		{
+			return relationShard;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * ShardFragmentName returns the quoted shard name, as it appears in deparsed
+ * shard queries, optionally qualified with the schema name.
+ */
+static char *
+ShardFragmentName(RelationShard *relationShard, bool qualified)
+{
+	Oid relationId = relationShard->relationId;
+	char *relationName = get_rel_name(relationId);
+	char *schemaName = NULL;
+
+	if (qualified)
+	{
+		schemaName = get_namespace_name(get_rel_namespace(relationId));
+	}
+
+	AppendShardIdToName(&relationName, relationShard->shardId);
+
+	return (char *) quote_qualified_identifier(schemaName, relationName);
+}
+
+
+/*
+ * CountSubstringOccurrences returns the number of non-overlapping occurrences
+ * of the substring in the string.
+ */
+static int
+CountSubstringOccurrences(const char *string, const char *substring)
+{
+	int occurrenceCount = 0;
+	int substringLength = strlen(substring);
+	const char *position = strstr(string, substring);
+
+	while (position != NULL)
+	{
+		occurrenceCount++;
+		position = strstr(position + substringLength, substring);
+	}
+
+	return occurrenceCount;
+}
@@ -17,6 +17,7 @@
 #include "distributed/citus_nodefuncs.h"
 #include "distributed/citus_nodes.h"
 #include "distributed/insert_select_planner.h"
+#include "distributed/intermediate_result_pruning.h"
 #include "distributed/intermediate_results.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
@@ -27,6 +28,8 @@
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_master_planner.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/multi_server_executor.h"
+#include "distributed/pg_dist_partition.h"
 #include "distributed/recursive_planning.h"
 #include "distributed/shardinterval_utils.h"
 #include "distributed/worker_shard_visibility.h"
@@ -41,6 +44,7 @@
 #else
 #include "optimizer/cost.h"
 #endif
+#include "optimizer/clauses.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/planner.h"
 #include "utils/builtins.h"
@@ -54,6 +58,9 @@ static List *plannerRestrictionContextList = NIL;
 int MultiTaskQueryLogLevel = MULTI_TASK_QUERY_INFO_OFF; /* multi-task query log level */
 static uint64 NextPlanId = 1;
 
+/* GUC, determining whether multi-shard SELECTs with parameters get generic plans */
+bool EnableGenericDistributedPlans = false;
+
 
 static bool ListContainsDistributedTableRTE(List *rangeTableList);
 static bool IsUpdateOrDelete(Query *query);
@@ -92,6 +99,10 @@ static void PopPlannerRestrictionContext(void);
 static void ResetPlannerRestrictionContext(
 	PlannerRestrictionContext *plannerRestrictionContext);
 static bool HasUnresolvedExternParamsWalker(Node *expression, ParamListInfo boundParams);
+static bool CanCreateGenericDistributedPlan(Query *originalQuery);
+static DistributedPlan * CreateGenericDistributedPlan(Query *originalQuery, Query *query,
+													  PlannerRestrictionContext *
+													  plannerRestrictionContext);
 
 
 /* Distributed planner hook */
@@ -654,8 +665,17 @@ CreateDistributedPlan(uint64 planId, Query *originalQuery, Query *query, ParamLi
 		 * The remainder of the planning logic cannot handle unbound
 		 * parameters. We return a NULL plan, which will have an
 		 * extremely high cost, such that postgres will replan with
-		 * bound parameters.
+		 * bound parameters. Simple multi-shard SELECTs are an exception,
+		 * for which we can create a plan that prunes shards and binds the
+		 * parameters at execution time.
 		 */
+		if (EnableGenericDistributedPlans &&
+			CanCreateGenericDistributedPlan(originalQuery))
+		{
+			return CreateGenericDistributedPlan(originalQuery, query,
+												plannerRestrictionContext);
+		}
+
 		return NULL;
 	}
 
@@ -726,6 +746,9 @@ CreateDistributedPlan(uint64 planId, Query *originalQuery, Query *query, ParamLi
 												plannerRestrictionContext);
 		distributedPlan->subPlanList = subPlanList;
 
+		/* only send the intermediate results to the nodes that read them */
+		RecordSubPlanReaders(distributedPlan);
+
 		return distributedPlan;
 	}
 
@@ -771,6 +794,111 @@ CreateDistributedPlan(uint64 planId, Query *originalQuery, Query *query, ParamLi
 }
 
 
+/*
+ * CanCreateGenericDistributedPlan returns true if the given SELECT query with
+ * unresolved parameters can be planned without knowing the parameter values.
+ *
+ * We only do this for queries on a single hash-distributed table without
+ * subqueries or CTEs, in which parameters only appear in the WHERE clause.
+ * Such queries are planned by the logical planner as a single job whose task
+ * queries contain the parameters, which are then sent to the workers along
+ * with the task queries. The WHERE clause is all that is needed to prune
+ * shards once the parameter values are known.
+ */
+static bool
+CanCreateGenericDistributedPlan(Query *originalQuery)
+{
+	RangeTblEntry *rangeTableEntry = NULL;
+	Oid relationId = InvalidOid;
+
+	if (TaskExecutorType != MULTI_EXECUTOR_ADAPTIVE)
+	{
+		/* only the adaptive executor sends parameters along with task queries */
+		return false;
+	}
+
+	if (originalQuery->commandType != CMD_SELECT ||
+		originalQuery->cteList != NIL ||
+		originalQuery->setOperations != NULL ||
+		originalQuery->hasSubLinks ||
+		originalQuery->hasForUpdate ||
+		list_length(originalQuery->rtable) != 1)
+	{
+		return false;
+	}
+
+	rangeTableEntry = linitial(originalQuery->rtable);
+	if (rangeTableEntry->rtekind != RTE_RELATION)
+	{
+		return false;
+	}
+
+	relationId = rangeTableEntry->relid;
+	if (!IsDistributedTable(relationId) ||
+		PartitionMethod(relationId) != DISTRIBUTE_BY_HASH ||
+		PartitionedTable(relationId))
+	{
+		return false;
+	}
+
+	/* parameters outside of the WHERE clause would end up on the coordinator */
+	if (HasUnresolvedExternParamsWalker((Node *) originalQuery->targetList, NULL) ||
+		HasUnresolvedExternParamsWalker(originalQuery->havingQual, NULL) ||
+		HasUnresolvedExternParamsWalker(originalQuery->limitCount, NULL) ||
+		HasUnresolvedExternParamsWalker(originalQuery->limitOffset, NULL) ||
+		HasUnresolvedExternParamsWalker((Node *) originalQuery->jointree->fromlist,
+										NULL))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * CreateGenericDistributedPlan creates a distributed plan for a query that
+ * passed CanCreateGenericDistributedPlan without resolving its parameters.
+ * The plan contains a task for every shard and defers shard pruning to the
+ * executor, which prunes tasks using the WHERE clause of the query once the
+ * parameter values are known. Since the plan is independent of the parameter
+ * values, postgres can cache and reuse it as the generic plan of a prepared
+ * statement, which is invalidated along with the metadata of the table.
+ *
+ * The function returns NULL if the resulting plan cannot be used, in which
+ * case postgres replans the query with bound parameters.
+ */
+static DistributedPlan *
+CreateGenericDistributedPlan(Query *originalQuery, Query *query,
+							 PlannerRestrictionContext *plannerRestrictionContext)
+{
+	MultiTreeRoot *logicalPlan = NULL;
+	DistributedPlan *distributedPlan = NULL;
+	Job *workerJob = NULL;
+	Node *whereClause = originalQuery->jointree->quals;
+
+	logicalPlan = MultiLogicalPlanCreate(originalQuery, query,
+										 plannerRestrictionContext);
+	MultiLogicalPlanOptimize(logicalPlan);
+
+	distributedPlan = CreatePhysicalDistributedPlan(logicalPlan,
+													plannerRestrictionContext);
+
+	workerJob = distributedPlan->workerJob;
+	if (workerJob->dependedJobList != NIL ||
+		HasUnresolvedExternParamsWalker((Node *) distributedPlan->masterQuery, NULL))
+	{
+		return NULL;
+	}
+
+	workerJob->deferredPruning = true;
+	workerJob->deferredPruningClauseList =
+		make_ands_implicit((Expr *) copyObject(whereClause));
+
+	return distributedPlan;
+}
+
+
 /*
  * EnsurePartitionTableNotReplicated errors out if the infput relation is
  * a partition table and the table has a replication factor greater than
@@ -936,6 +1064,42 @@ GetDistributedPlan(CustomScan *customScan)
 }
 
 
+/*
+ * FindCitusCustomScan returns the Citus custom scan in the given plan tree, or
+ * NULL if the plan does not contain one. A plan has at most one Citus custom
+ * scan, which may be below the nodes of the master query.
+ */
+CustomScan *
+FindCitusCustomScan(Plan *plan)
+{
+	CustomScan *customScan = NULL;
+
+	if (plan == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(plan, CustomScan))
+	{
+		customScan = (CustomScan *) plan;
+
+		if (list_length(customScan->custom_private) == 1 &&
+			CitusIsA(linitial(customScan->custom_private), DistributedPlan))
+		{
+			return customScan;
+		}
+	}
+
+	customScan = FindCitusCustomScan(plan->lefttree);
+	if (customScan == NULL)
+	{
+		customScan = FindCitusCustomScan(plan->righttree);
+	}
+
+	return customScan;
+}
+
+
 /*
  * FinalizePlan combines local plan with distributed plan and creates a plan
  * which can be run by the PostgreSQL executor.
@@ -0,0 +1,1076 @@
+/*-------------------------------------------------------------------------
+ *
+ * intermediate_result_pruning.c
+ *	  Functions for determining which nodes read the intermediate results
+ *	  of subplans, such that the results are only sent to those nodes.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "distributed/colocation_utils.h"
+#include "distributed/distributed_planner.h"
+#include "distributed/intermediate_result_pruning.h"
+#include "distributed/intermediate_results.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/multi_join_order.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/recursive_planning.h"
+#include "distributed/worker_manager.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/plannodes.h"
+#include "optimizer/clauses.h"
+#include "parser/parsetree.h"
+#include "utils/builtins.h"
+#include "utils/typcache.h"
+
+
+/* controlled via GUC, used mostly for testing */
+bool LogIntermediateResults = false;
+
+/* whether tasks may read only the partition of a result that joins with their shard */
+bool EnablePartitionedIntermediateResults = false;
+
+
+/* context for counting the reads of an intermediate result */
+typedef struct IntermediateResultReadContext
+{
+	char *resultId;
+	int readCount;
+} IntermediateResultReadContext;
+
+
+/* context for replacing reads of results by reads of their partitions */
+typedef struct UpdateResultReadsContext
+{
+	List *partitionedReadList;
+	int shardIndex;
+} UpdateResultReadsContext;
+
+
+static void RecordSubPlanReadersInPlan(DistributedPlan *ownerPlan,
+									   DistributedPlan *readerPlan,
+									   DistributedSubPlan *readerSubPlan);
+static void RecordLocalPlanReaders(DistributedPlan *ownerPlan, PlannedStmt *localPlan,
+								   DistributedSubPlan *readerSubPlan);
+static void RecordTaskListReaders(DistributedSubPlan *subPlan, List *taskList);
+static void RecordPartitionedResultRead(DistributedSubPlan *subPlan,
+										PartitionedResultRead *partitionedRead);
+static bool PlannedStmtReadsIntermediateResult(PlannedStmt *plannedStmt,
+											   char *resultId);
+static bool PlanReadsIntermediateResult(Plan *plan, char *resultId);
+static bool QueryReadsIntermediateResult(Query *query, char *resultId);
+static bool IntermediateResultReadWalker(Node *node, char *resultId);
+static List * JoinTreeQualList(Query *query);
+static void InnerJoinQualList(Node *joinTreeNode, List **qualList);
+static PartitionedResultRead * PartitionedResultReadForClause(Query *query,
+															   Node *clause);
+static PartitionedResultRead * PartitionedResultReadForColumns(Query *query,
+																Var *resultColumn,
+																Var *relationColumn);
+static Var * ResolveJoinAliasColumn(Query *query, Var *column);
+static char * IntermediateResultReadFunctionId(RangeTblEntry *rangeTableEntry);
+static FuncExpr * IntermediateResultReadFunction(Node *node);
+static int IntermediateResultReadCount(Query *query, char *resultId);
+static bool CountIntermediateResultReadsWalker(Node *node,
+											   IntermediateResultReadContext *
+											   readContext);
+static bool UpdateResultReadsWalker(Node *node,
+									UpdateResultReadsContext *updateContext);
+
+
+/*
+ * RecordSubPlanReaders determines for each subplan of the given distributed
+ * plan which nodes read its intermediate result, and records them in the
+ * subplan. These are the nodes that have placements of the tasks that read
+ * the result, either in the distributed plan itself or in the plans of the
+ * other subplans. If the coordinator reads the result, either in the master
+ * query or in a subplan that does not need distributed planning, we also
+ * record that the result should be written to a local file.
+ *
+ * When the readers of a result cannot be determined during planning, such as
+ * for repartition jobs or for tasks that are pruned during execution, the
+ * result is sent to all nodes.
+ *
+ * We also record which results each subplan reads, such that the executor
+ * can run subplans that do not depend on each other concurrently.
+ */
+void
+RecordSubPlanReaders(DistributedPlan *distributedPlan)
+{
+	ListCell *subPlanCell = NULL;
+
+	foreach(subPlanCell, distributedPlan->subPlanList)
+	{
+		DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
+
+		subPlan->nodeGroupIdList = NIL;
+		subPlan->writeLocalFile = false;
+		subPlan->sendToAllNodes = false;
+		subPlan->dependedSubPlanIdList = NIL;
+		subPlan->partitionRelationIdList = NIL;
+		subPlan->partitionColumnIndexList = NIL;
+	}
+
+	RecordSubPlanReadersInPlan(distributedPlan, distributedPlan, NULL);
+}
+
+
+/*
+ * RecordSubPlanReadersInPlan records the nodes on which readerPlan reads the
+ * intermediate results of the subplans of ownerPlan, and then continues with
+ * the subplans of readerPlan, which may read the results as well. If
+ * readerPlan is part of the subplan readerSubPlan of ownerPlan, the results
+ * it reads are recorded as dependencies of readerSubPlan.
+ */
+static void
+RecordSubPlanReadersInPlan(DistributedPlan *ownerPlan, DistributedPlan *readerPlan,
+						   DistributedSubPlan *readerSubPlan)
+{
+	Job *workerJob = readerPlan->workerJob;
+	List *partitionedReadList = NIL;
+	ListCell *subPlanCell = NULL;
+
+	/* the tasks of pushed down queries might read partitions of results */
+	if (workerJob != NULL && workerJob->subqueryPushdown)
+	{
+		partitionedReadList = PartitionedResultReadList(workerJob->jobQuery);
+	}
+
+	foreach(subPlanCell, ownerPlan->subPlanList)
+	{
+		DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
+		char *resultId = GenerateResultId(ownerPlan->planId, subPlan->subPlanId);
+		PartitionedResultRead *partitionedRead =
+			FindPartitionedResultRead(partitionedReadList, resultId);
+		bool readsResult = false;
+
+		/* the master query runs on the coordinator */
+		if (QueryReadsIntermediateResult(readerPlan->masterQuery, resultId))
+		{
+			subPlan->writeLocalFile = true;
+			readsResult = true;
+		}
+
+		/* the SELECT of an INSERT ... SELECT via the coordinator is planned later */
+		if (QueryReadsIntermediateResult(readerPlan->insertSelectSubquery, resultId))
+		{
+			subPlan->sendToAllNodes = true;
+			readsResult = true;
+		}
+
+		/*
+		 * Repartition jobs assign their tasks during execution, and their
+		 * queries are not part of the worker job query.
+		 */
+		if (workerJob != NULL && workerJob->dependedJobList != NIL)
+		{
+			subPlan->sendToAllNodes = true;
+			readsResult = true;
+		}
+		else if (workerJob != NULL &&
+				 QueryReadsIntermediateResult(workerJob->jobQuery, resultId))
+		{
+			if (workerJob->deferredPruning)
+			{
+				subPlan->sendToAllNodes = true;
+			}
+			else if (partitionedRead != NULL)
+			{
+				RecordPartitionedResultRead(subPlan, partitionedRead);
+			}
+			else
+			{
+				RecordTaskListReaders(subPlan, workerJob->taskList);
+			}
+
+			readsResult = true;
+		}
+
+		if (readsResult && readerSubPlan != NULL && readerSubPlan != subPlan)
+		{
+			readerSubPlan->dependedSubPlanIdList =
+				list_append_unique_int(readerSubPlan->dependedSubPlanIdList,
+									   subPlan->subPlanId);
+		}
+	}
+
+	foreach(subPlanCell, readerPlan->subPlanList)
+	{
+		DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
+		CustomScan *customScan = FindCitusCustomScan(subPlan->plan->planTree);
+		DistributedSubPlan *dependentSubPlan = readerSubPlan;
+
+		if (dependentSubPlan == NULL)
+		{
+			dependentSubPlan = subPlan;
+		}
+
+		if (customScan != NULL)
+		{
+			DistributedPlan *subPlanDistributedPlan = GetDistributedPlan(customScan);
+
+			RecordSubPlanReadersInPlan(ownerPlan, subPlanDistributedPlan,
+									   dependentSubPlan);
+		}
+		else
+		{
+			RecordLocalPlanReaders(ownerPlan, subPlan->plan, dependentSubPlan);
+		}
+	}
+}
+
+
+/*
+ * RecordLocalPlanReaders records that the results of the subplans of
+ * ownerPlan that the given plan reads should be written to local files. This
+ * is the case for plans that do not need distributed planning, such as CTEs
+ * that only read the results of other CTEs, which run on the coordinator.
+ */
+static void
+RecordLocalPlanReaders(DistributedPlan *ownerPlan, PlannedStmt *localPlan,
+					   DistributedSubPlan *readerSubPlan)
+{
+	ListCell *subPlanCell = NULL;
+
+	foreach(subPlanCell, ownerPlan->subPlanList)
+	{
+		DistributedSubPlan *subPlan = (DistributedSubPlan *) lfirst(subPlanCell);
+		char *resultId = GenerateResultId(ownerPlan->planId, subPlan->subPlanId);
+
+		if (!PlannedStmtReadsIntermediateResult(localPlan, resultId))
+		{
+			continue;
+		}
+
+		subPlan->writeLocalFile = true;
+
+		if (readerSubPlan != subPlan)
+		{
+			readerSubPlan->dependedSubPlanIdList =
+				list_append_unique_int(readerSubPlan->dependedSubPlanIdList,
+									   subPlan->subPlanId);
+		}
+	}
+}
+
+
+/*
+ * RecordTaskListReaders adds the groups of the nodes that have placements of
+ * the given tasks to the readers of the subplan. We add all placements rather
+ * than only the first one, since the executor may fail over to the others.
+ */
+static void
+RecordTaskListReaders(DistributedSubPlan *subPlan, List *taskList)
+{
+	ListCell *taskCell = NULL;
+
+	foreach(taskCell, taskList)
+	{
+		Task *task = (Task *) lfirst(taskCell);
+		ListCell *placementCell = NULL;
+
+		foreach(placementCell, task->taskPlacementList)
+		{
+			ShardPlacement *placement = (ShardPlacement *) lfirst(placementCell);
+
+			subPlan->nodeGroupIdList = list_append_unique_int(subPlan->nodeGroupIdList,
+															  placement->groupId);
+		}
+	}
+}
+
+
+/*
+ * RecordPartitionedResultRead adds the partitioning of the given read to the
+ * partitionings in which the result of the subplan is read, unless tasks
+ * already read the result in the same partitioning.
+ */
+static void
+RecordPartitionedResultRead(DistributedSubPlan *subPlan,
+							PartitionedResultRead *partitionedRead)
+{
+	char *resultId = partitionedRead->resultId;
+	char *partitionPrefix = PartitionedResultPrefix(resultId,
+													partitionedRead->relationId,
+													partitionedRead->partitionColumnIndex);
+	ListCell *relationIdCell = NULL;
+	ListCell *columnIndexCell = NULL;
+
+	forboth(relationIdCell, subPlan->partitionRelationIdList,
+			columnIndexCell, subPlan->partitionColumnIndexList)
+	{
+		char *otherPartitionPrefix = PartitionedResultPrefix(resultId,
+															 lfirst_oid(relationIdCell),
+															 lfirst_int(columnIndexCell));
+
+		if (strcmp(otherPartitionPrefix, partitionPrefix) == 0)
+		{
+			return;
+		}
+	}
+
+	subPlan->partitionRelationIdList = lappend_oid(subPlan->partitionRelationIdList,
+												   partitionedRead->relationId);
+	subPlan->partitionColumnIndexList = lappend_int(subPlan->partitionColumnIndexList,
+													partitionedRead->partitionColumnIndex);
+}
+
+
+/*
+ * SubPlanDestinationNodeList returns the nodes in the given list to which the
+ * intermediate result of the subplan should be sent. If the result is also
+ * written to a local file, the local node is skipped.
+ */
+List *
+SubPlanDestinationNodeList(DistributedSubPlan *subPlan, List *workerNodeList)
+{
+	List *destinationNodeList = NIL;
+	ListCell *workerNodeCell = NULL;
+	int32 localGroupId = GetLocalGroupId();
+
+	foreach(workerNodeCell, workerNodeList)
+	{
+		WorkerNode *workerNode = (WorkerNode *) lfirst(workerNodeCell);
+
+		if (subPlan->writeLocalFile && workerNode->groupId == localGroupId)
+		{
+			continue;
+		}
+
+		if (subPlan->sendToAllNodes ||
+			list_member_int(subPlan->nodeGroupIdList, workerNode->groupId))
+		{
+			destinationNodeList = lappend(destinationNodeList, workerNode);
+		}
+	}
+
+	return destinationNodeList;
+}
+
+
+/*
+ * PlannedStmtReadsIntermediateResult returns whether the given local plan, or
+ * one of the plans of its subqueries, calls read_intermediate_result for the
+ * given result.
+ */
+static bool
+PlannedStmtReadsIntermediateResult(PlannedStmt *plannedStmt, char *resultId)
+{
+	ListCell *subPlanCell = NULL;
+
+	if (PlanReadsIntermediateResult(plannedStmt->planTree, resultId))
+	{
+		return true;
+	}
+
+	foreach(subPlanCell, plannedStmt->subplans)
+	{
+		Plan *subPlan = (Plan *) lfirst(subPlanCell);
+
+		if (PlanReadsIntermediateResult(subPlan, resultId))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * PlanReadsIntermediateResult returns whether the given plan tree calls
+ * read_intermediate_result for the given result, either in a function scan
+ * or in the expressions of one of its nodes.
+ */
+static bool
+PlanReadsIntermediateResult(Plan *plan, char *resultId)
+{
+	List *childPlanList = NIL;
+	ListCell *childPlanCell = NULL;
+
+	if (plan == NULL)
+	{
+		return false;
+	}
+
+	if (IntermediateResultReadWalker((Node *) plan->targetlist, resultId) ||
+		IntermediateResultReadWalker((Node *) plan->qual, resultId))
+	{
+		return true;
+	}
+
+	switch (nodeTag(plan))
+	{
+		case T_FunctionScan:
+		{
+			FunctionScan *functionScan = (FunctionScan *) plan;
+
+			if (IntermediateResultReadWalker((Node *) functionScan->functions,
+											 resultId))
+			{
+				return true;
+			}
+
+			break;
+		}
+
+		case T_SubqueryScan:
+		{
+			childPlanList = list_make1(((SubqueryScan *) plan)->subplan);
+			break;
+		}
+
+		case T_Append:
+		{
+			childPlanList = ((Append *) plan)->appendplans;
+			break;
+		}
+
+		case T_MergeAppend:
+		{
+			childPlanList = ((MergeAppend *) plan)->mergeplans;
+			break;
+		}
+
+		case T_BitmapAnd:
+		{
+			childPlanList = ((BitmapAnd *) plan)->bitmapplans;
+			break;
+		}
+
+		case T_BitmapOr:
+		{
+			childPlanList = ((BitmapOr *) plan)->bitmapplans;
+			break;
+		}
+
+		case T_ModifyTable:
+		{
+			childPlanList = ((ModifyTable *) plan)->plans;
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+
+	foreach(childPlanCell, childPlanList)
+	{
+		if (PlanReadsIntermediateResult((Plan *) lfirst(childPlanCell), resultId))
+		{
+			return true;
+		}
+	}
+
+	return PlanReadsIntermediateResult(plan->lefttree, resultId) ||
+		   PlanReadsIntermediateResult(plan->righttree, resultId);
+}
+
+
+/*
+ * QueryReadsIntermediateResult returns whether the given query, which may be
+ * NULL, calls read_intermediate_result for the given result.
+ */
+static bool
+QueryReadsIntermediateResult(Query *query, char *resultId)
+{
+	if (query == NULL)
+	{
+		return false;
+	}
+
+	return IntermediateResultReadWalker((Node *) query, resultId);
+}
+
+
+/*
+ * IntermediateResultReadWalker returns true if it finds a read_intermediate_result
+ * call for the given result. Calls with a result id that is not a constant
+ * may read any result, so we consider those to read the result as well.
+ */
+static bool
+IntermediateResultReadWalker(Node *node, char *resultId)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(node, FuncExpr))
+	{
+		FuncExpr *funcExpr = (FuncExpr *) node;
+
+		if (funcExpr->funcid == CitusReadIntermediateResultFuncId())
+		{
+			Node *resultIdArgument = (Node *) linitial(funcExpr->args);
+			Const *resultIdConst = NULL;
+
+			if (!IsA(resultIdArgument, Const))
+			{
+				return true;
+			}
+
+			resultIdConst = (Const *) resultIdArgument;
+			if (!resultIdConst->constisnull &&
+				strcmp(TextDatumGetCString(resultIdConst->constvalue), resultId) == 0)
+			{
+				return true;
+			}
+		}
+	}
+	else if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, IntermediateResultReadWalker,
+								 resultId, 0);
+	}
+
+	return expression_tree_walker(node, IntermediateResultReadWalker, resultId);
+}
+
+
+/*
+ * PartitionedResultReadList returns the reads of intermediate results in the
+ * given worker job query for which each task only needs the partition of the
+ * result that corresponds to its shard.
+ *
+ * That is the case if the result is read once, directly in the FROM clause of
+ * the query or of the subquery that the physical planner wraps around it, and
+ * an equality between a column of the result and the distribution column of a
+ * hash-distributed relation in the FROM clause must hold for every row of the
+ * query. Rows of the result then only join with rows in the shard whose hash
+ * range contains the value of that column, and since all distributed tables
+ * in a pushed down query are co-located, task i only needs the rows of the
+ * result that fall into the hash range of shard i.
+ */
+List *
+PartitionedResultReadList(Query *query)
+{
+	List *partitionedReadList = NIL;
+	List *qualList = NIL;
+	ListCell *qualCell = NULL;
+
+	if (!EnablePartitionedIntermediateResults || query == NULL)
+	{
+		return NIL;
+	}
+
+	/* the worker job query of a pushed down query wraps the original query */
+	while (list_length(query->rtable) == 1 && query->setOperations == NULL)
+	{
+		RangeTblEntry *rangeTableEntry = (RangeTblEntry *) linitial(query->rtable);
+
+		if (rangeTableEntry->rtekind != RTE_SUBQUERY)
+		{
+			break;
+		}
+
+		query = rangeTableEntry->subquery;
+	}
+
+	if (query->commandType != CMD_SELECT || query->setOperations != NULL)
+	{
+		return NIL;
+	}
+
+	qualList = JoinTreeQualList(query);
+
+	foreach(qualCell, qualList)
+	{
+		Node *clause = (Node *) lfirst(qualCell);
+		PartitionedResultRead *resultRead = NULL;
+
+		resultRead = PartitionedResultReadForClause(query, clause);
+		if (resultRead != NULL &&
+			FindPartitionedResultRead(partitionedReadList, resultRead->resultId) == NULL)
+		{
+			partitionedReadList = lappend(partitionedReadList, resultRead);
+		}
+	}
+
+	return partitionedReadList;
+}
+
+
+/*
+ * FindPartitionedResultRead returns the read of the given result in the list,
+ * or NULL if the result is not read partitioned.
+ */
+PartitionedResultRead *
+FindPartitionedResultRead(List *partitionedReadList, char *resultId)
+{
+	ListCell *resultReadCell = NULL;
+
+	foreach(resultReadCell, partitionedReadList)
+	{
+		PartitionedResultRead *resultRead =
+			(PartitionedResultRead *) lfirst(resultReadCell);
+
+		if (strcmp(resultRead->resultId, resultId) == 0)
+		{
+			return resultRead;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * PartitionedResultPrefix returns the prefix of the identifiers of the
+ * partitions of a result that is partitioned along the shards of the given
+ * relation by the given column. Since co-located relations have the same
+ * shards, the prefix contains the co-location group of the relation.
+ */
+char *
+PartitionedResultPrefix(char *resultId, Oid relationId, int partitionColumnIndex)
+{
+	StringInfo partitionPrefix = makeStringInfo();
+
+	appendStringInfo(partitionPrefix, "%s_%u_%d", resultId,
+					 TableColocationId(relationId), partitionColumnIndex);
+
+	return partitionPrefix->data;
+}
+
+
+/*
+ * JoinTreeQualList returns the clauses in the WHERE clause and in the ON
+ * clauses of inner joins that are not below an outer join, which hold for
+ * every row of the query.
+ */
+static List *
+JoinTreeQualList(Query *query)
+{
+	List *qualList = NIL;
+	Node *whereQuals = query->jointree->quals;
+
+	if (whereQuals != NULL && IsA(whereQuals, List))
+	{
+		/* the physical planner keeps the where clause implicitly AND'd */
+		qualList = list_copy((List *) whereQuals);
+	}
+	else if (whereQuals != NULL)
+	{
+		qualList = make_ands_implicit((Expr *) whereQuals);
+	}
+
+	InnerJoinQualList((Node *) query->jointree, &qualList);
+
+	return qualList;
+}
+
+
+/*
+ * InnerJoinQualList appends the ON clauses of the inner joins in the given
+ * join tree node to the list, without descending into outer joins.
+ */
+static void
+InnerJoinQualList(Node *joinTreeNode, List **qualList)
+{
+	if (joinTreeNode == NULL)
+	{
+		return;
+	}
+
+	if (IsA(joinTreeNode, FromExpr))
+	{
+		FromExpr *fromExpr = (FromExpr *) joinTreeNode;
+		ListCell *fromCell = NULL;
+
+		foreach(fromCell, fromExpr->fromlist)
+		{
+			InnerJoinQualList((Node *) lfirst(fromCell), qualList);
+		}
+	}
+	else if (IsA(joinTreeNode, JoinExpr))
+	{
+		JoinExpr *joinExpr = (JoinExpr *) joinTreeNode;
+
+		if (joinExpr->jointype != JOIN_INNER)
+		{
+			return;
+		}
+
+		if (joinExpr->quals != NULL)
+		{
+			*qualList = list_concat(*qualList,
+									make_ands_implicit((Expr *) joinExpr->quals));
+		}
+
+		InnerJoinQualList(joinExpr->larg, qualList);
+		InnerJoinQualList(joinExpr->rarg, qualList);
+	}
+}
+
+
+/*
+ * PartitionedResultReadForClause returns the partitioned read of an
+ * intermediate result that the given clause allows, or NULL if the clause is
+ * not an equality between a column of a result and a distribution column.
+ */
+static PartitionedResultRead *
+PartitionedResultReadForClause(Query *query, Node *clause)
+{
+	OpExpr *operatorExpression = NULL;
+	Node *leftArgument = NULL;
+	Node *rightArgument = NULL;
+	PartitionedResultRead *resultRead = NULL;
+
+	if (!IsA(clause, OpExpr) || list_length(((OpExpr *) clause)->args) != 2)
+	{
+		return NULL;
+	}
+
+	operatorExpression = (OpExpr *) clause;
+	leftArgument = (Node *) linitial(operatorExpression->args);
+	rightArgument = (Node *) lsecond(operatorExpression->args);
+
+	if (!IsA(leftArgument, Var) || !IsA(rightArgument, Var))
+	{
+		return NULL;
+	}
+
+	/* rows are partitioned by value, so the operator has to be plain equality */
+	if (exprType(leftArgument) != exprType(rightArgument) ||
+		lookup_type_cache(exprType(leftArgument), TYPECACHE_EQ_OPR)->eq_opr !=
+		operatorExpression->opno)
+	{
+		return NULL;
+	}
+
+	resultRead = PartitionedResultReadForColumns(query, (Var *) leftArgument,
+												 (Var *) rightArgument);
+	if (resultRead == NULL)
+	{
+		resultRead = PartitionedResultReadForColumns(query, (Var *) rightArgument,
+													 (Var *) leftArgument);
+	}
+
+	return resultRead;
+}
+
+
+/*
+ * PartitionedResultReadForColumns returns the partitioned read of the
+ * intermediate result that resultColumn belongs to, if relationColumn is the
+ * distribution column of a hash-distributed relation and the result is only
+ * read once in the query.
+ */
+static PartitionedResultRead *
+PartitionedResultReadForColumns(Query *query, Var *resultColumn, Var *relationColumn)
+{
+	RangeTblEntry *resultRangeTableEntry = NULL;
+	RangeTblEntry *relationRangeTableEntry = NULL;
+	PartitionedResultRead *resultRead = NULL;
+	Var *distributionColumn = NULL;
+	char *resultId = NULL;
+	int partitionColumnIndex = 0;
+
+	resultColumn = ResolveJoinAliasColumn(query, resultColumn);
+	relationColumn = ResolveJoinAliasColumn(query, relationColumn);
+	if (resultColumn == NULL || relationColumn == NULL)
+	{
+		return NULL;
+	}
+
+	relationRangeTableEntry = rt_fetch(relationColumn->varno, query->rtable);
+	if (relationRangeTableEntry->rtekind != RTE_RELATION ||
+		!IsDistributedTable(relationRangeTableEntry->relid) ||
+		PartitionMethod(relationRangeTableEntry->relid) != DISTRIBUTE_BY_HASH)
+	{
+		return NULL;
+	}
+
+	distributionColumn = DistPartitionKey(relationRangeTableEntry->relid);
+	if (distributionColumn == NULL ||
+		distributionColumn->varattno != relationColumn->varattno)
+	{
+		return NULL;
+	}
+
+	resultRangeTableEntry = rt_fetch(resultColumn->varno, query->rtable);
+	partitionColumnIndex = resultColumn->varattno - 1;
+
+	if (resultRangeTableEntry->rtekind == RTE_SUBQUERY)
+	{
+		/* recursive planning reads results in a subquery */
+		Query *subquery = resultRangeTableEntry->subquery;
+		TargetEntry *targetEntry = NULL;
+		Var *subqueryColumn = NULL;
+
+		if (list_length(subquery->rtable) != 1 || subquery->jointree->quals != NULL ||
+			subquery->hasAggs || subquery->groupClause != NIL ||
+			subquery->distinctClause != NIL || subquery->hasWindowFuncs ||
+			subquery->hasTargetSRFs || subquery->limitCount != NULL ||
+			subquery->limitOffset != NULL || subquery->setOperations != NULL)
+		{
+			return NULL;
+		}
+
+		targetEntry = get_tle_by_resno(subquery->targetList, resultColumn->varattno);
+		if (targetEntry == NULL || !IsA(targetEntry->expr, Var))
+		{
+			return NULL;
+		}
+
+		subqueryColumn = (Var *) targetEntry->expr;
+		if (subqueryColumn->varlevelsup != 0)
+		{
+			return NULL;
+		}
+
+		resultRangeTableEntry = rt_fetch(subqueryColumn->varno, subquery->rtable);
+		partitionColumnIndex = subqueryColumn->varattno - 1;
+	}
+
+	resultId = IntermediateResultReadFunctionId(resultRangeTableEntry);
+	if (resultId == NULL)
+	{
+		return NULL;
+	}
+
+	/* other reads of the same result might need all of its rows */
+	if (partitionColumnIndex < 0 || IntermediateResultReadCount(query, resultId) != 1)
+	{
+		return NULL;
+	}
+
+	resultRead = (PartitionedResultRead *) palloc0(sizeof(PartitionedResultRead));
+	resultRead->resultId = resultId;
+	resultRead->partitionColumnIndex = partitionColumnIndex;
+	resultRead->relationId = relationRangeTableEntry->relid;
+
+	return resultRead;
+}
+
+
+/*
+ * ResolveJoinAliasColumn returns the column of a base range table entry that
+ * the given column of the query refers to, or NULL if the column is not a
+ * plain column of the query.
+ */
+static Var *
+ResolveJoinAliasColumn(Query *query, Var *column)
+{
+	while (column != NULL)
+	{
+		RangeTblEntry *rangeTableEntry = NULL;
+		Node *aliasColumn = NULL;
+
+		if (column->varlevelsup != 0 || column->varattno <= 0)
+		{
+			return NULL;
+		}
+
+		rangeTableEntry = rt_fetch(column->varno, query->rtable);
+		if (rangeTableEntry->rtekind != RTE_JOIN)
+		{
+			return column;
+		}
+
+		aliasColumn = (Node *) list_nth(rangeTableEntry->joinaliasvars,
+										column->varattno - 1);
+		if (aliasColumn == NULL || !IsA(aliasColumn, Var))
+		{
+			return NULL;
+		}
+
+		column = (Var *) aliasColumn;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * IntermediateResultReadFunctionId returns the identifier of the intermediate
+ * result if the range table entry is a call to read_intermediate_result with
+ * a constant result id, and NULL otherwise.
+ */
+static char *
+IntermediateResultReadFunctionId(RangeTblEntry *rangeTableEntry)
+{
+	RangeTblFunction *rangeTableFunction = NULL;
+	FuncExpr *readFunction = NULL;
+	Node *resultIdArgument = NULL;
+	Const *resultIdConst = NULL;
+
+	if (rangeTableEntry->rtekind != RTE_FUNCTION ||
+		list_length(rangeTableEntry->functions) != 1 ||
+		rangeTableEntry->funcordinality)
+	{
+		return NULL;
+	}
+
+	rangeTableFunction = (RangeTblFunction *) linitial(rangeTableEntry->functions);
+	readFunction = IntermediateResultReadFunction(rangeTableFunction->funcexpr);
+	if (readFunction == NULL)
+	{
+		return NULL;
+	}
+
+	resultIdArgument = (Node *) linitial(readFunction->args);
+	if (!IsA(resultIdArgument, Const))
+	{
+		return NULL;
+	}
+
+	resultIdConst = (Const *) resultIdArgument;
+	if (resultIdConst->constisnull)
+	{
+		return NULL;
+	}
+
+	return TextDatumGetCString(resultIdConst->constvalue);
+}
+
+
+/*
+ * IntermediateResultReadFunction returns the given node if it is a call to
+ * read_intermediate_result, and NULL otherwise.
+ */
+static FuncExpr *
+IntermediateResultReadFunction(Node *node)
+{
+	if (node == NULL || !IsA(node, FuncExpr) ||
+		((FuncExpr *) node)->funcid != CitusReadIntermediateResultFuncId())
+	{
+		return NULL;
+	}
+
+	return (FuncExpr *) node;
+}
+
+
+/*
+ * IntermediateResultReadCount returns the number of read_intermediate_result
+ * calls in the query that may read the given result.
+ */
+static int
+IntermediateResultReadCount(Query *query, char *resultId)
+{
+	IntermediateResultReadContext readContext;
+
+	readContext.resultId = resultId;
+	readContext.readCount = 0;
+
+	CountIntermediateResultReadsWalker((Node *) query, &readContext);
+
+	return readContext.readCount;
+}
+
+
+/*
+ * CountIntermediateResultReadsWalker counts the read_intermediate_result calls
+ * that may read the result in the context. Like IntermediateResultReadWalker,
+ * it considers calls with a result id that is not a constant to read it.
+ */
+static bool
+CountIntermediateResultReadsWalker(Node *node, IntermediateResultReadContext *readContext)
+{
+	FuncExpr *readFunction = NULL;
+
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	readFunction = IntermediateResultReadFunction(node);
+	if (readFunction != NULL)
+	{
+		Node *resultIdArgument = (Node *) linitial(readFunction->args);
+
+		if (!IsA(resultIdArgument, Const) ||
+			(!((Const *) resultIdArgument)->constisnull &&
+			 strcmp(TextDatumGetCString(((Const *) resultIdArgument)->constvalue),
+					readContext->resultId) == 0))
+		{
+			readContext->readCount++;
+		}
+	}
+	else if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, CountIntermediateResultReadsWalker,
+								 readContext, 0);
+	}
+
+	return expression_tree_walker(node, CountIntermediateResultReadsWalker,
+								  readContext);
+}
+
+
+/*
+ * UpdateResultReadsToPartitionNames changes the reads of the results in the
+ * partitioned read list into reads of the partition for the given shard index.
+ */
+void
+UpdateResultReadsToPartitionNames(Query *query, List *partitionedReadList,
+								  int shardIndex)
+{
+	UpdateResultReadsContext updateContext;
+
+	updateContext.partitionedReadList = partitionedReadList;
+	updateContext.shardIndex = shardIndex;
+
+	UpdateResultReadsWalker((Node *) query, &updateContext);
+}
+
+
+/*
+ * UpdateResultReadsWalker replaces the result ids of the read_intermediate_result
+ * calls for the results in the context by the ids of their partitions.
+ */
+static bool
+UpdateResultReadsWalker(Node *node, UpdateResultReadsContext *updateContext)
+{
+	FuncExpr *readFunction = NULL;
+
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	readFunction = IntermediateResultReadFunction(node);
+	if (readFunction != NULL)
+	{
+		Node *resultIdArgument = (Node *) linitial(readFunction->args);
+		PartitionedResultRead *resultRead = NULL;
+		Const *resultIdConst = NULL;
+
+		if (!IsA(resultIdArgument, Const) || ((Const *) resultIdArgument)->constisnull)
+		{
+			return false;
+		}
+
+		resultIdConst = (Const *) resultIdArgument;
+		resultRead = FindPartitionedResultRead(updateContext->partitionedReadList,
+											   TextDatumGetCString(
+												   resultIdConst->constvalue));
+		if (resultRead != NULL)
+		{
+			char *partitionPrefix =
+				PartitionedResultPrefix(resultRead->resultId, resultRead->relationId,
+										resultRead->partitionColumnIndex);
+			char *partitionId = PartitionedResultId(partitionPrefix,
+													updateContext->shardIndex);
+
+			resultIdConst->constvalue = CStringGetTextDatum(partitionId);
+		}
+
+		return false;
+	}
+	else if (IsA(node, Query))
+	{
+		return query_tree_walker((Query *) node, UpdateResultReadsWalker,
+								 updateContext, 0);
+	}
+
+	return expression_tree_walker(node, UpdateResultReadsWalker, updateContext);
+}
@@ -20,6 +20,7 @@
 #include "commands/explain.h"
 #include "commands/tablecmds.h"
 #include "optimizer/cost.h"
+#include "distributed/citus_custom_scan.h"
 #include "distributed/citus_nodefuncs.h"
 #include "distributed/connection_management.h"
 #include "distributed/insert_select_planner.h"
@@ -31,6 +32,7 @@
 #include "distributed/multi_logical_planner.h"
 #include "distributed/multi_master_planner.h"
 #include "distributed/multi_physical_planner.h"
+#include "distributed/multi_router_executor.h"
 #include "distributed/distributed_planner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/remote_commands.h"
@@ -76,10 +78,14 @@ typedef struct RemoteExplainPlan
 
 /* Explain functions for distributed queries */
 static void ExplainSubPlans(DistributedPlan *distributedPlan, ExplainState *es);
-static void ExplainJob(Job *job, ExplainState *es);
+static void ExplainJob(Job *job, ParamListInfo params, ExplainState *es);
 static void ExplainMapMergeJob(MapMergeJob *mapMergeJob, ExplainState *es);
-static void ExplainTaskList(List *taskList, ExplainState *es);
-static RemoteExplainPlan * RemoteExplain(Task *task, ExplainState *es);
+static void ExplainTaskList(List *taskList, ParamListInfo params, ExplainState *es);
+static RemoteExplainPlan * RemoteExplain(Task *task, ParamListInfo params,
+										 ExplainState *es);
+static int ExecuteRemoteExplainQuery(MultiConnection *connection,
+									 const char *explainQuery, ParamListInfo params,
+									 PGresult **result);
 static void ExplainTask(Task *task, int placementIndex, List *explainOutputList,
 						ExplainState *es);
 static void ExplainTaskPlacement(ShardPlacement *taskPlacement, List *explainOutputList,
@@ -112,6 +118,8 @@ CitusExplainScan(CustomScanState *node, List *ancestors, struct ExplainState *es
 {
 	CitusScanState *scanState = (CitusScanState *) node;
 	DistributedPlan *distributedPlan = scanState->distributedPlan;
+	EState *executorState = ScanStateGetExecutorState(scanState);
+	ParamListInfo params = executorState->es_param_list_info;
 
 	if (!ExplainDistributedQueries)
 	{
@@ -128,7 +136,7 @@ CitusExplainScan(CustomScanState *node, List *ancestors, struct ExplainState *es
 		ExplainSubPlans(distributedPlan, es);
 	}
 
-	ExplainJob(distributedPlan->workerJob, es);
+	ExplainJob(distributedPlan->workerJob, params, es);
 
 	ExplainCloseGroup("Distributed Query", "Distributed Query", true, es);
 }
@@ -220,7 +228,7 @@ ExplainSubPlans(DistributedPlan *distributedPlan, ExplainState *es)
  * or all tasks if citus.explain_all_tasks is on.
  */
 static void
-ExplainJob(Job *job, ExplainState *es)
+ExplainJob(Job *job, ParamListInfo params, ExplainState *es)
 {
 	List *dependedJobList = job->dependedJobList;
 	int dependedJobCount = list_length(dependedJobList);
@@ -232,6 +240,12 @@ ExplainJob(Job *job, ExplainState *es)
 
 	ExplainPropertyIntegerInternal("Task Count", NULL, taskCount, es);
 
+	if (job->deferredPruningClauseList != NIL)
+	{
+		/* generic plans prune the shards for the parameters of each execution */
+		ExplainPropertyText("Shard Pruning", "On Execution", es);
+	}
+
 	if (dependedJobCount > 0)
 	{
 		ExplainPropertyText("Tasks Shown", "None, not supported for re-partition "
@@ -255,9 +269,16 @@ ExplainJob(Job *job, ExplainState *es)
 	 */
 	if (dependedJobCount == 0)
 	{
+		/*
+		 * Only task queries of generic plans contain parameters, the others
+		 * had their parameters resolved on the coordinator.
+		 */
+		ParamListInfo taskParams =
+			job->deferredPruningClauseList != NIL ? params : NULL;
+
 		ExplainOpenGroup("Tasks", "Tasks", false, es);
 
-		ExplainTaskList(taskList, es);
+		ExplainTaskList(taskList, taskParams, es);
 
 		ExplainCloseGroup("Tasks", "Tasks", false, es);
 	}
@@ -340,7 +361,7 @@ ExplainMapMergeJob(MapMergeJob *mapMergeJob, ExplainState *es)
  * or all tasks if citus.explain_all_tasks is on.
  */
 static void
-ExplainTaskList(List *taskList, ExplainState *es)
+ExplainTaskList(List *taskList, ParamListInfo params, ExplainState *es)
 {
 	ListCell *taskCell = NULL;
 	ListCell *remoteExplainCell = NULL;
@@ -354,7 +375,7 @@ ExplainTaskList(List *taskList, ExplainState *es)
 		Task *task = (Task *) lfirst(taskCell);
 		RemoteExplainPlan *remoteExplain = NULL;
 
-		remoteExplain = RemoteExplain(task, es);
+		remoteExplain = RemoteExplain(task, params, es);
 		remoteExplainList = lappend(remoteExplainList, remoteExplain);
 
 		if (!ExplainAllTasks)
@@ -378,10 +399,11 @@ ExplainTaskList(List *taskList, ExplainState *es)
 /*
  * RemoteExplain fetches the the remote EXPLAIN output for a single
  * task. It tries each shard placement until one succeeds or all
- * failed.
+ * failed. Task queries of generic plans contain parameters, whose
+ * values are sent along with the EXPLAIN query.
  */
 static RemoteExplainPlan *
-RemoteExplain(Task *task, ExplainState *es)
+RemoteExplain(Task *task, ParamListInfo params, ExplainState *es)
 {
 	StringInfo explainQuery = NULL;
 	List *taskPlacementList = task->taskPlacementList;
@@ -426,8 +448,8 @@ RemoteExplain(Task *task, ExplainState *es)
 		ExecuteCriticalRemoteCommand(connection, "SAVEPOINT citus_explain_savepoint");
 
 		/* run explain query */
-		executeResult = ExecuteOptionalRemoteCommand(connection, explainQuery->data,
-													 &queryResult);
+		executeResult = ExecuteRemoteExplainQuery(connection, explainQuery->data,
+												  params, &queryResult);
 		if (executeResult != 0)
 		{
 			PQclear(queryResult);
@@ -456,6 +478,55 @@ RemoteExplain(Task *task, ExplainState *es)
 }
 
 
+/*
+ * ExecuteRemoteExplainQuery executes the given EXPLAIN query like
+ * ExecuteOptionalRemoteCommand, but sends the given parameters along
+ * with the query if there are any.
+ */
+static int
+ExecuteRemoteExplainQuery(MultiConnection *connection, const char *explainQuery,
+						  ParamListInfo params, PGresult **result)
+{
+	int parameterCount = 0;
+	Oid *parameterTypes = NULL;
+	const char **parameterValues = NULL;
+	int querySent = 0;
+	PGresult *localResult = NULL;
+	bool raiseInterrupts = true;
+
+	if (params == NULL)
+	{
+		return ExecuteOptionalRemoteCommand(connection, explainQuery, result);
+	}
+
+	/* force evaluation of bound params */
+	params = copyParamList(params);
+	parameterCount = params->numParams;
+
+	ExtractParametersFromParamListInfo(params, &parameterTypes, &parameterValues);
+
+	querySent = SendRemoteCommandParams(connection, explainQuery, parameterCount,
+										parameterTypes, parameterValues, false);
+	if (querySent == 0)
+	{
+		ReportConnectionError(connection, WARNING);
+		return QUERY_SEND_FAILED;
+	}
+
+	localResult = GetRemoteCommandResult(connection, raiseInterrupts);
+	if (!IsResponseOK(localResult))
+	{
+		ReportResultError(connection, localResult, WARNING);
+		PQclear(localResult);
+		ForgetResults(connection);
+		return RESPONSE_NOT_OKAY;
+	}
+
+	*result = localResult;
+	return 0;
+}
+
+
 /*
  * ExplainTask shows the EXPLAIN output for an single task. The output has been
  * fetched from the placement at index placementIndex. If explainOutputList is NIL,
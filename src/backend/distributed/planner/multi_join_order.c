@@ -3,6 +3,9 @@
  * multi_join_order.c
  *
  * Routines for constructing the join order list using a rule-based approach.
+ * When citus.enable_cost_based_join_order is set, join orders are first
+ * compared by the estimated number of bytes they transfer across the
+ * network, based on shard sizes, and the rules only break ties.
  *
  * Copyright (c) 2012-2016, Citus Data, Inc.
  *
@@ -18,6 +21,7 @@
 #include "access/heapam.h"
 #include "access/htup_details.h"
 #include "catalog/pg_am.h"
+#include "distributed/master_metadata_utility.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_join_order.h"
 #include "distributed/multi_physical_planner.h"
@@ -41,6 +45,7 @@
 /* Config variables managed via guc.c */
 bool LogMultiJoinOrder = false; /* print join order as a debugging aid */
 bool EnableSingleHashRepartitioning = false;
+bool EnableCostBasedJoinOrder = false;
 
 /* Function pointer type definition for join rule evaluation functions */
 typedef JoinOrderNode *(*RuleEvalFunction) (JoinOrderNode *currentJoinNode,
@@ -61,6 +66,9 @@ static List * BestJoinOrder(List *candidateJoinOrders);
 static List * FewestOfJoinRuleType(List *candidateJoinOrders, JoinRuleType ruleType);
 static uint32 JoinRuleTypeCount(List *joinOrder, JoinRuleType ruleTypeToCount);
 static List * LatestLargeDataTransfer(List *candidateJoinOrders);
+static List * CheapestJoinOrders(List *candidateJoinOrders);
+static double JoinOrderTransferCost(List *joinOrder, double *tableSizeArray);
+static bool TableEntrySize(TableEntry *tableEntry, double *tableSize);
 static void PrintJoinOrderList(List *joinOrder);
 static uint32 LargeDataTransferLocation(List *joinOrder);
 static List * TableEntryListDifference(List *lhsTableList, List *rhsTableList);
@@ -380,6 +388,19 @@ BestJoinOrder(List *candidateJoinOrders)
 	uint32 highestValidIndex = JOIN_RULE_LAST - 1;
 	uint32 candidateCount PG_USED_FOR_ASSERTS_ONLY = 0;
 
+	/*
+	 * If enabled, we keep the join orders that transfer the fewest bytes
+	 * across the network, after avoiding cartesian products. The rule-based
+	 * heuristics below then only break ties, for instance when the sizes of
+	 * the shards are unknown.
+	 */
+	if (EnableCostBasedJoinOrder)
+	{
+		candidateJoinOrders = FewestOfJoinRuleType(candidateJoinOrders,
+												   CARTESIAN_PRODUCT);
+		candidateJoinOrders = CheapestJoinOrders(candidateJoinOrders);
+	}
+
 	/*
 	 * We start with the highest ranking rule type (cartesian product), and walk
 	 * over these rules in reverse order. For each rule type, we then keep join
@@ -510,6 +531,152 @@ LatestLargeDataTransfer(List *candidateJoinOrders)
 }
 
 
+/*
+ * CheapestJoinOrders finds and returns the join orders that are estimated to
+ * transfer the fewest bytes across the network. If the size of any of the
+ * tables cannot be estimated, the function returns all join orders.
+ */
+static List *
+CheapestJoinOrders(List *candidateJoinOrders)
+{
+	List *cheapestJoinOrders = NIL;
+	double cheapestTransferCost = 0.0;
+	List *firstJoinOrder = (List *) linitial(candidateJoinOrders);
+	double *tableSizeArray = NULL;
+	uint32 maxRangeTableId = 0;
+	ListCell *joinOrderNodeCell = NULL;
+	ListCell *joinOrderCell = NULL;
+
+	/* all join orders contain the same tables, so we estimate their sizes once */
+	foreach(joinOrderNodeCell, firstJoinOrder)
+	{
+		JoinOrderNode *joinOrderNode = (JoinOrderNode *) lfirst(joinOrderNodeCell);
+
+		maxRangeTableId = Max(maxRangeTableId, joinOrderNode->tableEntry->rangeTableId);
+	}
+
+	tableSizeArray = palloc0((maxRangeTableId + 1) * sizeof(double));
+
+	foreach(joinOrderNodeCell, firstJoinOrder)
+	{
+		JoinOrderNode *joinOrderNode = (JoinOrderNode *) lfirst(joinOrderNodeCell);
+		TableEntry *tableEntry = joinOrderNode->tableEntry;
+
+		if (!TableEntrySize(tableEntry, &tableSizeArray[tableEntry->rangeTableId]))
+		{
+			return candidateJoinOrders;
+		}
+	}
+
+	foreach(joinOrderCell, candidateJoinOrders)
+	{
+		List *joinOrder = (List *) lfirst(joinOrderCell);
+		double transferCost = JoinOrderTransferCost(joinOrder, tableSizeArray);
+
+		if (cheapestJoinOrders == NIL || transferCost < cheapestTransferCost)
+		{
+			cheapestJoinOrders = list_make1(joinOrder);
+			cheapestTransferCost = transferCost;
+		}
+		else if (transferCost == cheapestTransferCost)
+		{
+			cheapestJoinOrders = lappend(cheapestJoinOrders, joinOrder);
+		}
+	}
+
+	return cheapestJoinOrders;
+}
+
+
+/*
+ * JoinOrderTransferCost estimates the number of bytes that the given join
+ * order transfers across the network, given the sizes of its tables indexed
+ * by range table id.
+ *
+ * Single partition joins transfer the side that is repartitioned, which is
+ * the tables joined so far if the join uses the partitioning of the candidate
+ * table, and the candidate table otherwise. Dual partition joins and
+ * cartesian products transfer both sides. We assume that joins are on keys,
+ * so that a join result is about as large as its larger input.
+ */
+static double
+JoinOrderTransferCost(List *joinOrder, double *tableSizeArray)
+{
+	double transferCost = 0.0;
+	double joinedSize = 0.0;
+	ListCell *joinOrderNodeCell = NULL;
+
+	foreach(joinOrderNodeCell, joinOrder)
+	{
+		JoinOrderNode *joinOrderNode = (JoinOrderNode *) lfirst(joinOrderNodeCell);
+		TableEntry *tableEntry = joinOrderNode->tableEntry;
+		double tableSize = tableSizeArray[tableEntry->rangeTableId];
+
+		switch (joinOrderNode->joinRuleType)
+		{
+			case SINGLE_HASH_PARTITION_JOIN:
+			case SINGLE_RANGE_PARTITION_JOIN:
+			{
+				if (joinOrderNode->anchorTable == tableEntry)
+				{
+					transferCost += joinedSize;
+				}
+				else
+				{
+					transferCost += tableSize;
+				}
+
+				break;
+			}
+
+			case DUAL_PARTITION_JOIN:
+			case CARTESIAN_PRODUCT:
+			{
+				transferCost += joinedSize + tableSize;
+				break;
+			}
+
+			default:
+			{
+				/* first table, reference joins and local joins stay in place */
+				break;
+			}
+		}
+
+		joinedSize = Max(joinedSize, tableSize);
+	}
+
+	return transferCost;
+}
+
+
+/*
+ * TableEntrySize estimates the size of the given table in bytes from the
+ * sizes of its shard placements in the metadata, and returns false if the
+ * size is unknown, as for hash-distributed tables before
+ * master_update_shard_statistics. Reference tables are never transferred by
+ * joins, so their size does not need to be known.
+ */
+static bool
+TableEntrySize(TableEntry *tableEntry, double *tableSize)
+{
+	Oid relationId = tableEntry->relationId;
+	uint64 tableSizeEstimate = 0;
+
+	if (PartitionMethod(relationId) == DISTRIBUTE_BY_NONE)
+	{
+		*tableSize = 0.0;
+		return true;
+	}
+
+	tableSizeEstimate = DistributedTableSizeEstimate(relationId);
+
+	*tableSize = (double) tableSizeEstimate;
+
+	return tableSizeEstimate > 0;
+}
+
+
 /*
  * LargeDataTransferLocation finds the first location of a large data transfer
  * join rule, and returns that location. If the join order does not have any
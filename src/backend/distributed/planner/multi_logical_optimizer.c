@@ -251,6 +251,7 @@ static bool WorkerAggregateWalker(Node *node,
 static List * WorkerAggregateExpressionList(Aggref *originalAggregate,
 											WorkerAggregateWalkerContext *walkerContextry);
 static AggregateType GetAggregateType(Oid aggFunctionId);
+static bool AggregateEnabledCustom(Oid aggFunctionId);
 static Oid AggregateArgumentType(Aggref *aggregate);
 static Oid AggregateFunctionOid(const char *functionName, Oid inputType);
 static Oid TypeOid(Oid schemaId, const char *typeName);
@@ -269,6 +270,7 @@ static void ErrorIfUnsupportedJsonAggregate(AggregateType type,
 											Aggref *aggregateExpression);
 static void ErrorIfUnsupportedJsonObjectAggregate(AggregateType type,
 												  Aggref *aggregateExpression);
+static void ErrorIfUnsupportedCustomAggregate(Aggref *aggregateExpression);
 static void ErrorIfUnsupportedAggregateDistinct(Aggref *aggregateExpression,
 												MultiNode *logicalPlanNode);
 static Var * AggregateDistinctColumn(Aggref *aggregateExpression);
@@ -1798,6 +1800,53 @@ MasterAggregateExpression(Aggref *originalAggregate,
 
 		newMasterExpression = (Expr *) unionAggregate;
 	}
+	else if (aggregateType == AGGREGATE_CUSTOM)
+	{
+		/*
+		 * Other aggregates with combine functions are handled in two steps.
+		 * First, worker nodes compute worker_partial_agg(), which returns the
+		 * transition states of the original aggregate. Then, the master node
+		 * computes coord_combine_agg(), which combines the states and applies
+		 * the final function of the original aggregate. The last argument is
+		 * a NULL of the original return type, which determines the return
+		 * type of coord_combine_agg().
+		 */
+		Oid combineFunctionId = FunctionOid("pg_catalog", COORD_COMBINE_AGGREGATE_NAME,
+											3);
+		Oid resultType = exprType((Node *) originalAggregate);
+		int32 resultTypeMod = exprTypmod((Node *) originalAggregate);
+		Oid resultCollationId = exprCollation((Node *) originalAggregate);
+		Const *aggregateOidParam = makeConst(OIDOID, -1, InvalidOid, sizeof(Oid),
+											 ObjectIdGetDatum(originalAggregate->
+															  aggfnoid),
+											 false, true);
+		Const *resultTypeParam = makeNullConst(resultType, resultTypeMod,
+											   resultCollationId);
+		Var *stateColumn = NULL;
+		List *combineArgumentList = NIL;
+		Aggref *combineAggregate = NULL;
+
+		stateColumn = makeVar(masterTableId, walkerContext->columnId, CSTRINGOID, -1,
+							  InvalidOid, columnLevelsUp);
+		walkerContext->columnId++;
+
+		combineArgumentList =
+			list_make3(makeTargetEntry((Expr *) aggregateOidParam, 1, NULL, false),
+					   makeTargetEntry((Expr *) stateColumn, 2, NULL, false),
+					   makeTargetEntry((Expr *) resultTypeParam, 3, NULL, false));
+
+		combineAggregate = copyObject(originalAggregate);
+		combineAggregate->aggfnoid = combineFunctionId;
+		combineAggregate->aggtype = resultType;
+		combineAggregate->args = combineArgumentList;
+		combineAggregate->aggkind = AGGKIND_NORMAL;
+		combineAggregate->aggfilter = NULL;
+		combineAggregate->aggtranstype = InvalidOid;
+		combineAggregate->aggargtypes = list_make3_oid(OIDOID, CSTRINGOID, resultType);
+		combineAggregate->aggsplit = AGGSPLIT_SIMPLE;
+
+		newMasterExpression = (Expr *) combineAggregate;
+	}
 	else if (aggregateType == AGGREGATE_TOPN_UNION_AGG ||
 			 aggregateType == AGGREGATE_TOPN_ADD_AGG)
 	{
@@ -2855,6 +2904,36 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 		workerAggregateList = lappend(workerAggregateList, sumAggregate);
 		workerAggregateList = lappend(workerAggregateList, countAggregate);
 	}
+	else if (aggregateType == AGGREGATE_CUSTOM)
+	{
+		/*
+		 * For other aggregates with combine functions, we compute
+		 * worker_partial_agg(aggregate, var) on worker nodes. The aggregate
+		 * is passed as a regprocedure, such that workers resolve it by name.
+		 */
+		Oid partialFunctionId = FunctionOid("pg_catalog", WORKER_PARTIAL_AGGREGATE_NAME,
+											2);
+		Oid argumentType = AggregateArgumentType(originalAggregate);
+		TargetEntry *argument = (TargetEntry *) linitial(originalAggregate->args);
+		Const *aggregateOidParam = makeConst(REGPROCEDUREOID, -1, InvalidOid,
+											 sizeof(Oid),
+											 ObjectIdGetDatum(originalAggregate->
+															  aggfnoid),
+											 false, true);
+		Aggref *partialAggregate = copyObject(originalAggregate);
+
+		partialAggregate->aggfnoid = partialFunctionId;
+		partialAggregate->aggtype = CSTRINGOID;
+		partialAggregate->args =
+			list_make2(makeTargetEntry((Expr *) aggregateOidParam, 1, NULL, false),
+					   makeTargetEntry(copyObject(argument->expr), 2, NULL, false));
+		partialAggregate->aggkind = AGGKIND_NORMAL;
+		partialAggregate->aggtranstype = InvalidOid;
+		partialAggregate->aggargtypes = list_make2_oid(OIDOID, argumentType);
+		partialAggregate->aggsplit = AGGSPLIT_SIMPLE;
+
+		workerAggregateList = lappend(workerAggregateList, partialAggregate);
+	}
 	else
 	{
 		/*
@@ -2908,6 +2987,11 @@ GetAggregateType(Oid aggFunctionId)
 
 	if (!found)
 	{
+		if (AggregateEnabledCustom(aggFunctionId))
+		{
+			return AGGREGATE_CUSTOM;
+		}
+
 		ereport(ERROR, (errmsg("unsupported aggregate function %s", aggregateProcName)));
 	}
 
@@ -2915,6 +2999,44 @@ GetAggregateType(Oid aggFunctionId)
 }
 
 
+/*
+ * AggregateEnabledCustom returns whether the given aggregate can be executed
+ * in two phases through worker_partial_agg and coord_combine_agg. This is the
+ * case for regular aggregates with a single argument that have a combine
+ * function, and serialization functions if their transition state is of type
+ * internal. We do not support polymorphic transition states, since their
+ * types cannot be resolved outside of the original aggregate.
+ */
+static bool
+AggregateEnabledCustom(Oid aggFunctionId)
+{
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	bool supportsCombine = false;
+	bool supportsSerialization = false;
+
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggFunctionId));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		return false;
+	}
+
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+
+	supportsCombine = aggregateForm->aggkind == AGGKIND_NORMAL &&
+					  OidIsValid(aggregateForm->aggcombinefn) &&
+					  !IsPolymorphicType(aggregateForm->aggtranstype);
+	supportsSerialization = aggregateForm->aggtranstype != INTERNALOID ||
+							(OidIsValid(aggregateForm->aggserialfn) &&
+							 OidIsValid(aggregateForm->aggdeserialfn));
+
+	ReleaseSysCache(aggregateTuple);
+
+	return supportsCombine && supportsSerialization &&
+		   get_func_nargs(aggFunctionId) == 1;
+}
+
+
 /* Extracts the type of the argument over which the aggregate is operating. */
 static Oid
 AggregateArgumentType(Aggref *aggregate)
@@ -3196,6 +3318,10 @@ ErrorIfContainsUnsupportedAggregate(MultiNode *logicalPlanNode)
 		{
 			ErrorIfUnsupportedJsonObjectAggregate(aggregateType, aggregateExpression);
 		}
+		else if (aggregateType == AGGREGATE_CUSTOM)
+		{
+			ErrorIfUnsupportedCustomAggregate(aggregateExpression);
+		}
 		else if (aggregateExpression->aggdistinct)
 		{
 			ErrorIfUnsupportedAggregateDistinct(aggregateExpression, logicalPlanNode);
@@ -3204,6 +3330,31 @@ ErrorIfContainsUnsupportedAggregate(MultiNode *logicalPlanNode)
 }
 
 
+/*
+ * ErrorIfUnsupportedCustomAggregate checks if we can push down the given
+ * aggregate through worker_partial_agg and coord_combine_agg. If we cannot,
+ * this function errors.
+ */
+static void
+ErrorIfUnsupportedCustomAggregate(Aggref *aggregateExpression)
+{
+	const char *name = get_func_name(aggregateExpression->aggfnoid);
+
+	/* partial states cannot be built over ordered or distinct inputs */
+	if (aggregateExpression->aggorder)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s with order by is unsupported", name)));
+	}
+
+	if (aggregateExpression->aggdistinct)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("%s (distinct) is unsupported", name)));
+	}
+}
+
+
 /*
  * ErrorIfUnsupportedArrayAggregate checks if we can transform the array aggregate
  * expression and push it down to the worker node. If we cannot transform the
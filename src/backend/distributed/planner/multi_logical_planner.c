@@ -16,11 +16,15 @@
 
 #include "access/heapam.h"
 #include "access/nbtree.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_class.h"
+#include "catalog/pg_namespace.h"
+#include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "distributed/citus_clauses.h"
 #include "distributed/colocation_utils.h"
+#include "distributed/function_utils.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/insert_select_planner.h"
 #include "distributed/multi_logical_optimizer.h"
@@ -29,6 +33,7 @@
 #include "distributed/relation_restriction_equivalence.h"
 #include "distributed/query_pushdown_planning.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/multi_server_executor.h"
 #include "distributed/worker_protocol.h"
 #include "distributed/version_compat.h"
 #include "nodes/makefuncs.h"
@@ -43,6 +48,7 @@
 #include "optimizer/clauses.h"
 #include "optimizer/prep.h"
 #include "optimizer/tlist.h"
+#include "parser/parse_oper.h"
 #include "parser/parsetree.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
@@ -51,6 +57,11 @@
 #include "utils/relcache.h"
 
 
+/* Config variables managed via guc.c */
+bool EnableRepartitionedCountDistinct = false;
+bool EnableRepartitionedGroupBy = false;
+
+
 /* Struct to differentiate different qualifier types in an expression tree walker */
 typedef struct QualifierWalkerContext
 {
@@ -66,7 +77,28 @@ typedef MultiNode *(*RuleApplyFunction) (MultiNode *leftNode, MultiNode *rightNo
 
 static RuleApplyFunction RuleApplyFunctionArray[JOIN_RULE_LAST] = { 0 }; /* join rules */
 
+
+/*
+ * RepartitionedCountDistinctContext is used to replace the expressions of a
+ * count(distinct) query with references to the columns of the subquery that
+ * RepartitionedCountDistinctQuery creates.
+ */
+typedef struct RepartitionedCountDistinctContext
+{
+	List *subqueryTargetList;
+	bool unsupportedExpression;
+} RepartitionedCountDistinctContext;
+
 /* Local functions forward declarations */
+static Query * RepartitionedCountDistinctQuery(Query *queryTree);
+static Var * RepartitionedCountDistinctColumn(Query *queryTree);
+static Query * RepartitionedGroupByQuery(Query *queryTree);
+static Index RepartitionableAggregateQueryTableId(Query *queryTree);
+static RangeTblEntry * RepartitionSubqueryEntry(Query *subquery, char *aliasName);
+static Aggref * CountStarAggregate(void);
+static Node * RepartitionedCountDistinctMutator(Node *node,
+												RepartitionedCountDistinctContext *
+												context);
 static bool AllTargetExpressionsAreColumnReferences(List *targetEntryList);
 static FieldSelect * CompositeFieldRecursive(Expr *expression, Query *query);
 static bool FullCompositeFieldList(List *compositeFieldList);
@@ -133,11 +165,21 @@ MultiLogicalPlanCreate(Query *originalQuery, Query *queryTree,
 	MultiNode *multiQueryNode = NULL;
 	MultiTreeRoot *rootNode = NULL;
 
+	Query *repartitionedQuery = NULL;
+
 	if (ShouldUseSubqueryPushDown(originalQuery, queryTree))
 	{
 		multiQueryNode = SubqueryMultiNodeTree(originalQuery, queryTree,
 											   plannerRestrictionContext);
 	}
+	else if ((repartitionedQuery = RepartitionedCountDistinctQuery(queryTree)) != NULL)
+	{
+		multiQueryNode = MultiNodeTree(repartitionedQuery);
+	}
+	else if ((repartitionedQuery = RepartitionedGroupByQuery(queryTree)) != NULL)
+	{
+		multiQueryNode = MultiNodeTree(repartitionedQuery);
+	}
 	else
 	{
 		multiQueryNode = MultiNodeTree(queryTree);
@@ -151,6 +193,548 @@ MultiLogicalPlanCreate(Query *originalQuery, Query *queryTree,
 }
 
 
+/*
+ * RepartitionedCountDistinctQuery rewrites a single table query with
+ * count(distinct) aggregates on a column other than the partition column into
+ * a query on a subquery that groups by that column, and returns the new query.
+ * For example,
+ *
+ *   SELECT g, count(DISTINCT c) FROM t WHERE q GROUP BY g
+ *
+ * becomes
+ *
+ *   SELECT g, count(c) FROM (SELECT c, g, count(*) FROM t WHERE q GROUP BY c, g) s
+ *   GROUP BY g
+ *
+ * The subquery is planned as a repartition job that hashes its rows on the
+ * first group by column. Each distinct value then ends up in exactly one
+ * partition, where it is deduplicated, and the coordinator only sums the counts
+ * of the partitions instead of deduplicating all values itself.
+ *
+ * The function returns NULL if repartitioning is disabled, or if the query is
+ * not eligible for the rewrite. The caller then plans the original query.
+ */
+static Query *
+RepartitionedCountDistinctQuery(Query *queryTree)
+{
+	Query *subquery = NULL;
+	Query *outerQuery = NULL;
+	RangeTblRef *subqueryReference = NULL;
+	Var *distinctColumn = NULL;
+	TargetEntry *distinctTargetEntry = NULL;
+	SortGroupClause *distinctGroupClause = NULL;
+	List *subqueryTargetList = NIL;
+	List *subqueryGroupClauseList = NIL;
+	ListCell *groupClauseCell = NULL;
+	Oid lessThanOperator = InvalidOid;
+	Oid equalsOperator = InvalidOid;
+	bool hashable = false;
+	Index nextSortGroupRefIndex = 1;
+	AttrNumber nextResNo = 1;
+	RepartitionedCountDistinctContext context;
+
+	distinctColumn = RepartitionedCountDistinctColumn(queryTree);
+	if (distinctColumn == NULL)
+	{
+		return NULL;
+	}
+
+	/* the distinct column comes first, since the subquery is partitioned on it */
+	distinctTargetEntry = makeTargetEntry((Expr *) copyObject(distinctColumn),
+										  nextResNo++, pstrdup("distinct_column"),
+										  false);
+	distinctTargetEntry->ressortgroupref = nextSortGroupRefIndex++;
+
+	get_sort_group_operators(distinctColumn->vartype, true, true, false,
+							 &lessThanOperator, &equalsOperator, NULL, &hashable);
+
+	distinctGroupClause = makeNode(SortGroupClause);
+	distinctGroupClause->tleSortGroupRef = distinctTargetEntry->ressortgroupref;
+	distinctGroupClause->eqop = equalsOperator;
+	distinctGroupClause->sortop = lessThanOperator;
+	distinctGroupClause->nulls_first = false;
+	distinctGroupClause->hashable = hashable;
+
+	subqueryTargetList = list_make1(distinctTargetEntry);
+	subqueryGroupClauseList = list_make1(distinctGroupClause);
+
+	/* the subquery also groups by the expressions the query groups by */
+	foreach(groupClauseCell, queryTree->groupClause)
+	{
+		SortGroupClause *groupClause = (SortGroupClause *) lfirst(groupClauseCell);
+		TargetEntry *groupTargetEntry = get_sortgroupclause_tle(groupClause,
+																queryTree->targetList);
+		TargetEntry *subqueryTargetEntry = NULL;
+		SortGroupClause *subqueryGroupClause = NULL;
+		AttrNumber resNo = InvalidAttrNumber;
+
+		if (equal(groupTargetEntry->expr, distinctColumn))
+		{
+			continue;
+		}
+
+		resNo = nextResNo++;
+		subqueryTargetEntry = makeTargetEntry(copyObject(groupTargetEntry->expr), resNo,
+											  psprintf("group_column_%d", resNo), false);
+		subqueryTargetEntry->ressortgroupref = nextSortGroupRefIndex++;
+
+		subqueryGroupClause = copyObject(groupClause);
+		subqueryGroupClause->tleSortGroupRef = subqueryTargetEntry->ressortgroupref;
+
+		subqueryTargetList = lappend(subqueryTargetList, subqueryTargetEntry);
+		subqueryGroupClauseList = lappend(subqueryGroupClauseList, subqueryGroupClause);
+	}
+
+	/* repartitioned subqueries need an aggregate, the count is not used */
+	subqueryTargetList = lappend(subqueryTargetList,
+								 makeTargetEntry((Expr *) CountStarAggregate(),
+												 nextResNo++, pstrdup("count"), false));
+
+	subquery = makeNode(Query);
+	subquery->commandType = CMD_SELECT;
+	subquery->querySource = QSRC_ORIGINAL;
+	subquery->canSetTag = true;
+	subquery->rtable = copyObject(queryTree->rtable);
+	subquery->jointree = copyObject(queryTree->jointree);
+	subquery->targetList = subqueryTargetList;
+	subquery->groupClause = subqueryGroupClauseList;
+	subquery->hasAggs = true;
+
+	/* replace the expressions of the query with columns of the subquery */
+	memset(&context, 0, sizeof(context));
+	context.subqueryTargetList = subqueryTargetList;
+
+	outerQuery = copyObject(queryTree);
+	outerQuery->targetList = (List *)
+		RepartitionedCountDistinctMutator((Node *) outerQuery->targetList, &context);
+	outerQuery->havingQual =
+		RepartitionedCountDistinctMutator(outerQuery->havingQual, &context);
+
+	if (context.unsupportedExpression)
+	{
+		return NULL;
+	}
+
+	subqueryReference = makeNode(RangeTblRef);
+	subqueryReference->rtindex = 1;
+
+	outerQuery->rtable = list_make1(RepartitionSubqueryEntry(subquery,
+															 "count_distinct_subquery"));
+	outerQuery->jointree = makeFromExpr(list_make1(subqueryReference), NULL);
+
+	return outerQuery;
+}
+
+
+/*
+ * RepartitionedCountDistinctColumn returns the column of the count(distinct)
+ * aggregates of the given query if RepartitionedCountDistinctQuery can rewrite
+ * the query, and NULL otherwise. The query needs to be a plain aggregate query
+ * on a single distributed table, and all its aggregates need to be
+ * count(distinct) on the same column other than the partition column.
+ */
+static Var *
+RepartitionedCountDistinctColumn(Query *queryTree)
+{
+	RangeTblEntry *rangeTableEntry = NULL;
+	Index rangeTableIndex = 0;
+	Oid relationId = InvalidOid;
+	Var *partitionColumn = NULL;
+	Var *distinctColumn = NULL;
+	List *expressionList = NIL;
+	ListCell *expressionCell = NULL;
+
+	if (!EnableRepartitionedCountDistinct ||
+		CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION)
+	{
+		return NULL;
+	}
+
+	rangeTableIndex = RepartitionableAggregateQueryTableId(queryTree);
+	if (rangeTableIndex == 0)
+	{
+		return NULL;
+	}
+
+	rangeTableEntry = rt_fetch(rangeTableIndex, queryTree->rtable);
+	relationId = rangeTableEntry->relid;
+
+	expressionList = pull_var_clause((Node *) list_make2(queryTree->targetList,
+														 queryTree->havingQual),
+									 PVC_INCLUDE_AGGREGATES);
+	foreach(expressionCell, expressionList)
+	{
+		Node *expression = (Node *) lfirst(expressionCell);
+		Aggref *aggregate = NULL;
+		TargetEntry *argument = NULL;
+		char *aggregateName = NULL;
+
+		/* columns outside of aggregates are checked when we replace them */
+		if (!IsA(expression, Aggref))
+		{
+			continue;
+		}
+
+		aggregate = (Aggref *) expression;
+		aggregateName = get_func_name(aggregate->aggfnoid);
+		if (get_func_namespace(aggregate->aggfnoid) != PG_CATALOG_NAMESPACE ||
+			strncmp(aggregateName, AggregateNames[AGGREGATE_COUNT], NAMEDATALEN) != 0 ||
+			aggregate->aggdistinct == NIL || aggregate->aggfilter != NULL ||
+			aggregate->agglevelsup != 0 || list_length(aggregate->args) != 1)
+		{
+			return NULL;
+		}
+
+		argument = (TargetEntry *) linitial(aggregate->args);
+		if (!IsA(argument->expr, Var) ||
+			((Var *) argument->expr)->varno != rangeTableIndex ||
+			((Var *) argument->expr)->varlevelsup != 0 ||
+			((Var *) argument->expr)->varattno <= 0)
+		{
+			return NULL;
+		}
+
+		if (distinctColumn == NULL)
+		{
+			distinctColumn = (Var *) argument->expr;
+		}
+		else if (!equal(distinctColumn, argument->expr))
+		{
+			return NULL;
+		}
+	}
+
+	if (distinctColumn == NULL)
+	{
+		return NULL;
+	}
+
+	/* count(distinct) on the partition column is already computed on the shards */
+	partitionColumn = PartitionColumn(relationId, rangeTableIndex);
+	if (partitionColumn != NULL && partitionColumn->varattno == distinctColumn->varattno)
+	{
+		return NULL;
+	}
+
+	return distinctColumn;
+}
+
+
+/*
+ * RepartitionedGroupByQuery rewrites a single table query that groups by
+ * columns other than the partition column into a query on a subquery that
+ * contains the grouping, and returns the new query. For example,
+ *
+ *   SELECT g, sum(v) FROM t WHERE q GROUP BY g ORDER BY 2 DESC LIMIT 10
+ *
+ * becomes
+ *
+ *   SELECT g, s FROM (SELECT g, sum(v) AS s FROM t WHERE q GROUP BY g) sub
+ *   ORDER BY 2 DESC LIMIT 10
+ *
+ * The subquery is planned as a repartition job that hashes the partial
+ * aggregates of the shards on the first group by column, and finalizes the
+ * groups of each partition on the workers. The coordinator then only receives
+ * final groups, and only the top groups of each partition if the query has a
+ * limit, instead of merging the partial aggregates of all groups itself.
+ *
+ * The function returns NULL if repartitioning is disabled, or if the query is
+ * not eligible for the rewrite. The caller then plans the original query.
+ */
+static Query *
+RepartitionedGroupByQuery(Query *queryTree)
+{
+	Query *subquery = NULL;
+	Query *outerQuery = NULL;
+	RangeTblRef *subqueryReference = NULL;
+	RangeTblEntry *rangeTableEntry = NULL;
+	Index rangeTableIndex = 0;
+	Var *partitionColumn = NULL;
+	SortGroupClause *repartitionGroupClause = NULL;
+	List *groupClauseList = NIL;
+	List *outerTargetList = NIL;
+	List *expressionList = NIL;
+	ListCell *groupClauseCell = NULL;
+	ListCell *expressionCell = NULL;
+	ListCell *targetEntryCell = NULL;
+	const Index subqueryTableId = 1;
+
+	if (!EnableRepartitionedGroupBy || queryTree->groupClause == NIL)
+	{
+		return NULL;
+	}
+
+	rangeTableIndex = RepartitionableAggregateQueryTableId(queryTree);
+	if (rangeTableIndex == 0)
+	{
+		return NULL;
+	}
+
+	rangeTableEntry = rt_fetch(rangeTableIndex, queryTree->rtable);
+	partitionColumn = PartitionColumn(rangeTableEntry->relid, rangeTableIndex);
+
+	/*
+	 * Groups on the partition column are already finalized on the shards, and
+	 * the subquery is partitioned on a column it groups by.
+	 */
+	foreach(groupClauseCell, queryTree->groupClause)
+	{
+		SortGroupClause *groupClause = (SortGroupClause *) lfirst(groupClauseCell);
+		TargetEntry *groupTargetEntry = get_sortgroupclause_tle(groupClause,
+																queryTree->targetList);
+		Var *groupColumn = NULL;
+
+		if (!IsA(groupTargetEntry->expr, Var))
+		{
+			continue;
+		}
+
+		groupColumn = (Var *) groupTargetEntry->expr;
+		if (partitionColumn != NULL && groupColumn->varno == rangeTableIndex &&
+			groupColumn->varattno == partitionColumn->varattno)
+		{
+			return NULL;
+		}
+
+		if (repartitionGroupClause == NULL)
+		{
+			repartitionGroupClause = groupClause;
+		}
+	}
+
+	if (repartitionGroupClause == NULL)
+	{
+		return NULL;
+	}
+
+	/* distinct and ordered aggregates are not split into partial aggregates */
+	expressionList = pull_var_clause((Node *) list_make2(queryTree->targetList,
+														 queryTree->havingQual),
+									 PVC_INCLUDE_AGGREGATES);
+	foreach(expressionCell, expressionList)
+	{
+		Node *expression = (Node *) lfirst(expressionCell);
+
+		if (IsA(expression, Aggref) &&
+			(((Aggref *) expression)->aggdistinct != NIL ||
+			 ((Aggref *) expression)->aggorder != NIL))
+		{
+			return NULL;
+		}
+	}
+
+	/*
+	 * The subquery returns all target entries of the query, including the ones
+	 * that are only used for sorting, and leaves sorting and limits to the
+	 * outer query.
+	 */
+	subquery = copyObject(queryTree);
+	subquery->sortClause = NIL;
+	subquery->limitCount = NULL;
+	subquery->limitOffset = NULL;
+	groupClauseList = list_delete_ptr(list_copy(queryTree->groupClause),
+									  repartitionGroupClause);
+	groupClauseList = lcons(repartitionGroupClause, groupClauseList);
+	subquery->groupClause = copyObject(groupClauseList);
+
+	foreach(targetEntryCell, subquery->targetList)
+	{
+		TargetEntry *subqueryTargetEntry = (TargetEntry *) lfirst(targetEntryCell);
+		TargetEntry *outerTargetEntry = NULL;
+		Var *column = NULL;
+
+		if (subqueryTargetEntry->resname == NULL)
+		{
+			subqueryTargetEntry->resname = psprintf("column_%d",
+													subqueryTargetEntry->resno);
+		}
+
+		column = makeVarFromTargetEntry(subqueryTableId, subqueryTargetEntry);
+		outerTargetEntry = flatCopyTargetEntry(subqueryTargetEntry);
+		outerTargetEntry->expr = (Expr *) column;
+		outerTargetList = lappend(outerTargetList, outerTargetEntry);
+
+		subqueryTargetEntry->resjunk = false;
+	}
+
+	subqueryReference = makeNode(RangeTblRef);
+	subqueryReference->rtindex = subqueryTableId;
+
+	outerQuery = makeNode(Query);
+	outerQuery->commandType = CMD_SELECT;
+	outerQuery->querySource = QSRC_ORIGINAL;
+	outerQuery->canSetTag = true;
+	outerQuery->rtable = list_make1(RepartitionSubqueryEntry(subquery,
+															 "group_by_subquery"));
+	outerQuery->jointree = makeFromExpr(list_make1(subqueryReference), NULL);
+	outerQuery->targetList = outerTargetList;
+	outerQuery->sortClause = copyObject(queryTree->sortClause);
+	outerQuery->limitCount = copyObject(queryTree->limitCount);
+	outerQuery->limitOffset = copyObject(queryTree->limitOffset);
+
+	return outerQuery;
+}
+
+
+/*
+ * RepartitionableAggregateQueryTableId returns the range table index of the
+ * distributed table that the given query aggregates over, if the query can be
+ * planned as a single relation repartition subquery. Otherwise, the function
+ * returns 0. This is also the case when the executor cannot run repartition
+ * jobs, such that the query is planned without repartitioning.
+ */
+static Index
+RepartitionableAggregateQueryTableId(Query *queryTree)
+{
+	List *rangeTableIndexList = NIL;
+	RangeTblEntry *rangeTableEntry = NULL;
+	Index rangeTableIndex = 0;
+	Oid relationId = InvalidOid;
+
+	if (TaskExecutorType != MULTI_EXECUTOR_TASK_TRACKER && !EnableRepartitionJoins)
+	{
+		return 0;
+	}
+
+	if (queryTree->commandType != CMD_SELECT || !queryTree->hasAggs ||
+		queryTree->hasSubLinks || queryTree->hasWindowFuncs ||
+		queryTree->hasTargetSRFs || queryTree->setOperations != NULL ||
+		queryTree->groupingSets != NIL || queryTree->distinctClause != NIL)
+	{
+		return 0;
+	}
+
+	ExtractRangeTableIndexWalker((Node *) queryTree->jointree, &rangeTableIndexList);
+	if (list_length(rangeTableIndexList) != 1)
+	{
+		return 0;
+	}
+
+	rangeTableIndex = linitial_int(rangeTableIndexList);
+	rangeTableEntry = rt_fetch(rangeTableIndex, queryTree->rtable);
+	if (rangeTableEntry->rtekind != RTE_RELATION)
+	{
+		return 0;
+	}
+
+	relationId = rangeTableEntry->relid;
+	if (!IsDistributedTable(relationId) ||
+		PartitionMethod(relationId) == DISTRIBUTE_BY_NONE)
+	{
+		return 0;
+	}
+
+	return rangeTableIndex;
+}
+
+
+/*
+ * RepartitionSubqueryEntry returns a range table entry for the given subquery,
+ * which is named after its target entries.
+ */
+static RangeTblEntry *
+RepartitionSubqueryEntry(Query *subquery, char *aliasName)
+{
+	RangeTblEntry *subqueryEntry = makeNode(RangeTblEntry);
+	List *columnNameList = NIL;
+	ListCell *targetEntryCell = NULL;
+
+	foreach(targetEntryCell, subquery->targetList)
+	{
+		TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+
+		columnNameList = lappend(columnNameList, makeString(pstrdup(targetEntry->resname)));
+	}
+
+	subqueryEntry->rtekind = RTE_SUBQUERY;
+	subqueryEntry->subquery = subquery;
+	subqueryEntry->alias = makeAlias(aliasName, NIL);
+	subqueryEntry->eref = makeAlias(aliasName, columnNameList);
+	subqueryEntry->inh = false;
+	subqueryEntry->inFromCl = true;
+
+	return subqueryEntry;
+}
+
+
+/*
+ * CountStarAggregate returns a count(*) aggregate.
+ */
+static Aggref *
+CountStarAggregate(void)
+{
+	Aggref *countAggregate = makeNode(Aggref);
+
+	countAggregate->aggfnoid = FunctionOid("pg_catalog", AggregateNames[AGGREGATE_COUNT],
+										   0);
+	countAggregate->aggtype = INT8OID;
+	countAggregate->aggcollid = InvalidOid;
+	countAggregate->inputcollid = InvalidOid;
+	countAggregate->aggtranstype = InvalidOid;
+	countAggregate->aggstar = true;
+	countAggregate->aggkind = AGGKIND_NORMAL;
+	countAggregate->agglevelsup = 0;
+	countAggregate->aggsplit = AGGSPLIT_SIMPLE;
+	countAggregate->location = -1;
+
+	return countAggregate;
+}
+
+
+/*
+ * RepartitionedCountDistinctMutator replaces the grouped expressions of the
+ * query with the corresponding columns of the count(distinct) subquery, and
+ * replaces count(distinct) aggregates with count aggregates on the distinct
+ * column of the subquery. If it finds a column that the subquery does not
+ * provide, it sets unsupportedExpression in the context.
+ */
+static Node *
+RepartitionedCountDistinctMutator(Node *node, RepartitionedCountDistinctContext *context)
+{
+	const Index subqueryTableId = 1;
+	ListCell *targetEntryCell = NULL;
+
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	foreach(targetEntryCell, context->subqueryTargetList)
+	{
+		TargetEntry *targetEntry = (TargetEntry *) lfirst(targetEntryCell);
+
+		if (!IsA(targetEntry->expr, Aggref) && equal(node, targetEntry->expr))
+		{
+			return (Node *) makeVarFromTargetEntry(subqueryTableId, targetEntry);
+		}
+	}
+
+	if (IsA(node, Aggref))
+	{
+		Aggref *countAggregate = copyObject((Aggref *) node);
+		TargetEntry *distinctTargetEntry =
+			(TargetEntry *) linitial(context->subqueryTargetList);
+		Var *distinctColumn = makeVarFromTargetEntry(subqueryTableId,
+													 distinctTargetEntry);
+
+		countAggregate->aggdistinct = NIL;
+		countAggregate->args = list_make1(makeTargetEntry((Expr *) distinctColumn, 1,
+														  NULL, false));
+
+		return (Node *) countAggregate;
+	}
+
+	if (IsA(node, Var))
+	{
+		context->unsupportedExpression = true;
+		return node;
+	}
+
+	return expression_tree_mutator(node, RepartitionedCountDistinctMutator,
+								   (void *) context);
+}
+
+
 /*
  * FindNodeCheck finds a node for which the check function returns true.
  *
@@ -36,6 +36,7 @@
 #include "distributed/citus_ruleutils.h"
 #include "distributed/colocation_utils.h"
 #include "distributed/deparse_shard_query.h"
+#include "distributed/intermediate_result_pruning.h"
 #include "distributed/master_protocol.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_router_planner.h"
@@ -87,6 +88,25 @@ bool EnableUniqueJobIds = true;
 static List *OperatorCache = NIL;
 
 
+/*
+ * ShardQueryTemplate keeps track of the task whose query string serves as a
+ * template for the query strings of the other tasks of a job. Only the first
+ * query string that is deparsed for a job is checked, since the query strings
+ * of the other tasks differ only in the shard names.
+ */
+typedef struct ShardQueryTemplate
+{
+	/* task whose query string passed ShardQueryStringIsTemplate, or NULL */
+	Task *task;
+
+	/* whether we already checked a query string of the job */
+	bool checked;
+
+	/* number of query strings that were generated from the template */
+	int instantiatedCount;
+} ShardQueryTemplate;
+
+
 /* Local functions forward declarations for job creation */
 static Job * BuildJobTree(MultiTreeRoot *multiTree);
 static MultiNode * LeftMostNode(MultiTreeRoot *multiTree);
@@ -140,7 +160,9 @@ static Task * QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 									  RelationRestrictionContext *restrictionContext,
 									  uint32 taskId,
 									  TaskType taskType,
-									  bool modifyRequiresMasterEvaluation);
+									  bool modifyRequiresMasterEvaluation,
+									  List *partitionedReadList,
+									  ShardQueryTemplate *queryTemplate);
 static bool ShardIntervalsEqual(FmgrInfo *comparisonFunction,
 								ShardInterval *firstInterval,
 								ShardInterval *secondInterval);
@@ -2091,10 +2113,18 @@ QueryPushdownSqlTaskList(Query *query, uint64 jobId,
 	int maxShardOffset = 0;
 	bool *taskRequiredForShardIndex = NULL;
 	ListCell *prunedRelationShardCell = NULL;
+	ShardQueryTemplate queryTemplate = { NULL, false, 0 };
+	List *partitionedReadList = NIL;
 
 	/* error if shards are not co-partitioned */
 	ErrorIfUnsupportedShardDistribution(query);
 
+	/* tasks may only need the partitions of results that join with their shards */
+	if (taskType == SQL_TASK)
+	{
+		partitionedReadList = PartitionedResultReadList(query);
+	}
+
 	if (list_length(relationRestrictionContext->relationRestrictionList) == 0)
 	{
 		ereport(ERROR, (errmsg("cannot handle complex subqueries when the "
@@ -2180,13 +2210,22 @@ QueryPushdownSqlTaskList(Query *query, uint64 jobId,
 
 		subqueryTask = QueryPushdownTaskCreate(query, shardOffset,
 											   relationRestrictionContext, taskIdIndex,
-											   taskType, modifyRequiresMasterEvaluation);
+											   taskType, modifyRequiresMasterEvaluation,
+											   partitionedReadList, &queryTemplate);
 		subqueryTask->jobId = jobId;
 		sqlTaskList = lappend(sqlTaskList, subqueryTask);
 
 		++taskIdIndex;
 	}
 
+	if (queryTemplate.instantiatedCount > 0)
+	{
+		ereport(DEBUG4, (errmsg("generated the query strings of %d task(s) from the "
+								"query string of task %d",
+								queryTemplate.instantiatedCount,
+								queryTemplate.task->taskId)));
+	}
+
 	/* If it is a modify task with multiple tables */
 	if (taskType == MODIFY_TASK && list_length(
 			relationRestrictionContext->relationRestrictionList) > 1)
@@ -2315,14 +2354,23 @@ ErrorIfUnsupportedShardDistribution(Query *query)
 /*
  * SubqueryTaskCreate creates a sql task by replacing the target
  * shardInterval's boundary value.
+ *
+ * Deparsing the query for every shard dominates planning time of queries
+ * on tables with many shards. For SELECT queries, the query string of the
+ * first task therefore becomes the template of the job, and the query
+ * strings of subsequent tasks are generated by substituting the shard names
+ * in the query string of the template task, if possible.
+ *
+ * Reads of the intermediate results in partitionedReadList are changed into
+ * reads of the partition for the shard index, which rules out templates.
  */
 static Task *
 QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 						RelationRestrictionContext *restrictionContext, uint32 taskId,
-						TaskType taskType, bool modifyRequiresMasterEvaluation)
+						TaskType taskType, bool modifyRequiresMasterEvaluation,
+						List *partitionedReadList, ShardQueryTemplate *queryTemplate)
 {
-	Query *taskQuery = copyObject(originalQuery);
-
+	Query *taskQuery = NULL;
 	StringInfo queryString = makeStringInfo();
 	ListCell *restrictionCell = NULL;
 	Task *subqueryTask = NULL;
@@ -2404,32 +2452,69 @@ QueryPushdownTaskCreate(Query *originalQuery, int shardIndex,
 							   "shards in the query")));
 	}
 
-	/*
-	 * Augment the relations in the query with the shard IDs.
-	 */
-	UpdateRelationToShardNames((Node *) taskQuery, relationShardList);
+	subqueryTask = CreateBasicTask(jobId, taskId, taskType, NULL);
 
-	/*
-	 * Ands are made implicit during shard pruning, as predicate comparison and
-	 * refutation depend on it being so. We need to make them explicit again so
-	 * that the query string is generated as (...) AND (...) as opposed to
-	 * (...), (...).
-	 */
-	if (taskQuery->jointree->quals != NULL && IsA(taskQuery->jointree->quals, List))
+	if (taskType == SQL_TASK && partitionedReadList == NIL &&
+		queryTemplate->task != NULL)
 	{
-		taskQuery->jointree->quals = (Node *) make_ands_explicit(
-			(List *) taskQuery->jointree->quals);
-	}
+		subqueryTask->queryString =
+			InstantiateShardQueryTemplate(queryTemplate->task->queryString,
+										  queryTemplate->task->relationShardList,
+										  relationShardList);
+		if (subqueryTask->queryString != NULL)
+		{
+			ereport(DEBUG4, (errmsg("distributed statement: %s",
+									ApplyLogRedaction(subqueryTask->queryString))));
 
-	subqueryTask = CreateBasicTask(jobId, taskId, taskType, NULL);
+			queryTemplate->instantiatedCount++;
+		}
+	}
 
-	if ((taskType == MODIFY_TASK && !modifyRequiresMasterEvaluation) ||
-		taskType == SQL_TASK)
+	if (subqueryTask->queryString == NULL &&
+		((taskType == MODIFY_TASK && !modifyRequiresMasterEvaluation) ||
+		 taskType == SQL_TASK))
 	{
+		taskQuery = copyObject(originalQuery);
+
+		/*
+		 * Augment the relations in the query with the shard IDs.
+		 */
+		UpdateRelationToShardNames((Node *) taskQuery, relationShardList);
+
+		if (partitionedReadList != NIL)
+		{
+			UpdateResultReadsToPartitionNames(taskQuery, partitionedReadList,
+											  shardIndex);
+		}
+
+		/*
+		 * Ands are made implicit during shard pruning, as predicate comparison and
+		 * refutation depend on it being so. We need to make them explicit again so
+		 * that the query string is generated as (...) AND (...) as opposed to
+		 * (...), (...).
+		 */
+		if (taskQuery->jointree->quals != NULL && IsA(taskQuery->jointree->quals, List))
+		{
+			taskQuery->jointree->quals = (Node *) make_ands_explicit(
+				(List *) taskQuery->jointree->quals);
+		}
+
 		pg_get_query_def(taskQuery, queryString);
 		ereport(DEBUG4, (errmsg("distributed statement: %s",
 								ApplyLogRedaction(queryString->data))));
 		subqueryTask->queryString = queryString->data;
+
+		if (taskType == SQL_TASK && partitionedReadList == NIL &&
+			!queryTemplate->checked)
+		{
+			queryTemplate->checked = true;
+
+			if (ShardQueryStringIsTemplate(taskQuery, queryString->data,
+										   relationShardList))
+			{
+				queryTemplate->task = subqueryTask;
+			}
+		}
 	}
 
 	subqueryTask->dependedTaskList = NULL;
@@ -2626,6 +2711,7 @@ SqlTaskList(Job *job)
 	List *rangeTableList = jobQuery->rtable;
 	List *whereClauseList = (List *) jobQuery->jointree->quals;
 	List *dependedJobList = job->dependedJobList;
+	ShardQueryTemplate queryTemplate = { NULL, false, 0 };
 
 	/*
 	 * If we don't depend on a hash partition, then we determine the largest
@@ -2680,34 +2766,66 @@ SqlTaskList(Job *job)
 		List *fragmentCombination = (List *) lfirst(fragmentCombinationCell);
 		List *dataFetchTaskList = NIL;
 		int32 dataFetchTaskCount = 0;
-		StringInfo sqlQueryString = NULL;
+		char *sqlQueryString = NULL;
 		Task *sqlTask = NULL;
 		Query *taskQuery = NULL;
-		List *fragmentRangeTableList = NIL;
+		List *relationShardList = NIL;
 
 		/* create tasks to fetch fragments required for the sql task */
 		dataFetchTaskList = DataFetchTaskList(jobId, taskIdIndex, fragmentCombination);
 		dataFetchTaskCount = list_length(dataFetchTaskList);
 		taskIdIndex += dataFetchTaskCount;
 
-		/* update range table entries with fragment aliases (in place) */
-		taskQuery = copyObject(jobQuery);
-		fragmentRangeTableList = taskQuery->rtable;
-		UpdateRangeTableAlias(fragmentRangeTableList, fragmentCombination);
+		relationShardList = BuildRelationShardList(rangeTableList, fragmentCombination);
+
+		/*
+		 * Deparsing the query for every fragment combination dominates planning
+		 * time on tables with many shards. If possible, we therefore substitute
+		 * the shard names in the query string of an earlier task instead.
+		 */
+		if (queryTemplate.task != NULL && dataFetchTaskList == NIL)
+		{
+			sqlQueryString =
+				InstantiateShardQueryTemplate(queryTemplate.task->queryString,
+											  queryTemplate.task->relationShardList,
+											  relationShardList);
+			if (sqlQueryString != NULL)
+			{
+				queryTemplate.instantiatedCount++;
+			}
+		}
+
+		if (sqlQueryString == NULL)
+		{
+			StringInfo queryString = makeStringInfo();
+
+			/* update range table entries with fragment aliases (in place) */
+			taskQuery = copyObject(jobQuery);
+			UpdateRangeTableAlias(taskQuery->rtable, fragmentCombination);
 
-		/* transform the updated task query to a SQL query string */
-		sqlQueryString = makeStringInfo();
-		pg_get_query_def(taskQuery, sqlQueryString);
+			/* transform the updated task query to a SQL query string */
+			pg_get_query_def(taskQuery, queryString);
+			sqlQueryString = queryString->data;
+		}
 
-		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString->data);
+		sqlTask = CreateBasicTask(jobId, taskIdIndex, SQL_TASK, sqlQueryString);
 		sqlTask->dependedTaskList = dataFetchTaskList;
-		sqlTask->relationShardList = BuildRelationShardList(fragmentRangeTableList,
-															fragmentCombination);
+		sqlTask->relationShardList = relationShardList;
+
+		if (!queryTemplate.checked && taskQuery != NULL && dataFetchTaskList == NIL)
+		{
+			queryTemplate.checked = true;
+
+			if (ShardQueryStringIsTemplate(taskQuery, sqlQueryString, relationShardList))
+			{
+				queryTemplate.task = sqlTask;
+			}
+		}
 
 		/* log the query string we generated */
 		ereport(DEBUG4, (errmsg("generated sql query for task %d", sqlTask->taskId),
 						 errdetail("query string: \"%s\"",
-								   ApplyLogRedaction(sqlQueryString->data))));
+								   ApplyLogRedaction(sqlQueryString))));
 
 		sqlTask->anchorShardId = INVALID_SHARD_ID;
 		if (anchorRangeTableBasedAssignment)
@@ -2720,6 +2838,14 @@ SqlTaskList(Job *job)
 		sqlTaskList = lappend(sqlTaskList, sqlTask);
 	}
 
+	if (queryTemplate.instantiatedCount > 0)
+	{
+		ereport(DEBUG4, (errmsg("generated the query strings of %d task(s) from the "
+								"query string of task %d",
+								queryTemplate.instantiatedCount,
+								queryTemplate.task->taskId)));
+	}
+
 	return sqlTaskList;
 }
 
@@ -35,7 +35,6 @@
 
 
 static RangeTblEntry * AnchorRte(Query *subquery);
-static Query * WrapRteRelationIntoSubquery(RangeTblEntry *rteRelation);
 static List * UnionRelationRestrictionLists(List *firstRelationList,
 											List *secondRelationList);
 
@@ -48,12 +47,7 @@ ColocatedJoinChecker
 CreateColocatedJoinChecker(Query *subquery, PlannerRestrictionContext *restrictionContext)
 {
 	ColocatedJoinChecker colocatedJoinChecker;
-
 	RangeTblEntry *anchorRangeTblEntry = NULL;
-	Query *anchorSubquery = NULL;
-	PlannerRestrictionContext *anchorPlannerRestrictionContext = NULL;
-	RelationRestrictionContext *anchorRelationRestrictionContext = NULL;
-	List *anchorRestrictionEquivalences = NIL;
 
 	/* we couldn't pick an anchor subquery, no need to continue */
 	anchorRangeTblEntry = AnchorRte(subquery);
@@ -64,6 +58,27 @@ CreateColocatedJoinChecker(Query *subquery, PlannerRestrictionContext *restricti
 		return colocatedJoinChecker;
 	}
 
+	return CreateColocatedJoinCheckerForAnchor(subquery, anchorRangeTblEntry,
+											   restrictionContext);
+}
+
+
+/*
+ * CreateColocatedJoinCheckerForAnchor calculates a ColocatedJoinChecker for
+ * the given query that checks colocation with the given anchor relation or
+ * subquery, which should be in the join tree of the query.
+ */
+ColocatedJoinChecker
+CreateColocatedJoinCheckerForAnchor(Query *subquery, RangeTblEntry *anchorRangeTblEntry,
+									PlannerRestrictionContext *restrictionContext)
+{
+	ColocatedJoinChecker colocatedJoinChecker;
+
+	Query *anchorSubquery = NULL;
+	PlannerRestrictionContext *anchorPlannerRestrictionContext = NULL;
+	RelationRestrictionContext *anchorRelationRestrictionContext = NULL;
+	List *anchorRestrictionEquivalences = NIL;
+
 	if (anchorRangeTblEntry->rtekind == RTE_RELATION)
 	{
 		/*
@@ -251,7 +266,7 @@ SubqueryColocated(Query *subquery, ColocatedJoinChecker *checker)
  * projections. The returned query should be used cautiosly and it is mostly
  * designed for generating a stub query.
  */
-static Query *
+Query *
 WrapRteRelationIntoSubquery(RangeTblEntry *rteRelation)
 {
 	Query *subquery = makeNode(Query);
@@ -52,6 +52,7 @@
 #include "postgres.h"
 #include "funcapi.h"
 
+#include "access/heapam.h"
 #include "catalog/pg_type.h"
 #include "catalog/pg_class.h"
 #include "distributed/citus_nodes.h"
@@ -59,6 +60,7 @@
 #include "distributed/commands/multi_copy.h"
 #include "distributed/distributed_planner.h"
 #include "distributed/errormessage.h"
+#include "distributed/master_metadata_utility.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_logical_planner.h"
 #include "distributed/multi_router_planner.h"
@@ -85,8 +87,13 @@
 #endif
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
 
 
+/* size in kilobytes up to which non-colocated tables are broadcast in joins */
+int BroadcastJoinThreshold = 0;
+
 /*
  * RecursivePlanningContext is used to recursively plan subqueries
  * and CTEs, pull results to the coordinator, and push it back into
@@ -137,6 +144,11 @@ static void RecursivelyPlanNonColocatedJoinWalker(Node *joinNode,
 												  colocatedJoinChecker,
 												  RecursivePlanningContext *
 												  recursivePlanningContext);
+static bool ShouldBroadcastSmallDistributedTables(Query *query,
+												  RecursivePlanningContext *context);
+static void BroadcastSmallDistributedTables(Query *query,
+											RecursivePlanningContext *context);
+static void TransformRelationRTE(RangeTblEntry *rangeTableEntry);
 static void RecursivelyPlanNonColocatedSubqueriesInWhere(Query *query,
 														 ColocatedJoinChecker *
 														 colocatedJoinChecker,
@@ -303,6 +315,17 @@ RecursivelyPlanSubqueriesAndCTEs(Query *query, RecursivePlanningContext *context
 		RecursivelyPlanAllSubqueries((Node *) query->jointree->quals, context);
 	}
 
+	/*
+	 * If the query joins distributed tables that are not colocated, replace
+	 * the small ones with intermediate results that are broadcast to all
+	 * nodes, such that they can be joined with the shards of the large tables
+	 * without repartitioning.
+	 */
+	if (ShouldBroadcastSmallDistributedTables(query, context))
+	{
+		BroadcastSmallDistributedTables(query, context);
+	}
+
 	/*
 	 * If the query doesn't have distribution key equality,
 	 * recursively plan some of its subqueries.
@@ -369,6 +392,212 @@ ShouldRecursivelyPlanNonColocatedSubqueries(Query *subquery,
 }
 
 
+/*
+ * ShouldBroadcastSmallDistributedTables returns true if broadcast joins are
+ * enabled and the input query joins distributed tables that are not all
+ * joined on their distribution keys.
+ */
+static bool
+ShouldBroadcastSmallDistributedTables(Query *query, RecursivePlanningContext *context)
+{
+	if (BroadcastJoinThreshold <= 0)
+	{
+		return false;
+	}
+
+	if (query->commandType != CMD_SELECT)
+	{
+		return false;
+	}
+
+	if (context->allDistributionKeysInQueryAreEqual)
+	{
+		return false;
+	}
+
+	/* direct joins with local tables are not supported by any of Citus planners */
+	if (FindNodeCheckInRangeTableList(query->rtable, IsLocalTableRTE))
+	{
+		return false;
+	}
+
+	/*
+	 * Intermediate results cannot be on the outer side of an outer join with
+	 * a distributed table, so we leave outer joins to the other planners.
+	 */
+	if (FindNodeCheck((Node *) query->jointree, IsOuterJoinExpr))
+	{
+		return false;
+	}
+
+	return !AllDistributionKeysInSubqueryAreEqual(query,
+												  context->plannerRestrictionContext);
+}
+
+
+/*
+ * BroadcastSmallDistributedTables picks the largest distributed table in the
+ * join tree of the input query as the anchor, and recursively plans the
+ * distributed tables that are not joined with the anchor on the distribution
+ * key and whose size is known to be below citus.broadcast_join_threshold.
+ *
+ * The recursively planned tables are written to intermediate results on all
+ * nodes, which makes them behave like reference tables in the rest of the
+ * query. The sizes of the tables are taken from the shard statistics in the
+ * metadata, which hash-distributed tables only have after
+ * master_update_shard_statistics. If the size of any of the tables is
+ * unknown, we cannot tell which table is the largest, and no table is
+ * broadcast.
+ */
+static void
+BroadcastSmallDistributedTables(Query *query, RecursivePlanningContext *context)
+{
+	List *rangeTableList = query->rtable;
+	Relids joinRelIds = get_relids_in_jointree((Node *) query->jointree, false);
+	uint64 broadcastJoinThresholdBytes = BroadcastJoinThreshold * 1024L;
+	uint64 *tableSizeArray = palloc0((list_length(rangeTableList) + 1) *
+									 sizeof(uint64));
+	RangeTblEntry *anchorRangeTblEntry = NULL;
+	uint64 anchorTableSize = 0;
+	ColocatedJoinChecker colocatedJoinChecker;
+	int rangeTableIndex = -1;
+
+	while ((rangeTableIndex = bms_next_member(joinRelIds, rangeTableIndex)) >= 0)
+	{
+		RangeTblEntry *rangeTableEntry = rt_fetch(rangeTableIndex, rangeTableList);
+		uint64 tableSize = 0;
+
+		if (!IsDistributedTableRTE((Node *) rangeTableEntry) ||
+			PartitionMethod(rangeTableEntry->relid) == DISTRIBUTE_BY_NONE)
+		{
+			continue;
+		}
+
+		tableSize = DistributedTableSizeEstimate(rangeTableEntry->relid);
+		if (tableSize == 0)
+		{
+			return;
+		}
+
+		tableSizeArray[rangeTableIndex] = tableSize;
+
+		if (anchorRangeTblEntry == NULL || tableSize > anchorTableSize)
+		{
+			anchorRangeTblEntry = rangeTableEntry;
+			anchorTableSize = tableSize;
+		}
+	}
+
+	if (anchorRangeTblEntry == NULL)
+	{
+		return;
+	}
+
+	colocatedJoinChecker =
+		CreateColocatedJoinCheckerForAnchor(query, anchorRangeTblEntry,
+											context->plannerRestrictionContext);
+
+	rangeTableIndex = -1;
+	while ((rangeTableIndex = bms_next_member(joinRelIds, rangeTableIndex)) >= 0)
+	{
+		RangeTblEntry *rangeTableEntry = rt_fetch(rangeTableIndex, rangeTableList);
+		uint64 tableSize = tableSizeArray[rangeTableIndex];
+		Query *relationSubquery = NULL;
+
+		if (rangeTableEntry == anchorRangeTblEntry ||
+			!IsDistributedTableRTE((Node *) rangeTableEntry) ||
+			PartitionMethod(rangeTableEntry->relid) == DISTRIBUTE_BY_NONE)
+		{
+			continue;
+		}
+
+		if (tableSize > broadcastJoinThresholdBytes)
+		{
+			continue;
+		}
+
+		relationSubquery = WrapRteRelationIntoSubquery(rangeTableEntry);
+		if (SubqueryColocated(relationSubquery, &colocatedJoinChecker))
+		{
+			continue;
+		}
+
+		ereport(DEBUG1, (errmsg("broadcasting table %s in a join",
+								get_rel_name(rangeTableEntry->relid))));
+
+		TransformRelationRTE(rangeTableEntry);
+		RecursivelyPlanSubquery(rangeTableEntry->subquery, context);
+	}
+}
+
+
+/*
+ * TransformRelationRTE wraps a given relation RangeTableEntry inside a
+ * (SELECT <all columns> FROM relation) subquery.
+ *
+ * The subquery returns the columns in the order of their attribute numbers,
+ * with NULLs in place of dropped columns, such that the Vars in the query that
+ * refer to the relation remain valid. The said RangeTableEntry is modified and
+ * now points to the new subquery.
+ */
+static void
+TransformRelationRTE(RangeTblEntry *rangeTableEntry)
+{
+	Query *subquery = makeNode(Query);
+	RangeTblRef *newRangeTableRef = makeNode(RangeTblRef);
+	RangeTblEntry *newRangeTableEntry = NULL;
+	Relation relation = NULL;
+	TupleDesc tupleDescriptor = NULL;
+	int columnIndex = 0;
+
+	subquery->commandType = CMD_SELECT;
+
+	/* copy the input rangeTableEntry to prevent cycles */
+	newRangeTableEntry = copyObject(rangeTableEntry);
+
+	/* set the FROM expression to the subquery */
+	subquery->rtable = list_make1(newRangeTableEntry);
+	newRangeTableRef->rtindex = 1;
+	subquery->jointree = makeFromExpr(list_make1(newRangeTableRef), NULL);
+
+	relation = heap_open(rangeTableEntry->relid, NoLock);
+	tupleDescriptor = RelationGetDescr(relation);
+
+	for (columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+	{
+		FormData_pg_attribute *attributeForm = TupleDescAttr(tupleDescriptor,
+															 columnIndex);
+		char *columnName = pstrdup(NameStr(attributeForm->attname));
+		Expr *targetExpr = NULL;
+		TargetEntry *targetEntry = NULL;
+
+		if (attributeForm->attisdropped)
+		{
+			targetExpr = (Expr *) makeNullConst(INT4OID, -1, InvalidOid);
+		}
+		else
+		{
+			targetExpr = (Expr *) makeVar(1, columnIndex + 1, attributeForm->atttypid,
+										  attributeForm->atttypmod,
+										  attributeForm->attcollation, 0);
+		}
+
+		targetEntry = makeTargetEntry(targetExpr, columnIndex + 1, columnName, false);
+		subquery->targetList = lappend(subquery->targetList, targetEntry);
+	}
+
+	heap_close(relation, NoLock);
+
+	/* replace the relation with the constructed subquery */
+	rangeTableEntry->rtekind = RTE_SUBQUERY;
+	rangeTableEntry->subquery = subquery;
+	rangeTableEntry->relid = InvalidOid;
+	rangeTableEntry->relkind = 0;
+	rangeTableEntry->inh = false;
+	rangeTableEntry->tablesample = NULL;
+}
+
+
 /*
  * ContainsSubquery returns true if the input query contains any subqueries
  * in the FROM or WHERE clauses.
@@ -32,6 +32,10 @@
  * 2) If there is a hash range constraint on the partition column, find the
  *    shard interval matching the range
  *
+ * 2b) If there is an IN list or = ANY constraint on the partition column of
+ *    a hash-partitioned table, find the shard intervals of all the constants
+ *    at once
+ *
  * 3) If there are range constraints (e.g. (a > 0 AND a < 10)) on the
  *    partition column, find the shard intervals that overlap with the range
  *
@@ -39,7 +43,9 @@
  *    not excluded by constraints
  *
  * Finally, the union of the shards found by each pruning instance is
- * returned.
+ * returned, after removing the shards of append- and range-distributed
+ * tables whose zone maps show that they cannot match the restrictions on
+ * other columns.
  *
  * Copyright (c) 2014-2017, Citus Data, Inc.
  *
@@ -58,6 +64,7 @@
 #include "distributed/multi_join_order.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/shardinterval_utils.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/pg_dist_partition.h"
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
@@ -103,6 +110,14 @@ typedef struct PruningInstance
 	 */
 	Const *hashedEqualConsts;
 
+	/*
+	 * Constraint of the form partcol IN (...) on a hash-partitioned table,
+	 * stored as a list of column values, any of which the partition column
+	 * can be equal to. This avoids building a pruning instance for each of
+	 * the values of long IN lists.
+	 */
+	List *equalConstList;
+
 	/*
 	 * Types of constraints not understood.  We could theoretically try more
 	 * expensive methods of pruning if any such restrictions are found.
@@ -190,6 +205,9 @@ static Const * TransformPartitionRestrictionValue(Var *partitionColumn,
 static void AddSAOPartitionKeyRestrictionToInstance(ClauseWalkerContext *context,
 													ScalarArrayOpExpr *
 													arrayOperatorExpression);
+static bool AddSAOHashRestrictionToInstance(ClauseWalkerContext *context,
+											ScalarArrayOpExpr *arrayOperatorExpression,
+											ArrayType *array);
 static void AddHashRestrictionToInstance(ClauseWalkerContext *context, OpExpr *opClause,
 										 Var *varClause, Const *constantClause);
 static void AddNewConjuction(ClauseWalkerContext *context, OpExpr *op);
@@ -202,6 +220,9 @@ static int PerformCompare(FunctionCallInfo compareFunctionCall);
 
 static List * PruneOne(DistTableCacheEntry *cacheEntry, ClauseWalkerContext *context,
 					   PruningInstance *prune);
+static List * PruneEqualConstList(DistTableCacheEntry *cacheEntry,
+								  ClauseWalkerContext *context,
+								  PruningInstance *prune);
 static List * PruneWithBoundaries(DistTableCacheEntry *cacheEntry,
 								  ClauseWalkerContext *context,
 								  PruningInstance *prune);
@@ -332,7 +353,7 @@ PruneShards(Oid relationId, Index rangeTableId, List *whereClauseList,
 		if (context.partitionMethod == DISTRIBUTE_BY_HASH)
 		{
 			if (!prune->evaluatesToFalse && !prune->equalConsts &&
-				!prune->hashedEqualConsts)
+				!prune->hashedEqualConsts && !prune->equalConstList)
 			{
 				/* if hash-partitioned and no equals constraints, return all shards */
 				foundRestriction = false;
@@ -356,6 +377,12 @@ PruneShards(Oid relationId, Index rangeTableId, List *whereClauseList,
 					singlePartitionValueConst = NULL;
 				}
 			}
+			else if (partitionValueConst != NULL && prune->equalConstList != NIL)
+			{
+				/* IN lists are only batched if they contain multiple values */
+				singlePartitionValueConst = NULL;
+				foundPartitionColumnValue = true;
+			}
 		}
 
 		pruneOneList = PruneOne(cacheEntry, &context, prune);
@@ -385,6 +412,13 @@ PruneShards(Oid relationId, Index rangeTableId, List *whereClauseList,
 									  cacheEntry->shardIntervalArrayLength);
 	}
 
+	/* skip shards whose zone maps rule out the restrictions on other columns */
+	if (cacheEntry->zoneMapList != NIL)
+	{
+		prunedList = PruneShardsWithZoneMaps(cacheEntry, rangeTableId, whereClauseList,
+											 prunedList);
+	}
+
 	/* if requested, copy the partition value constant */
 	if (partitionValueConst != NULL)
 	{
@@ -661,6 +695,14 @@ AddSAOPartitionKeyRestrictionToInstance(ClauseWalkerContext *context,
 
 		array = DatumGetArrayTypeP(((Const *) arrayArgument)->constvalue);
 
+		/* for hash-partitioned tables, prune on all the array elements at once */
+		if (context->partitionMethod == DISTRIBUTE_BY_HASH &&
+			arrayOperatorExpression->useOr &&
+			AddSAOHashRestrictionToInstance(context, arrayOperatorExpression, array))
+		{
+			return;
+		}
+
 		/* get the necessary information from array type to iterate over it */
 		elementType = ARR_ELEMTYPE(array);
 		get_typlenbyvalalign(elementType,
@@ -703,6 +745,88 @@ AddSAOPartitionKeyRestrictionToInstance(ClauseWalkerContext *context,
 }
 
 
+/*
+ * AddSAOHashRestrictionToInstance adds a partcol IN (...) restriction on a
+ * hash-partitioned table to the current pruning instance as a single
+ * constraint, such that shards can be pruned for all array elements at once
+ * in PruneEqualConstList. Arrays with a single element, and instances that
+ * already have such a constraint, are left to the regular path, which
+ * builds a pruning instance for each array element. The function returns
+ * false in that case.
+ */
+static bool
+AddSAOHashRestrictionToInstance(ClauseWalkerContext *context,
+								ScalarArrayOpExpr *arrayOperatorExpression,
+								ArrayType *array)
+{
+	PruningInstance *prune = context->currentPruningInstance;
+	Var *partitionColumn = context->partitionColumn;
+	List *equalConstList = NIL;
+	int16 typlen = 0;
+	bool typbyval = false;
+	char typalign = '\0';
+	Oid elementType = ARR_ELEMTYPE(array);
+	ArrayIterator arrayIterator = NULL;
+	Datum arrayElement = 0;
+	bool isNull = false;
+
+	if (prune->equalConstList != NIL ||
+		ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array)) <= 1)
+	{
+		return false;
+	}
+
+	if (!prune->addedToPruningInstances)
+	{
+		context->pruningInstances = lappend(context->pruningInstances, prune);
+		prune->addedToPruningInstances = true;
+	}
+
+	get_typlenbyvalalign(elementType, &typlen, &typbyval, &typalign);
+
+	arrayIterator = array_create_iterator(array, 0, NULL);
+	while (array_iterate(arrayIterator, &arrayElement, &isNull))
+	{
+		Const *constElement = NULL;
+
+		/* the partition column is never equal to NULL */
+		if (isNull)
+		{
+			continue;
+		}
+
+		constElement = makeConst(elementType, -1, DEFAULT_COLLATION_OID, typlen,
+								 arrayElement, isNull, typbyval);
+
+		if (elementType != partitionColumn->vartype)
+		{
+			constElement = TransformPartitionRestrictionValue(partitionColumn,
+															  constElement);
+			if (constElement == NULL)
+			{
+				/* couldn't coerce value, so we cannot prune on this restriction */
+				prune->otherRestrictions = lappend(prune->otherRestrictions,
+												   arrayOperatorExpression);
+				return true;
+			}
+		}
+
+		equalConstList = lappend(equalConstList, constElement);
+	}
+
+	if (equalConstList == NIL)
+	{
+		/* IN list of NULLs */
+		prune->evaluatesToFalse = true;
+	}
+
+	prune->equalConstList = equalConstList;
+	prune->hasValidConstraint = true;
+
+	return true;
+}
+
+
 /*
  * AddNewConjuction adds the OpExpr to pending instance list of context
  * as conjunction as partial instance.
@@ -1040,6 +1164,12 @@ PruneOne(DistTableCacheEntry *cacheEntry, ClauseWalkerContext *context,
 		return NIL;
 	}
 
+	/* IN lists on hash-partitioned tables are pruned in one go */
+	if (prune->equalConstList != NIL)
+	{
+		return PruneEqualConstList(cacheEntry, context, prune);
+	}
+
 	/*
 	 * For an equal constraints, if there's no overlapping shards (always the
 	 * case for hash and range partitioning, sometimes for append), can
@@ -1147,6 +1277,75 @@ PruneOne(DistTableCacheEntry *cacheEntry, ClauseWalkerContext *context,
 }
 
 
+/*
+ * PruneEqualConstList returns the shards of a hash-partitioned table that
+ * contain any of the values in the IN list constraint of the pruning
+ * instance, in shard index order. The shard of each value is found with
+ * FindShardInterval, which computes the shard index directly from the hash
+ * value for tables with uniformly distributed shards, and shards that
+ * contain multiple values are only returned once.
+ */
+static List *
+PruneEqualConstList(DistTableCacheEntry *cacheEntry, ClauseWalkerContext *context,
+					PruningInstance *prune)
+{
+	int shardCount = cacheEntry->shardIntervalArrayLength;
+	bool *shardIndexMatched = palloc0(shardCount * sizeof(bool));
+	PruningInstance remainingInstance = *prune;
+	List *prunedList = NIL;
+	ListCell *equalConstCell = NULL;
+	int shardIndex = 0;
+
+	Assert(context->partitionMethod == DISTRIBUTE_BY_HASH);
+
+	ereport(DEBUG4, (errmsg("pruning shards for %d values of an IN list at once",
+							list_length(prune->equalConstList))));
+
+	foreach(equalConstCell, prune->equalConstList)
+	{
+		Const *equalConst = (Const *) lfirst(equalConstCell);
+		ShardInterval *shardInterval = FindShardInterval(equalConst->constvalue,
+														 cacheEntry);
+
+		if (shardInterval != NULL)
+		{
+			shardIndexMatched[shardInterval->shardIndex] = true;
+		}
+	}
+
+	/* other equality constraints further restrict the shards */
+	remainingInstance.equalConstList = NIL;
+	if (remainingInstance.equalConsts || remainingInstance.hashedEqualConsts)
+	{
+		List *remainingShardList = PruneOne(cacheEntry, context, &remainingInstance);
+		ListCell *shardCell = NULL;
+
+		foreach(shardCell, remainingShardList)
+		{
+			ShardInterval *shardInterval = (ShardInterval *) lfirst(shardCell);
+
+			if (shardIndexMatched[shardInterval->shardIndex])
+			{
+				prunedList = lappend(prunedList, shardInterval);
+			}
+		}
+
+		return prunedList;
+	}
+
+	for (shardIndex = 0; shardIndex < shardCount; shardIndex++)
+	{
+		if (shardIndexMatched[shardIndex])
+		{
+			prunedList = lappend(prunedList,
+								 cacheEntry->sortedShardIntervalArray[shardIndex]);
+		}
+	}
+
+	return prunedList;
+}
+
+
 /*
  * PerformCompare invokes comparator with prepared values, check for
  * unexpected NULL returns.
@@ -26,6 +26,9 @@
 #include "distributed/commands/utility_hook.h"
 #include "distributed/connection_management.h"
 #include "distributed/distributed_deadlock_detection.h"
+#include "distributed/intermediate_result_pruning.h"
+#include "distributed/intermediate_results.h"
+#include "distributed/local_executor.h"
 #include "distributed/maintenanced.h"
 #include "distributed/master_metadata_utility.h"
 #include "distributed/master_protocol.h"
@@ -33,17 +36,21 @@
 #include "distributed/multi_explain.h"
 #include "distributed/multi_join_order.h"
 #include "distributed/multi_logical_optimizer.h"
+#include "distributed/multi_logical_planner.h"
 #include "distributed/distributed_planner.h"
 #include "distributed/multi_router_executor.h"
 #include "distributed/multi_router_planner.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/pg_dist_partition.h"
 #include "distributed/placement_connection.h"
+#include "distributed/prepared_statement_cache.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/run_from_same_connection.h"
 #include "distributed/query_pushdown_planning.h"
 #include "distributed/query_stats.h"
+#include "distributed/recursive_planning.h"
 #include "distributed/remote_commands.h"
+#include "distributed/shared_connection_stats.h"
 #include "distributed/shared_library_init.h"
 #include "distributed/statistics_collection.h"
 #include "distributed/subplan_execution.h"
@@ -73,6 +80,8 @@ static void ResizeStackToMaximumDepth(void);
 static void multi_log_hook(ErrorData *edata);
 static void CreateRequiredDirectories(void);
 static void RegisterCitusConfigVariables(void);
+static bool ErrorIfNotASuitableHedgingThreshold(int *newval, void **extra,
+												GucSource source);
 static bool ErrorIfNotASuitableDeadlockFactor(double *newval, void **extra,
 											  GucSource source);
 static void NormalizeWorkerListPath(void);
@@ -235,6 +244,7 @@ _PG_init(void)
 	InitializeTransactionManagement();
 	InitializeBackendManagement();
 	InitializeConnectionManagement();
+	InitializeSharedConnectionStats();
 	InitPlacementConnectionManagement();
 	InitializeCitusQueryStats();
 
@@ -327,6 +337,7 @@ StartupCitusBackend(void)
 {
 	InitializeMaintenanceDaemonBackend();
 	InitializeBackendData();
+	RegisterConnectionCleanup();
 }
 
 
@@ -430,6 +441,18 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.log_intermediate_results",
+		gettext_noop("Log the nodes to which the intermediate results of "
+					 "subplans are sent and which subplans are executed "
+					 "concurrently."),
+		NULL,
+		&LogIntermediateResults,
+		false,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_single_hash_repartition_joins",
 		gettext_noop("Enables single hash repartitioning between hash "
@@ -441,6 +464,39 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_cost_based_join_order",
+		gettext_noop("Chooses join orders by the estimated amount of data that "
+					 "repartition joins transfer."),
+		gettext_noop("When enabled, the planner estimates the number of bytes "
+					 "that each candidate join order transfers across the network "
+					 "from the shard sizes in pg_dist_placement, and picks the "
+					 "cheapest one. The rule-based heuristics are used to break "
+					 "ties, and when the size of a table is unknown."),
+		&EnableCostBasedJoinOrder,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.broadcast_join_threshold",
+		gettext_noop("Sets the maximum size of distributed tables that are "
+					 "broadcast to all nodes in non-colocated joins."),
+		gettext_noop("When a query joins distributed tables that are not "
+					 "colocated, tables that are smaller than this size are "
+					 "read into intermediate results on all nodes and joined "
+					 "with the shards of the largest table, instead of being "
+					 "repartitioned. The sizes of tables are taken from the "
+					 "shard sizes in pg_dist_placement, and no table is "
+					 "broadcast if the size of a table is not known. 0 disables "
+					 "broadcast joins."),
+		&BroadcastJoinThreshold,
+		0, 0, MAX_KILOBYTES,
+		PGC_USERSET,
+		GUC_UNIT_KB,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_fast_path_router_planner",
 		gettext_noop("Enables fast path router planner"),
@@ -451,6 +507,23 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_generic_distributed_plans",
+		gettext_noop("Enables caching of distributed plans for prepared multi-shard "
+					 "SELECT queries."),
+		gettext_noop("By default, prepared statements on distributed tables are "
+					 "planned again for every execution with the parameter values. "
+					 "When enabled, SELECT queries on a single hash-distributed table "
+					 "that only use parameters in the WHERE clause get a generic plan "
+					 "that is cached by postgres. Shards are pruned when the plan is "
+					 "executed and the parameters are sent to the workers along with "
+					 "the shard queries."),
+		&EnableGenericDistributedPlans,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.override_table_visibility",
 		gettext_noop("Enables replacing occurencens of pg_catalog.pg_table_visible() "
@@ -509,6 +582,17 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.log_local_commands",
+		gettext_noop("Log queries that are executed locally, can be overriden by "
+					 "citus.log_remote_commands"),
+		NULL,
+		&LogLocalCommands,
+		false,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.log_distributed_deadlock_detection",
 		gettext_noop("Log distributed deadlock detection related processing in "
@@ -645,6 +729,141 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS | GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_binary_protocol",
+		gettext_noop("Requests the results of tasks from the workers in binary format."),
+		gettext_noop("When all result columns of a query have binary send and "
+					 "receive functions, the adaptive executor requests the task "
+					 "results in binary format and decodes them with the receive "
+					 "functions, which is considerably cheaper than parsing the text "
+					 "representation of types such as numeric, timestamp and arrays."),
+		&EnableBinaryProtocol,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.log_task_execution",
+		gettext_noop("Log how the adaptive executor sends tasks and receives "
+					 "their results."),
+		NULL,
+		&LogTaskExecution,
+		false,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_streaming_execution",
+		gettext_noop("Returns the results of read-only queries while the tasks are "
+					 "still being executed."),
+		gettext_noop("By default, the adaptive executor receives the results of "
+					 "all tasks before returning the first row. When enabled, "
+					 "read-only queries outside of transaction blocks return rows "
+					 "as they are received from the workers, and the remaining "
+					 "tasks are cancelled once no more rows are needed, for "
+					 "instance because a LIMIT is reached. Scrollable cursors "
+					 "always receive all results first."),
+		&EnableStreamingExecution,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.hedged_execution_threshold",
+		gettext_noop("Sets the time after which a slow read-only task is also "
+					 "started on another placement of the shard."),
+		gettext_noop("For read-only queries on reference tables or replicated "
+					 "distributed tables outside of transaction blocks, the adaptive "
+					 "executor starts a task that has not responded within this time, "
+					 "or within the 95th percentile of the durations of the tasks of "
+					 "the same query that already finished, whichever is higher, on "
+					 "the next placement of the shard. The placement that responds "
+					 "first provides the results and the command on the other "
+					 "placement is cancelled. This prevents a single slow worker from "
+					 "delaying every multi-shard query. The threshold cannot be less "
+					 "than 10ms, setting it to -1 disables hedged execution."),
+		&HedgedExecutionThreshold,
+		-1, -1, INT_MAX,
+		PGC_USERSET,
+		GUC_UNIT_MS,
+		ErrorIfNotASuitableHedgingThreshold, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_size_aware_scheduling",
+		gettext_noop("Starts the tasks of read-only queries on large shards first."),
+		gettext_noop("By default, the adaptive executor starts tasks in the order "
+					 "of the task list, such that a task on a large shard may only "
+					 "start at the end of the query. When enabled, tasks are started "
+					 "in order of decreasing shard size, as recorded in the shard "
+					 "statistics, and tasks on replicated shards are balanced across "
+					 "workers by size rather than by count. Shard statistics are "
+					 "kept for append-distributed tables and can be refreshed using "
+					 "master_update_shard_statistics."),
+		&EnableSizeAwareScheduling,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_pipelined_tasks_per_connection",
+		gettext_noop("Sets the maximum number of read-only tasks the adaptive "
+					 "executor sends over a connection at once."),
+		gettext_noop("By default, the adaptive executor sends the next task over a "
+					 "connection only after it received the results of the previous "
+					 "one. When there are more tasks than connections to a worker, "
+					 "for instance because citus.max_shared_pool_size or "
+					 "citus.multi_shard_modify_mode limit the number of connections, "
+					 "setting this above 1 sends up to this many read-only tasks in a "
+					 "single multi-statement command and receives their results in "
+					 "order, which saves a network round-trip per task. Tasks with "
+					 "parameters or binary results are sent one at a time."),
+		&MaxPipelinedTasksPerConnection,
+		1, 1, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_latency_aware_pool_sizing",
+		gettext_noop("Sizes the connection pools of the adaptive executor based on "
+					 "observed task durations and connection establishment times."),
+		gettext_noop("By default, the adaptive executor opens additional connections "
+					 "to a worker every citus.executor_slow_start_interval while tasks "
+					 "are waiting. When enabled, the executor keeps decayed averages of "
+					 "the task durations and connection establishment times observed "
+					 "on each worker in shared memory, and opens as many connections as "
+					 "can each execute waiting tasks for at least as long as it takes "
+					 "to establish a connection. Short tasks are then executed over "
+					 "fewer connections, while connections for long tasks are opened "
+					 "right away. Without recent statistics for a worker, the slow "
+					 "start interval is used."),
+		&EnableLatencyAwarePoolSizing,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_local_execution",
+		gettext_noop("Enables queries on shards that are local to the current node "
+					 "to be planned and executed locally."),
+		gettext_noop("When a placement of a shard that a query accesses resides on "
+					 "the node executing the query (e.g., a Citus MX worker), the "
+					 "adaptive executor plans and executes the shard query within "
+					 "the current session instead of sending it over a connection "
+					 "to the node itself. Once a command in a transaction block is "
+					 "executed locally, subsequent commands that access the local "
+					 "placements are also executed locally."),
+		&EnableLocalExecution,
+		false,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_deadlock_prevention",
 		gettext_noop("Avoids deadlocks by preventing concurrent multi-shard commands"),
@@ -755,6 +974,69 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_KB,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_parallel_subplan_execution",
+		gettext_noop("Enables executing the tasks of independent CTEs and "
+					 "subqueries concurrently."),
+		gettext_noop("When enabled, the tasks of consecutive subplans that do not "
+					 "read each other's results are executed in a single "
+					 "distributed execution before the subplans themselves, such "
+					 "that the workers run them concurrently."),
+		&EnableParallelSubPlanExecution,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_worker_to_worker_intermediate_results",
+		gettext_noop("Enables keeping the results of CTEs and subqueries on the "
+					 "workers that produce them."),
+		gettext_noop("When enabled, the tasks of a subplan whose result needs no "
+					 "processing on the coordinator write their rows into pieces "
+					 "of the intermediate result on the workers, and the nodes "
+					 "that read the result fetch the pieces directly from the "
+					 "other workers. Tasks do not fail over to other placements "
+					 "in this mode. Since the coordinator does not see the rows, "
+					 "this is only done when citus.max_intermediate_result_size "
+					 "is set to -1."),
+		&EnableWorkerToWorkerIntermediateResults,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_partitioned_intermediate_results",
+		gettext_noop("Enables partitioning the results of CTEs and subqueries "
+					 "along the shards of the tables they are joined with."),
+		gettext_noop("When enabled, tasks that join a shard with an intermediate "
+					 "result on the distribution column only read the partition "
+					 "of the result that corresponds to their shard. The "
+					 "coordinator, or the workers that produce the result, split "
+					 "it into partitions and only send each partition to the "
+					 "nodes with its shard."),
+		&EnablePartitionedIntermediateResults,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.compress_intermediate_results",
+		gettext_noop("Writes the results of CTEs and subqueries in compressed "
+					 "blocks."),
+		gettext_noop("When enabled, the COPY data of intermediate results is "
+					 "compressed with pglz in blocks of 64kB, both when it is "
+					 "sent to other nodes and when it is written to disk. "
+					 "Compressed results are decompressed when they are read, "
+					 "regardless of this setting."),
+		&CompressIntermediateResults,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_adaptive_executor_pool_size",
 		gettext_noop("Sets the maximum number of connections per worker node used by "
@@ -773,6 +1055,42 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_prepared_statements_per_connection",
+		gettext_noop("Sets the maximum number of statements the executor prepares "
+					 "on a single worker connection. Setting to 0 disables preparing "
+					 "statements on the workers."),
+		gettext_noop("When enabled, parameterized shard queries of prepared statements "
+					 "are prepared on the worker connection the first time they are "
+					 "sent, and subsequent executions only send the parameter values "
+					 "such that the workers do not need to parse and plan the query "
+					 "again. Statements remain prepared until the connection is "
+					 "closed, so this should not be used when the workers are behind "
+					 "a connection pooler in transaction pooling mode."),
+		&MaxPreparedStatementsPerConnection,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_shared_pool_size",
+		gettext_noop("Sets the maximum number of connections allowed per worker node "
+					 "across all the backends from this node. Setting to -1 disables "
+					 "connections throttling. Setting to 0 makes it auto-adjust, meaning "
+					 "equal to max_connections on the coordinator."),
+		gettext_noop("As a rule of thumb, the value should be at most equal to the "
+					 "max_connections on the remote nodes. The first connection of a "
+					 "backend to a node is always allowed, additional connections of "
+					 "the adaptive executor are only opened while the limit is not "
+					 "reached. The limit can only be set at server start, such that "
+					 "all backends apply the same limit to the shared counters."),
+		&MaxSharedPoolSize,
+		0, -1, INT_MAX,
+		PGC_POSTMASTER,
+		0,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_worker_nodes_tracked",
 		gettext_noop("Sets the maximum number of worker nodes that are tracked."),
@@ -921,6 +1239,40 @@ RegisterCitusConfigVariables(void)
 		0,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_repartitioned_count_distinct",
+		gettext_noop("Computes exact count(distinct) on non-distribution columns "
+					 "by repartitioning rows on the distinct column."),
+		gettext_noop("When enabled, single table queries with count(distinct) on a "
+					 "column other than the distribution column repartition their "
+					 "rows by that column, deduplicate the values on the workers, "
+					 "and sum the counts of the partitions on the coordinator. "
+					 "Otherwise, all distinct values are pulled to the coordinator. "
+					 "Repartitioning requires the task-tracker executor or "
+					 "citus.enable_repartition_joins."),
+		&EnableRepartitionedCountDistinct,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_repartitioned_group_by",
+		gettext_noop("Finalizes groups on the workers by repartitioning partial "
+					 "aggregates on the group by column."),
+		gettext_noop("When enabled, single table queries that group by columns "
+					 "other than the distribution column hash partition the partial "
+					 "aggregates of the shards on a group by column, finalize the "
+					 "groups of each partition on the workers, and only send final "
+					 "groups to the coordinator. Otherwise, the coordinator merges "
+					 "the partial aggregates of all groups. Repartitioning requires "
+					 "the task-tracker executor or citus.enable_repartition_joins."),
+		&EnableRepartitionedGroupBy,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomEnumVariable(
 		"citus.multi_shard_commit_protocol",
 		gettext_noop("Sets the commit protocol for commands modifying multiple shards."),
@@ -1211,6 +1563,28 @@ RegisterCitusConfigVariables(void)
 }
 
 
+/*
+ * We don't want to allow hedging thresholds below 10ms, since we would then
+ * start almost every read-only task on two placements. However, we define -1
+ * as the value to disable hedged execution.
+ */
+static bool
+ErrorIfNotASuitableHedgingThreshold(int *newval, void **extra, GucSource source)
+{
+	if (*newval < 10 && *newval != -1)
+	{
+		ereport(WARNING, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						  errmsg("citus.hedged_execution_threshold cannot be less "
+								 "than 10ms. To disable hedged execution set the "
+								 "value to -1.")));
+
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * We don't want to allow values less than 1.0. However, we define -1 as the value to disable
  * distributed deadlock checking. Here we enforce our special constraint.
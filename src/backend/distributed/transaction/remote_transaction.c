@@ -58,11 +58,9 @@ void
 StartRemoteTransactionBegin(struct MultiConnection *connection)
 {
 	RemoteTransaction *transaction = &connection->remoteTransaction;
-	StringInfo beginAndSetDistributedTransactionId = makeStringInfo();
-	DistributedTransactionId *distributedTransactionId = NULL;
+	StringInfo beginAndSetDistributedTransactionId = NULL;
 	ListCell *subIdCell = NULL;
 	List *activeSubXacts = NIL;
-	const char *timestamp = NULL;
 
 	Assert(transaction->transactionState == REMOTE_TRANS_INVALID);
 
@@ -71,27 +69,7 @@ StartRemoteTransactionBegin(struct MultiConnection *connection)
 
 	transaction->transactionState = REMOTE_TRANS_STARTING;
 
-	/*
-	 * Explicitly specify READ COMMITTED, the default on the remote
-	 * side might have been changed, and that would cause problematic
-	 * behaviour.
-	 */
-	appendStringInfoString(beginAndSetDistributedTransactionId,
-						   "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED;");
-
-	/*
-	 * Append BEGIN and assign_distributed_transaction_id() statements into a single command
-	 * and send both in one step. The reason is purely performance, we don't want
-	 * seperate roundtrips for these two statements.
-	 */
-	distributedTransactionId = GetCurrentDistributedTransactionId();
-	timestamp = timestamptz_to_str(distributedTransactionId->timestamp);
-	appendStringInfo(beginAndSetDistributedTransactionId,
-					 "SELECT assign_distributed_transaction_id(%d, " UINT64_FORMAT
-					 ", '%s');",
-					 distributedTransactionId->initiatorNodeIdentifier,
-					 distributedTransactionId->transactionNumber,
-					 timestamp);
+	beginAndSetDistributedTransactionId = BeginAndSetDistributedTransactionIdCommand();
 
 	/* append context for in-progress SAVEPOINTs for this transaction */
 	activeSubXacts = ActiveSubXactContexts();
@@ -131,6 +109,43 @@ StartRemoteTransactionBegin(struct MultiConnection *connection)
 }
 
 
+/*
+ * BeginAndSetDistributedTransactionIdCommand returns a command which starts
+ * a transaction block and assigns the current distributed transaction id.
+ */
+StringInfo
+BeginAndSetDistributedTransactionIdCommand(void)
+{
+	StringInfo beginAndSetDistributedTransactionId = makeStringInfo();
+	DistributedTransactionId *distributedTransactionId = NULL;
+	const char *timestamp = NULL;
+
+	/*
+	 * Explicitly specify READ COMMITTED, the default on the remote
+	 * side might have been changed, and that would cause problematic
+	 * behaviour.
+	 */
+	appendStringInfoString(beginAndSetDistributedTransactionId,
+						   "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED;");
+
+	/*
+	 * Append BEGIN and assign_distributed_transaction_id() statements into a single command
+	 * and send both in one step. The reason is purely performance, we don't want
+	 * seperate roundtrips for these two statements.
+	 */
+	distributedTransactionId = GetCurrentDistributedTransactionId();
+	timestamp = timestamptz_to_str(distributedTransactionId->timestamp);
+	appendStringInfo(beginAndSetDistributedTransactionId,
+					 "SELECT assign_distributed_transaction_id(%d, " UINT64_FORMAT
+					 ", '%s');",
+					 distributedTransactionId->initiatorNodeIdentifier,
+					 distributedTransactionId->transactionNumber,
+					 timestamp);
+
+	return beginAndSetDistributedTransactionId;
+}
+
+
 /*
  * FinishRemoteTransactionBegin finishes the work StartRemoteTransactionBegin
  * initiated. It blocks if necessary (i.e. if PQisBusy() would return true).
@@ -23,6 +23,7 @@
 #include "distributed/connection_management.h"
 #include "distributed/hash_helpers.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/local_executor.h"
 #include "distributed/multi_shard_transaction.h"
 #include "distributed/transaction_management.h"
 #include "distributed/placement_connection.h"
@@ -228,6 +229,8 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			dlist_init(&InProgressTransactions);
 			activeSetStmts = NULL;
 			CoordinatedTransactionUses2PC = false;
+			LocalExecutionHappened = false;
+			ResetPrefetchedSubPlanResults();
 
 			UnSetDistributedTransactionId();
 
@@ -281,6 +284,7 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			dlist_init(&InProgressTransactions);
 			activeSetStmts = NULL;
 			CoordinatedTransactionUses2PC = false;
+			LocalExecutionHappened = false;
 			FunctionCallLevel = 0;
 
 			/*
@@ -292,6 +296,7 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			 * citus.max_intermediate_result_size
 			 */
 			SubPlanLevel = 0;
+			ResetPrefetchedSubPlanResults();
 			UnSetDistributedTransactionId();
 			UnsetCitusNoticeLevel();
 			break;
@@ -450,6 +455,7 @@ CoordinatedSubTransactionCallback(SubXactEvent event, SubTransactionId subId,
 			}
 			PopSubXact(subId);
 
+			ForgetSubXactPrefetchedSubPlanResults(subId);
 			UnsetCitusNoticeLevel();
 			break;
 		}
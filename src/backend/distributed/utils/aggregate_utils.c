@@ -0,0 +1,589 @@
+/*-------------------------------------------------------------------------
+ *
+ * aggregate_utils.c
+ *	  Implementation of the aggregates that distribute the execution of
+ *	  user-defined aggregates with combine functions across workers.
+ *
+ * Aggregates that Citus does not know about can still be executed in two
+ * phases if they define a combine function. Workers run worker_partial_agg,
+ * which advances the transition state of the aggregate with its transition
+ * function and returns the state in its text form, skipping the final
+ * function. The coordinator then runs coord_combine_agg over the partial
+ * states, which merges them with the combine function and only applies the
+ * final function at the end. States of type internal are passed through the
+ * serialization and deserialization functions of the aggregate.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "distributed/version_compat.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/regproc.h"
+#include "utils/syscache.h"
+
+
+/*
+ * AggregateState is the transition state of worker_partial_agg and
+ * coord_combine_agg. It holds the transition state of the distributed
+ * aggregate along with what is needed to advance and convert it.
+ */
+typedef struct AggregateState
+{
+	Oid aggregateId;
+
+	/* transition function on workers, combine function on the coordinator */
+	FmgrInfo advanceFunction;
+
+	Oid serializeFunctionId;
+	Oid deserializeFunctionId;
+	Oid finalFunctionId;
+	bool finalFunctionExtra;
+
+	Oid transitionTypeId;
+	int16 transitionTypeLength;
+	bool transitionTypeByValue;
+
+	Datum value;
+	bool valueNull;
+} AggregateState;
+
+
+static AggregateState * CreateAggregateState(FunctionCallInfo fcinfo, Oid aggregateId,
+											 bool combine);
+static void CheckAggregatePermissions(Oid aggregateId, Form_pg_aggregate aggregateForm);
+static void CheckFunctionPermissions(Oid functionId, Oid userId);
+static void SetAggregateStateValue(FunctionCallInfo fcinfo, AggregateState *state,
+								   Datum newValue, bool newValueNull);
+static void AdvanceAggregateState(FunctionCallInfo fcinfo, AggregateState *state,
+								  Datum argument, bool argumentNull);
+static char * AggregateStateToString(FunctionCallInfo fcinfo, AggregateState *state);
+static Datum AggregateStateFromString(FunctionCallInfo fcinfo, AggregateState *state,
+									  char *stateString);
+static MemoryContext AggregateContext(FunctionCallInfo fcinfo);
+
+
+/* declarations for dynamic loading */
+PG_FUNCTION_INFO_V1(worker_partial_agg_sfunc);
+PG_FUNCTION_INFO_V1(worker_partial_agg_ffunc);
+PG_FUNCTION_INFO_V1(coord_combine_agg_sfunc);
+PG_FUNCTION_INFO_V1(coord_combine_agg_ffunc);
+
+
+/*
+ * worker_partial_agg_sfunc advances the transition state of the aggregate
+ * given by the second argument with the value in the third argument, using
+ * the transition function of the aggregate.
+ */
+Datum
+worker_partial_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	AggregateState *state = NULL;
+
+	if (PG_ARGISNULL(0))
+	{
+		if (PG_ARGISNULL(1))
+		{
+			ereport(ERROR, (errmsg("aggregate to distribute cannot be NULL")));
+		}
+
+		state = CreateAggregateState(fcinfo, PG_GETARG_OID(1), false);
+	}
+	else
+	{
+		state = (AggregateState *) PG_GETARG_POINTER(0);
+	}
+
+	AdvanceAggregateState(fcinfo, state, PG_GETARG_DATUM(2), PG_ARGISNULL(2));
+
+	PG_RETURN_POINTER(state);
+}
+
+
+/*
+ * worker_partial_agg_ffunc returns the transition state of the aggregate in
+ * its text form, without applying the final function of the aggregate.
+ */
+Datum
+worker_partial_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	AggregateState *state = NULL;
+
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	state = (AggregateState *) PG_GETARG_POINTER(0);
+	if (state->valueNull)
+	{
+		PG_RETURN_NULL();
+	}
+
+	PG_RETURN_CSTRING(AggregateStateToString(fcinfo, state));
+}
+
+
+/*
+ * coord_combine_agg_sfunc combines the partial transition state in the third
+ * argument, as returned by worker_partial_agg, into the transition state of
+ * the aggregate given by the second argument, using its combine function.
+ */
+Datum
+coord_combine_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	AggregateState *state = NULL;
+	Datum partialValue = 0;
+	bool partialValueNull = PG_ARGISNULL(2);
+
+	if (PG_ARGISNULL(0))
+	{
+		if (PG_ARGISNULL(1))
+		{
+			ereport(ERROR, (errmsg("aggregate to distribute cannot be NULL")));
+		}
+
+		state = CreateAggregateState(fcinfo, PG_GETARG_OID(1), true);
+	}
+	else
+	{
+		state = (AggregateState *) PG_GETARG_POINTER(0);
+	}
+
+	if (!partialValueNull)
+	{
+		char *partialValueString = PG_GETARG_CSTRING(2);
+
+		partialValue = AggregateStateFromString(fcinfo, state, partialValueString);
+	}
+
+	AdvanceAggregateState(fcinfo, state, partialValue, partialValueNull);
+
+	PG_RETURN_POINTER(state);
+}
+
+
+/*
+ * coord_combine_agg_ffunc applies the final function of the aggregate to the
+ * combined transition state. The last argument is only used to resolve the
+ * return type of the aggregate, and is always NULL.
+ */
+Datum
+coord_combine_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	AggregateState *state = NULL;
+	FmgrInfo finalFunction;
+	int finalArgumentCount = 1;
+	Datum result = 0;
+	LOCAL_FCINFO(finalFcinfo, 2);
+
+	if (PG_ARGISNULL(0))
+	{
+		/* none of the workers returned a state, start from the initial state */
+		if (PG_ARGISNULL(1))
+		{
+			ereport(ERROR, (errmsg("aggregate to distribute cannot be NULL")));
+		}
+
+		state = CreateAggregateState(fcinfo, PG_GETARG_OID(1), true);
+	}
+	else
+	{
+		state = (AggregateState *) PG_GETARG_POINTER(0);
+	}
+
+	if (!OidIsValid(state->finalFunctionId))
+	{
+		if (state->valueNull)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_DATUM(state->value);
+	}
+
+	fmgr_info(state->finalFunctionId, &finalFunction);
+
+	/* extra arguments of the final function are always NULL, as in nodeAgg.c */
+	if (state->finalFunctionExtra)
+	{
+		finalArgumentCount = 2;
+	}
+
+	if (finalFunction.fn_strict && (state->valueNull || state->finalFunctionExtra))
+	{
+		PG_RETURN_NULL();
+	}
+
+	InitFunctionCallInfoData(*finalFcinfo, &finalFunction, finalArgumentCount,
+							 PG_GET_COLLATION(), fcinfo->context, NULL);
+
+	if (state->valueNull)
+	{
+		fcSetArgNull(finalFcinfo, 0);
+	}
+	else
+	{
+		fcSetArg(finalFcinfo, 0, state->value);
+	}
+
+	if (state->finalFunctionExtra)
+	{
+		fcSetArgNull(finalFcinfo, 1);
+	}
+
+	result = FunctionCallInvoke(finalFcinfo);
+	fcinfo->isnull = finalFcinfo->isnull;
+
+	return result;
+}
+
+
+/*
+ * CreateAggregateState looks up the given aggregate and creates a transition
+ * state for it in the aggregate memory context, which holds the initial value
+ * of the aggregate. If combine is true, the state is advanced with the
+ * combine function of the aggregate, and otherwise with its transition
+ * function.
+ */
+static AggregateState *
+CreateAggregateState(FunctionCallInfo fcinfo, Oid aggregateId, bool combine)
+{
+	MemoryContext aggregateContext = AggregateContext(fcinfo);
+	MemoryContext oldContext = NULL;
+	HeapTuple aggregateTuple = NULL;
+	Form_pg_aggregate aggregateForm = NULL;
+	AggregateState *state = NULL;
+	Oid advanceFunctionId = InvalidOid;
+	Datum initialValueDatum = 0;
+	bool initialValueNull = true;
+
+	aggregateTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggregateId));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for aggregate %u", aggregateId)));
+	}
+
+	aggregateForm = (Form_pg_aggregate) GETSTRUCT(aggregateTuple);
+
+	if (!OidIsValid(aggregateForm->aggcombinefn))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("aggregate %s does not have a combine function",
+							   format_procedure(aggregateId))));
+	}
+
+	if (aggregateForm->aggtranstype == INTERNALOID &&
+		(!OidIsValid(aggregateForm->aggserialfn) ||
+		 !OidIsValid(aggregateForm->aggdeserialfn)))
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("aggregate %s does not have serialization functions",
+							   format_procedure(aggregateId))));
+	}
+
+	CheckAggregatePermissions(aggregateId, aggregateForm);
+
+	state = MemoryContextAllocZero(aggregateContext, sizeof(AggregateState));
+	state->aggregateId = aggregateId;
+	state->serializeFunctionId = aggregateForm->aggserialfn;
+	state->deserializeFunctionId = aggregateForm->aggdeserialfn;
+	state->finalFunctionId = aggregateForm->aggfinalfn;
+	state->finalFunctionExtra = aggregateForm->aggfinalextra;
+	state->transitionTypeId = aggregateForm->aggtranstype;
+	get_typlenbyval(state->transitionTypeId, &state->transitionTypeLength,
+					&state->transitionTypeByValue);
+
+	if (combine)
+	{
+		advanceFunctionId = aggregateForm->aggcombinefn;
+	}
+	else
+	{
+		advanceFunctionId = aggregateForm->aggtransfn;
+	}
+
+	fmgr_info_cxt(advanceFunctionId, &state->advanceFunction, aggregateContext);
+
+	initialValueDatum = SysCacheGetAttr(AGGFNOID, aggregateTuple,
+										Anum_pg_aggregate_agginitval,
+										&initialValueNull);
+	if (initialValueNull)
+	{
+		state->valueNull = true;
+	}
+	else
+	{
+		char *initialValueString = TextDatumGetCString(initialValueDatum);
+		Oid typeInputFunctionId = InvalidOid;
+		Oid typeIOParam = InvalidOid;
+
+		getTypeInputInfo(state->transitionTypeId, &typeInputFunctionId, &typeIOParam);
+
+		oldContext = MemoryContextSwitchTo(aggregateContext);
+		state->value = OidInputFunctionCall(typeInputFunctionId, initialValueString,
+											typeIOParam, -1);
+		state->valueNull = false;
+		MemoryContextSwitchTo(oldContext);
+	}
+
+	ReleaseSysCache(aggregateTuple);
+
+	return state;
+}
+
+
+/*
+ * CheckAggregatePermissions checks that the current user can execute the
+ * given aggregate, and that the owner of the aggregate can execute its
+ * support functions, like the executor does for regular aggregates.
+ */
+static void
+CheckAggregatePermissions(Oid aggregateId, Form_pg_aggregate aggregateForm)
+{
+	HeapTuple procedureTuple = NULL;
+	Oid aggregateOwnerId = InvalidOid;
+	AclResult aclResult = pg_proc_aclcheck(aggregateId, GetUserId(), ACL_EXECUTE);
+
+	if (aclResult != ACLCHECK_OK)
+	{
+		aclcheck_error(aclResult, ACLCHECK_OBJECT_AGGREGATE, get_func_name(aggregateId));
+	}
+
+	procedureTuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(aggregateId));
+	if (!HeapTupleIsValid(procedureTuple))
+	{
+		ereport(ERROR, (errmsg("cache lookup failed for function %u", aggregateId)));
+	}
+
+	aggregateOwnerId = ((Form_pg_proc) GETSTRUCT(procedureTuple))->proowner;
+	ReleaseSysCache(procedureTuple);
+
+	CheckFunctionPermissions(aggregateForm->aggtransfn, aggregateOwnerId);
+	CheckFunctionPermissions(aggregateForm->aggcombinefn, aggregateOwnerId);
+	CheckFunctionPermissions(aggregateForm->aggserialfn, aggregateOwnerId);
+	CheckFunctionPermissions(aggregateForm->aggdeserialfn, aggregateOwnerId);
+	CheckFunctionPermissions(aggregateForm->aggfinalfn, aggregateOwnerId);
+}
+
+
+/*
+ * CheckFunctionPermissions errors out if the given function is set and the
+ * given user cannot execute it.
+ */
+static void
+CheckFunctionPermissions(Oid functionId, Oid userId)
+{
+	AclResult aclResult = ACLCHECK_OK;
+
+	if (!OidIsValid(functionId))
+	{
+		return;
+	}
+
+	aclResult = pg_proc_aclcheck(functionId, userId, ACL_EXECUTE);
+	if (aclResult != ACLCHECK_OK)
+	{
+		aclcheck_error(aclResult, ACLCHECK_OBJECT_FUNCTION, get_func_name(functionId));
+	}
+}
+
+
+/*
+ * AdvanceAggregateState calls the transition or combine function of the
+ * aggregate with the current transition state and the given argument, and
+ * stores the result as the new transition state. NULLs are handled in the
+ * same way as the executor does for strict functions: NULL arguments are
+ * skipped, and the first non-NULL argument becomes the initial state if
+ * there is no initial value.
+ */
+static void
+AdvanceAggregateState(FunctionCallInfo fcinfo, AggregateState *state,
+					  Datum argument, bool argumentNull)
+{
+	Datum newValue = 0;
+	LOCAL_FCINFO(advanceFcinfo, 2);
+
+	if (state->advanceFunction.fn_strict)
+	{
+		if (argumentNull)
+		{
+			return;
+		}
+
+		if (state->valueNull)
+		{
+			SetAggregateStateValue(fcinfo, state, argument, false);
+			return;
+		}
+	}
+
+	InitFunctionCallInfoData(*advanceFcinfo, &state->advanceFunction, 2,
+							 PG_GET_COLLATION(), fcinfo->context, NULL);
+
+	if (state->valueNull)
+	{
+		fcSetArgNull(advanceFcinfo, 0);
+	}
+	else
+	{
+		fcSetArg(advanceFcinfo, 0, state->value);
+	}
+
+	if (argumentNull)
+	{
+		fcSetArgNull(advanceFcinfo, 1);
+	}
+	else
+	{
+		fcSetArg(advanceFcinfo, 1, argument);
+	}
+
+	newValue = FunctionCallInvoke(advanceFcinfo);
+
+	SetAggregateStateValue(fcinfo, state, newValue, advanceFcinfo->isnull);
+}
+
+
+/*
+ * SetAggregateStateValue stores the given value as the transition state,
+ * copying it into the aggregate memory context if it is passed by reference
+ * and freeing the previous value.
+ */
+static void
+SetAggregateStateValue(FunctionCallInfo fcinfo, AggregateState *state,
+					   Datum newValue, bool newValueNull)
+{
+	if (!state->transitionTypeByValue && !newValueNull &&
+		(state->valueNull || DatumGetPointer(newValue) != DatumGetPointer(state->value)))
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(AggregateContext(fcinfo));
+
+		newValue = datumCopy(newValue, state->transitionTypeByValue,
+							 state->transitionTypeLength);
+
+		MemoryContextSwitchTo(oldContext);
+
+		if (!state->valueNull)
+		{
+			pfree(DatumGetPointer(state->value));
+		}
+	}
+
+	state->value = newValue;
+	state->valueNull = newValueNull;
+}
+
+
+/*
+ * AggregateStateToString returns the text form of the transition state,
+ * which is the output of the serialization function of the aggregate for
+ * states of type internal.
+ */
+static char *
+AggregateStateToString(FunctionCallInfo fcinfo, AggregateState *state)
+{
+	Oid typeOutputFunctionId = InvalidOid;
+	bool typeIsVarlena = false;
+
+	if (OidIsValid(state->serializeFunctionId))
+	{
+		FmgrInfo serializeFunction;
+		Datum serializedValue = 0;
+		LOCAL_FCINFO(serializeFcinfo, 1);
+
+		fmgr_info(state->serializeFunctionId, &serializeFunction);
+		InitFunctionCallInfoData(*serializeFcinfo, &serializeFunction, 1,
+								 PG_GET_COLLATION(), fcinfo->context, NULL);
+		fcSetArg(serializeFcinfo, 0, state->value);
+
+		serializedValue = FunctionCallInvoke(serializeFcinfo);
+		if (serializeFcinfo->isnull)
+		{
+			ereport(ERROR, (errmsg("serialization function of aggregate %s "
+								   "returned NULL",
+								   format_procedure(state->aggregateId))));
+		}
+
+		return DatumGetCString(DirectFunctionCall1(byteaout, serializedValue));
+	}
+
+	getTypeOutputInfo(state->transitionTypeId, &typeOutputFunctionId, &typeIsVarlena);
+
+	return OidOutputFunctionCall(typeOutputFunctionId, state->value);
+}
+
+
+/*
+ * AggregateStateFromString parses the text form of a transition state as
+ * returned by AggregateStateToString.
+ */
+static Datum
+AggregateStateFromString(FunctionCallInfo fcinfo, AggregateState *state,
+						 char *stateString)
+{
+	Oid typeInputFunctionId = InvalidOid;
+	Oid typeIOParam = InvalidOid;
+
+	if (OidIsValid(state->deserializeFunctionId))
+	{
+		FmgrInfo deserializeFunction;
+		Datum deserializedValue = 0;
+		LOCAL_FCINFO(deserializeFcinfo, 2);
+
+		fmgr_info(state->deserializeFunctionId, &deserializeFunction);
+		InitFunctionCallInfoData(*deserializeFcinfo, &deserializeFunction, 2,
+								 PG_GET_COLLATION(), fcinfo->context, NULL);
+		fcSetArg(deserializeFcinfo, 0,
+				 DirectFunctionCall1(byteain, CStringGetDatum(stateString)));
+
+		/* the second argument only exists to make the function type safe */
+		fcSetArg(deserializeFcinfo, 1, PointerGetDatum(NULL));
+
+		deserializedValue = FunctionCallInvoke(deserializeFcinfo);
+		if (deserializeFcinfo->isnull)
+		{
+			ereport(ERROR, (errmsg("deserialization function of aggregate %s "
+								   "returned NULL",
+								   format_procedure(state->aggregateId))));
+		}
+
+		return deserializedValue;
+	}
+
+	getTypeInputInfo(state->transitionTypeId, &typeInputFunctionId, &typeIOParam);
+
+	return OidInputFunctionCall(typeInputFunctionId, stateString, typeIOParam, -1);
+}
+
+
+/*
+ * AggregateContext returns the memory context in which the transition state
+ * of the aggregate that is being computed lives, and errors out if the
+ * calling function is not used as part of an aggregate.
+ */
+static MemoryContext
+AggregateContext(FunctionCallInfo fcinfo)
+{
+	MemoryContext aggregateContext = NULL;
+
+	if (!AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		ereport(ERROR, (errmsg("%s called in non-aggregate context",
+							   get_func_name(fcinfo->flinfo->fn_oid))));
+	}
+
+	return aggregateContext;
+}
@@ -85,6 +85,7 @@ copyJobInfo(Job *newnode, Job *from)
 	COPY_SCALAR_FIELD(requiresMasterEvaluation);
 	COPY_SCALAR_FIELD(deferredPruning);
 	COPY_NODE_FIELD(partitionKeyValue);
+	COPY_NODE_FIELD(deferredPruningClauseList);
 }
 
 
@@ -130,6 +131,12 @@ CopyNodeDistributedSubPlan(COPYFUNC_ARGS)
 
 	COPY_SCALAR_FIELD(subPlanId);
 	COPY_NODE_FIELD(plan);
+	COPY_NODE_FIELD(nodeGroupIdList);
+	COPY_SCALAR_FIELD(writeLocalFile);
+	COPY_SCALAR_FIELD(sendToAllNodes);
+	COPY_NODE_FIELD(dependedSubPlanIdList);
+	COPY_NODE_FIELD(partitionRelationIdList);
+	COPY_NODE_FIELD(partitionColumnIndexList);
 }
 
 
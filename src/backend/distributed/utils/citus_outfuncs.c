@@ -209,6 +209,12 @@ OutDistributedSubPlan(OUTFUNC_ARGS)
 
 	WRITE_UINT_FIELD(subPlanId);
 	WRITE_NODE_FIELD(plan);
+	WRITE_NODE_FIELD(nodeGroupIdList);
+	WRITE_BOOL_FIELD(writeLocalFile);
+	WRITE_BOOL_FIELD(sendToAllNodes);
+	WRITE_NODE_FIELD(dependedSubPlanIdList);
+	WRITE_NODE_FIELD(partitionRelationIdList);
+	WRITE_NODE_FIELD(partitionColumnIndexList);
 }
 
 
@@ -326,6 +332,7 @@ OutJobFields(StringInfo str, const Job *node)
 	WRITE_BOOL_FIELD(requiresMasterEvaluation);
 	WRITE_BOOL_FIELD(deferredPruning);
 	WRITE_NODE_FIELD(partitionKeyValue);
+	WRITE_NODE_FIELD(deferredPruningClauseList);
 }
 
 
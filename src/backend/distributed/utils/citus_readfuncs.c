@@ -188,6 +188,7 @@ readJobInfo(Job *local_node)
 	READ_BOOL_FIELD(requiresMasterEvaluation);
 	READ_BOOL_FIELD(deferredPruning);
 	READ_NODE_FIELD(partitionKeyValue);
+	READ_NODE_FIELD(deferredPruningClauseList);
 }
 
 
@@ -237,6 +238,12 @@ ReadDistributedSubPlan(READFUNC_ARGS)
 
 	READ_UINT_FIELD(subPlanId);
 	READ_NODE_FIELD(plan);
+	READ_NODE_FIELD(nodeGroupIdList);
+	READ_BOOL_FIELD(writeLocalFile);
+	READ_BOOL_FIELD(sendToAllNodes);
+	READ_NODE_FIELD(dependedSubPlanIdList);
+	READ_NODE_FIELD(partitionRelationIdList);
+	READ_NODE_FIELD(partitionColumnIndexList);
 
 	READ_DONE();
 }
@@ -42,6 +42,8 @@
 #include "distributed/pg_dist_partition.h"
 #include "distributed/pg_dist_shard.h"
 #include "distributed/pg_dist_placement.h"
+#include "distributed/prepared_statement_cache.h"
+#include "distributed/shard_zone_maps.h"
 #include "distributed/shared_library_init.h"
 #include "distributed/shardinterval_utils.h"
 #include "distributed/version_compat.h"
@@ -116,6 +118,10 @@ typedef struct MetadataCacheData
 	Oid distLocalGroupRelationId;
 	Oid distObjectRelationId;
 	Oid distObjectPrimaryKeyIndexId;
+	Oid distZoneMapColumnRelationId;
+	Oid distZoneMapColumnPrimaryKeyIndexId;
+	Oid distShardZoneMapRelationId;
+	Oid distShardZoneMapPrimaryKeyIndexId;
 	Oid distColocationRelationId;
 	Oid distColocationConfigurationIndexId;
 	Oid distColocationColocationidIndexId;
@@ -1256,6 +1262,29 @@ BuildCachedShardList(DistTableCacheEntry *cacheEntry)
 
 	cacheEntry->shardColumnCompareFunction = shardColumnCompareFunction;
 	cacheEntry->shardIntervalCompareFunction = shardIntervalCompareFunction;
+
+	/* load the zone maps of non-partition columns, used for shard pruning */
+	if (cacheEntry->partitionMethod == DISTRIBUTE_BY_APPEND ||
+		cacheEntry->partitionMethod == DISTRIBUTE_BY_RANGE)
+	{
+		MemoryContext zoneMapContext =
+			AllocSetContextCreateExtended(MetadataCacheMemoryContext,
+										  "Zone Map Context",
+										  ALLOCSET_SMALL_MINSIZE,
+										  ALLOCSET_SMALL_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+		cacheEntry->zoneMapContext = zoneMapContext;
+		cacheEntry->zoneMapList =
+			BuildColumnZoneMapList(cacheEntry->relationId, sortedShardIntervalArray,
+								   shardIntervalArrayLength, zoneMapContext);
+
+		if (cacheEntry->zoneMapList == NIL)
+		{
+			MemoryContextDelete(zoneMapContext);
+			cacheEntry->zoneMapContext = NULL;
+		}
+	}
 }
 
 
@@ -1844,6 +1873,52 @@ DistObjectPrimaryKeyIndexId(void)
 }
 
 
+/* return oid of pg_dist_zone_map_column relation */
+Oid
+DistZoneMapColumnRelationId(void)
+{
+	CachedRelationNamespaceLookup("pg_dist_zone_map_column", CitusCatalogNamespaceId(),
+								  &MetadataCache.distZoneMapColumnRelationId);
+
+	return MetadataCache.distZoneMapColumnRelationId;
+}
+
+
+/* return oid of pg_dist_zone_map_column_pkey */
+Oid
+DistZoneMapColumnPrimaryKeyIndexId(void)
+{
+	CachedRelationNamespaceLookup("pg_dist_zone_map_column_pkey",
+								  CitusCatalogNamespaceId(),
+								  &MetadataCache.distZoneMapColumnPrimaryKeyIndexId);
+
+	return MetadataCache.distZoneMapColumnPrimaryKeyIndexId;
+}
+
+
+/* return oid of pg_dist_shard_zone_map relation */
+Oid
+DistShardZoneMapRelationId(void)
+{
+	CachedRelationNamespaceLookup("pg_dist_shard_zone_map", CitusCatalogNamespaceId(),
+								  &MetadataCache.distShardZoneMapRelationId);
+
+	return MetadataCache.distShardZoneMapRelationId;
+}
+
+
+/* return oid of pg_dist_shard_zone_map_pkey */
+Oid
+DistShardZoneMapPrimaryKeyIndexId(void)
+{
+	CachedRelationNamespaceLookup("pg_dist_shard_zone_map_pkey",
+								  CitusCatalogNamespaceId(),
+								  &MetadataCache.distShardZoneMapPrimaryKeyIndexId);
+
+	return MetadataCache.distShardZoneMapPrimaryKeyIndexId;
+}
+
+
 /* return oid of pg_dist_colocation relation */
 Oid
 DistColocationRelationId(void)
@@ -3052,6 +3127,13 @@ ResetDistTableCacheEntry(DistTableCacheEntry *cacheEntry)
 		cacheEntry->partitionColumn = NULL;
 	}
 
+	if (cacheEntry->zoneMapContext != NULL)
+	{
+		MemoryContextDelete(cacheEntry->zoneMapContext);
+		cacheEntry->zoneMapContext = NULL;
+		cacheEntry->zoneMapList = NIL;
+	}
+
 	if (cacheEntry->shardIntervalArrayLength == 0)
 	{
 		return;
@@ -3178,6 +3260,7 @@ InvalidateDistRelationCacheCallback(Datum argument, Oid relationId)
 	if (relationId == InvalidOid)
 	{
 		InvalidateEntireDistCache();
+		InvalidateWorkerPreparedStatements(InvalidOid);
 	}
 	else
 	{
@@ -3190,6 +3273,9 @@ InvalidateDistRelationCacheCallback(Datum argument, Oid relationId)
 		if (foundInCache)
 		{
 			cacheEntry->isValid = false;
+
+			/* the shard queries we prepared might no longer be valid */
+			InvalidateWorkerPreparedStatements(relationId);
 		}
 	}
 
@@ -23,6 +23,9 @@ typedef struct CitusScanState
 	MultiExecutorType executorType;   /* distributed executor type */
 	bool finishedRemoteScan;          /* flag to check if remote scan is finished */
 	Tuplestorestate *tuplestorestate; /* tuple store to store distributed results */
+
+	/* in-progress adaptive execution whose results are streamed, if any */
+	struct DistributedExecution *streamingExecution;
 } CitusScanState;
 
 
@@ -44,7 +44,14 @@ enum MultiConnectionMode
 	FOR_DML = 1 << 2,
 
 	/* open a connection per (co-located set of) placement(s) */
-	CONNECTION_PER_PLACEMENT = 1 << 3
+	CONNECTION_PER_PLACEMENT = 1 << 3,
+
+	/*
+	 * The connection is not required to make progress, e.g. an additional
+	 * connection of the adaptive executor. If citus.max_shared_pool_size is
+	 * reached for the node, no connection is established and NULL is returned.
+	 */
+	OPTIONAL_CONNECTION = 1 << 4
 };
 
 typedef enum MultiConnectionState
@@ -102,6 +109,15 @@ typedef struct MultiConnection
 
 	/* number of bytes sent to PQputCopyData() since last flush */
 	uint64 copyBytesWrittenSinceLastFlush;
+
+	/* whether the connection is counted in the shared connection stats */
+	bool sharedCounterIncremented;
+
+	/* statements prepared on this connection, see prepared_statement_cache.c */
+	MemoryContext preparedStatementContext;
+	HTAB *preparedStatementHash;
+	List *invalidatedStatementNameList;
+	uint32 preparedStatementCount;
 } MultiConnection;
 
 
@@ -160,6 +176,7 @@ extern struct MemoryContextData *ConnectionContext;
 
 extern void AfterXactConnectionHandling(bool isCommit);
 extern void InitializeConnectionManagement(void);
+extern void RegisterConnectionCleanup(void);
 
 extern void InitConnParams(void);
 extern void ResetConnParams(void);
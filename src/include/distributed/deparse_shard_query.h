@@ -22,6 +22,11 @@
 
 extern void RebuildQueryStrings(Query *originalQuery, List *taskList);
 extern bool UpdateRelationToShardNames(Node *node, List *relationShardList);
+extern bool ShardQueryStringIsTemplate(Query *shardQuery, char *queryString,
+									   List *relationShardList);
+extern char * InstantiateShardQueryTemplate(char *templateQueryString,
+											List *templateRelationShardList,
+											List *relationShardList);
 
 
 #endif /* DEPARSE_SHARD_QUERY_H */
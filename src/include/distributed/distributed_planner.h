@@ -99,11 +99,16 @@ typedef struct RelationRowLock
 } RelationRowLock;
 
 
+/* config variable */
+extern bool EnableGenericDistributedPlans;
+
+
 extern PlannedStmt * distributed_planner(Query *parse, int cursorOptions,
 										 ParamListInfo boundParams);
 extern List * ExtractRangeTableEntryList(Query *query);
 extern bool NeedsDistributedPlanning(Query *query);
 extern struct DistributedPlan * GetDistributedPlan(CustomScan *node);
+extern CustomScan * FindCitusCustomScan(Plan *plan);
 extern void multi_relation_restriction_hook(PlannerInfo *root, RelOptInfo *relOptInfo,
 											Index index, RangeTblEntry *rte);
 extern void multi_join_restriction_hook(PlannerInfo *root,
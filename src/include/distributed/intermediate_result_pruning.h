@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * intermediate_result_pruning.h
+ *	  Functions for determining which nodes read the intermediate results
+ *	  of subplans.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef INTERMEDIATE_RESULT_PRUNING_H
+#define INTERMEDIATE_RESULT_PRUNING_H
+
+#include "distributed/multi_physical_planner.h"
+#include "nodes/pg_list.h"
+
+
+/*
+ * PartitionedResultRead describes a read of an intermediate result whose
+ * rows can only join with rows of the shard that a task reads, because
+ * the column at partitionColumnIndex equals the distribution column of the
+ * hash-distributed relation. Such tasks only need to read the partition of
+ * the result that corresponds to their shard.
+ */
+typedef struct PartitionedResultRead
+{
+	char *resultId;
+	int partitionColumnIndex;
+	Oid relationId;
+} PartitionedResultRead;
+
+
+/* Config variables managed via guc.c */
+extern bool LogIntermediateResults;
+extern bool EnablePartitionedIntermediateResults;
+
+
+extern void RecordSubPlanReaders(DistributedPlan *distributedPlan);
+extern List * SubPlanDestinationNodeList(DistributedSubPlan *subPlan,
+										 List *workerNodeList);
+extern List * PartitionedResultReadList(Query *query);
+extern PartitionedResultRead * FindPartitionedResultRead(List *partitionedReadList,
+														 char *resultId);
+extern char * PartitionedResultPrefix(char *resultId, Oid relationId,
+									  int partitionColumnIndex);
+extern void UpdateResultReadsToPartitionNames(Query *query, List *partitionedReadList,
+											  int shardIndex);
+
+#endif   /* INTERMEDIATE_RESULT_PRUNING_H */
@@ -13,6 +13,7 @@
 
 
 #include "fmgr.h"
+#include "lib/stringinfo.h"
 
 #include "distributed/commands/multi_copy.h"
 #include "nodes/execnodes.h"
@@ -21,12 +22,42 @@
 #include "utils/palloc.h"
 
 
+/*
+ * IntermediateResultPiece describes a part of an intermediate result that is
+ * stored as a separate result on the node that produced it.
+ */
+typedef struct IntermediateResultPiece
+{
+	char *pieceId;
+	char *nodeName;
+	int nodePort;
+} IntermediateResultPiece;
+
+
+/* Config variables managed via guc.c */
+extern bool CompressIntermediateResults;
+
+
 extern DestReceiver * CreateRemoteFileDestReceiver(char *resultId, EState *executorState,
 												   List *initialNodeList, bool
 												   writeLocalFile);
+extern DestReceiver * CreateShardPartitionedDestReceiver(char *resultPrefix,
+														 EState *executorState,
+														 Oid relationId,
+														 int partitionColumnIndex,
+														 List *partitionNodeListList);
+extern DestReceiver * CreateTeeDestReceiver(List *destReceiverList);
 extern void ReceiveQueryResultViaCopy(const char *resultId);
+extern void SendQueryResultViaCopy(const char *resultId);
+extern void FetchIntermediateResultPieces(char *resultId, List *pieceList,
+										  List *nodeList, bool writeLocalFile);
+extern StringInfo FetchIntermediateResultPiecesCommand(char *resultId,
+													  List *pieceList);
+extern List * StartIntermediateResultCommands(List *nodeList, List *commandList);
+extern void FinishIntermediateResultCommands(List *connectionList);
 extern void RemoveIntermediateResultsDirectory(void);
 extern int64 IntermediateResultSize(char *resultId);
+extern char * PartitionedResultId(char *resultPrefix, int partitionIndex);
 
 
 #endif /* INTERMEDIATE_RESULTS_H */
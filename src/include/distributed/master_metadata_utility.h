@@ -93,6 +93,7 @@ extern int ReplicationModel;
 extern Datum citus_table_size(PG_FUNCTION_ARGS);
 extern Datum citus_total_relation_size(PG_FUNCTION_ARGS);
 extern Datum citus_relation_size(PG_FUNCTION_ARGS);
+extern uint64 DistributedTableSizeEstimate(Oid relationId);
 
 /* Function declarations to read shard and shard placement data */
 extern uint32 TableShardReplicationFactor(Oid relationId);
@@ -103,6 +104,7 @@ extern void CopyShardInterval(ShardInterval *srcInterval, ShardInterval *destInt
 extern void CopyShardPlacement(ShardPlacement *srcPlacement,
 							   ShardPlacement *destPlacement);
 extern uint64 ShardLength(uint64 shardId);
+extern uint64 TableShardLength(Oid relationId);
 extern bool NodeGroupHasShardPlacements(int32 groupId,
 										bool onlyConsiderActivePlacements);
 extern List * FinalizedShardPlacementList(uint64 shardId);
@@ -131,6 +133,7 @@ extern void CreateDistributedTable(Oid relationId, Var *distributionColumn,
 								   char distributionMethod, char *colocateWithTableName,
 								   bool viaDeprecatedAPI);
 extern void CreateTruncateTrigger(Oid relationId);
+extern char LookupDistributionMethod(Oid distributionMethodOid);
 
 extern void EnsureDependenciesExistsOnAllNodes(const ObjectAddress *target);
 extern void ReplicateAllDependenciesToNode(const char *nodeName, int nodePort);
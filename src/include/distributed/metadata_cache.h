@@ -85,6 +85,10 @@ typedef struct
 	/* pg_dist_placement metadata */
 	GroupShardPlacement **arrayOfPlacementArrays;
 	int *arrayOfPlacementArrayLengths;
+
+	/* citus.pg_dist_shard_zone_map metadata, only for append and range tables */
+	List *zoneMapList;
+	MemoryContext zoneMapContext;
 } DistTableCacheEntry;
 
 
@@ -134,6 +138,8 @@ extern Oid DistPlacementRelationId(void);
 extern Oid DistNodeRelationId(void);
 extern Oid DistLocalGroupIdRelationId(void);
 extern Oid DistObjectRelationId(void);
+extern Oid DistZoneMapColumnRelationId(void);
+extern Oid DistShardZoneMapRelationId(void);
 
 /* index oids */
 extern Oid DistNodeNodeIdIndexId(void);
@@ -148,6 +154,8 @@ extern Oid DistTransactionGroupIndexId(void);
 extern Oid DistTransactionRecordIndexId(void);
 extern Oid DistPlacementGroupidIndexId(void);
 extern Oid DistObjectPrimaryKeyIndexId(void);
+extern Oid DistZoneMapColumnPrimaryKeyIndexId(void);
+extern Oid DistShardZoneMapPrimaryKeyIndexId(void);
 
 /* type oids */
 extern Oid CitusCopyFormatTypeId(void);
@@ -10,6 +10,7 @@
 #ifndef MULTI_EXECUTOR_H
 #define MULTI_EXECUTOR_H
 
+#include "commands/copy.h"
 #include "executor/execdesc.h"
 #include "nodes/parsenodes.h"
 #include "nodes/execnodes.h"
@@ -32,16 +33,29 @@ extern bool WritableStandbyCoordinator;
 extern bool ForceMaxQueryParallelization;
 extern int MaxAdaptiveExecutorPoolSize;
 extern int ExecutorSlowStartInterval;
+extern bool EnableBinaryProtocol;
+extern bool LogTaskExecution;
+extern bool EnableStreamingExecution;
+extern int HedgedExecutionThreshold;
+extern bool EnableSizeAwareScheduling;
+extern int MaxPipelinedTasksPerConnection;
+extern bool EnableLatencyAwarePoolSizing;
 
 
 extern void CitusExecutorStart(QueryDesc *queryDesc, int eflags);
 extern void CitusExecutorRun(QueryDesc *queryDesc, ScanDirection direction, uint64 count,
 							 bool execute_once);
 extern TupleTableSlot * AdaptiveExecutor(CustomScanState *node);
+extern TupleTableSlot * ReturnTupleFromStreamingExecution(CitusScanState *scanState);
+extern void CancelStreamingExecution(CitusScanState *scanState);
 extern uint64 ExecuteTaskListExtended(RowModifyLevel modLevel, List *taskList,
 									  TupleDesc tupleDescriptor,
 									  Tuplestorestate *tupleStore,
 									  bool hasReturning, int targetPoolSize);
+extern void ExecuteTaskListsIntoTupleStores(List *taskListList,
+											List *tupleDescriptorList,
+											List *tupleStoreList);
+extern int64 MasterQueryRowLimit(Query *masterQuery);
 extern void ExecuteUtilityTaskListWithoutResults(List *taskList);
 extern uint64 ExecuteTaskList(RowModifyLevel modLevel, List *taskList, int
 							  targetPoolSize);
@@ -50,7 +64,11 @@ extern TupleTableSlot * ReturnTupleFromTuplestore(CitusScanState *scanState);
 extern void LoadTuplesIntoTupleStore(CitusScanState *citusScanState, Job *workerJob);
 extern void ReadFileIntoTupleStore(char *fileName, char *copyFormat, TupleDesc
 								   tupleDescriptor, Tuplestorestate *tupstore);
-extern Query * ParseQueryString(const char *queryString);
+extern void ReadCopyDataIntoTupleStore(char *fileName,
+									   copy_data_source_cb dataSourceCallback,
+									   char *copyFormat, TupleDesc tupleDescriptor,
+									   Tuplestorestate *tupstore);
+extern Query * ParseQueryString(const char *queryString, Oid *paramOids, int numParams);
 extern void ExecuteQueryStringIntoDestReceiver(const char *queryString, ParamListInfo
 											   params,
 											   DestReceiver *dest);
@@ -44,6 +44,10 @@
 #define TOPN_ADD_AGGREGATE_NAME "topn_add_agg"
 #define TOPN_UNION_AGGREGATE_NAME "topn_union_agg"
 
+/* Definitions related to user-defined aggregates with combine functions */
+#define WORKER_PARTIAL_AGGREGATE_NAME "worker_partial_agg"
+#define COORD_COMBINE_AGGREGATE_NAME "coord_combine_agg"
+
 
 /*
  * AggregateType represents an aggregate function's type, where the function is
@@ -52,7 +56,8 @@
  *
  * Please note that the order of values in this enumeration is tied to the order
  * of elements in the following AggregateNames array. This order needs to be
- * preserved.
+ * preserved. AGGREGATE_CUSTOM comes last and has no name, since it covers all
+ * other aggregates that have a combine function.
  */
 typedef enum
 {
@@ -75,7 +80,8 @@ typedef enum
 	AGGREGATE_HLL_ADD = 16,
 	AGGREGATE_HLL_UNION = 17,
 	AGGREGATE_TOPN_ADD_AGG = 18,
-	AGGREGATE_TOPN_UNION_AGG = 19
+	AGGREGATE_TOPN_UNION_AGG = 19,
+	AGGREGATE_CUSTOM = 20
 } AggregateType;
 
 
@@ -181,6 +181,11 @@ typedef struct MultiExtendedOp
 } MultiExtendedOp;
 
 
+/* Config variables managed via guc.c */
+extern bool EnableRepartitionedCountDistinct;
+extern bool EnableRepartitionedGroupBy;
+
+
 /* Function declarations for building logical plans */
 extern MultiTreeRoot * MultiLogicalPlanCreate(Query *originalQuery, Query *queryTree,
 											  PlannerRestrictionContext *
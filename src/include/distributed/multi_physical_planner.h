@@ -136,6 +136,7 @@ typedef struct Job
 	bool requiresMasterEvaluation; /* only applies to modify jobs */
 	bool deferredPruning;
 	Const *partitionKeyValue;
+	List *deferredPruningClauseList; /* only applies to generic select jobs */
 } Job;
 
 
@@ -315,6 +316,26 @@ typedef struct DistributedSubPlan
 
 	uint32 subPlanId;
 	PlannedStmt *plan;
+
+	/* groups of the nodes that read the result, see RecordSubPlanReaders */
+	List *nodeGroupIdList;
+
+	/* whether the coordinator reads the result from a local file */
+	bool writeLocalFile;
+
+	/* whether the readers are only known during execution */
+	bool sendToAllNodes;
+
+	/* ids of the earlier subplans whose results this subplan reads */
+	List *dependedSubPlanIdList;
+
+	/*
+	 * Partitionings in which tasks read the result, each along the shards of
+	 * the relation in partitionRelationIdList by the column at the same
+	 * position in partitionColumnIndexList, see PartitionedResultReadList.
+	 */
+	List *partitionRelationIdList;
+	List *partitionColumnIndexList;
 } DistributedSubPlan;
 
 
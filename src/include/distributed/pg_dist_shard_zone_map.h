@@ -0,0 +1,78 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_dist_shard_zone_map.h
+ *	  definition of the relations that hold per-shard minimum and maximum
+ *	  values of non-partition columns (citus.pg_dist_zone_map_column and
+ *	  citus.pg_dist_shard_zone_map).
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_DIST_SHARD_ZONE_MAP_H
+#define PG_DIST_SHARD_ZONE_MAP_H
+
+/* ----------------
+ *		pg_dist_zone_map_column definition.
+ * ----------------
+ */
+typedef struct FormData_pg_dist_zone_map_column
+{
+	Oid logicalrelid;         /* logical relation id; references pg_class oid */
+	int16 attnum;             /* column for which zone maps are kept */
+	Oid atttypid;             /* type of the column when the zone maps were added */
+} FormData_pg_dist_zone_map_column;
+
+/* ----------------
+ *      Form_pg_dist_zone_map_column corresponds to a pointer to a tuple with
+ *      the format of pg_dist_zone_map_column relation.
+ * ----------------
+ */
+typedef FormData_pg_dist_zone_map_column *Form_pg_dist_zone_map_column;
+
+/* ----------------
+ *      compiler constants for pg_dist_zone_map_column
+ * ----------------
+ */
+#define Natts_pg_dist_zone_map_column 3
+#define Anum_pg_dist_zone_map_column_logicalrelid 1
+#define Anum_pg_dist_zone_map_column_attnum 2
+#define Anum_pg_dist_zone_map_column_atttypid 3
+
+
+/* ----------------
+ *		pg_dist_shard_zone_map definition.
+ * ----------------
+ */
+typedef struct FormData_pg_dist_shard_zone_map
+{
+	int64 shardid;            /* shard the values were collected for */
+	int16 attnum;             /* column the values were collected for */
+#ifdef CATALOG_VARLEN           /* variable-length fields start here */
+	text minvalue;            /* column's minimum value in shard, NULL if none */
+	text maxvalue;            /* column's maximum value in shard, NULL if none */
+	int64 nullcount;          /* number of NULL values of the column in shard */
+#endif
+} FormData_pg_dist_shard_zone_map;
+
+/* ----------------
+ *      Form_pg_dist_shard_zone_map corresponds to a pointer to a tuple with
+ *      the format of pg_dist_shard_zone_map relation.
+ * ----------------
+ */
+typedef FormData_pg_dist_shard_zone_map *Form_pg_dist_shard_zone_map;
+
+/* ----------------
+ *      compiler constants for pg_dist_shard_zone_map
+ * ----------------
+ */
+#define Natts_pg_dist_shard_zone_map 5
+#define Anum_pg_dist_shard_zone_map_shardid 1
+#define Anum_pg_dist_shard_zone_map_attnum 2
+#define Anum_pg_dist_shard_zone_map_minvalue 3
+#define Anum_pg_dist_shard_zone_map_maxvalue 4
+#define Anum_pg_dist_shard_zone_map_nullcount 5
+
+
+#endif   /* PG_DIST_SHARD_ZONE_MAP_H */
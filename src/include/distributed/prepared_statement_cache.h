@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * prepared_statement_cache.h
+ *   Tracking of the statements that are prepared on worker connections.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PREPARED_STATEMENT_CACHE_H
+#define PREPARED_STATEMENT_CACHE_H
+
+#include "distributed/connection_management.h"
+
+/* config variable */
+extern int MaxPreparedStatementsPerConnection;
+
+extern char * LookupPreparedStatement(MultiConnection *connection, const char *command,
+									  int parameterCount, const Oid *parameterTypes);
+extern bool CanPrepareStatement(MultiConnection *connection);
+extern char * NewPreparedStatementName(MultiConnection *connection);
+extern void RememberPreparedStatement(MultiConnection *connection,
+									  const char *statementName, const char *command,
+									  int parameterCount, const Oid *parameterTypes,
+									  List *relationIdList);
+extern void ForgetPreparedStatements(MultiConnection *connection);
+extern char * DeallocateInvalidatedStatementsCommand(MultiConnection *connection);
+extern void InvalidateWorkerPreparedStatements(Oid relationId);
+
+#endif /* PREPARED_STATEMENT_CACHE_H */
@@ -33,7 +33,12 @@ typedef struct ColocatedJoinChecker
 extern ColocatedJoinChecker CreateColocatedJoinChecker(Query *subquery,
 													   PlannerRestrictionContext *
 													   restrictionContext);
+extern ColocatedJoinChecker CreateColocatedJoinCheckerForAnchor(Query *subquery,
+																RangeTblEntry *anchorRte,
+																PlannerRestrictionContext *
+																restrictionContext);
 extern bool SubqueryColocated(Query *subquery, ColocatedJoinChecker *context);
+extern Query * WrapRteRelationIntoSubquery(RangeTblEntry *rteRelation);
 
 
 #endif /* QUERY_COLOCATION_CHECKER_H */
@@ -26,6 +26,7 @@ extern bool ShouldUseSubqueryPushDown(Query *originalQuery, Query *rewrittenQuer
 extern bool JoinTreeContainsSubquery(Query *query);
 extern bool HasEmptyJoinTree(Query *query);
 extern bool WhereClauseContainsSubquery(Query *query);
+extern bool IsOuterJoinExpr(Node *node);
 extern bool SafeToPushdownWindowFunction(Query *query, StringInfo *errorDetail);
 extern MultiNode * SubqueryMultiNodeTree(Query *originalQuery,
 										 Query *queryTree,
@@ -22,6 +22,9 @@
 #endif
 
 
+extern int BroadcastJoinThreshold;
+
+
 extern List * GenerateSubplansForSubqueriesAndCTEs(uint64 planId, Query *originalQuery,
 												   PlannerRestrictionContext *
 												   plannerRestrictionContext);
@@ -14,6 +14,7 @@
 #include "libpq-fe.h"
 #include "nodes/pg_list.h"
 #include "lib/ilist.h"
+#include "lib/stringinfo.h"
 
 
 /* forward declare, to avoid recursive includes */
@@ -96,6 +97,7 @@ extern bool ParsePreparedTransactionName(char *preparedTransactionName, int32 *g
 
 /* change an individual remote transaction's state */
 extern void StartRemoteTransactionBegin(struct MultiConnection *connection);
+extern StringInfo BeginAndSetDistributedTransactionIdCommand(void);
 extern void FinishRemoteTransactionBegin(struct MultiConnection *connection);
 extern void RemoteTransactionBegin(struct MultiConnection *connection);
 extern void RemoteTransactionListBegin(List *connectionList);
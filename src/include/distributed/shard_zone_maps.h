@@ -0,0 +1,76 @@
+/*-------------------------------------------------------------------------
+ *
+ * shard_zone_maps.h
+ *	  Per-shard minimum and maximum values of non-partition columns, used
+ *	  to prune shards of append- and range-distributed tables.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SHARD_ZONE_MAPS_H
+#define SHARD_ZONE_MAPS_H
+
+#include "distributed/master_metadata_utility.h"
+#include "distributed/metadata_cache.h"
+#include "fmgr.h"
+#include "nodes/pg_list.h"
+
+
+/* column of a distributed table for which zone maps are kept */
+typedef struct ZoneMapColumn
+{
+	AttrNumber attributeNumber;
+	Oid columnTypeId;
+} ZoneMapColumn;
+
+
+/* zone map of a column in a single shard, as stored in pg_dist_shard_zone_map */
+typedef struct ShardZoneMap
+{
+	AttrNumber attributeNumber;
+	text *minValue;             /* NULL if the column only has NULL values */
+	text *maxValue;             /* NULL if the column only has NULL values */
+	int64 nullCount;
+} ShardZoneMap;
+
+
+/*
+ * ColumnZoneMap holds the zone maps of a column for all shards of a table
+ * in the metadata cache. The arrays are indexed by the shard index of the
+ * shards in DistTableCacheEntry->sortedShardIntervalArray.
+ */
+typedef struct ColumnZoneMap
+{
+	AttrNumber attributeNumber;
+	Oid columnTypeId;
+	Oid columnCollation;
+	Oid operatorFamily;         /* default btree operator family of the type */
+	Oid operatorClassInputType; /* input type of the default btree operator class */
+	FmgrInfo *compareFunction;  /* btree comparison function of the type */
+
+	int shardCount;
+	bool *zoneMapExists;        /* false if the shard's values are unknown */
+	bool *valuesExist;          /* false if the shard only has NULL values */
+	Datum *minValues;
+	Datum *maxValues;
+	int64 *nullCounts;
+} ColumnZoneMap;
+
+
+extern List * ZoneMapColumnList(Oid relationId);
+extern List * WorkerShardZoneMaps(ShardPlacement *placement, Oid relationId,
+								  char *shardName, List *zoneMapColumnList);
+extern void InsertShardZoneMapRow(uint64 shardId, ShardZoneMap *shardZoneMap);
+extern void DeleteShardZoneMapRows(uint64 shardId);
+extern void DeleteZoneMapColumnRows(Oid relationId);
+extern void InvalidateShardZoneMaps(Oid relationId);
+extern List * BuildColumnZoneMapList(Oid relationId,
+									 ShardInterval **sortedShardIntervalArray,
+									 int shardCount, MemoryContext zoneMapContext);
+extern List * PruneShardsWithZoneMaps(DistTableCacheEntry *cacheEntry,
+									  Index rangeTableId, List *whereClauseList,
+									  List *shardIntervalList);
+
+#endif   /* SHARD_ZONE_MAPS_H */
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * shared_connection_stats.h
+ *   Central management of the number of connections that all backends
+ *   of the node open to the other nodes.
+ *
+ * Copyright (c) 2019, Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SHARED_CONNECTION_STATS_H
+#define SHARED_CONNECTION_STATS_H
+
+/* disables the shared connection budget */
+#define DISABLE_CONNECTION_THROTTLING -1
+
+/*
+ * NodeLatencyStats contains the average duration of tasks and of establishing
+ * connections on a node in milliseconds, 0 if not known.
+ */
+typedef struct NodeLatencyStats
+{
+	double taskDurationMs;
+	double connectionEstablishmentMs;
+} NodeLatencyStats;
+
+/* config variable */
+extern int MaxSharedPoolSize;
+
+extern void InitializeSharedConnectionStats(void);
+extern int GetMaxSharedPoolSize(void);
+extern bool TryToIncrementSharedConnectionCounter(const char *hostname, int port);
+extern void IncrementSharedConnectionCounter(const char *hostname, int port);
+extern void DecrementSharedConnectionCounter(const char *hostname, int port);
+extern void UpdateNodeLatencyStats(const char *hostname, int port,
+								   NodeLatencyStats *latencyStats);
+extern bool GetNodeLatencyStats(const char *hostname, int port,
+								NodeLatencyStats *latencyStats);
+
+#endif /* SHARED_CONNECTION_STATS_H */
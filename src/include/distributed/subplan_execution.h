@@ -13,11 +13,17 @@
 
 
 #include "distributed/multi_physical_planner.h"
+#include "utils/tuplestore.h"
 
 extern int MaxIntermediateResult;
 extern int SubPlanLevel;
+extern bool EnableParallelSubPlanExecution;
+extern bool EnableWorkerToWorkerIntermediateResults;
 
 extern void ExecuteSubPlans(DistributedPlan *distributedPlan);
+extern Tuplestorestate * TakePrefetchedSubPlanResult(DistributedPlan *distributedPlan);
+extern void ResetPrefetchedSubPlanResults(void);
+extern void ForgetSubXactPrefetchedSubPlanResults(SubTransactionId subId);
 
 
 #endif /* SUBPLAN_EXECUTION_H */
@@ -61,6 +61,8 @@
 #define ACLCHECK_OBJECT_SCHEMA ACL_KIND_NAMESPACE
 #define ACLCHECK_OBJECT_INDEX ACL_KIND_CLASS
 #define ACLCHECK_OBJECT_SEQUENCE ACL_KIND_CLASS
+#define ACLCHECK_OBJECT_AGGREGATE ACL_KIND_PROC
+#define ACLCHECK_OBJECT_FUNCTION ACL_KIND_PROC
 
 
 static inline int
@@ -181,6 +183,8 @@ get_expr_result_tupdesc(Node *expr, bool noError)
 #define ACLCHECK_OBJECT_SCHEMA OBJECT_SCHEMA
 #define ACLCHECK_OBJECT_INDEX OBJECT_INDEX
 #define ACLCHECK_OBJECT_SEQUENCE OBJECT_SEQUENCE
+#define ACLCHECK_OBJECT_AGGREGATE OBJECT_AGGREGATE
+#define ACLCHECK_OBJECT_FUNCTION OBJECT_FUNCTION
 
 
 #define ConstraintRelidIndexId ConstraintRelidTypidNameIndexId
@@ -256,6 +260,9 @@ RangeVarGetRelidInternal(const RangeVar *relation, LOCKMODE lockmode, uint32 fla
 #define GetSysCacheOid2Compat GetSysCacheOid2
 #define GetSysCacheOid3Compat GetSysCacheOid3
 #define GetSysCacheOid4Compat GetSysCacheOid4
+#define ExecTypeFromTLCompat ExecTypeFromTL
+#define PglzDecompressCompat(source, slen, dest, rawsize) \
+	pglz_decompress(source, slen, dest, rawsize, true)
 
 #define fcSetArg(fc, n, argval) \
 	(((fc)->args[n].isnull = false), ((fc)->args[n].value = (argval)))
@@ -323,6 +330,10 @@ FileCompatFromFileStart(File fileDesc)
 	GetSysCacheOid3(cacheId, key1, key2, key3)
 #define GetSysCacheOid4Compat(cacheId, oidcol, key1, key2, key3, key4) \
 	GetSysCacheOid4(cacheId, key1, key2, key3, key4)
+#define ExecTypeFromTLCompat(targetList) \
+	ExecTypeFromTL(targetList, false)
+#define PglzDecompressCompat(source, slen, dest, rawsize) \
+	pglz_decompress(source, slen, dest, rawsize)
 
 #define LOCAL_FCINFO(name, nargs) \
 	FunctionCallInfoData name ## data; \
@@ -34,4 +34,166 @@ SELECT sum(result::bigint) FROM run_command_on_workers($$
 $$);
 END;
 
+-- results are the same when they are transferred in binary format
+SET citus.enable_binary_protocol TO on;
+SET citus.log_task_execution TO on;
+SET client_min_messages TO DEBUG1;
+SELECT x, y * 1.5 AS n, ARRAY[x, y] AS a, 'row ' || x AS t FROM test ORDER BY x;
+SELECT count(*) FROM test WHERE x = 3;
+RESET client_min_messages;
+RESET citus.log_task_execution;
+RESET citus.enable_binary_protocol;
+
+-- results can be returned while the execution is in progress
+SET citus.enable_streaming_execution TO on;
+SELECT * FROM test ORDER BY x;
+SELECT count(*) FROM (SELECT x FROM test LIMIT 1) t;
+
+-- the connections of cancelled tasks are not reused
+SELECT count(*) FROM test;
+RESET citus.enable_streaming_execution;
+
+-- remaining tasks are cancelled once there are enough rows for the LIMIT
+SELECT count(*) FROM (SELECT x FROM test LIMIT 1) t;
+SELECT count(*) FROM (SELECT x FROM test LIMIT 1 OFFSET 1) t;
+SELECT count(*) FROM (SELECT x FROM test LIMIT 0) t;
+SELECT count(*) FROM test;
+
+-- slow tasks on replicated tables are also started on the other placement
+SET citus.shard_replication_factor TO 2;
+CREATE TABLE replicated_test (x int, y int);
+SELECT create_distributed_table('replicated_test','x');
+INSERT INTO replicated_test SELECT i, i * 2 FROM generate_series(1,10) i;
+
+-- thresholds below 10ms are not allowed
+SET citus.hedged_execution_threshold TO 0;
+SET citus.hedged_execution_threshold TO 10;
+SELECT * FROM replicated_test WHERE x < 4 ORDER BY x;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM replicated_test) t;
+SELECT count(*), sum(y) FROM replicated_test;
+-- connections of cancelled placement executions are not used for the next tasks
+SET citus.max_adaptive_executor_pool_size TO 1;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM replicated_test) t;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM replicated_test) t;
+SELECT * FROM replicated_test WHERE x < 4 ORDER BY x;
+RESET citus.max_adaptive_executor_pool_size;
+RESET citus.hedged_execution_threshold;
+
+-- tasks on large shards are started first, results are the same
+INSERT INTO replicated_test SELECT 2, 4 FROM generate_series(1, 1000);
+SET citus.enable_size_aware_scheduling TO on;
+SELECT count(*) FROM (
+  SELECT master_update_shard_statistics(shardid) FROM pg_dist_shard
+  WHERE logicalrelid IN ('test'::regclass, 'replicated_test'::regclass)) s;
+SELECT * FROM test ORDER BY x;
+SET citus.log_task_execution TO on;
+SET client_min_messages TO DEBUG1;
+SELECT count(*), sum(y) FROM replicated_test;
+RESET client_min_messages;
+RESET citus.log_task_execution;
+SELECT count(*) FROM test a JOIN test b USING (x);
+RESET citus.enable_size_aware_scheduling;
+DROP TABLE replicated_test;
+
+-- parameterized shard queries are prepared on the worker connections
+SET citus.max_prepared_statements_per_connection TO 10;
+PREPARE count_y(int) AS SELECT count(*) FROM test WHERE y = $1;
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(3);
+PREPARE select_y(int) AS SELECT y FROM test WHERE x = $1;
+EXECUTE select_y(1);
+EXECUTE select_y(1);
+EXECUTE select_y(1);
+EXECUTE select_y(1);
+EXECUTE select_y(1);
+EXECUTE select_y(1);
+EXECUTE select_y(3);
+-- statements are prepared again after DDL
+ALTER TABLE test ALTER COLUMN y TYPE bigint;
+EXECUTE select_y(1);
+EXECUTE select_y(3);
+-- statements that were prepared before DDL are deallocated on the workers
+SELECT run_command_on_workers($$CREATE FUNCTION adaptive_executor.prepared_statement_count() RETURNS bigint AS 'SELECT count(*) FROM pg_prepared_statements' LANGUAGE sql$$);
+SET citus.max_adaptive_executor_pool_size TO 1;
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+SELECT adaptive_executor.prepared_statement_count() FROM test WHERE x = 1;
+-- DDL on other tables does not invalidate the statements
+SELECT run_command_on_workers($$CREATE FUNCTION adaptive_executor.prepared_statements_before(timestamptz) RETURNS bigint AS 'SELECT count(*) FROM pg_prepared_statements WHERE prepare_time < $1' LANGUAGE sql$$);
+CREATE TABLE other_test (x int);
+SELECT create_distributed_table('other_test','x');
+SELECT clock_timestamp() AS before_ddl \gset
+ALTER TABLE other_test ADD COLUMN y int;
+EXECUTE count_y(2);
+SELECT adaptive_executor.prepared_statements_before(:'before_ddl') FROM test WHERE x = 1;
+DROP TABLE other_test;
+-- statements are deallocated and prepared again after DDL on the table
+ALTER TABLE test ALTER COLUMN y SET DEFAULT 0;
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+SELECT adaptive_executor.prepared_statements_before(:'before_ddl') FROM test WHERE x = 1;
+SELECT adaptive_executor.prepared_statement_count() FROM test WHERE x = 1;
+RESET citus.max_adaptive_executor_pool_size;
+SELECT run_command_on_workers($$DROP FUNCTION adaptive_executor.prepared_statement_count()$$);
+SELECT run_command_on_workers($$DROP FUNCTION adaptive_executor.prepared_statements_before(timestamptz)$$);
+DEALLOCATE count_y;
+DEALLOCATE select_y;
+RESET citus.max_prepared_statements_per_connection;
+
+-- multiple tasks are sent over a connection at once, results are the same
+SET citus.max_pipelined_tasks_per_connection TO 4;
+SET citus.multi_shard_modify_mode TO 'sequential';
+SET citus.log_task_execution TO on;
+SET client_min_messages TO DEBUG1;
+SELECT * FROM test ORDER BY x;
+SELECT count(*) FROM test a JOIN test b USING (x);
+-- tasks with binary results are sent one at a time
+SET citus.enable_binary_protocol TO on;
+SELECT * FROM test ORDER BY x;
+RESET citus.enable_binary_protocol;
+-- tasks with parameters are sent one at a time once the plan is generic
+PREPARE count_y(int) AS SELECT count(*) FROM test WHERE y = $1;
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+EXECUTE count_y(2);
+DEALLOCATE count_y;
+-- with a connection per task there is nothing to pipeline
+RESET citus.multi_shard_modify_mode;
+SET citus.force_max_query_parallelization TO on;
+SELECT count(*) FROM test a JOIN test b USING (x);
+RESET citus.force_max_query_parallelization;
+RESET client_min_messages;
+RESET citus.log_task_execution;
+RESET citus.max_pipelined_tasks_per_connection;
+
+-- pools are sized based on the latency observed by earlier executions
+SET citus.enable_latency_aware_pool_sizing TO on;
+-- open a connection per task to observe the connection establishment time
+SET citus.force_max_query_parallelization TO on;
+SELECT count(*) FROM test a JOIN test b USING (x);
+RESET citus.force_max_query_parallelization;
+SET citus.log_task_execution TO on;
+SET client_min_messages TO DEBUG1;
+SELECT count(*) FROM test a JOIN test b USING (x);
+SELECT * FROM test ORDER BY x;
+RESET client_min_messages;
+RESET citus.log_task_execution;
+RESET citus.enable_latency_aware_pool_sizing;
+
 DROP SCHEMA adaptive_executor CASCADE;
@@ -0,0 +1,48 @@
+CREATE SCHEMA broadcast_joins;
+SET search_path TO broadcast_joins;
+
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801016000;
+SET citus.shard_count TO 4;
+CREATE TABLE orders (order_id int, product_id int);
+SELECT create_distributed_table('orders', 'order_id');
+INSERT INTO orders VALUES (1, 2), (3, 2), (2, 3);
+
+SET citus.shard_count TO 2;
+CREATE TABLE products (product_id int, name text);
+SELECT create_distributed_table('products', 'product_id');
+INSERT INTO products VALUES (2, 'pen'), (3, 'ink');
+CREATE TABLE discontinued_products (product_id int);
+SELECT create_distributed_table('discontinued_products', 'product_id');
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- orders and products are not colocated, and broadcast joins are disabled by default
+SELECT o.order_id, p.name FROM orders o JOIN products p ON (o.product_id = p.product_id) ORDER BY o.order_id;
+SET citus.broadcast_join_threshold TO '1MB';
+
+-- without shard statistics the sizes of the tables are unknown, so nothing is broadcast
+SELECT sum(shardlength) FROM pg_dist_placement JOIN pg_dist_shard USING (shardid)
+WHERE logicalrelid IN ('orders'::regclass, 'products'::regclass);
+SELECT o.order_id, p.name FROM orders o JOIN products p ON (o.product_id = p.product_id) ORDER BY o.order_id;
+
+-- with shard statistics, the products table is smaller than the orders table
+-- and is broadcast to all nodes
+SELECT count(*) FROM (
+  SELECT master_update_shard_statistics(shardid) FROM pg_dist_shard
+  WHERE logicalrelid IN ('orders'::regclass, 'products'::regclass)) s;
+SELECT o.order_id, p.name FROM orders o JOIN products p ON (o.product_id = p.product_id) ORDER BY o.order_id;
+SELECT count(*) FROM orders o, products p WHERE o.product_id = p.product_id AND p.name = 'pen';
+
+-- empty tables have no size either and are not broadcast
+SELECT count(*) FROM (
+  SELECT master_update_shard_statistics(shardid) FROM pg_dist_shard
+  WHERE logicalrelid IN ('discontinued_products'::regclass)) s;
+SELECT count(*) FROM orders o JOIN discontinued_products d ON (o.product_id = d.product_id);
+
+-- the two shards of the products table together are larger than 8kB
+SET citus.broadcast_join_threshold TO '8kB';
+SELECT o.order_id, p.name FROM orders o JOIN products p ON (o.product_id = p.product_id) ORDER BY o.order_id;
+RESET citus.broadcast_join_threshold;
+
+DROP SCHEMA broadcast_joins CASCADE;
@@ -0,0 +1,37 @@
+CREATE SCHEMA custom_aggregates;
+SET search_path TO custom_aggregates;
+
+CREATE TABLE sales (store_id int, units int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801017000;
+SELECT create_distributed_table('sales','store_id');
+INSERT INTO sales VALUES (1, 5), (2, 3), (3, 7), (4, 1), (5, 4), (6, 2);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- user-defined aggregates with combine functions are computed in two phases
+CREATE AGGREGATE psum(int) (sfunc = int4pl, stype = int, combinefunc = int4pl);
+SELECT run_command_on_workers($$CREATE AGGREGATE custom_aggregates.psum(int) (sfunc = int4pl, stype = int, combinefunc = int4pl)$$);
+CREATE AGGREGATE pmax(int) (sfunc = int4larger, stype = int, combinefunc = int4larger);
+SELECT run_command_on_workers($$CREATE AGGREGATE custom_aggregates.pmax(int) (sfunc = int4larger, stype = int, combinefunc = int4larger)$$);
+
+-- workers compute the transition states, which the coordinator combines
+SET client_min_messages TO DEBUG4;
+\a\t
+EXPLAIN (COSTS FALSE) SELECT psum(units) FROM sales;
+\a\t
+RESET client_min_messages;
+
+SELECT psum(units), pmax(units) FROM sales;
+SELECT store_id % 2 AS parity, psum(units), pmax(units), psum(store_id) FROM sales GROUP BY 1 ORDER BY 1;
+SELECT psum(units) FILTER (WHERE store_id > 3) FROM sales;
+SELECT psum(DISTINCT units) FROM sales;
+
+DROP AGGREGATE psum(int);
+SELECT run_command_on_workers($$DROP AGGREGATE custom_aggregates.psum(int)$$);
+DROP AGGREGATE pmax(int);
+SELECT run_command_on_workers($$DROP AGGREGATE custom_aggregates.pmax(int)$$);
+
+DROP SCHEMA custom_aggregates CASCADE;
@@ -0,0 +1,51 @@
+CREATE SCHEMA generic_distributed_plans;
+SET search_path TO generic_distributed_plans;
+
+CREATE TABLE tenant_events (tenant_id int, event_count int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801011000;
+SELECT create_distributed_table('tenant_events','tenant_id');
+INSERT INTO tenant_events VALUES (1,10), (1,20), (3,5), (5,7), (6,4);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- prepared multi-shard queries get a generic plan that prunes shards on execution
+SET citus.enable_generic_distributed_plans TO on;
+PREPARE tenant_totals(int, int) AS
+  SELECT count(*), sum(event_count) FROM tenant_events WHERE tenant_id = $1 OR tenant_id = $2;
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+
+-- the shard queries of the generic plan are explained with the parameter values
+\a\t
+EXPLAIN (COSTS FALSE) EXECUTE tenant_totals(1, 3);
+\a\t
+
+-- other parameter values prune to other shards
+EXECUTE tenant_totals(3, 5);
+EXECUTE tenant_totals(6, 2);
+DEALLOCATE tenant_totals;
+
+-- otherwise the query is planned again with the parameter values, and the
+-- shard queries are explained without parameters
+RESET citus.enable_generic_distributed_plans;
+PREPARE tenant_totals(int, int) AS
+  SELECT count(*), sum(event_count) FROM tenant_events WHERE tenant_id = $1 OR tenant_id = $2;
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+EXECUTE tenant_totals(1, 3);
+\a\t
+EXPLAIN (COSTS FALSE) EXECUTE tenant_totals(1, 3);
+\a\t
+DEALLOCATE tenant_totals;
+
+DROP SCHEMA generic_distributed_plans CASCADE;
@@ -0,0 +1,31 @@
+CREATE SCHEMA in_list_pruning;
+SET search_path TO in_list_pruning;
+
+CREATE TABLE orders (customer_id int, order_total int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801013000;
+SELECT create_distributed_table('orders','customer_id');
+INSERT INTO orders SELECT c, c * 10 FROM generate_series(1, 10) c;
+INSERT INTO orders VALUES (3, 5);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- customers 1, 5, 8 and 10 all hash to the first shard, which is found
+-- for all values of the IN list at once
+SET client_min_messages TO DEBUG4;
+\a\t
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM orders WHERE customer_id IN (1, 5, 8, 10);
+\a\t
+RESET client_min_messages;
+
+-- NULLs and values without rows do not match any shard
+SELECT * FROM orders WHERE customer_id IN (1, 3, 5, 7, NULL) ORDER BY 1, 2;
+SELECT count(*), sum(order_total) FROM orders WHERE customer_id IN (2, 4, 6, 8, 10, 12);
+
+-- other constraints on the distribution column further restrict the shards
+SELECT count(*) FROM orders WHERE customer_id = ANY(ARRAY[1, 2, 3, 4]) AND customer_id IN (3, 4);
+SELECT count(*) FROM orders WHERE customer_id IN (1::bigint, 2::bigint) OR customer_id IN (NULL, NULL);
+
+DROP SCHEMA in_list_pruning CASCADE;
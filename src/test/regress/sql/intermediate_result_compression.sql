@@ -0,0 +1,47 @@
+CREATE SCHEMA intermediate_result_compression;
+SET search_path TO intermediate_result_compression;
+
+CREATE TABLE test (x int, y int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801024000;
+SELECT create_distributed_table('test','x');
+INSERT INTO test VALUES (1,2);
+INSERT INTO test VALUES (3,2);
+INSERT INTO test VALUES (2,3);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- intermediate results can be written in compressed blocks
+SET citus.compress_intermediate_results TO on;
+WITH c AS (SELECT x, repeat(md5(y::text), 5000) AS r FROM test) SELECT count(*), sum(length(r)) FROM c;
+WITH c AS (SELECT y FROM test ORDER BY x LIMIT 2) SELECT count(*) FROM test WHERE y IN (SELECT y FROM c);
+RESET citus.compress_intermediate_results;
+
+-- compressed results take much less space than uncompressed ones
+BEGIN;
+SET LOCAL citus.compress_intermediate_results TO on;
+SELECT create_intermediate_result('compressed', 'SELECT repeat(''compressible '', 10000) FROM generate_series(1, 10)');
+SET LOCAL citus.compress_intermediate_results TO off;
+SELECT create_intermediate_result('uncompressed', 'SELECT repeat(''compressible '', 10000) FROM generate_series(1, 10)');
+-- assembling a result from its pieces returns its size in bytes
+SELECT fetch_intermediate_result_pieces('uncompressed_copy', ARRAY['uncompressed'], ARRAY['localhost'], ARRAY[57636]);
+SELECT fetch_intermediate_result_pieces('compressed_copy', ARRAY['compressed'], ARRAY['localhost'], ARRAY[57636]) < 1300081 / 10 AS compressed;
+SELECT count(*), sum(length(r)) FROM read_intermediate_result('compressed', 'binary') AS res (r text);
+SELECT count(*), sum(length(r)) FROM read_intermediate_result('compressed_copy', 'binary') AS res (r text);
+END;
+
+-- a failed read of a compressed result does not affect the next read
+BEGIN;
+SET LOCAL citus.compress_intermediate_results TO on;
+SELECT create_intermediate_result('squares', 'SELECT s, s * s FROM generate_series(1, 5) s');
+SELECT * FROM read_intermediate_result('squares', 'binary') AS res (x int);
+END;
+BEGIN;
+SET LOCAL citus.compress_intermediate_results TO on;
+SELECT create_intermediate_result('squares', 'SELECT s, s * s FROM generate_series(1, 5) s');
+SELECT * FROM read_intermediate_result('squares', 'binary') AS res (x int, x2 int) ORDER BY x;
+END;
+
+DROP SCHEMA intermediate_result_compression CASCADE;
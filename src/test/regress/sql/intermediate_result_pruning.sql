@@ -0,0 +1,36 @@
+CREATE SCHEMA intermediate_result_pruning;
+SET search_path TO intermediate_result_pruning;
+
+CREATE TABLE orders (customer_id int, amount int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801020000;
+SELECT create_distributed_table('orders','customer_id');
+INSERT INTO orders VALUES (1, 20);
+INSERT INTO orders VALUES (3, 20);
+INSERT INTO orders VALUES (2, 30);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- intermediate results are only sent to the nodes that read them
+SET citus.log_intermediate_results TO on;
+SET client_min_messages TO DEBUG1;
+
+-- router queries only read the result on the node of their shard, which is
+-- the first worker for customer 1 and the second worker for customer 3
+WITH c AS (SELECT amount FROM orders ORDER BY customer_id LIMIT 2)
+SELECT customer_id, amount FROM orders WHERE customer_id = 1 AND amount IN (SELECT amount FROM c);
+WITH c AS (SELECT amount FROM orders ORDER BY customer_id LIMIT 2)
+SELECT customer_id, amount FROM orders WHERE customer_id = 3 AND amount IN (SELECT amount FROM c);
+
+-- the tasks of the multi-shard query read the result on all nodes
+WITH c AS (SELECT max(amount) AS m FROM orders) SELECT count(*) FROM orders WHERE amount = (SELECT m FROM c);
+
+-- CTEs that only read other CTEs run on the coordinator and read local files
+WITH a AS (SELECT customer_id FROM orders ORDER BY customer_id LIMIT 2), b AS (SELECT count(*) AS c FROM a)
+SELECT customer_id, amount FROM orders WHERE customer_id = (SELECT c FROM b);
+RESET client_min_messages;
+RESET citus.log_intermediate_results;
+
+DROP SCHEMA intermediate_result_pruning CASCADE;
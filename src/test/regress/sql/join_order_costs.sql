@@ -0,0 +1,49 @@
+CREATE SCHEMA join_order_costs;
+SET search_path TO join_order_costs;
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801015000;
+CREATE TABLE page_views (page_id int, visitor_id int);
+SELECT create_distributed_table('page_views', 'page_id');
+CREATE TABLE visitors (visitor_key int, visitor_id int, country_id int);
+SELECT create_distributed_table('visitors', 'visitor_key');
+CREATE TABLE countries (country_key int, country_id int);
+SELECT create_distributed_table('countries', 'country_key');
+INSERT INTO page_views SELECT i, i FROM generate_series(1, 1000) i;
+INSERT INTO visitors VALUES (1, 1, 1), (2, 2, 2);
+INSERT INTO countries VALUES (1, 1);
+
+SET citus.task_executor_type TO 'adaptive';
+SET citus.enable_repartition_joins TO on;
+SET citus.log_multi_join_order TO on;
+SET client_min_messages TO LOG;
+
+-- by default, the join order follows the order of the tables in the query
+SELECT count(*) FROM page_views p, visitors v, countries c
+WHERE p.visitor_id = v.visitor_id AND v.country_id = c.country_id;
+
+-- join orders are chosen by the estimated amount of data that repartition joins transfer
+SET citus.enable_cost_based_join_order TO on;
+
+-- shard sizes of hash-distributed tables are not in the metadata until the shard
+-- statistics are updated, and the planner does not ask the workers, so the
+-- rule-based join order is used
+SELECT sum(shardlength) FROM pg_dist_placement JOIN pg_dist_shard USING (shardid)
+WHERE logicalrelid IN ('page_views'::regclass, 'visitors'::regclass, 'countries'::regclass);
+SELECT count(*) FROM page_views p, visitors v, countries c
+WHERE p.visitor_id = v.visitor_id AND v.country_id = c.country_id;
+
+-- with shard statistics, the table that transfers the least data is joined first
+SELECT count(*) FROM (
+  SELECT master_update_shard_statistics(shardid) FROM pg_dist_shard
+  WHERE logicalrelid IN ('page_views'::regclass, 'visitors'::regclass, 'countries'::regclass)) s;
+SELECT count(*) FROM page_views p, visitors v, countries c
+WHERE p.visitor_id = v.visitor_id AND v.country_id = c.country_id;
+
+RESET client_min_messages;
+RESET citus.log_multi_join_order;
+RESET citus.enable_cost_based_join_order;
+RESET citus.enable_repartition_joins;
+
+DROP SCHEMA join_order_costs CASCADE;
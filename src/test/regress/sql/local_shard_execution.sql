@@ -0,0 +1,56 @@
+CREATE SCHEMA local_shard_execution;
+SET search_path TO local_shard_execution;
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.replication_model TO 'streaming';
+SET citus.next_shard_id TO 1470000;
+
+CREATE TABLE reference_table (key int PRIMARY KEY);
+SELECT create_reference_table('reference_table');
+
+CREATE TABLE distributed_table (key int PRIMARY KEY, value int);
+SELECT create_distributed_table('distributed_table', 'key');
+
+INSERT INTO distributed_table SELECT i, i FROM generate_series(1, 10) i;
+
+\c - - - :worker_1_port
+SET search_path TO local_shard_execution;
+SET citus.enable_local_execution TO on;
+
+-- reference tables always have a placement on the worker
+BEGIN;
+INSERT INTO reference_table VALUES (1) RETURNING *;
+SELECT count(*) FROM reference_table;
+
+-- after a local execution, multi-shard queries also use the local shards
+SELECT count(*) FROM distributed_table;
+
+-- rows returned by local tasks count towards the LIMIT of the query
+SELECT count(*) FROM (SELECT key FROM distributed_table LIMIT 2) t;
+COMMIT;
+
+-- the remote placement of the reference table is modified as well
+\c - - - :worker_2_port
+SELECT count(*) FROM local_shard_execution.reference_table;
+
+\c - - - :worker_1_port
+SET search_path TO local_shard_execution;
+SET citus.enable_local_execution TO on;
+
+-- commands that can only go over connections error out after a local execution
+BEGIN;
+SELECT count(*) FROM reference_table;
+INSERT INTO reference_table SELECT i FROM generate_series(2, 3) i;
+ROLLBACK;
+
+-- without local execution the same transaction works fine
+BEGIN;
+SET LOCAL citus.enable_local_execution TO off;
+SELECT count(*) FROM reference_table;
+INSERT INTO reference_table SELECT i FROM generate_series(2, 3) i;
+SELECT count(*) FROM reference_table;
+ROLLBACK;
+
+\c - - - :master_port
+DROP SCHEMA local_shard_execution CASCADE;
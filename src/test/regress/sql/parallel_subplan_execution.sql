@@ -0,0 +1,62 @@
+CREATE SCHEMA parallel_subplan_execution;
+SET search_path TO parallel_subplan_execution;
+
+CREATE TABLE test (x int, y int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801021000;
+SELECT create_distributed_table('test','x');
+INSERT INTO test VALUES (1,2);
+INSERT INTO test VALUES (3,2);
+INSERT INTO test VALUES (2,3);
+
+SET citus.task_executor_type TO 'adaptive';
+
+SET citus.log_intermediate_results TO on;
+SET client_min_messages TO DEBUG1;
+
+-- by default, the subplans execute their tasks one after the other
+SHOW citus.enable_parallel_subplan_execution;
+WITH a AS (SELECT max(x) AS m FROM test), b AS (SELECT count(*) AS c FROM test WHERE y = 2) SELECT x, m, c FROM test, a, b WHERE x = 1;
+
+-- the tasks of independent subplans are executed concurrently
+SET citus.enable_parallel_subplan_execution TO on;
+WITH a AS (SELECT max(x) AS m FROM test), b AS (SELECT count(*) AS c FROM test WHERE y = 2) SELECT x, m, c FROM test, a, b WHERE x = 1;
+-- subplans that read the results of earlier subplans wait for them
+WITH a AS (SELECT y FROM test ORDER BY x LIMIT 2),
+     b AS (SELECT count(*) AS c FROM test WHERE y IN (SELECT y FROM a)),
+     c AS (SELECT sum(x) AS s FROM test)
+SELECT x, c, s FROM test, b, c WHERE x = 1;
+-- subplans with a LIMIT are executed on their own
+WITH a AS (SELECT x FROM test LIMIT 1), b AS (SELECT max(y) AS m FROM test), c AS (SELECT min(y) AS n FROM test)
+SELECT count(*), max(m), max(n) FROM test, a, b, c WHERE test.x = 1;
+-- the rows of concurrently executed tasks can be transferred in binary format
+SET citus.enable_binary_protocol TO on;
+WITH a AS (SELECT max(x) AS m FROM test), b AS (SELECT count(*) AS c FROM test WHERE y = 2) SELECT x, m, c FROM test, a, b WHERE x = 1;
+RESET citus.enable_binary_protocol;
+RESET client_min_messages;
+RESET citus.log_intermediate_results;
+
+-- prefetched rows of subplans that fail in a subtransaction are discarded
+CREATE FUNCTION failing_subplan_count() RETURNS bigint AS $$
+DECLARE
+  result bigint;
+BEGIN
+  BEGIN
+    WITH a AS (SELECT count(*) / 0 AS r FROM test), b AS (SELECT max(y) AS m FROM test)
+    SELECT r INTO result FROM a, b;
+  EXCEPTION WHEN division_by_zero THEN
+    result := -1;
+  END;
+  RETURN result;
+END;
+$$ LANGUAGE plpgsql;
+BEGIN;
+SELECT failing_subplan_count();
+WITH a AS (SELECT max(x) AS m FROM test), b AS (SELECT count(*) AS c FROM test WHERE y = 2) SELECT x, m, c FROM test, a, b WHERE x = 1;
+WITH a AS (SELECT max(y) AS m FROM test), b AS (SELECT count(*) AS c FROM test) SELECT m, c FROM a, b;
+COMMIT;
+RESET citus.enable_parallel_subplan_execution;
+
+DROP SCHEMA parallel_subplan_execution CASCADE;
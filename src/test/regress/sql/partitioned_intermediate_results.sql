@@ -0,0 +1,54 @@
+CREATE SCHEMA partitioned_intermediate_results;
+SET search_path TO partitioned_intermediate_results;
+
+CREATE TABLE test (x int, y int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801023000;
+SELECT create_distributed_table('test','x');
+INSERT INTO test VALUES (1,2);
+INSERT INTO test VALUES (3,2);
+INSERT INTO test VALUES (2,3);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- tasks that join a shard with an intermediate result read only their partition
+SET citus.enable_partitioned_intermediate_results TO on;
+SELECT count(*), sum(t.y) FROM test t JOIN (SELECT y AS k FROM test ORDER BY x LIMIT 3) s ON t.x = s.k;
+SET citus.enable_worker_to_worker_intermediate_results TO on;
+SET citus.max_intermediate_result_size TO -1;
+WITH c AS (SELECT x, y FROM test WHERE y = 2) SELECT count(*), sum(c.y) FROM test t JOIN c ON t.x = c.x;
+RESET citus.max_intermediate_result_size;
+RESET citus.enable_worker_to_worker_intermediate_results;
+
+-- the coordinator only sends each node the partitions of its shards
+SET citus.log_intermediate_results TO on;
+SET client_min_messages TO DEBUG1;
+WITH c AS (SELECT y AS k FROM test ORDER BY x LIMIT 3) SELECT count(*), sum(t.y) FROM test t JOIN c ON t.x = c.k;
+RESET client_min_messages;
+RESET citus.log_intermediate_results;
+RESET citus.enable_partitioned_intermediate_results;
+
+-- rows are partitioned by the hash of the partition column
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'hash',
+       ARRAY['-2147483648', '0'], ARRAY['-1', '2147483647']);
+-- or by its value
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['1', '4', '7'], ARRAY['3', '6', '10']);
+-- only the given partitions are written
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['1', '4', '7'], ARRAY['3', '6', '10'], ARRAY[0, 2]);
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'hash',
+       ARRAY['-2147483648', '0'], ARRAY['-1', '2147483647'], ARRAY[1]);
+-- split points must be sorted and must not overlap
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['1', '3'], ARRAY['4', '10']);
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['5', '1'], ARRAY['10', '4']);
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['5'], ARRAY['1']);
+SELECT * FROM worker_partition_query_result('squares', 'SELECT i, i * i FROM generate_series(1, 10) i', 0, 'range',
+       ARRAY['1', '4'], ARRAY['3', '10'], ARRAY[2]);
+
+DROP SCHEMA partitioned_intermediate_results CASCADE;
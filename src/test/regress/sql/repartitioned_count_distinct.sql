@@ -0,0 +1,32 @@
+CREATE SCHEMA repartitioned_count_distinct;
+SET search_path TO repartitioned_count_distinct;
+
+CREATE TABLE page_views (page_id int, visitor_id int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801018000;
+SELECT create_distributed_table('page_views','page_id');
+INSERT INTO page_views VALUES (1, 10), (2, 10), (3, 20), (4, 30), (5, 20), (6, 10), (7, 40), (8, 30);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- count(distinct) on non-distribution columns is computed by repartitioning
+SET citus.enable_repartitioned_count_distinct TO on;
+SET citus.enable_repartition_joins TO on;
+
+-- the page views are hash partitioned on visitor_id in a map merge job
+\a\t
+EXPLAIN (COSTS FALSE) SELECT count(DISTINCT visitor_id) FROM page_views;
+\a\t
+
+-- visitors that viewed pages in multiple shards are counted once
+SELECT count(DISTINCT visitor_id) FROM page_views;
+SELECT count(DISTINCT visitor_id) FROM page_views WHERE page_id > 5;
+SELECT page_id % 2 AS parity, count(DISTINCT visitor_id) FROM page_views GROUP BY 1 ORDER BY 1;
+SELECT count(DISTINCT visitor_id), count(DISTINCT visitor_id) + 1 AS c FROM page_views
+HAVING count(DISTINCT visitor_id) > 1;
+RESET citus.enable_repartition_joins;
+RESET citus.enable_repartitioned_count_distinct;
+
+DROP SCHEMA repartitioned_count_distinct CASCADE;
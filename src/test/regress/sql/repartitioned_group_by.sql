@@ -0,0 +1,33 @@
+CREATE SCHEMA repartitioned_group_by;
+SET search_path TO repartitioned_group_by;
+
+CREATE TABLE orders (order_id int, customer_id int, amount int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801019000;
+SELECT create_distributed_table('orders','order_id');
+INSERT INTO orders VALUES
+  (1, 100, 10), (2, 200, 20), (3, 100, 30), (4, 300, 5),
+  (5, 200, 15), (6, 100, 20), (7, 300, 25), (8, 400, 40);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- groups on non-distribution columns are finalized on the workers by repartitioning
+SET citus.enable_repartitioned_group_by TO on;
+SET citus.enable_repartition_joins TO on;
+
+-- the partial aggregates of the orders are hash partitioned on customer_id in a map merge job
+\a\t
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM orders GROUP BY customer_id;
+\a\t
+
+-- the orders of each customer are spread across shards
+SELECT customer_id, count(*), sum(amount) FROM orders GROUP BY customer_id ORDER BY customer_id;
+SELECT customer_id, sum(amount) FROM orders GROUP BY customer_id ORDER BY 2 DESC LIMIT 1;
+SELECT customer_id, avg(amount) FROM orders GROUP BY customer_id HAVING count(*) > 2;
+SELECT count(*) FROM orders GROUP BY customer_id ORDER BY 1;
+RESET citus.enable_repartition_joins;
+RESET citus.enable_repartitioned_group_by;
+
+DROP SCHEMA repartitioned_group_by CASCADE;
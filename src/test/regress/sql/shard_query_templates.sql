@@ -0,0 +1,27 @@
+CREATE SCHEMA shard_query_templates;
+SET search_path TO shard_query_templates;
+
+CREATE TABLE test (x int, y int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801012000;
+SELECT create_distributed_table('test','x');
+INSERT INTO test VALUES (1,2);
+INSERT INTO test VALUES (3,2);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- the query strings of other shards are generated from the query string of the first shard
+SET client_min_messages TO DEBUG4;
+\a\t
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM test;
+\a\t
+RESET client_min_messages;
+SELECT count(*) FROM test;
+
+-- shard names are only substituted in the FROM clause of shard queries
+SELECT x, 'shard_query_templates.test_801012000' AS t FROM test ORDER BY x;
+SELECT count(*) FROM test a JOIN test b USING (x) WHERE a.y = 2;
+
+DROP SCHEMA shard_query_templates CASCADE;
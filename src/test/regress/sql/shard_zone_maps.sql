@@ -0,0 +1,65 @@
+CREATE SCHEMA shard_zone_maps;
+SET search_path TO shard_zone_maps;
+
+-- shards of append-distributed tables are pruned using zone maps of other columns
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801014000;
+CREATE TABLE events (event_time date, event_id int, payload text, flag bool, uid uuid);
+SELECT create_distributed_table('events', 'event_time', 'append');
+COPY events FROM STDIN WITH (FORMAT csv);
+2019-01-01,1,a,false,00000000-0000-0000-0000-000000000001
+2019-01-02,2,b,false,00000000-0000-0000-0000-000000000002
+\.
+COPY events FROM STDIN WITH (FORMAT csv);
+2019-01-03,3,c,true,00000000-0000-0000-0000-000000000003
+2019-01-04,4,,true,
+\.
+COPY events FROM STDIN WITH (FORMAT csv);
+2019-01-05,5,e,false,00000000-0000-0000-0000-000000000005
+2019-01-06,,f,true,00000000-0000-0000-0000-000000000006
+\.
+SELECT master_add_zone_map_column('events', 'event_id');
+SELECT master_add_zone_map_column('events', 'payload');
+-- types without min and max aggregates use their sort order
+SELECT master_add_zone_map_column('events', 'flag');
+SELECT master_add_zone_map_column('events', 'uid');
+SELECT master_add_zone_map_column('events', 'event_time');
+SELECT master_add_zone_map_column('events', 'event_id');
+SELECT logicalrelid, attnum FROM citus.pg_dist_zone_map_column ORDER BY attnum;
+SELECT shardid, attnum, minvalue, maxvalue, nullcount
+FROM citus.pg_dist_shard_zone_map JOIN pg_dist_shard USING (shardid)
+WHERE logicalrelid = 'events'::regclass ORDER BY shardid, attnum;
+SELECT coordinator_plan($Q$
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM events WHERE event_id = 3
+$Q$);
+SELECT count(*) FROM events WHERE event_id = 3;
+SELECT coordinator_plan($Q$
+EXPLAIN (COSTS FALSE) SELECT event_time, event_id, payload FROM events WHERE event_id > 2 AND 'd' > payload
+$Q$);
+SELECT event_time, event_id, payload FROM events WHERE event_id > 2 AND 'd' > payload;
+SELECT count(*) FROM events WHERE payload IS NULL;
+SELECT count(*) FROM events WHERE event_id IS NULL OR event_id = 1;
+SELECT coordinator_plan($Q$
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM events WHERE flag < true
+$Q$);
+SELECT count(*) FROM events WHERE flag < true;
+SELECT coordinator_plan($Q$
+EXPLAIN (COSTS FALSE) SELECT count(*) FROM events WHERE uid = '00000000-0000-0000-0000-000000000003'
+$Q$);
+SELECT count(*) FROM events WHERE uid = '00000000-0000-0000-0000-000000000003';
+
+-- zone maps are removed when rows are written to the shards
+UPDATE events SET event_id = 10 WHERE event_id = 1;
+SELECT count(*)
+FROM citus.pg_dist_shard_zone_map JOIN pg_dist_shard USING (shardid)
+WHERE logicalrelid = 'events'::regclass;
+SELECT count(*) FROM events WHERE event_id = 10;
+SELECT count(*) FROM (
+  SELECT master_update_shard_statistics(shardid) FROM pg_dist_shard
+  WHERE logicalrelid = 'events'::regclass) s;
+SELECT count(*) FROM events WHERE event_id = 10;
+SELECT count(*) FROM events WHERE event_id = 1;
+DROP TABLE events;
+SELECT count(*) FROM citus.pg_dist_zone_map_column;
+
+DROP SCHEMA shard_zone_maps CASCADE;
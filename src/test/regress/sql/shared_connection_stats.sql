@@ -0,0 +1,28 @@
+CREATE SCHEMA shared_connection_stats;
+SET search_path TO shared_connection_stats;
+
+-- all backends apply the same limit, which can only be set at server start
+SHOW citus.max_shared_pool_size;
+SET citus.max_shared_pool_size TO 1;
+
+SET citus.shard_count TO 8;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801010000;
+CREATE TABLE page_views (page_id int, view_count int);
+SELECT create_distributed_table('page_views', 'page_id');
+INSERT INTO page_views SELECT i, i * 10 FROM generate_series(1, 16) i;
+
+SET citus.task_executor_type TO 'adaptive';
+SET citus.max_adaptive_executor_pool_size TO 2;
+SET citus.executor_slow_start_interval TO '0ms';
+
+-- the default limit of max_connections allows opening all connections of the pool
+BEGIN;
+SELECT count(*), sum(view_count) FROM (SELECT page_id, view_count, pg_sleep(0.05) FROM page_views) v;
+SELECT sum(result::bigint) FROM run_command_on_workers($$
+  SELECT count(*) FROM pg_stat_activity
+  WHERE pid <> pg_backend_pid() AND query LIKE '%8010100%'
+$$);
+END;
+
+DROP SCHEMA shared_connection_stats CASCADE;
@@ -0,0 +1,42 @@
+CREATE SCHEMA worker_to_worker_intermediate_results;
+SET search_path TO worker_to_worker_intermediate_results;
+
+CREATE TABLE test (x int, y int);
+
+SET citus.shard_count TO 4;
+SET citus.shard_replication_factor TO 1;
+SET citus.next_shard_id TO 801022000;
+SELECT create_distributed_table('test','x');
+INSERT INTO test VALUES (1,2);
+INSERT INTO test VALUES (3,2);
+INSERT INTO test VALUES (2,3);
+
+SET citus.task_executor_type TO 'adaptive';
+
+-- subplan results can stay on the workers and be fetched between workers
+SET citus.enable_worker_to_worker_intermediate_results TO on;
+SET citus.log_intermediate_results TO on;
+SET client_min_messages TO DEBUG1;
+
+-- the coordinator cannot enforce the size limit on rows that it does not see
+SHOW citus.max_intermediate_result_size;
+WITH c AS (SELECT x, y FROM test WHERE y = 2) SELECT count(*), sum(c.x) FROM test, c WHERE test.x = 1;
+SET citus.max_intermediate_result_size TO -1;
+WITH c AS (SELECT x, y FROM test WHERE y = 2) SELECT count(*), sum(c.x) FROM test, c WHERE test.x = 1;
+WITH c AS (SELECT x FROM test) SELECT count(*) FROM test WHERE x IN (SELECT x FROM c);
+RESET client_min_messages;
+
+-- pieces can be fetched in transactions that are committed with 2PC
+SET citus.multi_shard_commit_protocol TO '2pc';
+BEGIN;
+UPDATE test SET y = y + 1;
+SET LOCAL client_min_messages TO DEBUG1;
+WITH c AS (SELECT x, y FROM test WHERE y = 3) SELECT count(*), sum(c.x) FROM test, c WHERE test.x = 1;
+COMMIT;
+SELECT * FROM test ORDER BY x;
+RESET citus.multi_shard_commit_protocol;
+RESET citus.max_intermediate_result_size;
+RESET citus.log_intermediate_results;
+RESET citus.enable_worker_to_worker_intermediate_results;
+
+DROP SCHEMA worker_to_worker_intermediate_results CASCADE;